@@ -0,0 +1,77 @@
+// span.h
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// A subset of C++20 std::span for older compilers.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+
+#if __cplusplus >= 202002L
+#include <span>
+namespace celestia
+{
+using std::span;
+}
+#else
+namespace celestia
+{
+// A subset of C++20 std::span with a dynamic extent: a non-owning view
+// of a contiguous sequence of objects.
+template<typename T> class span
+{
+ public:
+    typedef T              element_type;
+    typedef typename std::remove_cv<T>::type value_type;
+    typedef std::size_t    size_type;
+    typedef T*             pointer;
+    typedef T&             reference;
+    typedef T*             iterator;
+
+    constexpr span() noexcept = default;
+    constexpr span(pointer data, size_type size) noexcept :
+        m_data(data),
+        m_size(size)
+    {}
+
+    // Any container with contiguous storage, such as std::vector
+    template<typename C,
+             typename = typename std::enable_if<std::is_convertible<decltype(std::declval<C&>().data()), pointer>::value>::type>
+    constexpr span(C& c) noexcept :
+        m_data(c.data()),
+        m_size(c.size())
+    {}
+
+    // span<U> converts to span<const U>
+    template<typename U,
+             typename = typename std::enable_if<std::is_convertible<U(*)[], T(*)[]>::value>::type>
+    constexpr span(const span<U>& s) noexcept :
+        m_data(s.data()),
+        m_size(s.size())
+    {}
+
+    constexpr pointer   data() const noexcept  { return m_data; }
+    constexpr size_type size() const noexcept  { return m_size; }
+    constexpr bool      empty() const noexcept { return m_size == 0; }
+
+    constexpr reference operator[](size_type i) const { return m_data[i]; }
+
+    constexpr iterator begin() const noexcept { return m_data; }
+    constexpr iterator end() const noexcept   { return m_data + m_size; }
+
+    constexpr span first(size_type count) const { return span(m_data, count); }
+    constexpr span subspan(size_type offset, size_type count) const { return span(m_data + offset, count); }
+
+ private:
+    pointer   m_data{ nullptr };
+    size_type m_size{ 0 };
+};
+}
+#endif
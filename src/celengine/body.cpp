@@ -196,6 +196,25 @@ const Timeline* Body::getTimeline() const
 }
 
 
+bool Body::isThreadSafe() const
+{
+    if (timeline == nullptr)
+        return true;
+
+    for (unsigned int i = 0; i < timeline->phaseCount(); i++)
+    {
+        const auto& phase = timeline->getPhase(i);
+        if (!phase->orbit()->isThreadSafe() || !phase->rotationModel()->isThreadSafe())
+            return false;
+
+        if (!phase->orbitFrame()->isThreadSafe() || !phase->bodyFrame()->isThreadSafe())
+            return false;
+    }
+
+    return true;
+}
+
+
 void Body::setTimeline(Timeline* newTimeline)
 {
     if (timeline != newTimeline)
@@ -210,6 +210,9 @@ class Body : public AstroObject
 
     void setTimeline(Timeline* timeline);
     const Timeline* getTimeline() const;
+    // Whether the positions and orientations of the body may be computed
+    // on several threads at once
+    bool isThreadSafe() const;
 
     FrameTree* getFrameTree() const;
     FrameTree* getOrCreateFrameTree();
@@ -7,6 +7,7 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <map>
 #include <celutil/util.h>
 #include "constellation.h"
 
@@ -122,17 +123,22 @@ Constellation* Constellation::getConstellation(unsigned int n)
 
 Constellation* Constellation::getConstellation(const string& name)
 {
-    for (auto& cons: constellations)
+    // Star names are resolved by trying the last word as a constellation,
+    // so this is called for almost every lookup of a star by name.
+    static const map<string, Constellation*, CompareIgnoringCasePredicate> index = []()
     {
-        if (compareIgnoringCase(name, cons.getAbbreviation()) == 0 ||
-            compareIgnoringCase(name, cons.getGenitive()) == 0     ||
-            compareIgnoringCase(name, cons.getName()) == 0)
+        map<string, Constellation*, CompareIgnoringCasePredicate> m;
+        for (auto& cons: constellations)
         {
-            return &cons;
+            m.emplace(cons.abbrev, &cons);
+            m.emplace(cons.genitive, &cons);
+            m.emplace(cons.name, &cons);
         }
-    }
+        return m;
+    }();
 
-    return nullptr;
+    auto iter = index.find(name);
+    return iter != index.end() ? iter->second : nullptr;
 }
 
 const string Constellation::getName() const
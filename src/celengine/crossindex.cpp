@@ -0,0 +1,304 @@
+// crossindex.cpp
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// Cross indexes between star catalogs and Celestia catalog numbers.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <fmt/printf.h>
+#include <celutil/bytes.h>
+#include <celutil/gettext.h>
+#include "crossindex.h"
+
+using namespace std;
+
+
+constexpr const char     CROSSINDEX_FILE_HEADER[] = "CELINDEX";
+constexpr const uint16_t UNSORTED_VERSION = 0x0100;
+constexpr const uint16_t SORTED_VERSION   = 0x0200;
+
+namespace
+{
+// Header of a sorted cross index; all fields are little endian. Version
+// 0x0100 files only have the magic and the version.
+struct SortedHeader
+{
+    char     magic[8];
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t nEntries;
+};
+static_assert(sizeof(SortedHeader) == 16, "Unexpected padding in cross index header");
+static_assert(sizeof(CrossIndex::Entry) == 8, "Unexpected padding in cross index entry");
+
+constexpr const size_t UNSORTED_HEADER_SIZE = sizeof(CROSSINDEX_FILE_HEADER) - 1 + sizeof(uint16_t);
+
+inline bool byCatalogNumber(const CrossIndex::Entry& a, const CrossIndex::Entry& b)
+{
+    return a.catalogNumber < b.catalogNumber;
+}
+
+// Indexes of the entries sorted by Celestia catalog number; the entries
+// are sorted by catalog number, so stars with several catalog numbers
+// have the lowest one first.
+vector<uint32_t> buildReverseIndex(const vector<CrossIndex::Entry>& entries)
+{
+    vector<uint32_t> reverse(entries.size());
+    for (uint32_t i = 0; i < (uint32_t) reverse.size(); i++)
+        reverse[i] = i;
+    stable_sort(reverse.begin(), reverse.end(),
+                [&entries](uint32_t a, uint32_t b)
+                {
+                    return entries[a].celCatalogNumber < entries[b].celCatalogNumber;
+                });
+    return reverse;
+}
+
+inline void swapEntry(CrossIndex::Entry& entry)
+{
+    LE_TO_CPU_INT32(entry.catalogNumber, entry.catalogNumber);
+    LE_TO_CPU_INT32(entry.celCatalogNumber, entry.celCatalogNumber);
+}
+}
+
+
+bool CrossIndex::open(const fs::path& filename)
+{
+    if (!file.open(filename))
+        return false;
+
+    if (!load(file.data(), file.size()))
+    {
+        file.close();
+        return false;
+    }
+
+    // Nothing refers to the mapping when the entries had to be copied
+    if (entries != reinterpret_cast<const Entry*>(file.data() + sizeof(SortedHeader)))
+        file.close();
+
+    return true;
+}
+
+
+bool CrossIndex::load(const char* data, size_t size)
+{
+    if (size < UNSORTED_HEADER_SIZE ||
+        memcmp(data, CROSSINDEX_FILE_HEADER, sizeof(CROSSINDEX_FILE_HEADER) - 1) != 0)
+    {
+        return false;
+    }
+
+    uint16_t version;
+    memcpy(&version, data + sizeof(CROSSINDEX_FILE_HEADER) - 1, sizeof version);
+    LE_TO_CPU_INT16(version, version);
+
+    if (version == UNSORTED_VERSION)
+    {
+        size_t dataSize = size - UNSORTED_HEADER_SIZE;
+        if (dataSize % sizeof(Entry) != 0)
+            return false;
+
+        vector<Entry> unsorted(dataSize / sizeof(Entry));
+        memcpy(unsorted.data(), data + UNSORTED_HEADER_SIZE, dataSize);
+        for (auto& entry : unsorted)
+            swapEntry(entry);
+        stable_sort(unsorted.begin(), unsorted.end(), byCatalogNumber);
+        setEntries(move(unsorted));
+        return true;
+    }
+
+    if (version != SORTED_VERSION || size < sizeof(SortedHeader))
+        return false;
+
+    SortedHeader header;
+    memcpy(&header, data, sizeof header);
+    LE_TO_CPU_INT32(header.nEntries, header.nEntries);
+    uint32_t n = header.nEntries;
+    if (size != sizeof header + (sizeof(Entry) + sizeof(uint32_t)) * (size_t) n)
+        return false;
+
+    const char* entryData   = data + sizeof header;
+    const char* reverseData = entryData + sizeof(Entry) * n;
+#if defined(WORDS_BIGENDIAN) || defined(__BIG_ENDIAN__)
+    entryStorage.resize(n);
+    reverseStorage.resize(n);
+    memcpy(entryStorage.data(), entryData, sizeof(Entry) * n);
+    memcpy(reverseStorage.data(), reverseData, sizeof(uint32_t) * n);
+    for (auto& entry : entryStorage)
+        swapEntry(entry);
+    for (auto& index : reverseStorage)
+        LE_TO_CPU_INT32(index, index);
+    entries = entryStorage.data();
+    reverse = reverseStorage.data();
+#else
+    // The mapping is page aligned and the header is a multiple of 4 bytes,
+    // so the tables can be used in place.
+    entries = reinterpret_cast<const Entry*>(entryData);
+    reverse = reinterpret_cast<const uint32_t*>(reverseData);
+#endif
+    nEntries = n;
+
+    // A bad reverse table would make lookups read past the entries, and
+    // the binary searches need both tables sorted.
+    for (uint32_t i = 0; i < n; i++)
+    {
+        if (reverse[i] >= n ||
+            (i > 0 && (entries[i - 1].catalogNumber > entries[i].catalogNumber ||
+                       entries[reverse[i - 1]].celCatalogNumber > entries[reverse[i]].celCatalogNumber)))
+        {
+            entries  = nullptr;
+            reverse  = nullptr;
+            nEntries = 0;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+bool CrossIndex::load(istream& in)
+{
+    char header[UNSORTED_HEADER_SIZE];
+    in.read(header, sizeof header);
+    if (!in.good() || memcmp(header, CROSSINDEX_FILE_HEADER, sizeof(CROSSINDEX_FILE_HEADER) - 1) != 0)
+    {
+        cerr << _("Bad header for cross index\n");
+        return false;
+    }
+
+    uint16_t version;
+    memcpy(&version, header + sizeof(CROSSINDEX_FILE_HEADER) - 1, sizeof version);
+    LE_TO_CPU_INT16(version, version);
+
+    if (version == SORTED_VERSION)
+    {
+        // Read the whole file and check it like a mapped one
+        string data(header, sizeof header);
+        data.append(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+        if (!load(data.data(), data.size()))
+        {
+            cerr << _("Bad cross index\n");
+            return false;
+        }
+
+        // The tables may point into data
+        vector<Entry> sorted(entries, entries + nEntries);
+        vector<uint32_t> reverseIndex(reverse, reverse + nEntries);
+        entryStorage   = move(sorted);
+        reverseStorage = move(reverseIndex);
+        entries = entryStorage.data();
+        reverse = reverseStorage.data();
+        return true;
+    }
+
+    if (version != UNSORTED_VERSION)
+    {
+        cerr << _("Bad version for cross index\n");
+        return false;
+    }
+
+    vector<Entry> unsorted;
+    unsigned int record = 0;
+    for (;;)
+    {
+        Entry entry;
+        in.read(reinterpret_cast<char*>(&entry.catalogNumber), sizeof entry.catalogNumber);
+        if (in.eof())
+            break;
+
+        in.read(reinterpret_cast<char*>(&entry.celCatalogNumber), sizeof entry.celCatalogNumber);
+        if (in.fail())
+        {
+            fmt::fprintf(cerr, _("Loading cross index failed at record %u\n"), record);
+            return false;
+        }
+
+        swapEntry(entry);
+        unsorted.push_back(entry);
+        record++;
+    }
+
+    stable_sort(unsorted.begin(), unsorted.end(), byCatalogNumber);
+    setEntries(move(unsorted));
+
+    return true;
+}
+
+
+void CrossIndex::setEntries(vector<Entry>&& sortedEntries)
+{
+    reverseStorage = buildReverseIndex(sortedEntries);
+    entryStorage   = move(sortedEntries);
+    entries  = entryStorage.data();
+    reverse  = reverseStorage.data();
+    nEntries = (uint32_t) entryStorage.size();
+}
+
+
+AstroCatalog::IndexNumber CrossIndex::findCelestiaNumber(AstroCatalog::IndexNumber catalogNumber) const
+{
+    const Entry* end = entries + nEntries;
+    const Entry* iter = lower_bound(entries, end, catalogNumber,
+                                    [](const Entry& e, AstroCatalog::IndexNumber n)
+                                    {
+                                        return e.catalogNumber < n;
+                                    });
+    if (iter == end || iter->catalogNumber != catalogNumber)
+        return AstroCatalog::InvalidIndex;
+
+    return iter->celCatalogNumber;
+}
+
+
+AstroCatalog::IndexNumber CrossIndex::findCatalogNumber(AstroCatalog::IndexNumber celCatalogNumber) const
+{
+    const uint32_t* end = reverse + nEntries;
+    const uint32_t* iter = lower_bound(reverse, end, celCatalogNumber,
+                                       [this](uint32_t i, AstroCatalog::IndexNumber n)
+                                       {
+                                           return entries[i].celCatalogNumber < n;
+                                       });
+    if (iter == end || entries[*iter].celCatalogNumber != celCatalogNumber)
+        return AstroCatalog::InvalidIndex;
+
+    return entries[*iter].catalogNumber;
+}
+
+
+bool CrossIndex::write(ostream& out, vector<Entry>& entries)
+{
+    stable_sort(entries.begin(), entries.end(), byCatalogNumber);
+    vector<uint32_t> reverse = buildReverseIndex(entries);
+
+    SortedHeader header;
+    memcpy(header.magic, CROSSINDEX_FILE_HEADER, sizeof header.magic);
+    LE_TO_CPU_INT16(header.version, SORTED_VERSION);
+    header.reserved = 0;
+    LE_TO_CPU_INT32(header.nEntries, (uint32_t) entries.size());
+    out.write(reinterpret_cast<const char*>(&header), sizeof header);
+
+    for (Entry entry : entries)
+    {
+        swapEntry(entry);
+        out.write(reinterpret_cast<const char*>(&entry), sizeof entry);
+    }
+
+    for (uint32_t index : reverse)
+    {
+        LE_TO_CPU_INT32(index, index);
+        out.write(reinterpret_cast<const char*>(&index), sizeof index);
+    }
+
+    return out.good();
+}
@@ -0,0 +1,70 @@
+// crossindex.h
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// Cross indexes between star catalogs and Celestia catalog numbers.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+#include <celcompat/filesystem.h>
+#include <celutil/mappedfile.h>
+#include <celengine/astroobj.h>
+
+/*! A cross index maps the numbers of a star catalog like HD or SAO to
+ *  Celestia catalog numbers and back.
+ *
+ *  Version 0x0200 files are written presorted by makexindex: the header
+ *  is followed by the entries sorted by catalog number, and then by the
+ *  indexes of the entries sorted by Celestia catalog number. Both
+ *  directions are binary searches, run directly over the file mapping.
+ *  Version 0x0100 files hold the entries in no particular order; they are
+ *  still read, and sorted when loaded.
+ */
+class CrossIndex
+{
+ public:
+    struct Entry
+    {
+        AstroCatalog::IndexNumber catalogNumber;
+        AstroCatalog::IndexNumber celCatalogNumber;
+    };
+
+    CrossIndex() = default;
+    ~CrossIndex() = default;
+
+    bool open(const fs::path& filename);
+    bool load(std::istream& in);
+
+    uint32_t size() const      { return nEntries; }
+    const Entry* data() const  { return entries; }
+
+    // Celestia catalog number of a star from the cross indexed catalog
+    AstroCatalog::IndexNumber findCelestiaNumber(AstroCatalog::IndexNumber catalogNumber) const;
+    // Number in the cross indexed catalog of a star; when the star has
+    // several, the lowest one.
+    AstroCatalog::IndexNumber findCatalogNumber(AstroCatalog::IndexNumber celCatalogNumber) const;
+
+    // Sort the entries and write them as a version 0x0200 cross index.
+    static bool write(std::ostream& out, std::vector<Entry>& entries);
+
+ private:
+    bool load(const char* data, size_t size);
+    void setEntries(std::vector<Entry>&& sortedEntries);
+
+    MappedFile            file;
+    // Only used when the entries can't be read from the mapping directly
+    std::vector<Entry>    entryStorage;
+    std::vector<uint32_t> reverseStorage;
+
+    const Entry*          entries{ nullptr };
+    const uint32_t*       reverse{ nullptr };
+    uint32_t              nEntries{ 0 };
+};
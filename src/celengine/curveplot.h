@@ -97,6 +97,10 @@ class CurvePlot
     unsigned int lastUsed() const { return m_lastUsed; }
     void setLastUsed(unsigned int lastUsed) { m_lastUsed = lastUsed; }
 
+    // Sampling tolerance in kilometers the plot was built with
+    double tolerance() const { return m_tolerance; }
+    void setTolerance(double tolerance) { m_tolerance = tolerance; }
+
     void addSample(const CurvePlotSample& sample);
     void removeSamplesBefore(double t);
     void removeSamplesAfter(double t);
@@ -111,5 +115,7 @@ class CurvePlot
     double m_duration{ 0.0 };
 
     unsigned int m_lastUsed{ 0 };
+
+    double m_tolerance{ 0.0 };
 };
 
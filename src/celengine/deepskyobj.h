@@ -85,6 +85,10 @@ class DeepSkyObject : public AstroObject
     virtual bool pick(const celmath::Ray3d& ray,
                       double& distanceToPicker,
                       double& cosAngleToBoundCenter) const = 0;
+    /*! Return the radius of a sphere around the object's position which
+     *  contains everything pick() may report as hit.
+     */
+    virtual float getPickRadius() const { return radius; }
     virtual bool load(AssociativeArray*, const fs::path& resPath);
     virtual void render(const Eigen::Vector3f& offset,
                         const Eigen::Quaternionf& viewerOrientation,
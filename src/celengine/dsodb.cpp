@@ -101,13 +101,13 @@ DeepSkyObject* DSODatabase::find(const string& name) const
 }
 
 
-vector<string> DSODatabase::getCompletion(const string& name) const
+vector<string> DSODatabase::getCompletion(const string& name, size_t limit) const
 {
     vector<string> completion;
 
     // only named DSOs are supported by completion.
     if (!name.empty() && namesDB != nullptr)
-        return namesDB->getCompletion(name);
+        return namesDB->getCompletion(name, true, limit);
     else
         return completion;
 }
@@ -205,6 +205,16 @@ void DSODatabase::findCloseDSOs(DSOHandler&     dsoHandler,
 }
 
 
+DeepSkyObject* DSODatabase::pickDSO(DSORayPicker& picker,
+                                    const Vector3d& origin,
+                                    const Vector3d& direction,
+                                    OctreeProcStats* stats) const
+{
+    DeepSkyObject* const* picked = octreeRoot->pickObject(picker, origin, direction, stats);
+    return picked != nullptr ? *picked : nullptr;
+}
+
+
 DSONameDatabase* DSODatabase::getNameDatabase() const
 {
     return namesDB;
@@ -217,6 +227,12 @@ void DSODatabase::setNameDatabase(DSONameDatabase* _namesDB)
 }
 
 
+void DSODatabase::setThreadPool(ThreadPool* pool)
+{
+    threadPool = pool;
+}
+
+
 bool DSODatabase::load(istream& in, const fs::path& resourcePath)
 {
     Tokenizer tokenizer(&in);
@@ -363,6 +379,8 @@ void DSODatabase::finish()
     buildOctree();
     buildIndexes();
     calcAvgAbsMag();
+    if (namesDB != nullptr)
+        namesDB->buildIndexes();
     /*
     // Put AbsMag = avgAbsMag for Add-ons without AbsMag entry
     for (int i = 0; i < nDSOs; ++i)
@@ -383,28 +401,24 @@ void DSODatabase::buildOctree()
     // TODO: investigate using a different center--it's possible that more
     // objects end up straddling the base level nodes when the center of the
     // octree is at the origin.
-    DynamicDSOOctree* root   = new DynamicDSOOctree(Vector3d::Zero(), absMag);
-    for (int i = 0; i < nDSOs; ++i)
-    {
-        root->insertObject(DSOs[i], DSO_OCTREE_ROOT_SIZE);
-    }
-
-    DPRINTF(LOG_LEVEL_INFO, "Spatially sorting DSOs for improved locality of reference . . .\n");
-    DeepSkyObject** sortedDSOs    = new DeepSkyObject*[nDSOs];
-    DeepSkyObject** firstDSO      = sortedDSOs;
-
     // The spatial sorting part is useless for DSOs since we
     // are storing pointers to objects and not the objects themselves:
-    root->rebuildAndSort(octreeRoot, firstDSO);
-
-    DPRINTF(LOG_LEVEL_INFO, "%d DSOs total\n", (int) (firstDSO - sortedDSOs));
+    DeepSkyObject** sortedDSOs    = new DeepSkyObject*[nDSOs];
+    octreeRoot = DynamicDSOOctree::build(Vector3d::Zero(),
+                                         absMag,
+                                         DSO_OCTREE_ROOT_SIZE,
+                                         DSOs,
+                                         (uint32_t) nDSOs,
+                                         sortedDSOs,
+                                         threadPool);
+
+    DPRINTF(LOG_LEVEL_INFO, "%d DSOs total\n", nDSOs);
     DPRINTF(LOG_LEVEL_INFO, "Octree has %d nodes and %d DSOs.\n",
             1 + octreeRoot->countChildren(), octreeRoot->countObjects());
     //cout<<"DSOs:  "<< octreeRoot->countObjects()<<"   Nodes:"
     //    <<octreeRoot->countChildren() <<endl;
     // Clean up . . .
     delete[] DSOs;
-    delete   root;
 
     DSOs = sortedDSOs;
 }
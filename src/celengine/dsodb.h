@@ -40,7 +40,7 @@ class DSODatabase
     DeepSkyObject* find(const AstroCatalog::IndexNumber catalogNumber) const;
     DeepSkyObject* find(const std::string&) const;
 
-    std::vector<std::string> getCompletion(const std::string&) const;
+    std::vector<std::string> getCompletion(const std::string&, size_t limit = 0) const;
 
     void findVisibleDSOs(DSOHandler& dsoHandler,
                          const Eigen::Vector3d& obsPosition,
@@ -54,12 +54,23 @@ class DSODatabase
                        const Eigen::Vector3d& obsPosition,
                        float radius) const;
 
+    // The DSO hit by a ray which is closest in angle to it, or nullptr if
+    // the picker reports no DSO as hit; see DSOOctree::pickObject().
+    DeepSkyObject* pickDSO(DSORayPicker& picker,
+                           const Eigen::Vector3d& origin,
+                           const Eigen::Vector3d& direction,
+                           OctreeProcStats* = nullptr) const;
+
     std::string getDSOName    (const DeepSkyObject* const &, bool i18n = false) const;
     std::string getDSONameList(const DeepSkyObject* const &, const unsigned int maxNames = MAX_DSO_NAMES) const;
 
     DSONameDatabase* getNameDatabase() const;
     void setNameDatabase(DSONameDatabase*);
 
+    // Threads which may be used to build the octree; not owned by the
+    // DSO database.
+    void setThreadPool(ThreadPool*);
+
     bool load(std::istream&, const fs::path& resourcePath = fs::path());
     bool loadBinary(std::istream&);
     void finish();
@@ -79,6 +90,7 @@ private:
     DSONameDatabase* namesDB{ nullptr };
     DeepSkyObject**  catalogNumberIndex{ nullptr };
     DSOOctree*       octreeRoot{ nullptr };
+    ThreadPool*      threadPool{ nullptr };
     AstroCatalog::IndexNumber nextAutoCatalogNumber{ 0xfffffffe };
 
     double           avgAbsMag{ 0.0 };
@@ -10,6 +10,8 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+#include <cmath>
 #include <celengine/dsooctree.h>
 
 using namespace Eigen;
@@ -43,7 +45,7 @@ double dsoAbsoluteMagnitudeDecayFunction(const double excludingFactor)
 
 
 template <>
-DynamicDSOOctree* DynamicDSOOctree::getChild(DeepSkyObject* const & _obj, const PointType& cellCenterPos)
+int DynamicDSOOctree::childIndex(DeepSkyObject* const & _obj, const PointType& cellCenterPos)
 {
     PointType objPos = _obj->getPosition();
 
@@ -52,7 +54,7 @@ DynamicDSOOctree* DynamicDSOOctree::getChild(DeepSkyObject* const & _obj, const
     child     |= objPos.y() < cellCenterPos.y() ? 0 : YPos;
     child     |= objPos.z() < cellCenterPos.z() ? 0 : ZPos;
 
-    return _children[child];
+    return child;
 }
 
 
@@ -65,6 +67,44 @@ template<> DynamicDSOOctree::ExclusionFactorDecayFunction*
            DynamicDSOOctree::decayFunction = dsoAbsoluteMagnitudeDecayFunction;
 
 
+// The pick radius of a node is computed bottom up; children always come
+// after their parent in the node order.
+template<>
+void DSOOctree::buildObjectData()
+{
+    pickRadii.assign(centerX.size(), -1.0);
+
+    for (uint32_t node = (uint32_t) centerX.size(); node-- > 0;)
+    {
+        PointType center(centerX[node], centerY[node], centerZ[node]);
+        double radius = -1.0;
+
+        DeepSkyObject* const* nodeObjects = objects + firstObject[node];
+        for (uint32_t i = 0; i < objectCounts[node]; ++i)
+        {
+            const DeepSkyObject* dso = nodeObjects[i];
+            radius = std::max(radius, (dso->getPosition() - center).norm() + dso->getPickRadius());
+        }
+
+        uint32_t child = firstChild[node];
+        if (child != 0)
+        {
+            for (uint32_t i = child; i < child + NODE_CHILDREN; ++i)
+            {
+                if (pickRadii[i] >= 0.0)
+                {
+                    PointType childCenter(centerX[i], centerY[i], centerZ[i]);
+                    radius = std::max(radius, (childCenter - center).norm() + pickRadii[i]);
+                }
+            }
+        }
+
+        // Allow for rounding in the distances computed while picking
+        pickRadii[node] = radius < 0.0 ? radius : radius * (1.0 + 1.0e-9);
+    }
+}
+
+
 // total specialization of the StaticOctree template process*() methods for DSOs:
 template<>
 void DSOOctree::processVisibleObjects(DSOHandler&    processor,
@@ -72,126 +112,171 @@ void DSOOctree::processVisibleObjects(DSOHandler&    processor,
                                       const Hyperplane<double, 3>*  frustumPlanes,
                                       float          limitingFactor,
                                       double         scale,
-                                      OctreeProcStats *stats) const
+                                      OctreeProcStats *stats,
+                                      ThreadPool      * /*threadPool*/) const
 {
-#ifdef OCTREE_DEBUG
-    size_t h;
-    if (stats != nullptr)
+    // There are few enough DSOs that the traversal isn't worth splitting
+    // between threads.
+    auto visitor = [&](uint32_t node, double minDistance)
     {
-        h = stats->height + 1;
-        stats->nodes++;
-    }
-#endif
-    // See if this node lies within the view frustum
+        // Process the objects in this node
+        double dimmest     = minDistance > 0.0 ? astro::appToAbsMag((double) limitingFactor, minDistance) : 1000.0;
 
-    // Test the cubic octree node against each one of the five
-    // planes that define the infinite view frustum.
-    for (unsigned int i = 0; i < 5; ++i)
-    {
-        const Hyperplane<double, 3>& plane = frustumPlanes[i];
-
-        double r = scale * plane.normal().cwiseAbs().sum();
-        if (plane.signedDistance(cellCenterPos) < -r)
-            return;
-    }
-
-    // Compute the distance to node; this is equal to the distance to
-    // the cellCenterPos of the node minus the boundingRadius of the node, scale * SQRT3.
-    double minDistance = (obsPosition - cellCenterPos).norm() - scale * DSOOctree::SQRT3;
-
-    // Process the objects in this node
-    double dimmest     = minDistance > 0.0 ? astro::appToAbsMag((double) limitingFactor, minDistance) : 1000.0;
-
-    for (unsigned int i=0; i<nObjects; ++i)
-    {
+        DeepSkyObject* const* nodeObjects = objects + firstObject[node];
+        uint32_t nNodeObjects = objectCounts[node];
 #ifdef OCTREE_DEBUG
         if (stats != nullptr)
-            stats->objects++;
+            stats->objects += nNodeObjects;
 #endif
-        DeepSkyObject* _obj = _firstObject[i];
-        float  absMag      = _obj->getAbsoluteMagnitude();
-        if (absMag < dimmest)
+        for (uint32_t i = 0; i < nNodeObjects; ++i)
         {
-            double distance    = (obsPosition - _obj->getPosition()).norm() - _obj->getBoundingSphereRadius();
-            float appMag = (float) ((distance >= 32.6167) ? astro::absToAppMag((double) absMag, distance) : absMag);
+            DeepSkyObject* _obj = nodeObjects[i];
+            float  absMag      = _obj->getAbsoluteMagnitude();
+            if (absMag < dimmest)
+            {
+                double distance    = (obsPosition - _obj->getPosition()).norm() - _obj->getBoundingSphereRadius();
+                float appMag = (float) ((distance >= 32.6167) ? astro::absToAppMag((double) absMag, distance) : absMag);
 
-            if ( appMag < limitingFactor)
-                processor.process(_obj, distance, absMag);
+                if ( appMag < limitingFactor)
+                    processor.process(_obj, distance, absMag);
+            }
         }
-    }
+    };
+
+    traverseVisibleNodes(obsPosition, frustumPlanes, limitingFactor, scale, visitor, stats);
+}
+
+
+template<>
+void DSOOctree::processCloseObjects(DSOHandler&    processor,
+                                    const PointType& obsPosition,
+                                    double         boundingRadius,
+                                    double         scale) const
+{
+    // Compute distance squared to avoid having to sqrt for distance
+    // comparison.
+    double radiusSquared    = boundingRadius * boundingRadius;
 
-    // See if any of the objects in child nodes are potentially included
-    // that we need to recurse deeper.
-    if (minDistance <= 0.0 || astro::absToAppMag((double) exclusionFactor, minDistance) <= limitingFactor)
+    auto visitor = [&](uint32_t node)
     {
-        // Recurse into the child nodes
-        if (_children != nullptr)
+        // Check all the objects in the node.
+        DeepSkyObject* const* nodeObjects = objects + firstObject[node];
+        for (uint32_t i = 0; i < objectCounts[node]; ++i)
         {
-            for (int i = 0; i < 8; ++i)
+            DeepSkyObject* _obj = nodeObjects[i];
+
+            if ((obsPosition - _obj->getPosition()).squaredNorm() < radiusSquared)
             {
-                _children[i]->processVisibleObjects(processor,
-                                                    obsPosition,
-                                                    frustumPlanes,
-                                                    limitingFactor,
-                                                    scale * 0.5f,
-                                                    stats);
-#ifdef OCTREE_DEBUG
-                if (stats != nullptr && stats->height > h)
-                    h = stats->height;
-#endif
+                float  absMag      = _obj->getAbsoluteMagnitude();
+                double distance    = (obsPosition - _obj->getPosition()).norm() - _obj->getBoundingSphereRadius();
+
+                processor.process(_obj, distance, absMag);
             }
-#ifdef OCTREE_DEBUG
-            if (stats != nullptr)
-                stats->height = h;
-#endif
         }
-    }
+    };
+
+    traverseCloseNodes(obsPosition, boundingRadius, scale, visitor);
 }
 
 
+// A node is searched only if the ray passes through the sphere given by
+// its pick radius. The angle between the ray and any object in the node
+// is at least the angle between the ray and the center of the sphere,
+// less the angular radius of the sphere; the nodes are searched in order
+// of the cosine of this angle, the largest first.
 template<>
-void DSOOctree::processCloseObjects(DSOHandler&    processor,
-                                    const PointType& obsPosition,
-                                    double         boundingRadius,
-                                    double         scale) const
+DeepSkyObject* const* DSOOctree::pickObject(DSORayPicker&    picker,
+                                            const PointType& origin,
+                                            const PointType& direction,
+                                            OctreeProcStats* stats) const
 {
-    // Compute the distance to node; this is equal to the distance to
-    // the cellCenterPos of the node minus the boundingRadius of the node, scale * SQRT3.
-    double nodeDistance    = (obsPosition - cellCenterPos).norm() - scale * DSOOctree::SQRT3;    //
+    struct QueueEntry
+    {
+        double   cosBound;
+        uint32_t node;
+        uint32_t depth;
+    };
+    auto before = [](const QueueEntry& a, const QueueEntry& b) { return a.cosBound < b.cosBound; };
+
+    // Returns false if the ray misses the sphere of the node
+    auto nodeBound = [&](uint32_t node, double& cosBound)
+    {
+        double radius = pickRadii[node];
+        if (radius < 0.0)
+            return false;
 
-    if (nodeDistance > boundingRadius)
-        return;
+        PointType toCenter = PointType(centerX[node], centerY[node], centerZ[node]) - origin;
+        double distance2 = toCenter.squaredNorm();
+        if (distance2 <= radius * radius)
+        {
+            cosBound = 1.0;
+            return true;
+        }
 
-    // At this point, we've determined that the cellCenterPos of the node is
-    // close enough that we must check individual objects for proximity.
+        double along = toCenter.dot(direction);
+        double across = toCenter.cross(direction).norm();
+        if (along <= 0.0 || across > radius)
+            return false;
 
-    // Compute distance squared to avoid having to sqrt for distance
-    // comparison.
-    double radiusSquared    = boundingRadius * boundingRadius;    //
+        double angle = std::atan2(across, along) - std::asin(radius / std::sqrt(distance2));
+        cosBound = angle <= 0.0 ? 1.0 : std::cos(angle) + 1.0e-9;
+        return true;
+    };
+
+    DeepSkyObject* const* picked = nullptr;
+    double pickedCosAngle = -2.0;
 
-    // Check all the objects in the node.
-    for (unsigned int i=0; i<nObjects; ++i)
+    std::vector<QueueEntry> queue;
+    queue.reserve(64);
+    double rootBound;
+    if (!pickRadii.empty() && nodeBound(0, rootBound))
+        queue.push_back({ rootBound, 0, 0 });
+
+    while (!queue.empty())
     {
-        DeepSkyObject* _obj = _firstObject[i];        //
+        std::pop_heap(queue.begin(), queue.end(), before);
+        QueueEntry entry = queue.back();
+        queue.pop_back();
+        if (entry.cosBound < pickedCosAngle)
+            break;
 
-        if ((obsPosition - _obj->getPosition()).squaredNorm() < radiusSquared)    //
+        if (stats != nullptr)
         {
-            float  absMag      = _obj->getAbsoluteMagnitude();
-            double distance    = (obsPosition - _obj->getPosition()).norm() - _obj->getBoundingSphereRadius();
+            stats->nodes++;
+            stats->objects += objectCounts[entry.node];
+            stats->height = std::max(stats->height, (size_t) entry.depth + 1);
+        }
 
-            processor.process(_obj, distance, absMag);
+        DeepSkyObject* const* nodeObjects = objects + firstObject[entry.node];
+        for (uint32_t i = 0; i < objectCounts[entry.node]; ++i)
+        {
+            double cosAngle;
+            if (!picker.pick(nodeObjects[i], cosAngle))
+                continue;
+
+            // Nodes aren't searched in object order, so ties go to the
+            // object first in the array, as with a depth first traversal.
+            if (cosAngle > pickedCosAngle || (cosAngle == pickedCosAngle && nodeObjects + i < picked))
+            {
+                picked         = nodeObjects + i;
+                pickedCosAngle = cosAngle;
+            }
         }
-    }
 
-    // Recurse into the child nodes
-    if (_children != nullptr)
-    {
-        for (int i = 0; i < 8; ++i)
+        uint32_t child = firstChild[entry.node];
+        if (child == 0)
+            continue;
+
+        for (uint32_t i = child; i < child + NODE_CHILDREN; ++i)
         {
-            _children[i]->processCloseObjects(processor,
-                                              obsPosition,
-                                              boundingRadius,
-                                              scale * 0.5f);
+            double cosBound;
+            if (nodeBound(i, cosBound) && cosBound >= pickedCosAngle)
+            {
+                queue.push_back({ cosBound, i, entry.depth + 1 });
+                std::push_heap(queue.begin(), queue.end(), before);
+            }
         }
     }
+
+    return picked;
 }
@@ -20,5 +20,9 @@
 typedef DynamicOctree  <DeepSkyObject*, double> DynamicDSOOctree;
 typedef StaticOctree   <DeepSkyObject*, double> DSOOctree;
 typedef OctreeProcessor<DeepSkyObject*, double> DSOHandler;
+typedef OctreeRayPicker<DeepSkyObject*, double> DSORayPicker;
+
+template<> int  DynamicDSOOctree::childIndex(DeepSkyObject* const &, const Eigen::Vector3d&);
+template<> void DSOOctree::buildObjectData();
 
 #endif  // _CELENGINE_DSOOCTREE_H_
@@ -16,6 +16,9 @@
 #include <celengine/deepskyobj.h>
 #include <celengine/location.h>
 #include <celengine/frame.h>
+#include <celengine/timeline.h>
+#include <celengine/timelinephase.h>
+#include <celutil/threadcache.h>
 
 using namespace Eigen;
 using namespace std;
@@ -202,6 +205,58 @@ getFrameDepth(const Selection& sel, unsigned int depth, unsigned int maxDepth,
 }
 
 
+//! Frames nested deeper than this are circular, and aren't thread safe.
+static const unsigned int MaxThreadSafeDepth = 50;
+
+bool
+ReferenceFrame::isThreadSafe() const
+{
+    return this->isThreadSafe(0);
+}
+
+
+// Whether the position of an object, and its orientation for orientation
+// frames, may be computed on several threads at once. Unlike
+// getFrameDepth(), all the phases of the timeline of a body are checked.
+static bool
+isThreadSafeObject(const Selection& sel, unsigned int depth,
+                   ReferenceFrame::FrameType frameType)
+{
+    if (depth > MaxThreadSafeDepth)
+        return false;
+
+    if (sel.star() != nullptr)
+        return sel.star()->isThreadSafe();
+
+    Body* body = sel.body();
+    if (sel.location() != nullptr)
+    {
+        // The position of a location depends on the orientation of its body
+        body = sel.location()->getParentBody();
+        frameType = ReferenceFrame::OrientationFrame;
+    }
+
+    if (body == nullptr || body->getTimeline() == nullptr)
+        return true;
+
+    const Timeline* timeline = body->getTimeline();
+    for (unsigned int i = 0; i < timeline->phaseCount(); i++)
+    {
+        const auto& phase = timeline->getPhase(i);
+        if (!phase->orbit()->isThreadSafe() ||
+            !phase->orbitFrame()->isThreadSafe(depth + 1))
+            return false;
+
+        if (frameType == ReferenceFrame::OrientationFrame &&
+            (!phase->rotationModel()->isThreadSafe() ||
+             !phase->bodyFrame()->isThreadSafe(depth + 1)))
+            return false;
+    }
+
+    return true;
+}
+
+
 
 /*** J2000EclipticFrame ***/
 
@@ -227,6 +282,13 @@ J2000EclipticFrame::nestingDepth(unsigned int depth,
 }
 
 
+bool
+J2000EclipticFrame::isThreadSafe(unsigned int depth) const
+{
+    return isThreadSafeObject(getCenter(), depth, PositionFrame);
+}
+
+
 /*** J2000EquatorFrame ***/
 
 J2000EquatorFrame::J2000EquatorFrame(Selection center) :
@@ -258,6 +320,13 @@ J2000EquatorFrame::nestingDepth(unsigned int depth,
 }
 
 
+bool
+J2000EquatorFrame::isThreadSafe(unsigned int depth) const
+{
+    return isThreadSafeObject(getCenter(), depth, PositionFrame);
+}
+
+
 /*** BodyFixedFrame ***/
 
 BodyFixedFrame::BodyFixedFrame(Selection center, Selection obj) :
@@ -336,6 +405,14 @@ BodyFixedFrame::nestingDepth(unsigned int depth,
 }
 
 
+bool
+BodyFixedFrame::isThreadSafe(unsigned int depth) const
+{
+    return isThreadSafeObject(getCenter(), depth, PositionFrame) &&
+           isThreadSafeObject(fixObject, depth, OrientationFrame);
+}
+
+
 /*** BodyMeanEquatorFrame ***/
 
 BodyMeanEquatorFrame::BodyMeanEquatorFrame(Selection center,
@@ -441,55 +518,91 @@ BodyMeanEquatorFrame::nestingDepth(unsigned int depth,
 }
 
 
+bool
+BodyMeanEquatorFrame::isThreadSafe(unsigned int depth) const
+{
+    return isThreadSafeObject(getCenter(), depth, PositionFrame) &&
+           isThreadSafeObject(equatorObject, depth, OrientationFrame);
+}
+
+
 /*** CachingFrame ***/
 
+namespace
+{
+// An entry of the orientation cache of CachingFrame; each thread has its
+// own table, like the position cache of CachingOrbit.
+struct FrameCacheEntry
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    Quaterniond orientation;
+    Vector3d angularVelocity;
+    uint64_t key{ 0 };
+    double tjd{ 0.0 };
+    bool hasOrientation{ false };
+    bool hasAngularVelocity{ false };
+};
+
+constexpr const unsigned int FRAME_CACHE_SIZE = 64;
+
+thread_local FrameCacheEntry frameCache[FRAME_CACHE_SIZE];
+
+// Return the entry for a frame and time, reset if it held another one
+FrameCacheEntry& frameCacheEntry(uint64_t key, double tjd)
+{
+    FrameCacheEntry& entry = frameCache[threadCacheIndex(key, tjd, FRAME_CACHE_SIZE)];
+    if (entry.key != key || entry.tjd != tjd)
+    {
+        entry.key = key;
+        entry.tjd = tjd;
+        entry.hasOrientation = false;
+        entry.hasAngularVelocity = false;
+    }
+    return entry;
+}
+}
+
+
 CachingFrame::CachingFrame(Selection _center) :
     ReferenceFrame(_center),
-    lastTime(-1.0e50),
-    lastOrientation(Quaterniond::Identity()),
-    lastAngularVelocity(0.0, 0.0, 0.0),
-    orientationCacheValid(false),
-    angularVelocityCacheValid(false)
+    cacheKey(newThreadCacheKey())
 {
 }
 
 
+// Orientations of frames depend on other frames and bodies, which may
+// have used the same entry by the time the orientation is computed.
 Quaterniond
 CachingFrame::getOrientation(double tjd) const
 {
-    if (tjd != lastTime)
-    {
-        lastTime = tjd;
-        lastOrientation = computeOrientation(tjd);
-        orientationCacheValid = true;
-        angularVelocityCacheValid = false;
-    }
-    else if (!orientationCacheValid)
-    {
-        lastOrientation = computeOrientation(tjd);
-        orientationCacheValid = true;
-    }
+    FrameCacheEntry& entry = frameCacheEntry(cacheKey, tjd);
+    if (entry.hasOrientation)
+        return entry.orientation;
+
+    Quaterniond orientation = computeOrientation(tjd);
 
-    return lastOrientation;
+    FrameCacheEntry& newEntry = frameCacheEntry(cacheKey, tjd);
+    newEntry.orientation = orientation;
+    newEntry.hasOrientation = true;
+
+    return orientation;
 }
 
 
 Vector3d CachingFrame::getAngularVelocity(double tjd) const
 {
-    if (tjd != lastTime)
-    {
-        lastTime = tjd;
-        lastAngularVelocity = computeAngularVelocity(tjd);
-        orientationCacheValid = false;
-        angularVelocityCacheValid = true;
-    }
-    else if (!angularVelocityCacheValid)
-    {
-        lastAngularVelocity = computeAngularVelocity(tjd);
-        angularVelocityCacheValid = true;
-    }
+    FrameCacheEntry& entry = frameCacheEntry(cacheKey, tjd);
+    if (entry.hasAngularVelocity)
+        return entry.angularVelocity;
 
-    return lastAngularVelocity;
+    Vector3d angularVelocity = computeAngularVelocity(tjd);
+
+    FrameCacheEntry& newEntry = frameCacheEntry(cacheKey, tjd);
+    newEntry.angularVelocity = angularVelocity;
+    newEntry.hasAngularVelocity = true;
+
+    return angularVelocity;
 }
 
 
@@ -660,6 +773,15 @@ TwoVectorFrame::nestingDepth(unsigned int depth,
 }
 
 
+bool
+TwoVectorFrame::isThreadSafe(unsigned int depth) const
+{
+    return isThreadSafeObject(getCenter(), depth, PositionFrame) &&
+           primaryVector.isThreadSafe(depth) &&
+           secondaryVector.isThreadSafe(depth);
+}
+
+
 
 // Copy constructor
 FrameVector::FrameVector(const FrameVector& fv) :
@@ -801,3 +923,22 @@ FrameVector::nestingDepth(unsigned int depth,
         return depth;
     }
 }
+
+
+bool
+FrameVector::isThreadSafe(unsigned int depth) const
+{
+    switch (vecType)
+    {
+    case RelativePosition:
+    case RelativeVelocity:
+        return isThreadSafeObject(observer, depth, ReferenceFrame::PositionFrame) &&
+               isThreadSafeObject(target, depth, ReferenceFrame::PositionFrame);
+
+    case ConstantVector:
+        return depth <= MaxThreadSafeDepth && frame->isThreadSafe(depth + 1);
+
+    default:
+        return true;
+    }
+}
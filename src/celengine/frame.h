@@ -11,6 +11,7 @@
 #ifndef _CELENGINE_FRAME_H_
 #define _CELENGINE_FRAME_H_
 
+#include <cstdint>
 #include <celengine/astro.h>
 #include <celengine/selection.h>
 #include <Eigen/Core>
@@ -20,8 +21,9 @@
 /*! A ReferenceFrame object has a center and set of orthogonal axes.
  *
  * Subclasses of ReferenceFrame must override the getOrientation method
- * (which specifies the coordinate axes at a given time) and the
- * nestingDepth() method (which is used to check for recursive frames.)
+ * (which specifies the coordinate axes at a given time), the
+ * nestingDepth() method (which is used to check for recursive frames)
+ * and the isThreadSafe() method.
  */
 class ReferenceFrame
 {
@@ -58,13 +60,21 @@ class ReferenceFrame
                                       unsigned int maxDepth,
                                       FrameType frameType) const = 0;
 
+    // Whether the frame, including the states of the objects it refers
+    // to, may be computed on several threads at once
+    bool isThreadSafe() const;
+
+    virtual bool isThreadSafe(unsigned int depth) const = 0;
+
  private:
     Selection centerObject;
 };
 
 
 /*! Base class for complex frames where there may be some benefit
- *  to caching the last calculated orientation.
+ *  to caching the calculated orientations. Orientations and angular
+ *  velocities are cached per thread, so frames can be used by several
+ *  threads at once.
  */
 class CachingFrame : public ReferenceFrame
 {
@@ -82,11 +92,8 @@ class CachingFrame : public ReferenceFrame
     virtual Eigen::Vector3d computeAngularVelocity(double tjd) const;
 
  private:
-    mutable double lastTime;
-    mutable Eigen::Quaterniond lastOrientation;
-    mutable Eigen::Vector3d lastAngularVelocity;
-    mutable bool orientationCacheValid;
-    mutable bool angularVelocityCacheValid;
+    // Key of the frame in the per thread caches
+    uint64_t cacheKey;
 };
 
 
@@ -109,6 +116,7 @@ class J2000EclipticFrame : public ReferenceFrame
     virtual unsigned int nestingDepth(unsigned int depth,
                                       unsigned int maxDepth,
                                       FrameType frameType) const;
+    virtual bool isThreadSafe(unsigned int depth) const;
 };
 
 
@@ -125,6 +133,7 @@ class J2000EquatorFrame : public ReferenceFrame
     virtual unsigned int nestingDepth(unsigned int depth,
                                       unsigned int maxDepth,
                                       FrameType frameType) const;
+    virtual bool isThreadSafe(unsigned int depth) const;
 };
 
 
@@ -147,6 +156,7 @@ class BodyFixedFrame : public ReferenceFrame
     virtual unsigned int nestingDepth(unsigned int depth,
                                       unsigned int maxDepth,
                                       FrameType frameType) const;
+    virtual bool isThreadSafe(unsigned int depth) const;
 
  private:
     Selection fixObject;
@@ -167,6 +177,7 @@ class BodyMeanEquatorFrame : public ReferenceFrame
     virtual unsigned int nestingDepth(unsigned int depth,
                                       unsigned int maxDepth,
                                       FrameType frameType) const;
+    virtual bool isThreadSafe(unsigned int depth) const;
 
  private:
     Selection equatorObject;
@@ -195,6 +206,9 @@ class FrameVector
      */
     unsigned int nestingDepth(unsigned int depth, unsigned int maxDepth) const;
 
+    //! Whether the vector may be computed on several threads at once
+    bool isThreadSafe(unsigned int depth) const;
+
     enum FrameVectorType
     {
         RelativePosition,
@@ -249,6 +263,7 @@ class TwoVectorFrame : public CachingFrame
     virtual unsigned int nestingDepth(unsigned int depth,
                                       unsigned int maxDepth,
                                       FrameType frameType) const;
+    virtual bool isThreadSafe(unsigned int depth) const;
 
     //! The sine of minimum angle between the primary and secondary vectors
     static const double Tolerance;
@@ -250,6 +250,13 @@ bool Galaxy::pick(const Ray3d& ray,
 }
 
 
+// The scales of all galactic forms are at most one.
+float Galaxy::getPickRadius() const
+{
+    return getRadius() * (1.0f + RADIUS_CORRECTION);
+}
+
+
 bool Galaxy::load(AssociativeArray* params, const fs::path& resPath)
 {
     double detail = 1.0;
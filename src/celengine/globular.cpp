@@ -290,6 +290,13 @@ bool Globular::pick(const Ray3d& ray,
 }
 
 
+// The scales of the globular form are at most one.
+float Globular::getPickRadius() const
+{
+    return getRadius() * (1.0f + RADIUS_CORRECTION);
+}
+
+
 bool Globular::load(AssociativeArray* params, const fs::path& resPath)
 {
     // Load the basic DSO parameters first
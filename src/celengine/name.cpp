@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cstring>
 #include <celutil/debug.h>
 #include "name.h"
 
@@ -21,6 +23,9 @@ void NameDatabase::add(const AstroCatalog::IndexNumber catalogNumber, const std:
 
         nameIndex[fname] = catalogNumber;
         numberIndex.insert(NumberIndex::value_type(catalogNumber, fname));
+
+        if (indexesValid)
+            clearIndexes();
     }
 }
 void NameDatabase::erase(const AstroCatalog::IndexNumber catalogNumber)
@@ -30,6 +35,14 @@ void NameDatabase::erase(const AstroCatalog::IndexNumber catalogNumber)
 
 AstroCatalog::IndexNumber NameDatabase::getCatalogNumberByName(const std::string& name) const
 {
+    if (indexesValid)
+    {
+        AstroCatalog::IndexNumber catalogNumber = lookup(name);
+        if (catalogNumber == AstroCatalog::InvalidIndex)
+            catalogNumber = lookup(ReplaceGreekLetterAbbr(name));
+        return catalogNumber;
+    }
+
     NameIndex::const_iterator iter = nameIndex.find(name);
 
     if (iter == nameIndex.end())
@@ -86,16 +99,22 @@ NameDatabase::NumberIndex::const_iterator NameDatabase::getFinalNameIter() const
     return numberIndex.end();
 }
 
-std::vector<std::string> NameDatabase::getCompletion(const std::string& name, bool greek) const
+std::vector<std::string> NameDatabase::getCompletion(const std::string& name, bool greek, size_t limit) const
 {
     if (greek)
     {
         auto compList = getGreekCompletion(name);
         compList.push_back(name);
-        return getCompletion(compList);
+        return getCompletion(compList, limit);
     }
 
     std::vector<std::string> completion;
+    if (indexesValid)
+    {
+        findCompletion(name, limit, completion);
+        return completion;
+    }
+
     int name_length = UTF8Length(name);
 
     for (NameIndex::const_iterator iter = nameIndex.begin(); iter != nameIndex.end(); ++iter)
@@ -103,18 +122,313 @@ std::vector<std::string> NameDatabase::getCompletion(const std::string& name, bo
         if (!UTF8StringCompare(iter->first, name, name_length, true))
         {
             completion.push_back(iter->first);
+            if (limit != 0 && completion.size() >= limit)
+                break;
         }
     }
     return completion;
 }
 
-std::vector<std::string> NameDatabase::getCompletion(const std::vector<std::string> &list) const
+std::vector<std::string> NameDatabase::getCompletion(const std::vector<std::string> &list, size_t limit) const
 {
     std::vector<std::string> completion;
     for (const auto &n : list)
     {
-        for (const auto &nn : getCompletion(n, false))
+        if (limit != 0 && completion.size() >= limit)
+            break;
+
+        for (const auto &nn : getCompletion(n, false, limit == 0 ? 0 : limit - completion.size()))
             completion.emplace_back(nn);
     }
     return completion;
 }
+
+namespace
+{
+// Byte wise comparison of folded keys; the radix tree relies on the keys
+// being sorted by unsigned bytes.
+inline int compareKeys(const char* s0, uint32_t n0, const char* s1, uint32_t n1)
+{
+    int c = memcmp(s0, s1, std::min(n0, n1));
+    if (c != 0)
+        return c;
+    return n0 < n1 ? -1 : (n0 > n1 ? 1 : 0);
+}
+
+// The name index ignores the case of ASCII letters only; bytes of
+// multibyte UTF-8 characters are never changed by toupper().
+inline char upperCase(char c)
+{
+    return c >= 'a' && c <= 'z' ? (char) (c - 'a' + 'A') : c;
+}
+
+// FNV-1a of the upper case name, seeded and finalized with the MurmurHash3
+// mixer so that different seeds give independent hashes.
+inline uint32_t hashName(const char* s, size_t n, uint32_t seed)
+{
+    uint32_t h = 2166136261u ^ (seed * 0x9e3779b9u);
+    for (size_t i = 0; i < n; i++)
+    {
+        h ^= (unsigned char) upperCase(s[i]);
+        h *= 16777619u;
+    }
+
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+}
+
+void NameDatabase::buildIndexes()
+{
+    clearIndexes();
+    buildLookupTable();
+    buildCompletionIndex();
+    indexesValid = true;
+}
+
+void NameDatabase::clearIndexes()
+{
+    indexesValid = false;
+    completionKeys.clear();
+    completionEntries.clear();
+    completionNodes.clear();
+    lookupKeys.clear();
+    lookupBuckets.clear();
+    lookupSlots.clear();
+}
+
+void NameDatabase::buildCompletionIndex()
+{
+    completionEntries.reserve(nameIndex.size());
+    for (const auto& n : nameIndex)
+    {
+        std::string key = UTF8FoldCase(n.first);
+        completionEntries.push_back({ (uint32_t) completionKeys.size(), (uint32_t) key.size(), &n.first });
+        completionKeys += key;
+    }
+
+    const char* keys = completionKeys.data();
+    std::sort(completionEntries.begin(), completionEntries.end(),
+              [keys](const CompletionEntry& a, const CompletionEntry& b)
+              {
+                  int c = compareKeys(keys + a.keyOffset, a.keyLength, keys + b.keyOffset, b.keyLength);
+                  return c != 0 ? c < 0 : *a.name < *b.name;
+              });
+
+    if (!completionEntries.empty())
+        completionNodes.push_back({ 0, (uint32_t) completionEntries.size(), 0, 0, 0 });
+
+    // The tree is built breadth first, so that the children of every node
+    // are appended next to each other.
+    for (size_t i = 0; i < completionNodes.size(); i++)
+    {
+        CompletionNode node = completionNodes[i];
+
+        // The entries are sorted, so the common prefix of the first and the
+        // last one is shared by all entries of the node.
+        const char* firstKey = completionKey(node.first);
+        const char* lastKey  = completionKey(node.last - 1);
+        uint32_t maxDepth = std::min(completionEntries[node.first].keyLength,
+                                     completionEntries[node.last - 1].keyLength);
+        uint32_t depth = node.depth;
+        while (depth < maxDepth && firstKey[depth] == lastKey[depth])
+            depth++;
+
+        // Keys ending at this node sort before all the longer ones
+        uint32_t j = node.first;
+        while (j < node.last && completionEntries[j].keyLength == depth)
+            j++;
+
+        auto firstChild = (uint32_t) completionNodes.size();
+        while (j < node.last)
+        {
+            char c = completionKey(j)[depth];
+            uint32_t k = j + 1;
+            while (k < node.last && completionKey(k)[depth] == c)
+                k++;
+            completionNodes.push_back({ j, k, depth + 1, 0, 0 });
+            j = k;
+        }
+
+        completionNodes[i].depth      = depth;
+        completionNodes[i].firstChild = firstChild;
+        completionNodes[i].nChildren  = (uint32_t) completionNodes.size() - firstChild;
+    }
+}
+
+// Follow the folded name down the radix tree; all entries of the node
+// where it ends are completions.
+void NameDatabase::findCompletion(const std::string& name, size_t limit, std::vector<std::string>& completion) const
+{
+    if (completionNodes.empty())
+        return;
+
+    std::string prefix = UTF8FoldCase(name);
+    uint32_t nodeIndex = 0;
+    size_t pos = 0;
+    for (;;)
+    {
+        const CompletionNode& node = completionNodes[nodeIndex];
+        const char* key = completionKey(node.first);
+        size_t end = std::min((size_t) node.depth, prefix.size());
+        for (; pos < end; pos++)
+        {
+            if (key[pos] != prefix[pos])
+                return;
+        }
+
+        if (prefix.size() <= node.depth)
+        {
+            for (uint32_t i = node.first; i < node.last; i++)
+            {
+                if (limit != 0 && completion.size() >= limit)
+                    break;
+                completion.push_back(*completionEntries[i].name);
+            }
+            return;
+        }
+
+        auto c = (unsigned char) prefix[pos];
+        auto children = completionNodes.begin() + node.firstChild;
+        auto child = std::lower_bound(children, children + node.nChildren, c,
+                                      [this, pos](const CompletionNode& n, unsigned char ch)
+                                      {
+                                          return (unsigned char) completionKey(n.first)[pos] < ch;
+                                      });
+        if (child == children + node.nChildren || (unsigned char) completionKey(child->first)[pos] != c)
+            return;
+
+        nodeIndex = (uint32_t) (child - completionNodes.begin());
+    }
+}
+
+// Build a minimal perfect hash of the names with hash and displace: the
+// hash with seed 0 assigns every name to a bucket, and each bucket gets
+// the first seed which moves all of its names to free slots. The largest
+// buckets are placed first while most slots are still free; buckets with
+// a single name simply take the remaining slots.
+void NameDatabase::buildLookupTable()
+{
+    auto n = (uint32_t) nameIndex.size();
+    if (n == 0)
+        return;
+
+    std::vector<uint32_t> keyOffsets;
+    std::vector<uint32_t> keyBuckets;
+    keyOffsets.reserve(n + 1);
+    keyBuckets.reserve(n);
+    lookupSlots.resize(n);
+    for (const auto& name : nameIndex)
+    {
+        keyOffsets.push_back((uint32_t) lookupKeys.size());
+        keyBuckets.push_back(hashName(name.first.data(), name.first.size(), 0) % n);
+        for (char c : name.first)
+            lookupKeys += upperCase(c);
+    }
+    keyOffsets.push_back((uint32_t) lookupKeys.size());
+
+    std::vector<uint32_t> bucketSizes(n, 0);
+    for (uint32_t b : keyBuckets)
+        bucketSizes[b]++;
+
+    // Names grouped by bucket, largest buckets first
+    std::vector<uint32_t> keys(n);
+    for (uint32_t i = 0; i < n; i++)
+        keys[i] = i;
+    std::sort(keys.begin(), keys.end(),
+              [&](uint32_t a, uint32_t b)
+              {
+                  uint32_t ba = keyBuckets[a], bb = keyBuckets[b];
+                  if (bucketSizes[ba] != bucketSizes[bb])
+                      return bucketSizes[ba] > bucketSizes[bb];
+                  return ba != bb ? ba < bb : a < b;
+              });
+
+    const char* arena = lookupKeys.data();
+    std::vector<bool> used(n, false);
+    std::vector<uint32_t> slots;
+    lookupBuckets.assign(n, 0);
+
+    uint32_t i = 0;
+    for (; i < n && bucketSizes[keyBuckets[keys[i]]] > 1; )
+    {
+        uint32_t bucket = keyBuckets[keys[i]];
+        uint32_t size = bucketSizes[bucket];
+        for (uint32_t seed = 1; ; seed++)
+        {
+            slots.clear();
+            for (uint32_t j = i; j < i + size; j++)
+            {
+                uint32_t k = keys[j];
+                uint32_t slot = hashName(arena + keyOffsets[k], keyOffsets[k + 1] - keyOffsets[k], seed) % n;
+                if (used[slot] || std::find(slots.begin(), slots.end(), slot) != slots.end())
+                    break;
+                slots.push_back(slot);
+            }
+
+            if (slots.size() == size)
+            {
+                lookupBuckets[bucket] = (int32_t) seed;
+                break;
+            }
+        }
+
+        for (uint32_t j = 0; j < size; j++)
+        {
+            used[slots[j]] = true;
+            lookupSlots[slots[j]].keyOffset = keys[i + j];
+        }
+        i += size;
+    }
+
+    uint32_t freeSlot = 0;
+    for (; i < n; i++)
+    {
+        while (used[freeSlot])
+            freeSlot++;
+        used[freeSlot] = true;
+        lookupBuckets[keyBuckets[keys[i]]] = -1 - (int32_t) freeSlot;
+        lookupSlots[freeSlot].keyOffset = keys[i];
+    }
+
+    // The slots have been filled with the indexes of their names so far
+    std::vector<AstroCatalog::IndexNumber> catalogNumbers;
+    catalogNumbers.reserve(n);
+    for (const auto& name : nameIndex)
+        catalogNumbers.push_back(name.second);
+    for (auto& slot : lookupSlots)
+    {
+        uint32_t k = slot.keyOffset;
+        slot.keyOffset     = keyOffsets[k];
+        slot.keyLength     = keyOffsets[k + 1] - keyOffsets[k];
+        slot.catalogNumber = catalogNumbers[k];
+    }
+}
+
+AstroCatalog::IndexNumber NameDatabase::lookup(const std::string& name) const
+{
+    auto n = (uint32_t) lookupSlots.size();
+    if (n == 0)
+        return AstroCatalog::InvalidIndex;
+
+    int32_t bucket = lookupBuckets[hashName(name.data(), name.size(), 0) % n];
+    uint32_t slot = bucket < 0 ? (uint32_t) (-1 - bucket)
+                               : hashName(name.data(), name.size(), (uint32_t) bucket) % n;
+
+    const LookupSlot& entry = lookupSlots[slot];
+    if (entry.keyLength != name.size())
+        return AstroCatalog::InvalidIndex;
+
+    const char* key = lookupKeys.data() + entry.keyOffset;
+    for (size_t i = 0; i < name.size(); i++)
+    {
+        if (key[i] != upperCase(name[i]))
+            return AstroCatalog::InvalidIndex;
+    }
+
+    return entry.catalogNumber;
+}
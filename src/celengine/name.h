@@ -46,11 +46,74 @@ class NameDatabase
     NumberIndex::const_iterator getFirstNameIter(const AstroCatalog::IndexNumber catalogNumber) const;
     NumberIndex::const_iterator getFinalNameIter() const;
 
-    std::vector<std::string> getCompletion(const std::string& name, bool greek = true) const;
-    std::vector<std::string> getCompletion(const std::vector<std::string> &list) const;
+    // Return the names starting with name, ignoring case; at most limit
+    // names are returned unless limit is 0.
+    std::vector<std::string> getCompletion(const std::string& name, bool greek = true, size_t limit = 0) const;
+    std::vector<std::string> getCompletion(const std::vector<std::string> &list, size_t limit = 0) const;
+
+    // Build the hash table used by getCatalogNumberByName() and the prefix
+    // index used by getCompletion(). Adding names invalidates them, and
+    // lookups fall back to searching the name index until they're built
+    // again.
+    void buildIndexes();
 
  protected:
     NameIndex   nameIndex;
     NumberIndex numberIndex;
+
+ private:
+    // Names sorted by their case folded form, which is kept in
+    // completionKeys.
+    struct CompletionEntry
+    {
+        uint32_t keyOffset;
+        uint32_t keyLength;
+        const std::string* name;
+    };
+
+    // Node of a radix tree over the folded names. The entries with keys
+    // starting with the node's prefix are [first, last); all of them share
+    // their first depth bytes. The children of a node are contiguous and
+    // sorted by the byte at depth of their keys.
+    struct CompletionNode
+    {
+        uint32_t first;
+        uint32_t last;
+        uint32_t depth;
+        uint32_t firstChild;
+        uint32_t nChildren;
+    };
+
+    const char* completionKey(uint32_t entry) const
+    {
+        return completionKeys.data() + completionEntries[entry].keyOffset;
+    }
+
+    // Slot of the minimal perfect hash table of names; the key is the
+    // upper case name in lookupKeys.
+    struct LookupSlot
+    {
+        uint32_t keyOffset;
+        uint32_t keyLength;
+        AstroCatalog::IndexNumber catalogNumber;
+    };
+
+    void buildCompletionIndex();
+    void buildLookupTable();
+    void clearIndexes();
+    void findCompletion(const std::string& name, size_t limit, std::vector<std::string>& completion) const;
+    AstroCatalog::IndexNumber lookup(const std::string& name) const;
+
+    std::string                   completionKeys;
+    std::vector<CompletionEntry>  completionEntries;
+    std::vector<CompletionNode>   completionNodes;
+
+    // Each bucket holds either the seed of the hash which maps its names
+    // to their slots, or -1 - the slot of its only name.
+    std::string                   lookupKeys;
+    std::vector<int32_t>          lookupBuckets;
+    std::vector<LookupSlot>       lookupSlots;
+
+    bool                          indexesValid{ false };
 };
 
@@ -15,7 +15,15 @@
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
+#include <celcompat/span.h>
 #include <celengine/observer.h>
+#include <celutil/threadpool.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
 #include <vector>
 
 // The DynamicOctree and StaticOctree template arguments are:
@@ -39,6 +47,47 @@ template <class OBJ, class PREC> class OctreeProcessor
     virtual ~OctreeProcessor() {};
 
     virtual void process(const OBJ& obj, PREC distance, float appMag) = 0;
+
+    // Process a batch of objects at once; the three spans have the same
+    // size. Traversals which collect their results pass them here instead
+    // of making a virtual call per object. The default implementation
+    // simply calls process() for every object, so handlers only need to
+    // override it when they can do better.
+    virtual void processBatch(celestia::span<const OBJ* const> objs,
+                              celestia::span<const PREC>       distances,
+                              celestia::span<const float>      appMags)
+    {
+        for (size_t i = 0; i < objs.size(); i++)
+            process(*objs[i], distances[i], appMags[i]);
+    }
+};
+
+
+
+// Tests objects against a pick ray for StaticOctree::pickObject().
+template <class OBJ, class PREC> class OctreeRayPicker
+{
+ public:
+    OctreeRayPicker()          {};
+    virtual ~OctreeRayPicker() {};
+
+    // Return true if the ray hits the object, and set cosAngle to the
+    // cosine of the angle between the ray and the direction from its
+    // origin to the object.
+    virtual bool pick(const OBJ& obj, PREC& cosAngle) = 0;
+};
+
+
+
+// Receives the objects found by StaticOctree::processConeObjects(). The
+// cone may be narrowed while objects are processed, so that processors
+// looking for the object closest to its axis end the search early.
+template <class OBJ, class PREC> class OctreeConeProcessor : public OctreeProcessor<OBJ, PREC>
+{
+ public:
+    // Largest angle in radians between the axis of the cone and the
+    // objects which are still of interest
+    virtual PREC maxAngle() const = 0;
 };
 
 
@@ -73,6 +122,21 @@ private:
     void insertObject  (const OBJ&, const PREC);
     void rebuildAndSort(StaticOctree<OBJ, PREC>*&, OBJ*&);
 
+    // Build the static octree for the objects objects[0] to
+    // objects[nObjects - 1] in one go, copying them to sortedObjects in
+    // octree order. The result is exactly the same as inserting the
+    // objects in order into a DynamicOctree with the given root and
+    // calling rebuildAndSort(), which is what happens without a thread
+    // pool. With one, the objects are sorted into the octree in parallel
+    // instead, without building the dynamic tree.
+    template<class ARRAY> static StaticOctree<OBJ, PREC>* build(const PointType& cellCenterPos,
+                                                                const float      exclusionFactor,
+                                                                const PREC       scale,
+                                                                const ARRAY&     objects,
+                                                                uint32_t         nObjects,
+                                                                OBJ*             sortedObjects,
+                                                                ThreadPool*      threadPool = nullptr);
+
  private:
    static unsigned int SPLIT_THRESHOLD;
 
@@ -85,6 +149,65 @@ private:
     void           split(const PREC);
     void           sortIntoChildNodes();
     DynamicOctree* getChild(const OBJ&, const Eigen::Matrix<PREC, 3, 1>&);
+    void           sortObjects(StaticOctree<OBJ, PREC>&, uint32_t, OBJ*&) const;
+
+    // Index of the child node containing the object; implemented by the
+    // specializations.
+    static int childIndex(const OBJ&, const PointType&);
+
+    // A node of the tree produced by build(). The objects of its subtree
+    // are the range [first, end) of the build order, with the objects
+    // kept in the node itself at the start of the range.
+    struct BuildNode
+    {
+        PointType                    cellCenterPos;
+        PREC                         exclusionFactor;
+        PREC                         scale;
+        uint32_t                     first;
+        uint32_t                     end;
+        uint32_t                     nObjects;
+        // Level of the node below the one where the keys of its objects
+        // were computed
+        uint32_t                     keyLevel;
+        // Which of the two key buffers holds the node's objects
+        uint32_t                     buffer;
+        std::unique_ptr<BuildNode[]> children;
+    };
+
+    // Number of levels covered by a BuildKey; octants are stored 21 to a
+    // 64 bit word.
+    static constexpr const unsigned int KEY_WORDS  = 2;
+    static constexpr const unsigned int KEY_LEVELS = KEY_WORDS * 21;
+
+    // The path of an object through a number of levels below a node: the
+    // child it goes to at every level, three bits per level, up to
+    // the level where it has to stay in the node because of its limiting
+    // factor or because it straddles the children.
+    struct BuildKey
+    {
+        uint64_t octants[KEY_WORDS];
+        uint32_t index;
+        uint32_t keptLevel;
+    };
+
+    struct BuildState
+    {
+        std::vector<const OBJ*> objects;
+        // The keys move between two buffers while they are sorted
+        std::vector<BuildKey>   keys[2];
+        ThreadPool*             threadPool;
+    };
+
+    static StaticOctree<OBJ, PREC>* buildFromObjects(const PointType& cellCenterPos,
+                                                     const float      exclusionFactor,
+                                                     const PREC       scale,
+                                                     BuildState&      state,
+                                                     OBJ*             sortedObjects);
+    static void childGeometry(const BuildNode& parent, int child, BuildNode& node);
+    static void computeKey   (BuildKey&, const BuildState&, const BuildNode&,
+                              const PREC* exclusionFactors, const PREC* childScales);
+    static void partitionNode(BuildNode&, BuildState&, bool parallel);
+    static void buildSubtree (BuildNode&, BuildState&);
 
     DynamicOctree**            _children;
     Eigen::Matrix<PREC, 3, 1>  cellCenterPos;
@@ -104,11 +227,8 @@ template <class OBJ, class PREC> class StaticOctree
     typedef Eigen::Matrix<PREC, 3, 1> PointType;
 
  public:
-    StaticOctree(const PointType&    cellCenterPos,
-                 const float         exclusionFactor,
-                 OBJ*                _firstObject,
-                 unsigned int        nObjects);
-    ~StaticOctree();
+    StaticOctree(OBJ* objects, unsigned int nObjects);
+    ~StaticOctree() = default;
 
     // These methods are only declared at the template level; we'll implement them as
     // full specializations, allowing for different traversal strategies depending on the
@@ -121,32 +241,268 @@ template <class OBJ, class PREC> class StaticOctree
     // objects that are outside the view frustum may be.  Frustum tests are performed
     // only at the node level to optimize the octree traversal, so an exact test
     // (if one is required) is the responsibility of the callback method.
+    // If a thread pool is given, specializations may split up the
+    // traversal between its threads. The objects are still passed to the
+    // processor on the calling thread, and in the same order.
     void processVisibleObjects(OctreeProcessor<OBJ, PREC>&       processor,
                                const PointType&                  obsPosition,
                                const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
                                float                             limitingFactor,
                                PREC                              scale,
-                               OctreeProcStats * = nullptr) const;
+                               OctreeProcStats *                 stats = nullptr,
+                               ThreadPool *                      threadPool = nullptr) const;
 
     void processCloseObjects(OctreeProcessor<OBJ, PREC>&        processor,
                              const PointType&                   obsPosition,
                              PREC                               boundingRadius,
                              PREC                               scale) const;
 
+    // These methods find the nObjects objects nearest to obsPosition, the
+    // ones that appear brightest from there, and the ones with the
+    // brightest limiting property, e.g. absolute magnitude for stars.
+    // The objects are returned best first, objects that compare equal in
+    // the order of the object array, which is what a linear scan over the
+    // objects would find. The search is best first over the nodes, and
+    // stops as soon as no remaining node can hold a better object. Like
+    // the process*() methods, they're implemented by specializations.
+    void findNearestObjects(const PointType&         obsPosition,
+                            PREC                     scale,
+                            unsigned int             nObjects,
+                            std::vector<const OBJ*>& result,
+                            OctreeProcStats*         stats = nullptr) const;
+
+    void findBrightestObjects(const PointType&         obsPosition,
+                              PREC                     scale,
+                              unsigned int             nObjects,
+                              std::vector<const OBJ*>& result,
+                              OctreeProcStats*         stats = nullptr) const;
+
+    void findMostLuminousObjects(PREC                     scale,
+                                 unsigned int             nObjects,
+                                 std::vector<const OBJ*>& result,
+                                 OctreeProcStats*         stats = nullptr) const;
+
+    // Find the object which the picker reports as hit by a ray from
+    // origin along the unit vector direction, and which is closest in
+    // angle to the ray; objects at the same angle are taken in the order
+    // of the object array. Returns nullptr if no object is hit. Only the
+    // nodes the ray passes through are searched, the ones closest in
+    // angle to the ray first, and the search ends as soon as no remaining
+    // node can hold an object closer to the ray than the best hit. This
+    // relies on pick radii, which only some specializations provide.
+    const OBJ* pickObject(OctreeRayPicker<OBJ, PREC>& picker,
+                          const PointType&            origin,
+                          const PointType&            direction,
+                          OctreeProcStats*            stats = nullptr) const;
+
+    // Pass the objects within the cone of processor.maxAngle() around the
+    // ray from obsPosition along the unit vector direction which pass the
+    // magnitude test of processVisibleObjects() to the processor, in order
+    // of increasing angle to the ray. The order is that of a lower bound
+    // of the angle, which specializations may widen for objects whose
+    // position isn't exact; objects with the same bound are passed in the
+    // order of the object array. Nodes are pruned by their angular
+    // distance to the ray and by magnitude, and the search ends as soon as
+    // no remaining object can be within the current maxAngle().
+    void processConeObjects(OctreeConeProcessor<OBJ, PREC>& processor,
+                            const PointType&                obsPosition,
+                            const PointType&                direction,
+                            float                           limitingFactor,
+                            PREC                            scale,
+                            OctreeProcStats*                stats = nullptr) const;
+
     int countChildren() const;
     int countObjects()  const;
 
-    void computeStatistics(std::vector<OctreeLevelStatistics>& stats, unsigned int level = 0);
+    void computeStatistics(std::vector<OctreeLevelStatistics>& stats) const;
+
+    // A node of the octree in a pointer-free form, used to store a built
+    // octree and restore it without reinserting the objects. Nodes are
+    // listed in the same breadth first order as in the octree itself.
+    struct PackedNode
+    {
+        PREC     cellCenterPos[3];
+        float    exclusionFactor;
+        uint32_t firstObject;
+        uint32_t nObjects;
+        uint32_t firstChild;
+    };
+
+    void pack(std::vector<PackedNode>& nodes) const;
+    // objects may be null for an octree whose objects are supplied by an
+    // ObjectPager instead.
+    static StaticOctree* unpack(const PackedNode* nodes, uint32_t nNodes,
+                                OBJ* objects, uint32_t nObjects);
+
+    // Size of the blocks in which the structure of arrays object data
+    // below is processed.
+    static constexpr const unsigned int OBJECT_BLOCK = 8;
+
+    // Object positions in the culling data are quantized to 16 bits
+    // relative to the box enclosing the objects of their node: an object
+    // is at origin + q * step, no further than error from its actual
+    // position. Specializations may flag nodes with objects needing
+    // special treatment by a negative error.
+    struct ObjectBounds
+    {
+        PREC origin[3];
+        PREC step;
+        PREC error;
+    };
+
+    // The objects of a single node, with their structure of arrays
+    // culling data if the specialization keeps any. The arrays are padded
+    // so that whole blocks of OBJECT_BLOCK entries can always be loaded.
+    struct NodeObjects
+    {
+        const OBJ*      objects;
+        const uint16_t* x;
+        const uint16_t* y;
+        const uint16_t* z;
+        const int16_t*  magnitude;
+        ObjectBounds    bounds;
+        uint32_t        count;
+    };
+
+    // Supplies the objects of the nodes of an octree which doesn't hold
+    // them in memory itself, e.g. because they're paged in from disk on
+    // demand. load() may be called from several threads at once while a
+    // traversal is split up between threads; the objects returned must
+    // remain valid until the traversal has finished.
+    class ObjectPager
+    {
+     public:
+        virtual ~ObjectPager() = default;
+        virtual NodeObjects load(uint32_t node) = 0;
+    };
+
+    void setObjectPager(ObjectPager* pager) { objectPager = pager; }
+    NodeObjects nodeObjects(uint32_t node) const;
 
  private:
     static const PREC SQRT3;
 
+    // Number of children of a node with children; they are always tested
+    // against the frustum together.
+    static constexpr const unsigned int NODE_CHILDREN = 8;
+
+    typedef Eigen::Array<PREC, NODE_CHILDREN, 1> ChildArray;
+
+    struct TraversalEntry
+    {
+        uint32_t node;
+        uint32_t depth;
+        PREC     scale;
+        PREC     minDistance;
+    };
+
+    uint32_t addNode(const PointType& cellCenterPos, float exclusionFactor);
+
+    // Called once the objects are in their final order. Specializations
+    // may fill in the per object culling data below; by default there is
+    // none.
+    void buildObjectData();
+
+    unsigned int cullChildren(uint32_t                          firstChild,
+                              const PointType&                  obsPosition,
+                              const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                              PREC                              childScale,
+                              ChildArray&                       minDistances) const;
+
+    // A part of a traversal split up by splitVisibleTraversal()
+    struct TraversalPart
+    {
+        TraversalEntry entry;
+        bool           subtree;
+    };
+
+    bool visibleRoot(const PointType&                  obsPosition,
+                     const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                     PREC                              scale,
+                     TraversalEntry&                   root) const;
+
+    void visibleChildren(const TraversalEntry&             entry,
+                         const PointType&                  obsPosition,
+                         const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                         float                             limitingFactor,
+                         std::vector<TraversalEntry>&      children) const;
+
+    template<class VISITOR> void traverseVisibleNodes(const PointType&                  obsPosition,
+                                                      const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                                                      float                             limitingFactor,
+                                                      PREC                              scale,
+                                                      VISITOR&                          visitor,
+                                                      OctreeProcStats*                  stats) const;
+
+    template<class VISITOR> void traverseVisibleSubtree(const TraversalEntry&             start,
+                                                        const PointType&                  obsPosition,
+                                                        const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                                                        float                             limitingFactor,
+                                                        VISITOR&                          visitor,
+                                                        OctreeProcStats*                  stats) const;
+
+    void splitVisibleTraversal(const PointType&                  obsPosition,
+                               const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                               float                             limitingFactor,
+                               PREC                              scale,
+                               unsigned int                      minSubtrees,
+                               std::vector<TraversalPart>&       parts) const;
+
+    template<class VISITOR> void traverseCloseNodes(const PointType& obsPosition,
+                                                    PREC             boundingRadius,
+                                                    PREC             scale,
+                                                    VISITOR&         visitor) const;
+
+    // Best first search for the objects with the lowest keys. KEY supplies
+    // the key of an object, and a lower bound of the keys of the objects
+    // in the subtree of a node, given the cell of the node and the
+    // exclusion factor of its parent:
+    //   PREC object(const OBJ&) const;
+    //   PREC node(const PointType& cellCenterPos, PREC scale, float parentExclusionFactor) const;
+    template<class KEY> void findBestObjects(const KEY&               key,
+                                             PREC                     scale,
+                                             unsigned int             nObjects,
+                                             std::vector<const OBJ*>& result,
+                                             OctreeProcStats*         stats) const;
+
  private:
-    StaticOctree** _children;
-    Eigen::Matrix<PREC, 3, 1>   cellCenterPos;
-    float          exclusionFactor;
-    OBJ*           _firstObject;
-    unsigned int   nObjects;
+    // The nodes are stored breadth first in structure of arrays form. The
+    // eight children of a node are always adjacent, so that node centers
+    // of siblings can be loaded and tested together. firstChild is zero
+    // for nodes without children (the root is never a child.)
+    std::vector<PREC>     centerX;
+    std::vector<PREC>     centerY;
+    std::vector<PREC>     centerZ;
+    std::vector<float>    exclusionFactors;
+    std::vector<uint32_t> firstChild;
+    std::vector<uint32_t> firstObject;
+    std::vector<uint32_t> objectCounts;
+
+    // Objects are sorted depth first, so the objects of any subtree are
+    // contiguous.
+    OBJ*                  objects;
+    uint32_t              nObjects;
+
+    // Optional compact culling data: quantized object positions and
+    // magnitudes in structure of arrays form, in object order and padded
+    // by OBJECT_BLOCK entries so that whole blocks can always be loaded,
+    // and the bounds the positions of each node are relative to. This is
+    // a copy kept next to the objects, about 9 bytes per object with the
+    // node bounds: the objects themselves can't shrink, as the rest of the
+    // engine keeps pointers to them.
+    std::vector<uint16_t>     objectX;
+    std::vector<uint16_t>     objectY;
+    std::vector<uint16_t>     objectZ;
+    std::vector<int16_t>      objectMagnitude;
+    std::vector<ObjectBounds> objectBounds;
+
+    // Optional radius of a sphere around the center of each node which
+    // encloses everything that can be picked in the subtree of the node;
+    // negative if the subtree has no objects.
+    std::vector<PREC>     pickRadii;
+
+    // If set, the objects are obtained from the pager instead
+    ObjectPager*          objectPager{ nullptr };
 };
 
 
@@ -294,10 +650,358 @@ inline void DynamicOctree<OBJ, PREC>::sortIntoChildNodes()
 }
 
 
+template <class OBJ, class PREC>
+inline DynamicOctree<OBJ, PREC>* DynamicOctree<OBJ, PREC>::getChild(const OBJ& obj, const PointType& cellCenterPos)
+{
+    return _children[childIndex(obj, cellCenterPos)];
+}
+
+
+// build() sorts the objects top down, with a stable radix sort on the
+// octant of each object within its node. The octants and the level at
+// which an object stays in a node are computed in one pass over the
+// objects for KEY_LEVELS levels at a time, which is deeper than octrees
+// usually get, so that the objects themselves aren't touched again while
+// sorting. Whether a node splits depends on the order in
+// which objects reach it: insertObject() keeps the first SPLIT_THRESHOLD
+// objects in the node, and the object that triggers the split stays there
+// as well. As the sort is stable, every node sees its objects in
+// insertion order, and the same rule can be applied.
+template <class OBJ, class PREC>
+template <class ARRAY>
+StaticOctree<OBJ, PREC>* DynamicOctree<OBJ, PREC>::build(const PointType& cellCenterPos,
+                                                         const float      exclusionFactor,
+                                                         const PREC       scale,
+                                                         const ARRAY&     objects,
+                                                         uint32_t         nObjects,
+                                                         OBJ*             sortedObjects,
+                                                         ThreadPool*      threadPool)
+{
+    // A single thread is better off inserting the objects one at a time,
+    // as each object is then only loaded once.
+    if (threadPool == nullptr || threadPool->threadCount() < 2)
+    {
+        DynamicOctree root(cellCenterPos, exclusionFactor);
+        for (uint32_t i = 0; i < nObjects; ++i)
+            root.insertObject(objects[i], scale);
+
+        StaticOctree<OBJ, PREC>* staticTree = nullptr;
+        root.rebuildAndSort(staticTree, sortedObjects);
+        return staticTree;
+    }
+
+    BuildState state;
+    state.objects.resize(nObjects);
+    state.threadPool = threadPool;
+    for (uint32_t i = 0; i < nObjects; ++i)
+        state.objects[i] = &objects[i];
+
+    return buildFromObjects(cellCenterPos, exclusionFactor, scale, state, sortedObjects);
+}
+
+
+template <class OBJ, class PREC>
+StaticOctree<OBJ, PREC>* DynamicOctree<OBJ, PREC>::buildFromObjects(const PointType& cellCenterPos,
+                                                                    const float      exclusionFactor,
+                                                                    const PREC       scale,
+                                                                    BuildState&      state,
+                                                                    OBJ*             sortedObjects)
+{
+    // Once a level has this many nodes per thread that may split, whole
+    // subtrees are handed to the threads.
+    const size_t SUBTREES_PER_THREAD = 4;
+    // Nodes with fewer objects than this are not worth sorting in parallel
+    const uint32_t MIN_PARALLEL_OBJECTS = 32768;
+
+    ThreadPool* threadPool = state.threadPool;
+    auto nObjects = (uint32_t) state.objects.size();
+    state.keys[0].resize(nObjects);
+    state.keys[1].resize(nObjects);
+    for (uint32_t i = 0; i < nObjects; ++i)
+        state.keys[0][i].index = i;
+
+    BuildNode root;
+    root.cellCenterPos   = cellCenterPos;
+    root.exclusionFactor = exclusionFactor;
+    root.scale           = scale;
+    root.first           = 0;
+    root.end             = nObjects;
+    root.keyLevel        = KEY_LEVELS;
+    root.buffer          = 0;
+
+    // Sort the tree level by level, each node using all threads, until
+    // there are enough nodes to hand out whole subtrees.
+    std::vector<BuildNode*> level;
+    level.push_back(&root);
+    while (!level.empty())
+    {
+        size_t nSplittable = std::count_if(level.begin(), level.end(), [](const BuildNode* node)
+                                           { return node->end - node->first > SPLIT_THRESHOLD; });
+        if (nSplittable >= SUBTREES_PER_THREAD * threadPool->threadCount())
+        {
+            threadPool->parallelFor(level.size(), [&](size_t i) { buildSubtree(*level[i], state); });
+            break;
+        }
+
+        std::vector<BuildNode*> next;
+        for (BuildNode* node : level)
+        {
+            partitionNode(*node, state, node->end - node->first >= MIN_PARALLEL_OBJECTS);
+            if (node->children != nullptr)
+            {
+                for (int i = 0; i < 8; ++i)
+                    next.push_back(&node->children[i]);
+            }
+        }
+        level.swap(next);
+    }
+
+    // Number the nodes breadth first, as rebuildAndSort() does; the
+    // objects are already in depth first order, but in either buffer.
+    auto* staticTree = new StaticOctree<OBJ, PREC>(sortedObjects, nObjects);
+    std::vector<const BuildNode*> queue;
+    queue.push_back(&root);
+    staticTree->addNode(root.cellCenterPos, root.exclusionFactor);
+    for (size_t i = 0; i < queue.size(); ++i)
+    {
+        const BuildNode* node = queue[i];
+        staticTree->firstObject[i]  = node->first;
+        staticTree->objectCounts[i] = node->nObjects;
+        const BuildKey* keys = state.keys[node->buffer].data();
+        for (uint32_t j = node->first; j < node->first + node->nObjects; ++j)
+            sortedObjects[j] = *state.objects[keys[j].index];
+        if (node->children != nullptr)
+        {
+            staticTree->firstChild[i] = (uint32_t) queue.size();
+            for (int j = 0; j < 8; ++j)
+            {
+                const BuildNode* child = &node->children[j];
+                queue.push_back(child);
+                staticTree->addNode(child->cellCenterPos, child->exclusionFactor);
+            }
+        }
+    }
+
+    staticTree->buildObjectData();
+
+    return staticTree;
+}
+
+
+// Same child layout as split()
+template <class OBJ, class PREC>
+void DynamicOctree<OBJ, PREC>::childGeometry(const BuildNode& parent, int child, BuildNode& node)
+{
+    PREC childScale = parent.scale * (PREC) 0.5;
+    PointType centerPos = parent.cellCenterPos;
+    centerPos += PointType(((child & XPos) != 0) ? childScale : -childScale,
+                           ((child & YPos) != 0) ? childScale : -childScale,
+                           ((child & ZPos) != 0) ? childScale : -childScale);
+    PREC childExclusionFactor = (float) decayFunction(parent.exclusionFactor);
+
+    node.cellCenterPos   = centerPos;
+    node.exclusionFactor = childExclusionFactor;
+    node.scale           = childScale;
+}
+
+
+// The exclusion factors and child scales of the levels below node only
+// depend on the level, so they're computed once for all objects.
+template <class OBJ, class PREC>
+void DynamicOctree<OBJ, PREC>::computeKey(BuildKey&        key,
+                                          const BuildState& state,
+                                          const BuildNode&  node,
+                                          const PREC*       exclusionFactors,
+                                          const PREC*       childScales)
+{
+    const OBJ& obj = *state.objects[key.index];
+    PointType cellCenterPos = node.cellCenterPos;
+
+    for (unsigned int i = 0; i < KEY_WORDS; ++i)
+        key.octants[i] = 0;
+    for (key.keptLevel = 0; key.keptLevel < KEY_LEVELS; ++key.keptLevel)
+    {
+        PREC exclusionFactor = exclusionFactors[key.keptLevel];
+        if (limitingFactorPredicate(obj, exclusionFactor) ||
+            straddlingPredicate(cellCenterPos, obj, exclusionFactor))
+            break;
+
+        int child = childIndex(obj, cellCenterPos);
+        key.octants[key.keptLevel / 21] |= (uint64_t) child << (3 * (key.keptLevel % 21));
+
+        PREC childScale = childScales[key.keptLevel];
+        cellCenterPos += PointType(((child & XPos) != 0) ? childScale : -childScale,
+                                   ((child & YPos) != 0) ? childScale : -childScale,
+                                   ((child & ZPos) != 0) ? childScale : -childScale);
+    }
+}
+
+
+// Decide which of the node's objects stay in it, and sort the others by
+// child. If parallel is set, the objects are processed in chunks on the
+// thread pool.
+template <class OBJ, class PREC>
+void DynamicOctree<OBJ, PREC>::partitionNode(BuildNode& node, BuildState& state, bool parallel)
+{
+    // Slot of the objects which stay in the node; children are 0-7
+    const unsigned int KEEP = 8;
+    const unsigned int N_SLOTS = 9;
+    const uint32_t CHUNK_SIZE = 8192;
+
+    uint32_t nObjects = node.end - node.first;
+    node.nObjects = nObjects;
+    // A node only splits once it holds SPLIT_THRESHOLD objects
+    if (nObjects <= SPLIT_THRESHOLD)
+        return;
+
+    BuildKey* keys = state.keys[node.buffer].data() + node.first;
+    BuildKey* sorted = state.keys[1 - node.buffer].data() + node.first;
+
+    size_t nChunks = 1;
+    if (parallel)
+        nChunks = std::min((size_t) state.threadPool->threadCount() * 4, (size_t) (nObjects + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    auto chunkStart = [&](size_t chunk) { return (uint32_t) ((uint64_t) nObjects * chunk / nChunks); };
+    auto forEachChunk = [&](const std::function<void(size_t)>& body)
+    {
+        if (nChunks > 1)
+            state.threadPool->parallelFor(nChunks, body);
+        else
+            body(0);
+    };
+
+    if (node.keyLevel == KEY_LEVELS)
+    {
+        PREC exclusionFactors[KEY_LEVELS];
+        PREC childScales[KEY_LEVELS];
+        BuildNode path;
+        path.exclusionFactor = node.exclusionFactor;
+        path.scale           = node.scale;
+        for (unsigned int i = 0; i < KEY_LEVELS; ++i)
+        {
+            exclusionFactors[i] = path.exclusionFactor;
+            childGeometry(path, 0, path);
+            childScales[i] = path.scale;
+        }
+
+        forEachChunk([&](size_t chunk)
+        {
+            for (uint32_t i = chunkStart(chunk); i < chunkStart(chunk + 1); ++i)
+                computeKey(keys[i], state, node, exclusionFactors, childScales);
+        });
+        node.keyLevel = 0;
+    }
+
+    uint32_t level = node.keyLevel;
+    auto slot = [level](const BuildKey& key)
+    {
+        return key.keptLevel == level ? KEEP : (unsigned int) (key.octants[level / 21] >> (3 * (level % 21))) & 7;
+    };
+
+    // The first object that could go into a child once the node is full
+    // triggers the split, and stays in the node.
+    uint32_t trigger = SPLIT_THRESHOLD;
+    while (trigger < nObjects && slot(keys[trigger]) == KEEP)
+        ++trigger;
+    if (trigger == nObjects)
+        return;
+
+    std::vector<uint32_t> offsets(nChunks * N_SLOTS, 0);
+    forEachChunk([&](size_t chunk)
+    {
+        uint32_t* counts = &offsets[chunk * N_SLOTS];
+        for (uint32_t i = chunkStart(chunk); i < chunkStart(chunk + 1); ++i)
+            counts[i == trigger ? KEEP : slot(keys[i])]++;
+    });
+
+    // Objects staying in the node come first, then those of children 0-7
+    uint32_t slotStart[N_SLOTS + 1];
+    uint32_t position = 0;
+    for (unsigned int s = 0; s < N_SLOTS; ++s)
+    {
+        unsigned int sl = (s + KEEP) % N_SLOTS;
+        slotStart[sl] = position;
+        for (size_t chunk = 0; chunk < nChunks; ++chunk)
+        {
+            uint32_t count = offsets[chunk * N_SLOTS + sl];
+            offsets[chunk * N_SLOTS + sl] = position;
+            position += count;
+        }
+    }
+    slotStart[N_SLOTS] = nObjects;
+
+    forEachChunk([&](size_t chunk)
+    {
+        uint32_t* next = &offsets[chunk * N_SLOTS];
+        for (uint32_t i = chunkStart(chunk); i < chunkStart(chunk + 1); ++i)
+            sorted[next[i == trigger ? KEEP : slot(keys[i])]++] = keys[i];
+    });
+
+    node.nObjects = slotStart[0];
+    node.buffer   = 1 - node.buffer;
+    node.children.reset(new BuildNode[8]);
+    for (int i = 0; i < 8; ++i)
+    {
+        BuildNode& child = node.children[i];
+        childGeometry(node, i, child);
+        child.first    = node.first + slotStart[i];
+        child.end      = node.first + (i == 7 ? slotStart[N_SLOTS] : slotStart[i + 1]);
+        child.keyLevel = level + 1;
+        child.buffer   = node.buffer;
+    }
+}
+
+
+template <class OBJ, class PREC>
+void DynamicOctree<OBJ, PREC>::buildSubtree(BuildNode& node, BuildState& state)
+{
+    partitionNode(node, state, false);
+    if (node.children != nullptr)
+    {
+        for (int i = 0; i < 8; ++i)
+            buildSubtree(node.children[i], state);
+    }
+}
+
+
+// Compile the dynamic octree into a static one. Nodes of the static
+// octree are numbered breadth first, while the objects are copied to
+// _sortedObjects in depth first order.
 template <class OBJ, class PREC>
 inline void DynamicOctree<OBJ, PREC>::rebuildAndSort(StaticOctree<OBJ, PREC>*& _staticNode, OBJ*& _sortedObjects)
 {
     OBJ* _firstObject = _sortedObjects;
+    _staticNode = new StaticOctree<OBJ, PREC>(_firstObject, 0);
+
+    std::vector<const DynamicOctree*> queue;
+    queue.push_back(this);
+    _staticNode->addNode(cellCenterPos, exclusionFactor);
+    for (size_t i = 0; i < queue.size(); ++i)
+    {
+        const DynamicOctree* node = queue[i];
+        if (node->_children != nullptr)
+        {
+            _staticNode->firstChild[i] = (uint32_t) queue.size();
+            for (int j = 0; j < 8; ++j)
+            {
+                const DynamicOctree* child = node->_children[j];
+                queue.push_back(child);
+                _staticNode->addNode(child->cellCenterPos, child->exclusionFactor);
+            }
+        }
+    }
+
+    sortObjects(*_staticNode, 0, _sortedObjects);
+    _staticNode->nObjects = (uint32_t) (_sortedObjects - _firstObject);
+    _staticNode->buildObjectData();
+}
+
+
+template <class OBJ, class PREC>
+inline void DynamicOctree<OBJ, PREC>::sortObjects(StaticOctree<OBJ, PREC>& staticTree,
+                                                  uint32_t                 index,
+                                                  OBJ*&                    _sortedObjects) const
+{
+    staticTree.firstObject[index] = (uint32_t) (_sortedObjects - staticTree.objects);
 
     if (_objects != nullptr)
         for (typename ObjectList::const_iterator iter = _objects->begin(); iter != _objects->end(); ++iter)
@@ -305,15 +1009,12 @@ inline void DynamicOctree<OBJ, PREC>::rebuildAndSort(StaticOctree<OBJ, PREC>*& _
             *_sortedObjects++ = **iter;
         }
 
-    unsigned int nObjects  = (unsigned int) (_sortedObjects - _firstObject);
-    _staticNode            = new StaticOctree<OBJ, PREC>(cellCenterPos, exclusionFactor, _firstObject, nObjects);
+    staticTree.objectCounts[index] = (uint32_t) (_sortedObjects - staticTree.objects) - staticTree.firstObject[index];
 
     if (_children != nullptr)
     {
-        _staticNode->_children    = new StaticOctree<OBJ, PREC>*[8];
-
-        for (int i=0; i<8; ++i)
-            _children[i]->rebuildAndSort(_staticNode->_children[i], _sortedObjects);
+        for (int i = 0; i < 8; ++i)
+            _children[i]->sortObjects(staticTree, staticTree.firstChild[index] + i, _sortedObjects);
     }
 }
 
@@ -322,84 +1023,534 @@ inline void DynamicOctree<OBJ, PREC>::rebuildAndSort(StaticOctree<OBJ, PREC>*& _
 template <class OBJ, class PREC>
 const PREC StaticOctree<OBJ, PREC>::SQRT3 = (PREC) 1.732050807568877;
 
+template <class OBJ, class PREC>
+constexpr const unsigned int StaticOctree<OBJ, PREC>::NODE_CHILDREN;
 
 template <class OBJ, class PREC>
-inline StaticOctree<OBJ, PREC>::StaticOctree(const Eigen::Matrix<PREC, 3, 1>& cellCenterPos,
-                                             const float         exclusionFactor,
-                                             OBJ*                _firstObject,
-                                             unsigned int        nObjects):
-    _children      (nullptr),
-    cellCenterPos  (cellCenterPos),
-    exclusionFactor(exclusionFactor),
-    _firstObject   (_firstObject),
-    nObjects       (nObjects)
+constexpr const unsigned int StaticOctree<OBJ, PREC>::OBJECT_BLOCK;
+
+template <class OBJ, class PREC>
+constexpr const unsigned int DynamicOctree<OBJ, PREC>::KEY_WORDS;
+
+template <class OBJ, class PREC>
+constexpr const unsigned int DynamicOctree<OBJ, PREC>::KEY_LEVELS;
+
+
+template <class OBJ, class PREC>
+inline StaticOctree<OBJ, PREC>::StaticOctree(OBJ* objects, unsigned int nObjects) :
+    objects (objects),
+    nObjects(nObjects)
 {
 }
 
 
 template <class OBJ, class PREC>
-inline StaticOctree<OBJ, PREC>::~StaticOctree()
+inline uint32_t StaticOctree<OBJ, PREC>::addNode(const PointType& cellCenterPos, float exclusionFactor)
 {
-    if (_children != nullptr)
-    {
-        for (int i = 0; i < 8; ++i)
-            delete _children[i];
+    centerX.push_back(cellCenterPos.x());
+    centerY.push_back(cellCenterPos.y());
+    centerZ.push_back(cellCenterPos.z());
+    exclusionFactors.push_back(exclusionFactor);
+    firstChild.push_back(0);
+    firstObject.push_back(0);
+    objectCounts.push_back(0);
+
+    return (uint32_t) (centerX.size() - 1);
+}
 
-        delete[] _children;
+
+template <class OBJ, class PREC>
+inline void StaticOctree<OBJ, PREC>::buildObjectData()
+{
+}
+
+
+template <class OBJ, class PREC>
+inline typename StaticOctree<OBJ, PREC>::NodeObjects StaticOctree<OBJ, PREC>::nodeObjects(uint32_t node) const
+{
+    if (objectPager != nullptr)
+        return objectPager->load(node);
+
+    uint32_t first = firstObject[node];
+    bool haveArrays = !objectX.empty();
+
+    NodeObjects result = {};
+    result.objects   = objects + first;
+    result.count     = objectCounts[node];
+    if (haveArrays)
+    {
+        result.x         = &objectX[first];
+        result.y         = &objectY[first];
+        result.z         = &objectZ[first];
+        result.magnitude = &objectMagnitude[first];
+        result.bounds    = objectBounds[node];
     }
+
+    return result;
 }
 
 
 template <class OBJ, class PREC>
 inline int StaticOctree<OBJ, PREC>::countChildren() const
 {
-    int count    = 0;
+    return (int) centerX.size() - 1;
+}
 
-    for (int i = 0; i < 8; ++i)
-        count    += _children != nullptr ? 1 + _children[i]->countChildren() : 0;
 
-    return count;
+template <class OBJ, class PREC>
+inline int StaticOctree<OBJ, PREC>::countObjects() const
+{
+    return (int) nObjects;
 }
 
 
 template <class OBJ, class PREC>
-inline int StaticOctree<OBJ, PREC>::countObjects() const
+void StaticOctree<OBJ, PREC>::computeStatistics(std::vector<OctreeLevelStatistics>& stats) const
 {
-    int count    = nObjects;
+    // Children always follow their parent in breadth first order, so the
+    // level of every node is known by the time it is reached.
+    std::vector<unsigned int> levels(centerX.size(), 0);
+    for (size_t i = 0; i < centerX.size(); i++)
+    {
+        unsigned int level = levels[i];
+        if (level >= stats.size())
+            stats.push_back({ 0, 0, 0.0 });
 
-    if (_children != nullptr)
-        for (int i = 0; i < 8; ++i)
-            count    += _children[i]->countObjects();
+        stats[level].nodeCount++;
+        stats[level].objectCount += objectCounts[i];
 
-    return count;
+        if (firstChild[i] != 0)
+        {
+            for (unsigned int j = 0; j < NODE_CHILDREN; j++)
+                levels[firstChild[i] + j] = level + 1;
+        }
+    }
 }
 
 
 template <class OBJ, class PREC>
-void StaticOctree<OBJ, PREC>::computeStatistics(std::vector<OctreeLevelStatistics>& stats, unsigned int level)
+void StaticOctree<OBJ, PREC>::pack(std::vector<PackedNode>& nodes) const
 {
-    if (level >= stats.size())
+    for (size_t i = 0; i < centerX.size(); i++)
     {
-        while (level >= stats.size())
+        PackedNode node;
+        node.cellCenterPos[0] = centerX[i];
+        node.cellCenterPos[1] = centerY[i];
+        node.cellCenterPos[2] = centerZ[i];
+        node.exclusionFactor  = exclusionFactors[i];
+        node.firstObject      = firstObject[i];
+        node.nObjects         = objectCounts[i];
+        node.firstChild       = firstChild[i];
+        nodes.push_back(node);
+    }
+}
+
+
+// Rebuild an octree from packed nodes. The node table is validated, and
+// nullptr is returned if it is inconsistent with the object array.
+template <class OBJ, class PREC>
+StaticOctree<OBJ, PREC>* StaticOctree<OBJ, PREC>::unpack(const PackedNode* nodes,
+                                                       uint32_t          nNodes,
+                                                       OBJ*              objects,
+                                                       uint32_t          nObjects)
+{
+    if (nNodes == 0)
+        return nullptr;
+
+    auto* tree = new StaticOctree(objects, nObjects);
+    uint64_t objectTotal = 0;
+    for (uint32_t i = 0; i < nNodes; i++)
+    {
+        const PackedNode& node = nodes[i];
+        bool valid = (uint64_t) node.firstObject + node.nObjects <= nObjects &&
+                     (node.firstChild == 0 ||
+                      (node.firstChild > i && (uint64_t) node.firstChild + NODE_CHILDREN <= nNodes));
+        if (!valid)
         {
-            OctreeLevelStatistics levelStats;
-            levelStats.nodeCount = 0;
-            levelStats.objectCount = 0;
-            levelStats.size = 0.0;
-            stats.push_back(levelStats);
+            delete tree;
+            return nullptr;
         }
+
+        PointType center(node.cellCenterPos[0], node.cellCenterPos[1], node.cellCenterPos[2]);
+        tree->addNode(center, node.exclusionFactor);
+        tree->firstObject[i]  = node.firstObject;
+        tree->objectCounts[i] = node.nObjects;
+        tree->firstChild[i]   = node.firstChild;
+        objectTotal += node.nObjects;
+    }
+
+    if (objectTotal != nObjects)
+    {
+        delete tree;
+        return nullptr;
     }
 
-    stats[level].nodeCount++;
-    stats[level].objectCount += nObjects;
-    stats[level].size = 0.0;
+    tree->buildObjectData();
+    return tree;
+}
 
-    if (_children != nullptr)
+
+// Test the eight children starting at firstChild against the planes of
+// the view frustum. All children are tested at once using Eigen arrays,
+// which map onto SIMD registers. Returns a bit mask of the children that
+// are at least partially inside the frustum; the distances from the
+// observer to the children are stored in minDistances.
+template <class OBJ, class PREC>
+inline unsigned int StaticOctree<OBJ, PREC>::cullChildren(uint32_t                          firstChild,
+                                                          const PointType&                  obsPosition,
+                                                          const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                                                          PREC                              childScale,
+                                                          ChildArray&                       minDistances) const
+{
+    Eigen::Map<const ChildArray> x(&centerX[firstChild]);
+    Eigen::Map<const ChildArray> y(&centerY[firstChild]);
+    Eigen::Map<const ChildArray> z(&centerZ[firstChild]);
+
+    // A child is culled when its center is further than the projected
+    // radius of the cube outside any one of the five planes.
+    Eigen::Array<bool, NODE_CHILDREN, 1> outside = Eigen::Array<bool, NODE_CHILDREN, 1>::Constant(false);
+    for (unsigned int i = 0; i < 5; ++i)
+    {
+        const Eigen::Hyperplane<PREC, 3>& plane = frustumPlanes[i];
+        const PointType& n = plane.normal();
+        PREC r = childScale * n.cwiseAbs().sum();
+        ChildArray d = x * n.x() + y * n.y() + z * n.z() + plane.offset();
+        outside = outside || (d < -r);
+    }
+
+    ChildArray dx = x - obsPosition.x();
+    ChildArray dy = y - obsPosition.y();
+    ChildArray dz = z - obsPosition.z();
+    minDistances = (dx * dx + dy * dy + dz * dz).sqrt() - childScale * SQRT3;
+
+    unsigned int mask = 0;
+    for (unsigned int i = 0; i < NODE_CHILDREN; ++i)
+    {
+        if (!outside[i])
+            mask |= 1u << i;
+    }
+
+    return mask;
+}
+
+
+// Test the cubic root node against each one of the five planes that
+// define the infinite view frustum, and set up the traversal entry for it
+// if it's visible. The same expressions as in cullChildren() are used, so
+// that all nodes are tested alike.
+template <class OBJ, class PREC>
+bool StaticOctree<OBJ, PREC>::visibleRoot(const PointType&                  obsPosition,
+                                          const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                                          PREC                              scale,
+                                          TraversalEntry&                   root) const
+{
+    PointType rootCenter(centerX[0], centerY[0], centerZ[0]);
+    for (unsigned int i = 0; i < 5; ++i)
+    {
+        const Eigen::Hyperplane<PREC, 3>& plane = frustumPlanes[i];
+        const PointType& n = plane.normal();
+        PREC r = scale * n.cwiseAbs().sum();
+        if (rootCenter.x() * n.x() + rootCenter.y() * n.y() + rootCenter.z() * n.z() + plane.offset() < -r)
+            return false;
+    }
+
+    PointType d = rootCenter - obsPosition;
+    root = { 0, 0, scale, std::sqrt(d.x() * d.x() + d.y() * d.y() + d.z() * d.z()) - scale * SQRT3 };
+    return true;
+}
+
+
+// Append the children of a node which need to be traversed to children,
+// in reverse order.
+template <class OBJ, class PREC>
+void StaticOctree<OBJ, PREC>::visibleChildren(const TraversalEntry&             entry,
+                                              const PointType&                  obsPosition,
+                                              const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                                              float                             limitingFactor,
+                                              std::vector<TraversalEntry>&      children) const
+{
+    // See if any of the objects in child nodes are potentially included
+    // that we need to descend deeper.
+    uint32_t child = firstChild[entry.node];
+    if (child == 0)
+        return;
+    if (entry.minDistance > 0 &&
+        astro::absToAppMag((PREC) exclusionFactors[entry.node], entry.minDistance) > limitingFactor)
+        return;
+
+    PREC childScale = entry.scale * (PREC) 0.5;
+    ChildArray minDistances;
+    unsigned int visible = cullChildren(child, obsPosition, frustumPlanes, childScale, minDistances);
+
+    for (int i = NODE_CHILDREN - 1; i >= 0; --i)
     {
-        for (int i = 0; i < 8; i++)
-            _children[i]->computeStatistics(stats, level + 1);
+        if ((visible & (1u << i)) != 0)
+            children.push_back({ child + i, entry.depth + 1, childScale, minDistances[i] });
     }
 }
 
 
+// Depth first traversal of the nodes that intersect the view frustum and
+// may contain objects brighter than limitingFactor. The visitor is called
+// with the index of every such node and the distance from the observer
+// to the node. Nodes are visited in the same order as by a recursive
+// traversal; an explicit stack is used instead of recursion.
+template <class OBJ, class PREC>
+template <class VISITOR>
+void StaticOctree<OBJ, PREC>::traverseVisibleNodes(const PointType&                  obsPosition,
+                                                   const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                                                   float                             limitingFactor,
+                                                   PREC                              scale,
+                                                   VISITOR&                          visitor,
+                                                   OctreeProcStats*                  stats) const
+{
+    TraversalEntry root;
+    if (visibleRoot(obsPosition, frustumPlanes, scale, root))
+        traverseVisibleSubtree(root, obsPosition, frustumPlanes, limitingFactor, visitor, stats);
+}
+
+
+template <class OBJ, class PREC>
+template <class VISITOR>
+void StaticOctree<OBJ, PREC>::traverseVisibleSubtree(const TraversalEntry&             start,
+                                                     const PointType&                  obsPosition,
+                                                     const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                                                     float                             limitingFactor,
+                                                     VISITOR&                          visitor,
+                                                     OctreeProcStats*                  stats) const
+{
+    std::vector<TraversalEntry> stack;
+    stack.reserve(64);
+    stack.push_back(start);
+
+    while (!stack.empty())
+    {
+        TraversalEntry entry = stack.back();
+        stack.pop_back();
+
+#ifdef OCTREE_DEBUG
+        if (stats != nullptr)
+        {
+            stats->nodes++;
+            if (entry.depth + 1 > stats->height)
+                stats->height = entry.depth + 1;
+        }
+#endif
+
+        visitor(entry.node, entry.minDistance);
+
+        // Children are pushed in reverse order so that they're visited in order
+        visibleChildren(entry, obsPosition, frustumPlanes, limitingFactor, stack);
+    }
+}
+
+
+// Split the traversal into parts which can be processed independently,
+// by expanding the upper levels of the octree breadth first until there
+// are at least minSubtrees subtrees with children left. The parts are
+// returned in traversal order: processing them in sequence, visiting
+// only the node of parts without the subtree flag, is the same as a
+// traversal of the whole octree.
+template <class OBJ, class PREC>
+void StaticOctree<OBJ, PREC>::splitVisibleTraversal(const PointType&                  obsPosition,
+                                                    const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                                                    float                             limitingFactor,
+                                                    PREC                              scale,
+                                                    unsigned int                      minSubtrees,
+                                                    std::vector<TraversalPart>&       parts) const
+{
+    parts.clear();
+
+    TraversalEntry root;
+    if (!visibleRoot(obsPosition, frustumPlanes, scale, root))
+        return;
+    parts.push_back({ root, true });
+
+    std::vector<TraversalPart> expanded;
+    std::vector<TraversalEntry> children;
+    for (;;)
+    {
+        unsigned int nSubtrees = 0;
+        for (const auto& part : parts)
+        {
+            if (part.subtree && firstChild[part.entry.node] != 0)
+                nSubtrees++;
+        }
+        if (nSubtrees == 0 || nSubtrees >= minSubtrees)
+            break;
+
+        expanded.clear();
+        for (const auto& part : parts)
+        {
+            if (!part.subtree || firstChild[part.entry.node] == 0)
+            {
+                expanded.push_back(part);
+                continue;
+            }
+
+            expanded.push_back({ part.entry, false });
+            children.clear();
+            visibleChildren(part.entry, obsPosition, frustumPlanes, limitingFactor, children);
+            for (auto iter = children.rbegin(); iter != children.rend(); ++iter)
+                expanded.push_back({ *iter, true });
+        }
+        parts.swap(expanded);
+    }
+}
+
+
+// Depth first traversal of the nodes that lie at least partially within
+// boundingRadius of obsPosition.
+template <class OBJ, class PREC>
+template <class VISITOR>
+void StaticOctree<OBJ, PREC>::traverseCloseNodes(const PointType& obsPosition,
+                                                 PREC             boundingRadius,
+                                                 PREC             scale,
+                                                 VISITOR&         visitor) const
+{
+    // Compute the distance to node; this is equal to the distance to
+    // the cellCenterPos of the node minus the boundingRadius of the node, scale * SQRT3.
+    PointType rootCenter(centerX[0], centerY[0], centerZ[0]);
+    if ((obsPosition - rootCenter).norm() - scale * SQRT3 > boundingRadius)
+        return;
+
+    std::vector<TraversalEntry> stack;
+    stack.reserve(64);
+    stack.push_back({ 0, 0, scale, 0 });
+
+    while (!stack.empty())
+    {
+        TraversalEntry entry = stack.back();
+        stack.pop_back();
+
+        visitor(entry.node);
+
+        uint32_t child = firstChild[entry.node];
+        if (child == 0)
+            continue;
+
+        PREC childScale = entry.scale * (PREC) 0.5;
+        Eigen::Map<const ChildArray> x(&centerX[child]);
+        Eigen::Map<const ChildArray> y(&centerY[child]);
+        Eigen::Map<const ChildArray> z(&centerZ[child]);
+        ChildArray dx = x - obsPosition.x();
+        ChildArray dy = y - obsPosition.y();
+        ChildArray dz = z - obsPosition.z();
+        ChildArray nodeDistances = (dx * dx + dy * dy + dz * dz).sqrt() - childScale * SQRT3;
+
+        for (int i = NODE_CHILDREN - 1; i >= 0; --i)
+        {
+            if (nodeDistances[i] <= boundingRadius)
+                stack.push_back({ child + i, entry.depth + 1, childScale, 0 });
+        }
+    }
+}
+
+
+// The best objects found so far are kept in a heap with the worst of them
+// on top, and the nodes still to be searched in a heap ordered by the
+// bound of their keys. Every object is compared by its key and then by its
+// address, so that the result doesn't depend on the order in which the
+// nodes are searched. Nodes are only queued if they may hold an object at
+// least as good as the worst one found, and the search ends once the
+// closest node in the queue can't.
+template <class OBJ, class PREC>
+template <class KEY>
+void StaticOctree<OBJ, PREC>::findBestObjects(const KEY&               key,
+                                              PREC                     scale,
+                                              unsigned int             nResults,
+                                              std::vector<const OBJ*>& result,
+                                              OctreeProcStats*         stats) const
+{
+    result.clear();
+    if (nResults == 0)
+        return;
+
+    struct Candidate
+    {
+        PREC       key;
+        const OBJ* object;
+    };
+    auto better = [](const Candidate& a, const Candidate& b)
+    {
+        return a.key < b.key || (a.key == b.key && std::less<const OBJ*>()(a.object, b.object));
+    };
+
+    struct QueueEntry
+    {
+        PREC     bound;
+        uint32_t node;
+        uint32_t depth;
+        PREC     scale;
+    };
+    auto later = [](const QueueEntry& a, const QueueEntry& b) { return a.bound > b.bound; };
+
+    std::vector<Candidate> best;
+    best.reserve(nResults);
+    std::vector<QueueEntry> queue;
+    queue.reserve(64);
+
+    PointType rootCenter(centerX[0], centerY[0], centerZ[0]);
+    queue.push_back({ key.node(rootCenter, scale, -std::numeric_limits<float>::infinity()), 0, 0, scale });
+
+    while (!queue.empty())
+    {
+        std::pop_heap(queue.begin(), queue.end(), later);
+        QueueEntry entry = queue.back();
+        queue.pop_back();
+        if (best.size() == nResults && entry.bound > best.front().key)
+            break;
+
+        if (stats != nullptr)
+        {
+            stats->nodes++;
+            stats->objects += objectCounts[entry.node];
+            stats->height = std::max(stats->height, (size_t) entry.depth + 1);
+        }
+
+        if (objectCounts[entry.node] != 0)
+        {
+            NodeObjects nodeObjs = nodeObjects(entry.node);
+            for (uint32_t i = 0; i < nodeObjs.count; ++i)
+            {
+                Candidate candidate = { key.object(nodeObjs.objects[i]), &nodeObjs.objects[i] };
+                if (best.size() < nResults)
+                {
+                    best.push_back(candidate);
+                    std::push_heap(best.begin(), best.end(), better);
+                }
+                else if (better(candidate, best.front()))
+                {
+                    std::pop_heap(best.begin(), best.end(), better);
+                    best.back() = candidate;
+                    std::push_heap(best.begin(), best.end(), better);
+                }
+            }
+        }
+
+        uint32_t child = firstChild[entry.node];
+        if (child == 0)
+            continue;
+
+        PREC childScale = entry.scale * (PREC) 0.5;
+        float exclusionFactor = exclusionFactors[entry.node];
+        for (unsigned int i = 0; i < NODE_CHILDREN; ++i)
+        {
+            PointType center(centerX[child + i], centerY[child + i], centerZ[child + i]);
+            PREC bound = key.node(center, childScale, exclusionFactor);
+            if (best.size() < nResults || !(bound > best.front().key))
+            {
+                queue.push_back({ bound, child + i, entry.depth + 1, childScale });
+                std::push_heap(queue.begin(), queue.end(), later);
+            }
+        }
+    }
+
+    std::sort_heap(best.begin(), best.end(), better);
+    result.reserve(best.size());
+    for (const auto& candidate : best)
+        result.push_back(candidate.object);
+}
+
+
 #endif // _OCTREE_H_
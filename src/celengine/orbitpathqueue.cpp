@@ -0,0 +1,125 @@
+// orbitpathqueue.cpp
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// Sample orbit paths on background threads.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <celephem/orbit.h>
+#include <celutil/timer.h>
+#include "orbitpathqueue.h"
+#include "orbitsampler.h"
+
+using namespace std;
+
+
+OrbitPathQueue::OrbitPathQueue(unsigned int nThreads)
+{
+    for (unsigned int i = 0; i < max(1u, nThreads); i++)
+        workers.emplace_back(&OrbitPathQueue::workerMain, this);
+}
+
+
+OrbitPathQueue::~OrbitPathQueue()
+{
+    {
+        lock_guard<std::mutex> lock(mutex);
+        requests.clear();
+        quit = true;
+    }
+    wakeWorkers.notify_all();
+
+    for (auto& worker : workers)
+        worker.join();
+}
+
+
+void OrbitPathQueue::request(const Request& request)
+{
+    {
+        lock_guard<std::mutex> lock(mutex);
+        requests.push_back(request);
+    }
+    wakeWorkers.notify_one();
+}
+
+
+void OrbitPathQueue::cancel(const Orbit* orbit)
+{
+    unique_lock<std::mutex> lock(mutex);
+    requests.erase(remove_if(requests.begin(), requests.end(),
+                             [orbit](const Request& r) { return r.orbit == orbit; }),
+                   requests.end());
+    idle.wait(lock, [this, orbit]() { return find(sampling.begin(), sampling.end(), orbit) == sampling.end(); });
+    results.erase(remove_if(results.begin(), results.end(),
+                            [orbit](const Result& r) { return r.request.orbit == orbit; }),
+                  results.end());
+}
+
+
+void OrbitPathQueue::cancelQueued(const Orbit* orbit)
+{
+    lock_guard<std::mutex> lock(mutex);
+    requests.erase(remove_if(requests.begin(), requests.end(),
+                             [orbit](const Request& r) { return r.orbit == orbit; }),
+                   requests.end());
+}
+
+
+void OrbitPathQueue::cancelAll()
+{
+    unique_lock<std::mutex> lock(mutex);
+    requests.clear();
+    idle.wait(lock, [this]() { return sampling.empty(); });
+    results.clear();
+}
+
+
+void OrbitPathQueue::collect(vector<Result>& completed)
+{
+    lock_guard<std::mutex> lock(mutex);
+    for (auto& result : results)
+        completed.push_back(move(result));
+    results.clear();
+}
+
+
+size_t OrbitPathQueue::pendingCount() const
+{
+    lock_guard<std::mutex> lock(mutex);
+    return requests.size() + sampling.size();
+}
+
+
+void OrbitPathQueue::workerMain()
+{
+    unique_lock<std::mutex> lock(mutex);
+    for (;;)
+    {
+        wakeWorkers.wait(lock, [this]() { return quit || !requests.empty(); });
+        if (quit)
+            return;
+
+        Result result;
+        result.request = requests.back();
+        requests.pop_back();
+        sampling.push_back(result.request.orbit);
+        lock.unlock();
+
+        Timer timer;
+        OrbitSampler sampler(result.request.tolerance);
+        result.request.orbit->sample(result.request.startTime, result.request.endTime, sampler);
+        result.samples = move(sampler.samples);
+        result.duration = timer.getTime();
+
+        lock.lock();
+        sampling.erase(find(sampling.begin(), sampling.end(), result.request.orbit));
+        results.push_back(move(result));
+        idle.notify_all();
+    }
+}
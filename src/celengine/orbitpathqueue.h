@@ -0,0 +1,83 @@
+// orbitpathqueue.h
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// Sample orbit paths on background threads.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "curveplot.h"
+
+class Orbit;
+
+/*! OrbitPathQueue samples orbit paths on worker threads, so the frames
+ *  drawn meanwhile don't wait for them. Requests are taken newest first,
+ *  as the latest ones are for the orbits in view; the samples of
+ *  completed requests are collected by the rendering thread. Only orbits
+ *  for which isThreadSafe() is true may be requested, and they must
+ *  outlive their requests: cancel() and cancelAll() wait for the
+ *  requests being sampled.
+ */
+class OrbitPathQueue
+{
+ public:
+    struct Request
+    {
+        const Orbit* orbit;
+        double startTime;
+        double endTime;
+        double tolerance;
+    };
+
+    struct Result
+    {
+        Request request;
+        std::vector<CurvePlotSample> samples;
+        // Sampling time in seconds
+        double duration;
+    };
+
+    explicit OrbitPathQueue(unsigned int nThreads);
+    ~OrbitPathQueue();
+
+    OrbitPathQueue(const OrbitPathQueue&) = delete;
+    OrbitPathQueue& operator=(const OrbitPathQueue&) = delete;
+
+    void request(const Request& request);
+    // Drop the requests and results for an orbit, once it isn't sampled
+    // any more, so that it may be destroyed
+    void cancel(const Orbit* orbit);
+    // Drop the requests for an orbit that haven't been started
+    void cancelQueued(const Orbit* orbit);
+    // Drop all requests and results, once the requests being sampled
+    // have completed
+    void cancelAll();
+
+    // Append the completed requests to results
+    void collect(std::vector<Result>& results);
+    size_t pendingCount() const;
+
+ private:
+    void workerMain();
+
+    std::vector<std::thread>    workers;
+
+    mutable std::mutex          mutex;
+    std::condition_variable     wakeWorkers;
+    std::condition_variable     idle;
+    std::deque<Request>         requests;
+    std::vector<Result>         results;
+    // Orbits of the requests being sampled
+    std::vector<const Orbit*>   sampling;
+    bool                        quit{ false };
+};
@@ -20,6 +20,11 @@ public:
     std::vector<CurvePlotSample> samples;
 
     OrbitSampler() = default;
+    // Sample orbits so that the curves drawn through the samples stay
+    // within tolerance kilometers of them
+    explicit OrbitSampler(double _tolerance) : tolerance(_tolerance) {}
+
+    double getTolerance() const { return tolerance; }
 
     void sample(double t, const Eigen::Vector3d& position, const Eigen::Vector3d& velocity)
     {
@@ -45,4 +50,7 @@ public:
             plot->addSample(*iter);
         }
     }
+
+private:
+    double tolerance{ 0.0 };
 };
@@ -0,0 +1,305 @@
+// pagedstarcatalog.cpp
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// Star catalog kept on disk and paged in by octree node.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <celutil/bytes.h>
+#include "pagedstarcatalog.h"
+
+using namespace std;
+
+
+constexpr const char     PAGED_FILE_HEADER[] = "CELSTPGS";
+constexpr const uint16_t PAGED_FILE_VERSION  = 0x0100;
+constexpr const size_t   DEFAULT_MEMORY_BUDGET = 256 * 1024 * 1024;
+
+namespace
+{
+// All fields of the file are stored little endian, without padding. The
+// header is followed by the node table and then by the star records.
+struct PagedFileHeader
+{
+    char     magic[8];
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t nStars;
+    uint32_t nNodes;
+    float    rootSize;
+};
+static_assert(sizeof(PagedFileHeader) == 24, "Unexpected padding in paged star catalog header");
+
+// Same layout as the star records of a stars.dat file
+struct StarRecord
+{
+    uint32_t catNo;
+    float    x, y, z;
+    int16_t  absMag;
+    uint16_t spectralType;
+};
+static_assert(sizeof(StarRecord) == 20, "Unexpected padding in paged star record");
+
+constexpr const size_t NODE_SIZE = sizeof(float) * 4 + sizeof(uint32_t) * 3;
+static_assert(sizeof(StarOctree::PackedNode) == NODE_SIZE, "Unexpected padding in packed octree node");
+
+inline void swapNode(StarOctree::PackedNode& node)
+{
+#if defined(WORDS_BIGENDIAN) || defined(__BIG_ENDIAN__)
+    for (float& c : node.cellCenterPos)
+        LE_TO_CPU_FLOAT(c, c);
+    LE_TO_CPU_FLOAT(node.exclusionFactor, node.exclusionFactor);
+    LE_TO_CPU_INT32(node.firstObject, node.firstObject);
+    LE_TO_CPU_INT32(node.nObjects, node.nObjects);
+    LE_TO_CPU_INT32(node.firstChild, node.firstChild);
+#else
+    (void) node;
+#endif
+}
+}
+
+
+PagedStarCatalog::PagedStarCatalog()
+{
+    stats.memoryBudget = DEFAULT_MEMORY_BUDGET;
+}
+
+
+bool PagedStarCatalog::open(const fs::path& filename)
+{
+    if (!file.open(filename) || file.size() < sizeof(PagedFileHeader))
+        return false;
+
+    PagedFileHeader header;
+    memcpy(&header, file.data(), sizeof header);
+    LE_TO_CPU_INT16(header.version, header.version);
+    LE_TO_CPU_INT32(header.nStars, header.nStars);
+    LE_TO_CPU_INT32(header.nNodes, header.nNodes);
+    LE_TO_CPU_FLOAT(header.rootSize, header.rootSize);
+    if (memcmp(header.magic, PAGED_FILE_HEADER, sizeof header.magic) != 0 ||
+        header.version != PAGED_FILE_VERSION ||
+        file.size() != sizeof header + NODE_SIZE * header.nNodes + sizeof(StarRecord) * header.nStars)
+    {
+        file.close();
+        return false;
+    }
+
+    nodes.resize(header.nNodes);
+    memcpy(nodes.data(), file.data() + sizeof header, NODE_SIZE * header.nNodes);
+    for (auto& node : nodes)
+        swapNode(node);
+
+    tree.reset(StarOctree::unpack(nodes.data(), header.nNodes, nullptr, header.nStars));
+    if (tree == nullptr)
+    {
+        nodes.clear();
+        file.close();
+        return false;
+    }
+    tree->setObjectPager(this);
+
+    records        = file.data() + sizeof header + NODE_SIZE * header.nNodes;
+    nStars         = header.nStars;
+    octreeRootSize = header.rootSize;
+    pages.resize(header.nNodes);
+    detailsCache.assign(0x10000, nullptr);
+
+    return true;
+}
+
+
+void PagedStarCatalog::setMemoryBudget(size_t bytes)
+{
+    lock_guard<std::mutex> lock(mutex);
+    stats.memoryBudget = bytes;
+    evictPages();
+}
+
+
+// Pages used before the frame was advanced may be evicted from now on.
+void PagedStarCatalog::nextFrame()
+{
+    lock_guard<std::mutex> lock(mutex);
+    frame++;
+    evictPages();
+}
+
+
+const Star* PagedStarCatalog::stableStar(const Star& star)
+{
+    lock_guard<std::mutex> lock(mutex);
+    unique_ptr<Star>& copy = stableStars[star.getIndex()];
+    if (copy == nullptr)
+        copy.reset(new Star(star));
+    return copy.get();
+}
+
+
+PagedStarCatalog::Statistics PagedStarCatalog::getStatistics() const
+{
+    lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+
+PagedStarCatalog::NodeObjects PagedStarCatalog::load(uint32_t node)
+{
+    NodeObjects result = {};
+    if (node >= nodes.size() || nodes[node].nObjects == 0)
+        return result;
+
+    lock_guard<std::mutex> lock(mutex);
+    Page* page = pages[node].get();
+    if (page != nullptr)
+    {
+        stats.hits++;
+        lru.splice(lru.begin(), lru, page->lruPosition);
+        page->lastUsed = frame;
+    }
+    else
+    {
+        stats.misses++;
+        page = loadPage(node);
+        evictPages();
+    }
+
+    result.objects   = page->stars.data();
+    result.x         = page->x.data();
+    result.y         = page->y.data();
+    result.z         = page->z.data();
+    result.magnitude = page->magnitude.data();
+    result.bounds    = page->bounds;
+    result.count     = (uint32_t) page->stars.size();
+
+    return result;
+}
+
+
+// Decode the star records of a node; called with the mutex held.
+PagedStarCatalog::Page* PagedStarCatalog::loadPage(uint32_t node)
+{
+    const PackedNode& packed = nodes[node];
+    uint32_t count = packed.nObjects;
+    size_t paddedSize = (count + StarOctree::OBJECT_BLOCK - 1) / StarOctree::OBJECT_BLOCK * StarOctree::OBJECT_BLOCK;
+
+    unique_ptr<Page> page(new Page);
+    page->stars.resize(count);
+    page->x.assign(paddedSize, 0);
+    page->y.assign(paddedSize, 0);
+    page->z.assign(paddedSize, 0);
+    page->magnitude.assign(paddedSize, 0);
+
+    const char* record = records + sizeof(StarRecord) * packed.firstObject;
+    for (uint32_t i = 0; i < count; i++, record += sizeof(StarRecord))
+    {
+        StarRecord rec;
+        memcpy(&rec, record, sizeof rec);
+#if defined(WORDS_BIGENDIAN) || defined(__BIG_ENDIAN__)
+        LE_TO_CPU_INT32(rec.catNo, rec.catNo);
+        LE_TO_CPU_FLOAT(rec.x, rec.x);
+        LE_TO_CPU_FLOAT(rec.y, rec.y);
+        LE_TO_CPU_FLOAT(rec.z, rec.z);
+        LE_TO_CPU_INT16(rec.absMag, rec.absMag);
+        LE_TO_CPU_INT16(rec.spectralType, rec.spectralType);
+#endif
+
+        StarDetails* details = detailsCache[rec.spectralType];
+        if (details == nullptr)
+        {
+            StellarClass sc;
+            if (sc.unpack(rec.spectralType))
+                details = StarDetails::GetStarDetails(sc);
+
+            // The converter rejects bad spectral types, so this only
+            // happens for damaged files; show the star anyway.
+            if (details == nullptr)
+                details = StarDetails::GetStarDetails(StellarClass());
+            detailsCache[rec.spectralType] = details;
+        }
+
+        Star& star = page->stars[i];
+        star.setPosition(rec.x, rec.y, rec.z);
+        star.setAbsoluteMagnitude((float) rec.absMag / 256.0f);
+        star.setDetails(details);
+        star.setIndex(rec.catNo);
+    }
+
+    quantizeStars(page->stars.data(), count,
+                  page->x.data(), page->y.data(), page->z.data(), page->magnitude.data(),
+                  page->bounds);
+
+    page->bytes = sizeof(Page) + sizeof(Star) * page->stars.capacity() +
+                  sizeof(uint16_t) * 4 * paddedSize;
+    page->lastUsed = frame;
+    lru.push_front(node);
+    page->lruPosition = lru.begin();
+
+    stats.residentPages++;
+    stats.residentStars += count;
+    stats.residentBytes += page->bytes;
+
+    pages[node] = move(page);
+    return pages[node].get();
+}
+
+
+// Evict the least recently used pages until the catalog fits into its
+// budget again. Pages used in the current frame may still be referred to
+// by the traversal, so the budget may be exceeded for a while when a
+// single frame needs more stars than fit into it.
+void PagedStarCatalog::evictPages()
+{
+    while (stats.residentBytes > stats.memoryBudget && !lru.empty())
+    {
+        uint32_t node = lru.back();
+        Page* page = pages[node].get();
+        if (page->lastUsed == frame)
+            break;
+
+        stats.residentPages--;
+        stats.residentStars -= page->stars.size();
+        stats.residentBytes -= page->bytes;
+        stats.evictions++;
+
+        lru.pop_back();
+        pages[node].reset();
+    }
+}
+
+
+bool PagedStarCatalog::write(const fs::path& filename,
+                             float rootSize,
+                             const vector<PackedNode>& nodes,
+                             const char* records,
+                             uint32_t nRecords)
+{
+    ofstream out(filename.string(), ios::out | ios::binary | ios::trunc);
+    if (!out.good())
+        return false;
+
+    PagedFileHeader header;
+    memcpy(header.magic, PAGED_FILE_HEADER, sizeof header.magic);
+    LE_TO_CPU_INT16(header.version, PAGED_FILE_VERSION);
+    header.reserved = 0;
+    LE_TO_CPU_INT32(header.nStars, nRecords);
+    LE_TO_CPU_INT32(header.nNodes, (uint32_t) nodes.size());
+    LE_TO_CPU_FLOAT(header.rootSize, rootSize);
+    out.write(reinterpret_cast<const char*>(&header), sizeof header);
+
+    for (PackedNode node : nodes)
+    {
+        swapNode(node);
+        out.write(reinterpret_cast<const char*>(&node), NODE_SIZE);
+    }
+
+    out.write(records, (streamsize) (sizeof(StarRecord) * nRecords));
+
+    return out.good();
+}
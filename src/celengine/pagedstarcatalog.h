@@ -0,0 +1,116 @@
+// pagedstarcatalog.h
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// Star catalog kept on disk and paged in by octree node.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <celcompat/filesystem.h>
+#include <celutil/mappedfile.h>
+#include <celengine/staroctree.h>
+
+/*! A paged star catalog holds the stars of a catalog too large to be kept
+ *  in memory. The file contains the node table of a star octree followed
+ *  by the star records, sorted depth first like the stars of an in memory
+ *  StarOctree, so that the stars of every node are contiguous. Only the
+ *  node table is loaded when the catalog is opened; the stars of a node
+ *  form a page which is decoded the first time a traversal reaches the
+ *  node, and pages are evicted least recently used first once the
+ *  memory budget is exceeded.
+ *
+ *  Pages used since the last call to nextFrame() are never evicted, so
+ *  the stars found by a traversal stay valid until nextFrame() is called
+ *  again, once per rendered frame. Stars which have to outlive the frame,
+ *  like selected ones, must be replaced by the copy returned by
+ *  stableStar(). Stars of the paged catalog have no names or cross
+ *  indexes and can't be looked up by catalog number.
+ */
+class PagedStarCatalog : public StarOctree::ObjectPager
+{
+ public:
+    using PackedNode  = StarOctree::PackedNode;
+    using NodeObjects = StarOctree::NodeObjects;
+
+    struct Statistics
+    {
+        size_t   residentPages{ 0 };
+        size_t   residentStars{ 0 };
+        size_t   residentBytes{ 0 };
+        size_t   memoryBudget{ 0 };
+        uint64_t hits{ 0 };
+        uint64_t misses{ 0 };
+        uint64_t evictions{ 0 };
+    };
+
+    PagedStarCatalog();
+    ~PagedStarCatalog() override = default;
+
+    bool open(const fs::path& filename);
+
+    const StarOctree* octree() const { return tree.get(); }
+    float rootSize() const           { return octreeRootSize; }
+    uint32_t size() const            { return nStars; }
+
+    void setMemoryBudget(size_t bytes);
+    void nextFrame();
+    // A copy of star, which must be a star of this catalog, that stays
+    // valid as long as the catalog
+    const Star* stableStar(const Star& star);
+    Statistics getStatistics() const;
+
+    NodeObjects load(uint32_t node) override;
+
+    // Write a paged catalog from star records in stars.dat format, already
+    // in the order of the octree described by nodes.
+    static bool write(const fs::path& filename,
+                      float rootSize,
+                      const std::vector<PackedNode>& nodes,
+                      const char* records,
+                      uint32_t nRecords);
+
+ private:
+    struct Page
+    {
+        std::vector<Star>     stars;
+        std::vector<uint16_t> x;
+        std::vector<uint16_t> y;
+        std::vector<uint16_t> z;
+        std::vector<int16_t>  magnitude;
+        StarOctree::ObjectBounds bounds;
+        size_t             bytes{ 0 };
+        uint64_t           lastUsed{ 0 };
+        std::list<uint32_t>::iterator lruPosition;
+    };
+
+    Page* loadPage(uint32_t node);
+    void evictPages();
+
+    MappedFile                  file;
+    const char*                 records{ nullptr };
+    uint32_t                    nStars{ 0 };
+    float                       octreeRootSize{ 0.0f };
+    std::vector<PackedNode>     nodes;
+    std::unique_ptr<StarOctree> tree;
+
+    mutable std::mutex          mutex;
+    // Resident pages by node, and their nodes with the most recently used first
+    std::vector<std::unique_ptr<Page>> pages;
+    std::list<uint32_t>         lru;
+    std::vector<StarDetails*>   detailsCache;
+    // Copies of the stars handed out by stableStar(), by catalog number
+    std::map<uint32_t, std::unique_ptr<Star>> stableStars;
+    uint64_t                    frame{ 1 };
+    Statistics                  stats;
+};
@@ -33,6 +33,19 @@ PointStarRenderer::PointStarRenderer() :
 }
 
 void PointStarRenderer::process(const Star& star, float distance, float appMag)
+{
+    renderStar(star, distance, appMag);
+}
+
+void PointStarRenderer::processBatch(celestia::span<const Star* const> stars,
+                                     celestia::span<const float> distances,
+                                     celestia::span<const float> appMags)
+{
+    for (size_t i = 0; i < stars.size(); i++)
+        renderStar(*stars[i], distances[i], appMags[i]);
+}
+
+void PointStarRenderer::renderStar(const Star& star, float distance, float appMag)
 {
     nProcessed++;
 
@@ -41,6 +41,9 @@ class PointStarRenderer : public ObjectRenderer<Star, float>
 
     PointStarRenderer();
     void process(const Star &star, float distance, float appMag);
+    void processBatch(celestia::span<const Star* const> stars,
+                      celestia::span<const float> distances,
+                      celestia::span<const float> appMags);
 
     Eigen::Vector3d obsPos;
     std::vector<RenderListEntry>* renderList    { nullptr };
@@ -62,4 +65,7 @@ class PointStarRenderer : public ObjectRenderer<Star, float>
     unsigned long total                         { 0 };
 #endif
     bool  useScaledDiscs                        { false };
+
+ private:
+    inline void renderStar(const Star &star, float distance, float appMag);
 };
@@ -61,6 +61,7 @@ std::ofstream hdrlog;
 #include "pointstarvertexbuffer.h"
 #include "pointstarrenderer.h"
 #include "orbitsampler.h"
+#include "orbitpathqueue.h"
 #include "asterismrenderer.h"
 #include "boundariesrenderer.h"
 #include "rendcontext.h"
@@ -86,6 +87,7 @@ std::ofstream hdrlog;
 #include <cassert>
 #include <sstream>
 #include <iomanip>
+#include <limits>
 #include <numeric>
 #ifdef USE_GLCONTEXT
 #include "glcontext.h"
@@ -164,10 +166,17 @@ static const int MaxSkyRings = 32;
 static const int MaxSkySlices = 180;
 static const int MinSkySlices = 30;
 
-// Size at which the orbit cache will be flushed of old orbit paths
-static const unsigned int OrbitCacheCullThreshold = 200;
-// Age in frames at which unused orbit paths may be eliminated from the cache
-static const uint32_t OrbitCacheRetireAge = 16;
+// Default memory used by cached orbit paths
+static const size_t OrbitCacheDefaultBudget = 32 * 1024 * 1024;
+// Number of steps of the coarse paths drawn while orbits are sampled in
+// the background
+static const unsigned int OrbitPathPlaceholderSteps = 16;
+// Closest distance to an orbit assumed when choosing its sampling tolerance,
+// as a fraction of its bounding radius
+static const double OrbitPathMinDistance = 1.0e-5;
+// Orbit paths are sampled again when the camera gets close enough to need
+// a tolerance smaller by this factor
+static const double OrbitPathResampleFactor = 4.0;
 
 Color Renderer::StarLabelColor          (0.471f, 0.356f, 0.682f);
 Color Renderer::PlanetLabelColor        (0.407f, 0.333f, 0.964f);
@@ -280,6 +289,7 @@ Renderer::Renderer() :
     glareVertexBuffer(nullptr),
     textureResolution(medres),
     frameCount(0),
+    orbitCacheBudget(OrbitCacheDefaultBudget),
     lastOrbitCacheFlush(0),
     minOrbitSize(MinOrbitSizeForLabel),
     distanceLimit(1.0e6f),
@@ -335,6 +345,8 @@ Renderer::Renderer() :
 
 Renderer::~Renderer()
 {
+    invalidateOrbitCache();
+
     delete pointStarVertexBuffer;
     delete glareVertexBuffer;
     delete[] skyVertices;
@@ -372,6 +384,7 @@ Renderer::~Renderer()
 
 Renderer::DetailOptions::DetailOptions() :
     orbitPathSamplePoints(100),
+    orbitPathTolerance(0.5),
     shadowTextureSize(256),
     eclipseTextureSize(128),
     orbitWindowEnd(0.5),
@@ -1121,6 +1134,200 @@ Vector4f renderOrbitColor(const Body *body, bool selected, float opacity)
 }
 
 
+// Return the path of an orbit from the cache, sampling the orbit when it
+// isn't cached or was sampled too coarsely for the current view. Orbits
+// that can be sampled in the background are drawn as a coarse path, or
+// as their previous path, until their samples are ready.
+CurvePlot* Renderer::getOrbitPath(const Orbit* orbit, double t, double tolerance, const Body* body)
+{
+    // Take the paths sampled in the background once per frame
+    if (lastOrbitCacheFlush != frameCount)
+    {
+        collectOrbitPaths();
+        lastOrbitCacheFlush = frameCount;
+    }
+
+    bool background = orbitPathQueue != nullptr && orbit->isThreadSafe();
+
+    double startTime = t;
+    double endTime;
+    // Aperiodic orbits aren't true orbits, but sampled trajectories,
+    // generally of spacecraft; they are sampled over their whole span.
+    if (!orbit->isPeriodic())
+    {
+        double begin = 0.0, end = 0.0;
+        orbit->getValidRange(begin, end);
+
+        if (begin != end)
+            startTime = begin;
+    }
+    else
+    {
+        startTime = t - orbit->getPeriod();
+    }
+    endTime = startTime + orbit->getPeriod();
+
+    OrbitCache::iterator cached = orbitCache.find(orbit);
+    if (cached != orbitCache.end())
+    {
+        CachedOrbitPath& path = cached->second;
+        path.plot->setLastUsed(frameCount);
+        orbitCacheLRU.splice(orbitCacheLRU.begin(), orbitCacheLRU, path.lruPosition);
+
+        // Sample the orbit again once the camera has come much closer
+        if (path.plot->tolerance() <= tolerance * OrbitPathResampleFactor)
+        {
+            orbitCacheHits++;
+            return path.plot;
+        }
+
+        if (background)
+        {
+            if (path.pendingTolerance == 0.0 ||
+                path.pendingTolerance > tolerance * OrbitPathResampleFactor)
+            {
+                orbitPathQueue->request({ orbit, startTime, endTime, tolerance });
+                path.pendingTolerance = tolerance;
+            }
+            orbitCacheHits++;
+            return path.plot;
+        }
+
+        eraseOrbitPath(cached);
+    }
+
+    orbitCacheMisses++;
+
+    CurvePlot* plot = new CurvePlot();
+    plot->setLastUsed(frameCount);
+
+    if (background)
+    {
+        OrbitSampler sampler;
+        for (unsigned int i = 0; i <= OrbitPathPlaceholderSteps; i++)
+        {
+            double s = startTime + (endTime - startTime) * i / OrbitPathPlaceholderSteps;
+            sampler.sample(s, orbit->positionAtTime(s), orbit->velocityAtTime(s));
+        }
+        sampler.insertForward(plot);
+        plot->setTolerance(numeric_limits<double>::infinity());
+
+        orbitPathQueue->request({ orbit, startTime, endTime, tolerance });
+        addOrbitPath(orbit, plot, tolerance);
+    }
+    else
+    {
+        Timer timer;
+        OrbitSampler sampler(tolerance);
+        orbit->sample(startTime, endTime, sampler);
+        sampler.insertForward(plot);
+        plot->setTolerance(tolerance);
+        DPRINTF(LOG_LEVEL_VERBOSE, "Sampled orbit of %s: %u samples within %g km in %.3f ms\n",
+                body != nullptr ? body->getName() : string("star"),
+                (unsigned int) sampler.samples.size(), tolerance, timer.getTime() * 1000.0);
+        orbitPathsSampled++;
+        orbitPathSamples += sampler.samples.size();
+        orbitSamplingTime += timer.getTime();
+
+        addOrbitPath(orbit, plot, 0.0);
+    }
+
+    return plot;
+}
+
+
+void Renderer::addOrbitPath(const Orbit* orbit, CurvePlot* plot, double pendingTolerance)
+{
+    orbitCacheLRU.push_front(orbit);
+
+    CachedOrbitPath& path = orbitCache[orbit];
+    path.plot = plot;
+    path.lruPosition = orbitCacheLRU.begin();
+    path.bytes = 0;
+    path.pendingTolerance = pendingTolerance;
+    updateOrbitPathSize(path);
+
+    trimOrbitCache();
+}
+
+
+void Renderer::updateOrbitPathSize(CachedOrbitPath& path)
+{
+    size_t bytes = sizeof(CurvePlot) + path.plot->sampleCount() * sizeof(CurvePlotSample);
+    orbitCacheBytes += bytes - path.bytes;
+    path.bytes = bytes;
+}
+
+
+void Renderer::eraseOrbitPath(OrbitCache::iterator iter)
+{
+    // The orbit itself stays, so a request being sampled needn't be
+    // waited for; its samples are dropped when collected.
+    if (iter->second.pendingTolerance != 0.0)
+        orbitPathQueue->cancelQueued(iter->first);
+
+    delete iter->second.plot;
+    orbitCacheBytes -= iter->second.bytes;
+    orbitCacheLRU.erase(iter->second.lruPosition);
+    orbitCache.erase(iter);
+}
+
+
+// Replace the paths of the cached orbits sampled in the background
+void Renderer::collectOrbitPaths()
+{
+    if (orbitPathQueue == nullptr)
+        return;
+
+    vector<OrbitPathQueue::Result> results;
+    orbitPathQueue->collect(results);
+    for (const auto& result : results)
+    {
+        // Drop the samples of orbits that left the cache or were
+        // requested again meanwhile
+        OrbitCache::iterator cached = orbitCache.find(result.request.orbit);
+        if (cached == orbitCache.end() || cached->second.pendingTolerance != result.request.tolerance)
+            continue;
+
+        DPRINTF(LOG_LEVEL_VERBOSE, "Sampled orbit in the background: %u samples within %g km in %.3f ms\n",
+                (unsigned int) result.samples.size(), result.request.tolerance, result.duration * 1000.0);
+        orbitPathsSampled++;
+        orbitPathSamples += result.samples.size();
+        orbitSamplingTime += result.duration;
+
+        CachedOrbitPath& path = cached->second;
+        CurvePlot* plot = new CurvePlot();
+        plot->setLastUsed(path.plot->lastUsed());
+        plot->setTolerance(result.request.tolerance);
+        for (const auto& sample : result.samples)
+            plot->addSample(sample);
+
+        delete path.plot;
+        path.plot = plot;
+        path.pendingTolerance = 0.0;
+        updateOrbitPathSize(path);
+    }
+
+    trimOrbitCache();
+}
+
+
+// Drop the least recently used orbit paths until the cache fits within
+// its budget, keeping those drawn in the current frame.
+void Renderer::trimOrbitCache()
+{
+    while (orbitCacheBytes > orbitCacheBudget && !orbitCacheLRU.empty())
+    {
+        OrbitCache::iterator oldest = orbitCache.find(orbitCacheLRU.back());
+        if (oldest->second.plot->lastUsed() == frameCount)
+            break;
+
+        eraseOrbitPath(oldest);
+        orbitCacheEvictions++;
+    }
+}
+
+
 static int orbitsRendered = 0;
 static int orbitsSkipped = 0;
 static int sectionsCulled = 0;
@@ -1146,81 +1353,15 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
     else
         orbit = orbitPath.star->getOrbit();
 
-    CurvePlot* cachedOrbit = nullptr;
-    OrbitCache::iterator cached = orbitCache.find(orbit);
-    if (cached != orbitCache.end())
-    {
-        cachedOrbit = cached->second;
-        cachedOrbit->setLastUsed(frameCount);
-    }
-
-    // If it's not in the cache already
-    if (cachedOrbit == nullptr)
-    {
-        double startTime = t;
-        int nSamples = detailOptions.orbitPathSamplePoints;
-
-        // Adjust the number of samples used for aperiodic orbits--these aren't
-        // true orbits, but are sampled trajectories, generally of spacecraft.
-        // Better control is really needed--some sort of adaptive sampling would
-        // be ideal.
-        if (!orbit->isPeriodic())
-        {
-            double begin = 0.0, end = 0.0;
-            orbit->getValidRange(begin, end);
-
-            if (begin != end)
-            {
-                startTime = begin;
-                nSamples = (int) (orbit->getPeriod() * 100.0);
-                nSamples = max(min(nSamples, 1000), 100);
-            }
-            else
-            {
-                // If the orbit is aperiodic and doesn't have a
-                // finite duration, we don't render it. A compromise
-                // would be to pick some time window centered at the
-                // current time, but we'd have to pick some arbitrary
-                // duration.
-                nSamples = 0;
-            }
-        }
-        else
-        {
-            startTime = t - orbit->getPeriod();
-        }
-
-        cachedOrbit = new CurvePlot();
-        cachedOrbit->setLastUsed(frameCount);
-
-        OrbitSampler sampler;
-        orbit->sample(startTime,
-                      startTime + orbit->getPeriod(),
-                      sampler);
-        sampler.insertForward(cachedOrbit);
-
-        // If the orbit cache is full, first try and eliminate some old orbits
-        if (orbitCache.size() > OrbitCacheCullThreshold)
-        {
-            // Check for old orbits at most once per frame
-            if (lastOrbitCacheFlush != frameCount)
-            {
-                for (auto iter = orbitCache.begin(); iter != orbitCache.end();)
-                {
-                    // Tricky code to eliminate a node in the orbit cache without screwing
-                    // up the iterator. Should work in all STL implementations.
-                    if (frameCount - iter->second->lastUsed() > OrbitCacheRetireAge)
-                        orbitCache.erase(iter++);
-                    else
-                        ++iter;
-                }
-                lastOrbitCacheFlush = frameCount;
-            }
-        }
-
-        orbitCache[orbit] = cachedOrbit;
-    }
+    // Sample the orbit so that the curves drawn through the samples stay
+    // within orbitPathTolerance pixels of it where it passes closest to
+    // the camera.
+    double boundingRadius = orbit->getBoundingRadius();
+    double viewDistance = max(orbitPath.origin.norm() - boundingRadius,
+                              boundingRadius * OrbitPathMinDistance);
+    double tolerance = detailOptions.orbitPathTolerance * pixelSize * viewDistance;
 
+    CurvePlot* cachedOrbit = getOrbitPath(orbit, t, tolerance, body);
     if (cachedOrbit->empty())
         return;
 
@@ -1271,9 +1412,10 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
             cachedOrbit->removeSamplesBefore(cachedOrbit->startTime() * (1.0 + 1.0e-15));
 
             // Add the new samples
-            OrbitSampler sampler;
+            OrbitSampler sampler(cachedOrbit->tolerance());
             orbit->sample(newWindowStart, min(currentWindowStart, newWindowEnd), sampler);
             sampler.insertBackward(cachedOrbit);
+            updateOrbitPathSize(orbitCache.at(orbit));
 #if DEBUG_ORBIT_CACHE
             clog << "new sample count: " << cachedOrbit->sampleCount() << endl;
 #endif
@@ -1287,9 +1429,10 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
             cachedOrbit->removeSamplesAfter(cachedOrbit->endTime() * (1.0 - 1.0e-15));
 
             // Add the new samples
-            OrbitSampler sampler;
+            OrbitSampler sampler(cachedOrbit->tolerance());
             orbit->sample(max(currentWindowEnd, newWindowStart), newWindowEnd, sampler);
             sampler.insertForward(cachedOrbit);
+            updateOrbitPathSize(orbitCache.at(orbit));
 #if DEBUG_ORBIT_CACHE
             clog << "new sample count: " << cachedOrbit->sampleCount() << endl;
 #endif
@@ -1541,6 +1684,10 @@ void Renderer::render(const Observer& observer,
                       float faintestMagNight,
                       const Selection& sel)
 {
+    // Stars of a paged catalog found during the previous frame may be
+    // evicted from now on.
+    universe.getStarCatalog()->nextFrame();
+
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
 
@@ -1676,9 +1823,10 @@ void Renderer::draw(const Observer& observer,
     bool foundBrightestStar = false;
 #endif
 
+    // The near stars are only valid during this frame
+    nearStars.clear();
     if ((renderFlags & (ShowSSO | ShowOrbits)) != 0)
     {
-        nearStars.clear();
         universe.getNearStars(observer.getPosition(), SolarSystemMaxDistance, nearStars);
 
         // Set up direct light sources (i.e. just stars at the moment)
@@ -6303,7 +6451,36 @@ void Renderer::loadTextures(Body* body)
 
 void Renderer::invalidateOrbitCache()
 {
+    // Orbits may be deleted once this returns; wait for the ones being
+    // sampled in the background.
+    if (orbitPathQueue != nullptr)
+        orbitPathQueue->cancelAll();
+
+    for (const auto& cached : orbitCache)
+        delete cached.second.plot;
     orbitCache.clear();
+    orbitCacheLRU.clear();
+    orbitCacheBytes = 0;
+}
+
+
+void Renderer::setOrbitPathThreads(unsigned int nThreads)
+{
+    // Paths still waiting for their samples are requested again when
+    // they are drawn
+    orbitPathQueue = nullptr;
+    for (auto& cached : orbitCache)
+        cached.second.pendingTolerance = 0.0;
+
+    if (nThreads > 0)
+        orbitPathQueue = unique_ptr<OrbitPathQueue>(new OrbitPathQueue(nThreads));
+}
+
+
+void Renderer::setOrbitCacheBudget(size_t bytes)
+{
+    orbitCacheBudget = bytes;
+    trimOrbitCache();
 }
 
 
@@ -6595,6 +6772,17 @@ bool Renderer::getInfo(map<string, string>& info) const
     if (s != nullptr)
         info["Extensions"] = s;
 
+    info["OrbitCacheEntries"] = to_string(orbitCache.size());
+    info["OrbitCacheBytes"] = to_string(orbitCacheBytes);
+    info["OrbitCacheBudget"] = to_string(orbitCacheBudget);
+    info["OrbitCacheHits"] = to_string(orbitCacheHits);
+    info["OrbitCacheMisses"] = to_string(orbitCacheMisses);
+    info["OrbitCacheEvictions"] = to_string(orbitCacheEvictions);
+    info["OrbitPathsPending"] = to_string(orbitPathQueue != nullptr ? orbitPathQueue->pendingCount() : 0);
+    info["OrbitPathsSampled"] = to_string(orbitPathsSampled);
+    info["OrbitPathSamples"] = to_string(orbitPathSamples);
+    info["OrbitSamplingTime"] = to_string((uint64_t) (orbitSamplingTime * 1000.0));
+
     return true;
 }
 
@@ -30,6 +30,7 @@ class RendererWatcher;
 class FrameTree;
 class ReferenceMark;
 class CurvePlot;
+class OrbitPathQueue;
 class Rect;
 class PointStarVertexBuffer;
 class AsterismRenderer;
@@ -82,6 +83,7 @@ class Renderer
     {
         DetailOptions();
         unsigned int orbitPathSamplePoints;
+        double orbitPathTolerance;
         unsigned int shadowTextureSize;
         unsigned int eclipseTextureSize;
         double orbitWindowEnd;
@@ -342,6 +344,12 @@ class Renderer
     void clearSortedAnnotations();
 
     void invalidateOrbitCache();
+    // Sample orbit paths on nThreads background threads, or on the
+    // rendering thread when nThreads is zero
+    void setOrbitPathThreads(unsigned int nThreads);
+    // Memory in bytes used by cached orbit paths beyond which the least
+    // recently used ones are dropped
+    void setOrbitCacheBudget(size_t bytes);
 
     struct OrbitPathListEntry
     {
@@ -750,8 +758,39 @@ class Renderer
 #endif
 
  private:
-    typedef std::map<const Orbit*, CurvePlot*> OrbitCache;
+    struct CachedOrbitPath
+    {
+        CurvePlot* plot;
+        // Position in orbitCacheLRU
+        std::list<const Orbit*>::iterator lruPosition;
+        size_t bytes;
+        // Tolerance of the samples requested from orbitPathQueue, or zero
+        // when none are pending
+        double pendingTolerance;
+    };
+
+    CurvePlot* getOrbitPath(const Orbit* orbit, double t, double tolerance, const Body* body);
+    void addOrbitPath(const Orbit* orbit, CurvePlot* plot, double pendingTolerance);
+    void updateOrbitPathSize(CachedOrbitPath& path);
+    void eraseOrbitPath(std::map<const Orbit*, CachedOrbitPath>::iterator iter);
+    void collectOrbitPaths();
+    void trimOrbitCache();
+
+    typedef std::map<const Orbit*, CachedOrbitPath> OrbitCache;
     OrbitCache orbitCache;
+    // Cached orbits, most recently used first
+    std::list<const Orbit*> orbitCacheLRU;
+    size_t orbitCacheBytes{ 0 };
+    size_t orbitCacheBudget;
+    uint64_t orbitCacheHits{ 0 };
+    uint64_t orbitCacheMisses{ 0 };
+    uint64_t orbitCacheEvictions{ 0 };
+    // Totals of the orbit paths sampled, in the foreground or in the
+    // background, and of their sampling times in seconds
+    uint64_t orbitPathsSampled{ 0 };
+    uint64_t orbitPathSamples{ 0 };
+    double orbitSamplingTime{ 0.0 };
+    std::unique_ptr<OrbitPathQueue> orbitPathQueue;
     uint32_t lastOrbitCacheFlush;
 
     float minOrbitSize;
@@ -1044,6 +1044,22 @@ Star::getOrbitBarycenterPosition(double t) const
 }
 
 
+bool
+Star::isThreadSafe() const
+{
+    if (getRotationModel() != nullptr && !getRotationModel()->isThreadSafe())
+        return false;
+
+    for (const Star* star = this; star != nullptr; star = star->getOrbitBarycenter())
+    {
+        if (star->getOrbit() != nullptr && !star->getOrbit()->isThreadSafe())
+            return false;
+    }
+
+    return true;
+}
+
+
 /*! Get the velocity of the star in the universal coordinate system.
  */
 Vector3d
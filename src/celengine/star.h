@@ -267,6 +267,9 @@ public:
     UniversalCoord getOrbitBarycenterPosition(double t) const;
 
     Eigen::Vector3d getVelocity(double t) const;
+    // Whether the position and orientation of the star may be computed on
+    // several threads at once
+    bool isThreadSafe() const;
 
     void setPosition(float, float, float);
     void setPosition(const Eigen::Vector3f& positionLy);
@@ -21,54 +21,7 @@ using namespace std;
 // TODO: More of the functions in this module should be converted to
 // methods of the StarBrowser class.
 
-struct CloserStarPredicate
-{
-    Vector3f pos;
-    bool operator()(const Star* star0, const Star* star1) const
-    {
-        Vector3f p0 = star0->getPosition();
-        Vector3f p1 = star1->getPosition();
-
-#if 0
-        Vector3f v0(p0.x * 1e6 - pos.x, p0.y * 1e6 - pos.y, p0.z * 1e6 - pos.z);
-        Vector3f v1(p1.x * 1e6 - pos.x, p1.y * 1e6 - pos.y, p1.z * 1e6 - pos.z);
-#endif
-        Vector3f v0 = p0 * 1.0e6f - pos;
-        Vector3f v1 = p1 * 1.0e6f - pos;
-
-        return (v0.squaredNorm() < v1.squaredNorm());
-    }
-};
-
-
-struct BrighterStarPredicate
-{
-    Vector3f pos;
-    UniversalCoord ucPos;
-    bool operator()(const Star* star0, const Star* star1) const
-    {
-        Vector3f p0 = star0->getPosition();
-        Vector3f p1 = star1->getPosition();
-        Vector3f v0 = p0 * 1.0e6f - pos;
-        Vector3f v1 = p1 * 1.0e6f - pos;
-        float d0 = v0.norm();
-        float d1 = v1.norm();
-
-        return (star0->getApparentMagnitude(d0) <
-                star1->getApparentMagnitude(d1));
-    }
-};
-
-
-struct BrightestStarPredicate
-{
-    bool operator()(const Star* star0, const Star* star1) const
-    {
-        return (star0->getAbsoluteMagnitude() <
-                star1->getAbsoluteMagnitude());
-    }
-};
-
+static const unsigned int MAX_LISTED_STARS = 500;
 
 struct SolarSystemPredicate
 {
@@ -87,8 +40,8 @@ struct SolarSystemPredicate
         {
             Vector3f p0 = star0->getPosition();
             Vector3f p1 = star1->getPosition();
-            Vector3f v0 = p0 * 1.0e6f - pos;
-            Vector3f v1 = p1 * 1.0e6f - pos;
+            Vector3f v0 = p0 - pos;
+            Vector3f v1 = p1 - pos;
             return (v0.squaredNorm() < v1.squaredNorm());
         }
         else
@@ -99,16 +52,18 @@ struct SolarSystemPredicate
 };
 
 
-// Find the nearest/brightest/X-est N stars in a database.  The
+// Find the N stars in a database best matching a predicate; the
 // supplied predicate determines which of two stars is a better match.
+// The nearest and brightest stars are found by searching the star
+// octree instead, which gives the same results as this linear scan.
 template<class Pred> static std::vector<const Star*>*
 findStars(const StarDatabase& stardb, Pred pred, int nStars)
 {
     std::vector<const Star*>* finalStars = new std::vector<const Star*>();
     if (nStars == 0)
         return finalStars;
-    if(nStars > 500)
-        nStars = 500;
+    if (nStars > (int) MAX_LISTED_STARS)
+        nStars = (int) MAX_LISTED_STARS;
 
     typedef std::multiset<const Star*, Pred> StarSet;
     StarSet firstStars(pred);
@@ -150,12 +105,9 @@ findStars(const StarDatabase& stardb, Pred pred, int nStars)
 const Star* StarBrowser::nearestStar()
 {
     Universe* univ = appSim->getUniverse();
-    CloserStarPredicate closerPred;
-    closerPred.pos = pos;
-    std::vector<const Star*>* stars = findStars(*(univ->getStarCatalog()), closerPred, 1);
-    const Star *star = (*stars)[0];
-    delete stars;
-    return star;
+    std::vector<const Star*> stars;
+    univ->getStarCatalog()->findNearestStars(pos, 1, stars);
+    return stars.empty() ? nullptr : stars[0];
 }
 
 
@@ -163,21 +115,24 @@ std::vector<const Star*>*
 StarBrowser::listStars(unsigned int nStars)
 {
     Universe* univ = appSim->getUniverse();
+    const StarDatabase* stardb = univ->getStarCatalog();
+    nStars = min(nStars, MAX_LISTED_STARS);
+
     switch(predicate)
     {
     case BrighterStars:
         {
-            BrighterStarPredicate brighterPred;
-            brighterPred.pos = pos;
-            brighterPred.ucPos = ucPos;
-            return findStars(*(univ->getStarCatalog()), brighterPred, nStars);
+            auto* stars = new std::vector<const Star*>();
+            stardb->findBrightestStars(pos, nStars, *stars);
+            return stars;
         }
         break;
 
     case BrightestStars:
         {
-            BrightestStarPredicate brightestPred;
-            return findStars(*(univ->getStarCatalog()), brightestPred, nStars);
+            auto* stars = new std::vector<const Star*>();
+            stardb->findMostLuminousStars(nStars, *stars);
+            return stars;
         }
         break;
 
@@ -189,7 +144,7 @@ StarBrowser::listStars(unsigned int nStars)
             SolarSystemPredicate solarSysPred;
             solarSysPred.pos = pos;
             solarSysPred.solarSystems = solarSystems;
-            return findStars(*(univ->getStarCatalog()), solarSysPred,
+            return findStars(*stardb, solarSysPred,
                              min((size_t) nStars, solarSystems->size()));
         }
         break;
@@ -197,9 +152,9 @@ StarBrowser::listStars(unsigned int nStars)
     case NearestStars:
     default:
         {
-            CloserStarPredicate closerPred;
-            closerPred.pos = pos;
-            return findStars(*(univ->getStarCatalog()), closerPred, nStars);
+            auto* stars = new std::vector<const Star*>();
+            stardb->findNearestStars(pos, nStars, *stars);
+            return stars;
         }
         break;
     }
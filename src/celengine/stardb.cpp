@@ -14,10 +14,12 @@
 #include <cstdlib>
 #include <cassert>
 #include <algorithm>
+#include <fstream>
 #include <celmath/mathlib.h>
 #include <celutil/bytes.h>
 #include <celutil/debug.h>
 #include <celutil/gettext.h>
+#include <celutil/mappedfile.h>
 #include "stardb.h"
 #include "astro.h"
 #include "parser.h"
@@ -51,7 +53,17 @@ constexpr const float STAR_OCTREE_MAGNITUDE   = 6.0f;
 //constexpr const float STAR_EXTRA_ROOM        = 0.01f; // Reserve 1% capacity for extra stars
 
 constexpr const char FILE_HEADER[]            = "CELSTARS";
-constexpr const char CROSSINDEX_FILE_HEADER[] = "CELINDEX";
+
+// Layout of a star record in a version 0x0100 stars.dat file. All fields
+// are stored little endian and the record has no padding.
+struct BinaryStarRecord
+{
+    AstroCatalog::IndexNumber catNo;
+    float x, y, z;
+    int16_t absMag;
+    uint16_t spectralType;
+};
+static_assert(sizeof(BinaryStarRecord) == 20, "Binary star record must be 20 bytes");
 
 
 // Used to sort stars by catalog number
@@ -173,12 +185,6 @@ static bool parseCelestiaCatalogNumber(const string& name,
 }
 
 
-bool StarDatabase::CrossIndexEntry::operator<(const StarDatabase::CrossIndexEntry& e) const
-{
-    return catalogNumber < e.catalogNumber;
-}
-
-
 StarDatabase::StarDatabase()
 {
     crossIndexes.resize(MaxCatalog);
@@ -273,14 +279,7 @@ AstroCatalog::IndexNumber StarDatabase::crossIndex(const Catalog catalog, const
     if (xindex == nullptr)
         return AstroCatalog::InvalidIndex;
 
-    // A simple linear search.  We could store cross indices sorted by
-    // both catalog numbers and trade memory for speed
-    auto iter = std::find_if(xindex->begin(), xindex->end(),
-                             [celCatalogNumber](CrossIndexEntry& o){ return celCatalogNumber == o.celCatalogNumber; });
-    if (iter != xindex->end())
-        return iter->catalogNumber;
-
-    return AstroCatalog::InvalidIndex;
+    return xindex->findCatalogNumber(celCatalogNumber);
 }
 
 
@@ -295,15 +294,7 @@ AstroCatalog::IndexNumber StarDatabase::searchCrossIndexForCatalogNumber(const C
     if (xindex == nullptr)
         return AstroCatalog::InvalidIndex;
 
-    CrossIndexEntry xindexEnt;
-    xindexEnt.catalogNumber = number;
-
-    CrossIndex::iterator iter = lower_bound(xindex->begin(), xindex->end(),
-                                            xindexEnt);
-    if (iter == xindex->end() || iter->catalogNumber != number)
-        return AstroCatalog::InvalidIndex;
-    else
-        return iter->celCatalogNumber;
+    return xindex->findCelestiaNumber(number);
 }
 
 
@@ -317,13 +308,13 @@ Star* StarDatabase::searchCrossIndex(const Catalog catalog, const AstroCatalog::
 }
 
 
-vector<string> StarDatabase::getCompletion(const string& name) const
+vector<string> StarDatabase::getCompletion(const string& name, size_t limit) const
 {
     vector<string> completion;
 
     // only named stars are supported by completion.
     if (!name.empty() && namesDB != nullptr)
-        return namesDB->getCompletion(name);
+        return namesDB->getCompletion(name, true, limit);
     else
         return completion;
 }
@@ -521,7 +512,19 @@ void StarDatabase::findVisibleStars(StarHandler& starHandler,
                                       frustumPlanes,
                                       limitingMag,
                                       STAR_OCTREE_ROOT_SIZE,
-                                      stats);
+                                      stats,
+                                      threadPool);
+
+    if (pagedCatalog != nullptr)
+    {
+        pagedCatalog->octree()->processVisibleObjects(starHandler,
+                                                      position,
+                                                      frustumPlanes,
+                                                      limitingMag,
+                                                      pagedCatalog->rootSize(),
+                                                      stats,
+                                                      threadPool);
+    }
 }
 
 
@@ -533,6 +536,100 @@ void StarDatabase::findCloseStars(StarHandler& starHandler,
                                     position,
                                     radius,
                                     STAR_OCTREE_ROOT_SIZE);
+
+    if (pagedCatalog != nullptr)
+    {
+        pagedCatalog->octree()->processCloseObjects(starHandler,
+                                                    position,
+                                                    radius,
+                                                    pagedCatalog->rootSize());
+    }
+}
+
+
+void StarDatabase::findStarsInCone(StarConeHandler& starHandler,
+                                   const Vector3f& position,
+                                   const Vector3f& direction,
+                                   float limitingMag,
+                                   OctreeProcStats *stats) const
+{
+    octreeRoot->processConeObjects(starHandler,
+                                   position,
+                                   direction,
+                                   limitingMag,
+                                   STAR_OCTREE_ROOT_SIZE,
+                                   stats);
+
+    if (pagedCatalog != nullptr)
+    {
+        pagedCatalog->octree()->processConeObjects(starHandler,
+                                                   position,
+                                                   direction,
+                                                   limitingMag,
+                                                   pagedCatalog->rootSize(),
+                                                   stats);
+    }
+}
+
+
+void StarDatabase::findNearestStars(const Vector3f& obsPosition,
+                                    unsigned int n,
+                                    vector<const Star*>& stars) const
+{
+    octreeRoot->findNearestObjects(obsPosition, STAR_OCTREE_ROOT_SIZE, n, stars);
+}
+
+
+void StarDatabase::findBrightestStars(const Vector3f& obsPosition,
+                                      unsigned int n,
+                                      vector<const Star*>& stars) const
+{
+    octreeRoot->findBrightestObjects(obsPosition, STAR_OCTREE_ROOT_SIZE, n, stars);
+}
+
+
+void StarDatabase::findMostLuminousStars(unsigned int n,
+                                         vector<const Star*>& stars) const
+{
+    octreeRoot->findMostLuminousObjects(STAR_OCTREE_ROOT_SIZE, n, stars);
+}
+
+
+bool StarDatabase::loadPagedCatalog(const fs::path& filename, size_t memoryBudget)
+{
+    unique_ptr<PagedStarCatalog> catalog(new PagedStarCatalog());
+    if (!catalog->open(filename))
+        return false;
+
+    catalog->setMemoryBudget(memoryBudget);
+    pagedCatalog = move(catalog);
+
+    return true;
+}
+
+
+const PagedStarCatalog* StarDatabase::getPagedCatalog() const
+{
+    return pagedCatalog.get();
+}
+
+
+void StarDatabase::nextFrame() const
+{
+    // Stars paged in for the previous frame may be evicted now
+    if (pagedCatalog != nullptr)
+        pagedCatalog->nextFrame();
+}
+
+
+const Star* StarDatabase::getStableStar(const Star* star) const
+{
+    if (star == nullptr || pagedCatalog == nullptr ||
+        (star >= stars && star < stars + nStars))
+    {
+        return star;
+    }
+    return pagedCatalog->stableStar(*star);
 }
 
 
@@ -553,62 +650,35 @@ bool StarDatabase::loadCrossIndex(const Catalog catalog, istream& in)
     if (static_cast<unsigned int>(catalog) >= crossIndexes.size())
         return false;
 
-    if (crossIndexes[catalog] != nullptr)
-        delete crossIndexes[catalog];
-
-    // Verify that the star database file has a correct header
-    {
-        int headerLength = strlen(CROSSINDEX_FILE_HEADER);
-        char* header = new char[headerLength];
-        in.read(header, headerLength);
-        if (strncmp(header, CROSSINDEX_FILE_HEADER, headerLength))
-        {
-            cerr << _("Bad header for cross index\n");
-            delete[] header;
-            return false;
-        }
-        delete[] header;
-    }
-
-    // Verify the version
+    CrossIndex* xindex = new CrossIndex();
+    if (!xindex->load(in))
     {
-        uint16_t version;
-        in.read((char*) &version, sizeof version);
-        LE_TO_CPU_INT16(version, version);
-        if (version != 0x0100)
-        {
-            cerr << _("Bad version for cross index\n");
-            return false;
-        }
+        delete xindex;
+        return false;
     }
 
-    CrossIndex* xindex = new CrossIndex();
+    delete crossIndexes[catalog];
+    crossIndexes[catalog] = xindex;
 
-    unsigned int record = 0;
-    for (;;)
-    {
-        CrossIndexEntry ent;
-        in.read((char *) &ent.catalogNumber, sizeof ent.catalogNumber);
-        LE_TO_CPU_INT32(ent.catalogNumber, ent.catalogNumber);
-        if (in.eof())
-            break;
+    return true;
+}
 
-        in.read((char *) &ent.celCatalogNumber, sizeof ent.celCatalogNumber);
-        LE_TO_CPU_INT32(ent.celCatalogNumber, ent.celCatalogNumber);
-        if (in.fail())
-        {
-            fmt::fprintf(cerr, _("Loading cross index failed at record %u\n"), record);
-            delete xindex;
-            return false;
-        }
 
-        xindex->push_back(ent);
+bool StarDatabase::loadCrossIndex(const Catalog catalog, const fs::path& filename)
+{
+    if (static_cast<unsigned int>(catalog) >= crossIndexes.size())
+        return false;
 
-        record++;
+    CrossIndex* xindex = new CrossIndex();
+    if (!xindex->open(filename))
+    {
+        // The file may still be readable as a stream
+        delete xindex;
+        ifstream in(filename.string(), ios::in | ios::binary);
+        return in.good() && loadCrossIndex(catalog, in);
     }
 
-    sort(xindex->begin(), xindex->end());
-
+    delete crossIndexes[catalog];
     crossIndexes[catalog] = xindex;
 
     return true;
@@ -640,6 +710,9 @@ bool StarDatabase::loadBinary(istream& in)
             return false;
     }
 
+    // The stream contents can't be added to the octree cache key
+    octreeCacheKeyComplete = false;
+
     // Read the star count
     in.read((char *) &nStarsInFile, sizeof nStarsInFile);
     LE_TO_CPU_INT32(nStarsInFile, nStarsInFile);
@@ -698,10 +771,117 @@ bool StarDatabase::loadBinary(istream& in)
     DPRINTF(LOG_LEVEL_ERROR, "StarDatabase::read: nStars = %d\n", nStarsInFile);
     fmt::fprintf(clog, _("%d stars in binary database\n"), nStars);
 
-    // Create the temporary list of stars sorted by catalog number; this
-    // will be used to lookup stars during file loading. After loading is
-    // complete, the stars are sorted into an octree and this list gets
-    // replaced.
+    buildBinFileIndex();
+
+    return true;
+}
+
+
+/*! Load the binary star database through a read-only memory mapping of
+ *  the file. The header is validated once, after which the fixed size
+ *  records are decoded directly from the mapping. If the file can't be
+ *  mapped, fall back to reading it as a stream.
+ */
+bool StarDatabase::loadBinary(const fs::path& filename)
+{
+    MappedFile file(filename);
+    if (file.isOpen())
+    {
+        octreeCacheKey.add(file.data(), file.size());
+        return loadBinary(file.data(), file.size());
+    }
+
+    ifstream in(filename.string(), ios::in | ios::binary);
+    if (!in.good())
+        return false;
+    return loadBinary(in);
+}
+
+
+bool StarDatabase::loadBinary(const char* data, size_t size)
+{
+    size_t headerLength = strlen(FILE_HEADER);
+    size_t dataOffset   = headerLength + sizeof(uint16_t) + sizeof(uint32_t);
+    if (size < dataOffset || strncmp(data, FILE_HEADER, headerLength) != 0)
+        return false;
+
+    uint16_t version;
+    memcpy(&version, data + headerLength, sizeof version);
+    LE_TO_CPU_INT16(version, version);
+    if (version != 0x0100)
+        return false;
+
+    uint32_t nStarsInFile;
+    memcpy(&nStarsInFile, data + headerLength + sizeof version, sizeof nStarsInFile);
+    LE_TO_CPU_INT32(nStarsInFile, nStarsInFile);
+
+    // A truncated file is an error; the stream reader has the same
+    // behavior, but only finds out after decoding all of the
+    // preceding records.
+    if ((size - dataOffset) / sizeof(BinaryStarRecord) < nStarsInFile)
+        return false;
+
+    // Most stars share one of a few hundred spectral types, so cache the
+    // details lookup by packed type instead of unpacking every record.
+    vector<StarDetails*> detailsCache(0x10000, nullptr);
+
+    const char* record = data + dataOffset;
+    for (uint32_t i = 0; i < nStarsInFile; i++, record += sizeof(BinaryStarRecord))
+    {
+        // The mapping carries no alignment guarantee for the records, so
+        // copy them out instead of casting the pointer; on little endian
+        // hosts the byte order conversions below are no-ops.
+        BinaryStarRecord rec;
+        memcpy(&rec, record, sizeof rec);
+#if defined(WORDS_BIGENDIAN) || defined(__BIG_ENDIAN__)
+        LE_TO_CPU_INT32(rec.catNo, rec.catNo);
+        LE_TO_CPU_FLOAT(rec.x, rec.x);
+        LE_TO_CPU_FLOAT(rec.y, rec.y);
+        LE_TO_CPU_FLOAT(rec.z, rec.z);
+        LE_TO_CPU_INT16(rec.absMag, rec.absMag);
+        LE_TO_CPU_INT16(rec.spectralType, rec.spectralType);
+#endif
+
+        StarDetails* details = detailsCache[rec.spectralType];
+        if (details == nullptr)
+        {
+            StellarClass sc;
+            if (sc.unpack(rec.spectralType))
+                details = StarDetails::GetStarDetails(sc);
+
+            if (details == nullptr)
+            {
+                fmt::fprintf(cerr, _("Bad spectral type in star database, star #%u\n"), nStars);
+                return false;
+            }
+            detailsCache[rec.spectralType] = details;
+        }
+
+        Star star;
+        star.setPosition(rec.x, rec.y, rec.z);
+        star.setAbsoluteMagnitude((float) rec.absMag / 256.0f);
+        star.setDetails(details);
+        star.setIndex(rec.catNo);
+        unsortedStars.add(star);
+
+        nStars++;
+    }
+
+    DPRINTF(LOG_LEVEL_ERROR, "StarDatabase::read: nStars = %d\n", nStarsInFile);
+    fmt::fprintf(clog, _("%d stars in binary database\n"), nStars);
+
+    buildBinFileIndex();
+
+    return true;
+}
+
+
+// Create the temporary list of stars sorted by catalog number; this
+// will be used to lookup stars during file loading. After loading is
+// complete, the stars are sorted into an octree and this list gets
+// replaced.
+void StarDatabase::buildBinFileIndex()
+{
     if (unsortedStars.size() > 0)
     {
         binFileStarCount = unsortedStars.size();
@@ -713,8 +893,24 @@ bool StarDatabase::loadBinary(istream& in)
         sort(binFileCatalogNumberIndex, binFileCatalogNumberIndex + binFileStarCount,
              PtrCatalogNumberOrderingPredicate());
     }
+}
 
-    return true;
+
+void StarDatabase::setOctreeCacheFile(const fs::path& filename)
+{
+    octreeCacheFile = filename;
+}
+
+
+void StarDatabase::addToCacheKey(const fs::path& filename)
+{
+    octreeCacheKey.addFile(filename);
+}
+
+
+void StarDatabase::setThreadPool(ThreadPool* pool)
+{
+    threadPool = pool;
 }
 
 
@@ -722,13 +918,23 @@ void StarDatabase::finish()
 {
     fmt::fprintf(clog, _("Total star count: %d\n"), nStars);
 
-    buildOctree();
-    buildIndexes();
+    bool useCache = !octreeCacheFile.empty() && octreeCacheKeyComplete;
+    if (!useCache || !loadOctreeCache())
+    {
+        buildOctree();
+        buildIndexes();
+        if (useCache)
+            saveOctreeCache();
+    }
 
     // Delete the temporary indices used only during loading
     delete[] binFileCatalogNumberIndex;
     stcFileCatalogNumberIndex.clear();
 
+    // All names are loaded by now
+    if (namesDB != nullptr)
+        namesDB->buildIndexes();
+
     // Resolve all barycenters; this can't be done before star sorting. There's
     // still a bug here: final orbital radii aren't available until after
     // the barycenters have been resolved, and these are required when building
@@ -1381,20 +1587,18 @@ void StarDatabase::buildOctree()
     DPRINTF(LOG_LEVEL_INFO, "Sorting stars into octree . . .\n");
     float absMag = astro::appToAbsMag(STAR_OCTREE_MAGNITUDE,
                                       STAR_OCTREE_ROOT_SIZE * (float) sqrt(3.0));
-    DynamicStarOctree* root = new DynamicStarOctree(Vector3f(1000.0f, 1000.0f, 1000.0f),
-                                                    absMag);
-    for (unsigned int i = 0; i < unsortedStars.size(); ++i)
-    {
-        root->insertObject(unsortedStars[i], STAR_OCTREE_ROOT_SIZE);
-    }
-
-    DPRINTF(LOG_LEVEL_INFO, "Spatially sorting stars for improved locality of reference . . .\n");
-    Star* sortedStars    = new Star[nStars];
-    Star* firstStar      = sortedStars;
-    root->rebuildAndSort(octreeRoot, firstStar);
-
-    // ASSERT((int) (firstStar - sortedStars) == nStars);
-    DPRINTF(LOG_LEVEL_INFO, "%d stars total\n", (int) (firstStar - sortedStars));
+    // The stars are sorted spatially for improved locality of reference
+    // while the octree is built.
+    Star* sortedStars    = new Star[unsortedStars.size()];
+    octreeRoot = DynamicStarOctree::build(Vector3f(1000.0f, 1000.0f, 1000.0f),
+                                          absMag,
+                                          STAR_OCTREE_ROOT_SIZE,
+                                          unsortedStars,
+                                          (uint32_t) unsortedStars.size(),
+                                          sortedStars,
+                                          threadPool);
+
+    DPRINTF(LOG_LEVEL_INFO, "%d stars total\n", (int) unsortedStars.size());
     DPRINTF(LOG_LEVEL_INFO, "Octree has %d nodes and %d stars.\n",
             1 + octreeRoot->countChildren(), octreeRoot->countObjects());
 #ifdef PROFILE_OCTREE
@@ -1416,7 +1620,6 @@ void StarDatabase::buildOctree()
     // Clean up . . .
     //delete[] stars;
     unsortedStars.clear();
-    delete root;
 
     stars = sortedStars;
 }
@@ -1437,6 +1640,102 @@ void StarDatabase::buildIndexes()
 }
 
 
+/*! Restore the sorted star array, the octree and the catalog number index
+ *  from the octree cache instead of building them. The cache records the
+ *  sorted position of every star in catalog number order, and the load
+ *  time indexes already provide the loaded stars in that order, so this
+ *  is a linear pass over the stars without any octree insertion or
+ *  sorting.
+ */
+bool StarDatabase::loadOctreeCache()
+{
+    // Merge the binary and stc file indexes into a single list of the
+    // loaded stars ordered by catalog number.
+    vector<Star*> byCatalogNumber;
+    byCatalogNumber.reserve(nStars);
+    auto stcIter = stcFileCatalogNumberIndex.begin();
+    for (unsigned int i = 0; i < binFileStarCount; i++)
+    {
+        Star* binStar = binFileCatalogNumberIndex[i];
+        for (; stcIter != stcFileCatalogNumberIndex.end() && stcIter->first < binStar->getIndex(); ++stcIter)
+            byCatalogNumber.push_back(stcIter->second);
+        byCatalogNumber.push_back(binStar);
+    }
+    for (; stcIter != stcFileCatalogNumberIndex.end(); ++stcIter)
+        byCatalogNumber.push_back(stcIter->second);
+
+    // Catalog numbers must be unique for the cached order to be
+    // unambiguous.
+    if (byCatalogNumber.size() != (size_t) nStars)
+        return false;
+    for (size_t i = 1; i < byCatalogNumber.size(); i++)
+    {
+        if (byCatalogNumber[i - 1]->getIndex() >= byCatalogNumber[i]->getIndex())
+            return false;
+    }
+
+    StarOctreeCache cache;
+    if (!cache.open(octreeCacheFile, octreeCacheKey.value(), nStars))
+        return false;
+
+    DPRINTF(LOG_LEVEL_INFO, "Loading star octree from cache . . .\n");
+
+    Star* sortedStars = new Star[nStars];
+    Star** sortedIndex = new Star*[nStars];
+    vector<bool> filled(nStars, false);
+    const uint32_t* positions = cache.sortedPositions();
+    for (int i = 0; i < nStars; i++)
+    {
+        uint32_t pos = positions[i];
+        if (pos >= (uint32_t) nStars || filled[pos])
+        {
+            delete[] sortedStars;
+            delete[] sortedIndex;
+            return false;
+        }
+        filled[pos] = true;
+        sortedStars[pos] = *byCatalogNumber[i];
+        sortedIndex[i] = &sortedStars[pos];
+    }
+
+    StarOctree* root = StarOctree::unpack(cache.nodes(), cache.nodeCount(), sortedStars, nStars);
+    if (root == nullptr)
+    {
+        delete[] sortedStars;
+        delete[] sortedIndex;
+        return false;
+    }
+
+    unsortedStars.clear();
+    stars = sortedStars;
+    catalogNumberIndex = sortedIndex;
+    octreeRoot = root;
+
+    fmt::fprintf(clog, _("Loaded star octree from cache %s\n"), octreeCacheFile.string());
+
+    return true;
+}
+
+
+void StarDatabase::saveOctreeCache() const
+{
+    vector<uint32_t> positions(nStars);
+    for (int i = 0; i < nStars; i++)
+    {
+        // Stars with duplicate catalog numbers can't be cached
+        if (i > 0 && catalogNumberIndex[i - 1]->getIndex() == catalogNumberIndex[i]->getIndex())
+            return;
+        positions[i] = (uint32_t) (catalogNumberIndex[i] - stars);
+    }
+
+    vector<StarOctreeCache::PackedNode> nodes;
+    octreeRoot->pack(nodes);
+
+    if (!StarOctreeCache::write(octreeCacheFile, octreeCacheKey.value(), positions, nodes))
+        fmt::fprintf(cerr, _("Error writing star octree cache %s\n"), octreeCacheFile.string());
+}
+
+
 /*! While loading the star catalogs, this function must be called instead of
  *  find(). The final catalog number index for stars cannot be built until
  *  after all stars have been loaded. During catalog loading, there are two
@@ -12,13 +12,17 @@
 #define _CELENGINE_STARDB_H_
 
 #include <iostream>
+#include <memory>
 #include <vector>
 #include <map>
 #include <celutil/blockarray.h>
 #include <celengine/constellation.h>
+#include <celengine/crossindex.h>
 #include <celengine/starname.h>
 #include <celengine/star.h>
 #include <celengine/staroctree.h>
+#include <celengine/staroctreecache.h>
+#include <celengine/pagedstarcatalog.h>
 #include <celengine/parseobject.h>
 
 
@@ -39,7 +43,7 @@ class StarDatabase
     Star* find(const std::string&) const;
     AstroCatalog::IndexNumber findCatalogNumberByName(const std::string&) const;
 
-    std::vector<std::string> getCompletion(const std::string&) const;
+    std::vector<std::string> getCompletion(const std::string&, size_t limit = 0) const;
 
     void findVisibleStars(StarHandler& starHandler,
                           const Eigen::Vector3f& obsPosition,
@@ -53,6 +57,30 @@ class StarDatabase
                         const Eigen::Vector3f& obsPosition,
                         float radius) const;
 
+    // The stars brighter than limitingMag within the cone of the handler
+    // around the ray from obsPosition along direction, in order of their
+    // angle to the ray; see StarOctree::processConeObjects(). The stars
+    // of the octree and of a paged catalog are searched one after the
+    // other.
+    void findStarsInCone(StarConeHandler& starHandler,
+                         const Eigen::Vector3f& obsPosition,
+                         const Eigen::Vector3f& direction,
+                         float limitingMag,
+                         OctreeProcStats * = nullptr) const;
+
+    // The n stars nearest to obsPosition, apparently brightest as seen
+    // from there, or with the brightest absolute magnitude, best first.
+    // Stars that compare equal are in database order. Stars of a paged
+    // catalog aren't included.
+    void findNearestStars(const Eigen::Vector3f& obsPosition,
+                          unsigned int n,
+                          std::vector<const Star*>& stars) const;
+    void findBrightestStars(const Eigen::Vector3f& obsPosition,
+                            unsigned int n,
+                            std::vector<const Star*>& stars) const;
+    void findMostLuminousStars(unsigned int n,
+                               std::vector<const Star*>& stars) const;
+
     std::string getStarName    (const Star&, bool i18n = false) const;
     void getStarName(const Star& star, char* nameBuffer, unsigned int bufferSize, bool i18n = false) const;
     std::string getStarNameList(const Star&, const unsigned int maxNames = MAX_STAR_NAMES) const;
@@ -62,6 +90,7 @@ class StarDatabase
 
     bool load(std::istream&, const fs::path& resourcePath = fs::path());
     bool loadBinary(std::istream&);
+    bool loadBinary(const fs::path&);
 
     enum Catalog
     {
@@ -75,21 +104,37 @@ class StarDatabase
     // a HIPPARCOS stars.
     static const AstroCatalog::IndexNumber MAX_HIPPARCOS_NUMBER = 999999;
 
-    struct CrossIndexEntry
-    {
-        AstroCatalog::IndexNumber catalogNumber;
-        AstroCatalog::IndexNumber celCatalogNumber;
-
-        bool operator<(const CrossIndexEntry&) const;
-    };
-
-    typedef std::vector<CrossIndexEntry> CrossIndex;
-
     bool   loadCrossIndex  (const Catalog, std::istream&);
+    // Cross indexes written by makexindex are searched directly in the
+    // memory mapped file.
+    bool   loadCrossIndex  (const Catalog, const fs::path&);
     AstroCatalog::IndexNumber searchCrossIndexForCatalogNumber(const Catalog, const AstroCatalog::IndexNumber number) const;
     Star*  searchCrossIndex(const Catalog, const AstroCatalog::IndexNumber number) const;
     AstroCatalog::IndexNumber crossIndex(const Catalog, const AstroCatalog::IndexNumber number) const;
 
+    // The built star octree may be cached on disk and reused as long as
+    // none of the catalog files change. Every file that contributes stars
+    // has to be added to the cache key in load order; stars.dat is added
+    // automatically when loaded by filename.
+    void setOctreeCacheFile(const fs::path&);
+    void addToCacheKey(const fs::path&);
+
+    // Threads which may be used to build the octree and find visible
+    // stars; not owned by the star database.
+    void setThreadPool(ThreadPool*);
+
+    // A paged catalog adds stars which are kept on disk and only decoded
+    // while a traversal reaches their octree nodes. They're found by
+    // findVisibleStars(), findCloseStars() and findStarsInCone(), but not
+    // by name or catalog number. The stars it finds are valid until the
+    // next call to nextFrame(), which the renderer makes once per frame;
+    // getStableStar() returns a copy of a paged star that stays valid, and
+    // any other star unchanged.
+    bool loadPagedCatalog(const fs::path&, size_t memoryBudget);
+    const PagedStarCatalog* getPagedCatalog() const;
+    void nextFrame() const;
+    const Star* getStableStar(const Star*) const;
+
     void finish();
 
     static StarDatabase* read(std::istream&);
@@ -102,8 +147,12 @@ private:
                     const fs::path& path,
                     const bool isBarycenter);
 
+    bool loadBinary(const char* data, size_t size);
+    void buildBinFileIndex();
     void buildOctree();
     void buildIndexes();
+    bool loadOctreeCache();
+    void saveOctreeCache() const;
     Star* findWhileLoading(AstroCatalog::IndexNumber catalogNumber) const;
 
     int nStars{ 0 };
@@ -112,10 +161,17 @@ private:
     StarNameDatabase* namesDB{ nullptr };
     Star**            catalogNumberIndex{ nullptr };
     StarOctree*       octreeRoot{ nullptr };
+    ThreadPool*       threadPool{ nullptr };
+    std::unique_ptr<PagedStarCatalog> pagedCatalog;
     AstroCatalog::IndexNumber nextAutoCatalogNumber{ 0xfffffffe };
 
     std::vector<CrossIndex*> crossIndexes;
 
+    fs::path octreeCacheFile;
+    StarOctreeCacheKey octreeCacheKey;
+    // False if stars were loaded from a source that isn't part of the key
+    bool octreeCacheKeyComplete{ true };
+
     // These values are used by the star database loader; they are
     // not used after loading is complete.
     BlockArray<Star> unsortedStars;
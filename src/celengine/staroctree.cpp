@@ -10,6 +10,11 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <celutil/threadpool.h>
 #include <celengine/staroctree.h>
 
 using namespace Eigen;
@@ -24,6 +29,10 @@ using namespace Eigen;
 // render stars with orbits that are closer than MAX_STAR_ORBIT_RADIUS.
 static const float MAX_STAR_ORBIT_RADIUS = 1.0f;
 
+// Number of parts the traversal is split into per thread when a thread
+// pool is used.
+static const unsigned int PARTS_PER_THREAD = 4;
+
 
 // The octree node into which a star is placed is dependent on two properties:
 // its obsPosition and its luminosity--the fainter the star, the deeper the node
@@ -57,8 +66,7 @@ float starAbsoluteMagnitudeDecayFunction(const float excludingFactor)
 
 
 template<>
-DynamicStarOctree* DynamicStarOctree::getChild(const Star&          obj,
-                                               const Vector3f& cellCenterPos)
+int DynamicStarOctree::childIndex(const Star& obj, const Vector3f& cellCenterPos)
 {
     Vector3f objPos    = obj.getPosition();
 
@@ -67,7 +75,7 @@ DynamicStarOctree* DynamicStarOctree::getChild(const Star&          obj,
     child     |= objPos.y() < cellCenterPos.y() ? 0 : YPos;
     child     |= objPos.z() < cellCenterPos.z() ? 0 : ZPos;
 
-    return _children[child];
+    return child;
 }
 
 
@@ -83,85 +91,329 @@ template<> DynamicStarOctree::ExclusionFactorDecayFunction*
            DynamicStarOctree::decayFunction = starAbsoluteMagnitudeDecayFunction;
 
 
-// total specialization of the StaticOctree template process*() methods for stars:
-template<>
-void StarOctree::processVisibleObjects(StarHandler&    processor,
-                                       const Vector3f& obsPosition,
-                                       const Hyperplane<float, 3>*   frustumPlanes,
-                                       float           limitingFactor,
-                                       float           scale,
-                                       OctreeProcStats *stats) const
+namespace
 {
-#ifdef OCTREE_DEBUG
-    size_t h;
-    if (stats != nullptr)
+// Collects the stars found by a traversal. If there's a processor, the
+// stars are passed on to it in batches; otherwise they're kept until
+// flushTo() is called.
+class StarBatch
+{
+ public:
+    explicit StarBatch(StarHandler* processor = nullptr) : processor(processor)
     {
-        h = stats->height + 1;
-        stats->nodes++;
+        stars.reserve(BATCH_SIZE);
+        distances.reserve(BATCH_SIZE);
+        appMags.reserve(BATCH_SIZE);
+    }
+
+    void add(const Star& star, float distance, float appMag)
+    {
+        stars.push_back(&star);
+        distances.push_back(distance);
+        appMags.push_back(appMag);
+        if (processor != nullptr && stars.size() == BATCH_SIZE)
+            flush();
     }
-#endif
-    // See if this node lies within the view frustum
 
-    // Test the cubic octree node against each one of the five
-    // planes that define the infinite view frustum.
-    for (unsigned int i = 0; i < 5; ++i)
+    void flush()
     {
-        const Hyperplane<float, 3>& plane = frustumPlanes[i];
-        float r = scale * plane.normal().cwiseAbs().sum();
-        if (plane.signedDistance(cellCenterPos) < -r)
+        flushTo(*processor);
+    }
+
+    void flushTo(StarHandler& handler)
+    {
+        if (stars.empty())
             return;
+
+        handler.processBatch(stars, distances, appMags);
+        stars.clear();
+        distances.clear();
+        appMags.clear();
     }
 
-    // Compute the distance to node; this is equal to the distance to
-    // the cellCenterPos of the node minus the boundingRadius of the node, scale * SQRT3.
-    float minDistance = (obsPosition - cellCenterPos).norm() - scale * StarOctree::SQRT3;
+ private:
+    static constexpr const size_t BATCH_SIZE = 256;
 
-    // Process the objects in this node
-    float dimmest     = minDistance > 0 ? astro::appToAbsMag(limitingFactor, minDistance) : 1000;
+    StarHandler* processor;
+    std::vector<const Star*> stars;
+    std::vector<float> distances;
+    std::vector<float> appMags;
+};
 
-    for (unsigned int i=0; i<nObjects; ++i)
+constexpr const size_t StarBatch::BATCH_SIZE;
+}
+
+
+// The visibility test for single stars is done on blocks of stars at once,
+// using the compact culling data: positions quantized relative to the
+// bounds of their node, and absolute magnitudes in steps of 1/256, as in
+// stars.dat. The apparent magnitude test is rewritten as
+//
+//   appMag < limitingMag  <=>  log2(distance^2) < L - 0.4 * log2(10) * absMag
+//
+// with L = log2((10 pc)^2) + 0.4 * log2(10) * limitingMag, which is linear
+// in the stored magnitude; a lower bound of the logarithm is read off the
+// bits of the float instead of computing it. The test is widened by the
+// quantization errors, so it only preselects candidates for the exact
+// test on the stars themselves. Nodes with stars that have orbits, which
+// pass when close enough regardless of their magnitude, are flagged by a
+// negative error.
+void quantizeStars(const Star* stars, uint32_t nStars,
+                   uint16_t* x, uint16_t* y, uint16_t* z, int16_t* magnitude,
+                   StarOctree::ObjectBounds& bounds)
+{
+    Vector3f lower = Vector3f::Constant(std::numeric_limits<float>::max());
+    Vector3f upper = -lower;
+    bool hasOrbits = false;
+    for (uint32_t i = 0; i < nStars; ++i)
+    {
+        lower = lower.cwiseMin(stars[i].getPosition());
+        upper = upper.cwiseMax(stars[i].getPosition());
+        hasOrbits |= stars[i].getOrbit() != nullptr;
+    }
+
+    if (nStars == 0)
+        lower = upper = Vector3f::Zero();
+
+    float step = std::max((upper - lower).maxCoeff() / 65535.0f, std::numeric_limits<float>::min());
+    float error = std::numeric_limits<float>::min();
+    for (uint32_t i = 0; i < nStars; ++i)
+    {
+        Vector3f pos = stars[i].getPosition();
+        Vector3f q = ((pos - lower) / step).array().round().max(0.0f).min(65535.0f);
+        x[i] = (uint16_t) q.x();
+        y[i] = (uint16_t) q.y();
+        z[i] = (uint16_t) q.z();
+        error = std::max(error, (q * step + lower - pos).norm());
+
+        float mag = std::round(stars[i].getAbsoluteMagnitude() * 256.0f);
+        magnitude[i] = (int16_t) std::max(-32768.0f, std::min(mag, 32767.0f));
+    }
+
+    bounds.origin[0] = lower.x();
+    bounds.origin[1] = lower.y();
+    bounds.origin[2] = lower.z();
+    bounds.step      = step;
+    bounds.error     = hasOrbits ? -error : error;
+}
+
+
+template<>
+void StarOctree::buildObjectData()
+{
+    // Paged octrees get the data of each page from their pager
+    if (objects == nullptr)
+        return;
+
+    size_t paddedSize = (nObjects + OBJECT_BLOCK - 1) / OBJECT_BLOCK * OBJECT_BLOCK + OBJECT_BLOCK;
+    objectX.assign(paddedSize, 0);
+    objectY.assign(paddedSize, 0);
+    objectZ.assign(paddedSize, 0);
+    objectMagnitude.assign(paddedSize, 0);
+    objectBounds.resize(centerX.size());
+
+    for (uint32_t node = 0; node < centerX.size(); ++node)
+    {
+        uint32_t first = firstObject[node];
+        quantizeStars(objects + first, objectCounts[node],
+                      &objectX[first], &objectY[first], &objectZ[first], &objectMagnitude[first],
+                      objectBounds[node]);
+    }
+}
+
+
+// total specialization of the StaticOctree template process*() methods for stars:
+template<>
+void StarOctree::processVisibleObjects(StarHandler&    processor,
+                                       const Vector3f& obsPosition,
+                                       const Hyperplane<float, 3>*   frustumPlanes,
+                                       float           limitingFactor,
+                                       float           scale,
+                                       OctreeProcStats *stats,
+                                       ThreadPool      *threadPool) const
+{
+    // Tests the stars of single nodes and adds those that pass to a batch.
+    // A traversal split up between threads needs one per thread.
+    struct NodeCuller
     {
+        typedef Eigen::Array<float, OBJECT_BLOCK, 1> Block;
+        typedef Eigen::Array<int32_t, OBJECT_BLOCK, 1> IntBlock;
+        typedef Eigen::Array<uint16_t, OBJECT_BLOCK, 1> PositionBlock;
+        typedef Eigen::Array<int16_t, OBJECT_BLOCK, 1> MagnitudeBlock;
+
+        // The block test only preselects candidates; the thresholds are
+        // slightly widened so that rounding never rejects a star which
+        // passes the exact test applied to the candidates.
+        static constexpr float margin() { return 1.0e-4f; }
+
+        NodeCuller(const StarOctree& tree, const Vector3f& obsPosition, float limitingFactor,
+                   StarBatch& batch, OctreeProcStats* stats) :
+            tree(tree),
+            obsPosition(obsPosition),
+            limitingFactor(limitingFactor),
+            batch(batch),
+            stats(stats)
+        {
+            // Magnitudes are rounded to 1/256, so allow for stars up to
+            // that much brighter than their stored magnitude.
+            const double tenParsecs = 10.0 * LY_PER_PARSEC;
+            const double log2Of10   = std::log2(10.0);
+            log2Limit       = (float) (2.0 * std::log2(tenParsecs) + 0.4 * log2Of10 * (limitingFactor + 1.0 / 256.0)) + margin();
+            magnitudeFactor = (float) (0.4 * log2Of10 / 256.0);
+            orbitRadius2    = MAX_STAR_ORBIT_RADIUS * MAX_STAR_ORBIT_RADIUS * (1.0f + margin());
+        }
+
+        // A lower bound of log2(x) for x > 0, obtained from the bits of
+        // the float, which are a piecewise linear approximation of it.
+        static Block log2Bound(const Block& x)
+        {
+            IntBlock bits;
+            std::memcpy(bits.data(), x.data(), sizeof(bits));
+            return bits.cast<float>() * (1.0f / 8388608.0f) - 127.0f;
+        }
+
+        void operator()(uint32_t node, float minDistance)
+        {
+            uint32_t nNodeObjects = tree.objectCounts[node];
 #ifdef OCTREE_DEBUG
-        if (stats != nullptr)
-            stats->objects++;
+            if (stats != nullptr)
+                stats->objects += nNodeObjects;
 #endif
-        const Star& obj = _firstObject[i];
+            if (nNodeObjects == 0)
+                return;
+
+            // Process the objects in this node
+            float dimmest = minDistance > 0 ? astro::appToAbsMag(limitingFactor, minDistance) : 1000;
+            float maxMagnitude = dimmest * 256.0f + 1.0f;
+
+            if (candidates.size() < nNodeObjects)
+                candidates.resize(nNodeObjects);
+
+            // Only fetched once the node is known to have stars, as this
+            // may page them in.
+            NodeObjects nodeStars = tree.nodeObjects(node);
+            const ObjectBounds& bounds = nodeStars.bounds;
+
+            // Besides the quantization error, allow for rounding in the
+            // distances computed here and by the exact test. Since no star
+            // is further than maxDistance, the squared distance to a star
+            // is at least distance2 - 2 * maxDistance * error.
+            Vector3f lower(bounds.origin[0], bounds.origin[1], bounds.origin[2]);
+            Vector3f upper = lower + Vector3f::Constant(65535.0f * bounds.step);
+            float coordMax = std::max(lower.cwiseAbs().cwiseMax(upper.cwiseAbs()).maxCoeff(),
+                                      obsPosition.cwiseAbs().maxCoeff());
+            float error = std::abs(bounds.error) + 8.0f * std::numeric_limits<float>::epsilon() * coordMax;
+            float maxDistance = (obsPosition - lower).cwiseAbs().cwiseMax((obsPosition - upper).cwiseAbs()).norm() + error;
+            float distanceSlack = 2.0f * maxDistance * error;
+            bool hasOrbits = bounds.error < 0.0f;
+            Vector3f offset = lower - obsPosition;
+
+            // Compact the indices of the stars that pass into candidates
+            uint32_t nCandidates = 0;
+            for (uint32_t i = 0; i < nNodeObjects; i += OBJECT_BLOCK)
+            {
+                // Most blocks of faint stars fail on their magnitudes alone
+                Block magnitude = Map<const MagnitudeBlock>(nodeStars.magnitude + i).cast<float>();
+                Eigen::Array<bool, OBJECT_BLOCK, 1> bright = magnitude < maxMagnitude;
+                if (!bright.any())
+                    continue;
+
+                Block dx = Map<const PositionBlock>(nodeStars.x + i).cast<float>() * bounds.step + offset.x();
+                Block dy = Map<const PositionBlock>(nodeStars.y + i).cast<float>() * bounds.step + offset.y();
+                Block dz = Map<const PositionBlock>(nodeStars.z + i).cast<float>() * bounds.step + offset.z();
+                Block distance2 = (dx.square() + dy.square() + dz.square()) * (1.0f - margin()) - distanceSlack;
+                distance2 = distance2.max(std::numeric_limits<float>::min());
+
+                Eigen::Array<bool, OBJECT_BLOCK, 1> pass = log2Bound(distance2) < log2Limit - magnitude * magnitudeFactor;
+                if (hasOrbits)
+                    pass = pass || distance2 < orbitRadius2;
+                pass = pass && bright;
+
+                uint32_t nLanes = std::min((uint32_t) OBJECT_BLOCK, nNodeObjects - i);
+                for (uint32_t j = 0; j < nLanes; ++j)
+                {
+                    candidates[nCandidates] = i + j;
+                    nCandidates += pass[j] ? 1 : 0;
+                }
+            }
 
-        if (obj.getAbsoluteMagnitude() < dimmest)
-        {
-            float distance    = (obsPosition - obj.getPosition()).norm();
-            float appMag      = astro::absToAppMag(obj.getAbsoluteMagnitude(), distance);
+            for (uint32_t i = 0; i < nCandidates; ++i)
+            {
+                const Star& obj = nodeStars.objects[candidates[i]];
 
-            if (appMag < limitingFactor || (distance < MAX_STAR_ORBIT_RADIUS && obj.getOrbit()))
-                processor.process(obj, distance, appMag);
+                if (obj.getAbsoluteMagnitude() < dimmest)
+                {
+                    float distance    = (obsPosition - obj.getPosition()).norm();
+                    float appMag      = astro::absToAppMag(obj.getAbsoluteMagnitude(), distance);
+
+                    if (appMag < limitingFactor || (distance < MAX_STAR_ORBIT_RADIUS && obj.getOrbit()))
+                        batch.add(obj, distance, appMag);
+                }
+            }
         }
+
+        const StarOctree&     tree;
+        const Vector3f&       obsPosition;
+        float                 limitingFactor;
+        float                 log2Limit;
+        float                 magnitudeFactor;
+        float                 orbitRadius2;
+        StarBatch&            batch;
+        OctreeProcStats*      stats;
+        std::vector<uint32_t> candidates;
+    };
+
+    if (threadPool == nullptr || threadPool->threadCount() < 2)
+    {
+        StarBatch batch(&processor);
+        NodeCuller culler(*this, obsPosition, limitingFactor, batch, stats);
+        traverseVisibleNodes(obsPosition, frustumPlanes, limitingFactor, scale, culler, stats);
+        batch.flush();
+        return;
     }
 
-    // See if any of the objects in child nodes are potentially included
-    // that we need to recurse deeper.
-    if (minDistance <= 0 || astro::absToAppMag(exclusionFactor, minDistance) <= limitingFactor)
+    // Split the traversal into a few parts per thread, so that threads
+    // finishing early can steal work from the others.
+    std::vector<TraversalPart> parts;
+    splitVisibleTraversal(obsPosition, frustumPlanes, limitingFactor, scale,
+                          PARTS_PER_THREAD * threadPool->threadCount(), parts);
+
+    std::vector<StarBatch> results(parts.size());
+    std::vector<OctreeProcStats> partStats(parts.size());
+    threadPool->parallelFor(parts.size(), [&](size_t i)
     {
-        // Recurse into the child nodes
-        if (_children != nullptr)
+        const TraversalPart& part = parts[i];
+        OctreeProcStats* pStats = stats != nullptr ? &partStats[i] : nullptr;
+        NodeCuller culler(*this, obsPosition, limitingFactor, results[i], pStats);
+        if (part.subtree)
+        {
+            traverseVisibleSubtree(part.entry, obsPosition, frustumPlanes, limitingFactor, culler, pStats);
+        }
+        else
         {
-            for (int i=0; i<8; ++i)
-            {
-                _children[i]->processVisibleObjects(processor,
-                                                    obsPosition,
-                                                    frustumPlanes,
-                                                    limitingFactor,
-                                                    scale * 0.5f,
-                                                    stats
-                                                   );
 #ifdef OCTREE_DEBUG
-                if (stats != nullptr && stats->height > h)
-                    h = stats->height;
-#endif
+            if (pStats != nullptr)
+            {
+                pStats->nodes++;
+                pStats->height = part.entry.depth + 1;
             }
-#ifdef OCTREE_DEBUG
-            if (stats != nullptr)
-                stats->height = h;
 #endif
+            culler(part.entry.node, part.entry.minDistance);
+        }
+    });
+
+    // The stars are passed on in traversal order, so that the processor
+    // sees exactly the same sequence of stars as without threads.
+    for (auto& result : results)
+        result.flushTo(processor);
+
+    if (stats != nullptr)
+    {
+        for (const auto& partStat : partStats)
+        {
+            stats->nodes   += partStat.nodes;
+            stats->objects += partStat.objects;
+            stats->height   = std::max(stats->height, partStat.height);
         }
     }
 }
@@ -173,43 +425,386 @@ void StarOctree::processCloseObjects(StarHandler&    processor,
                                      float           boundingRadius,
                                      float           scale) const
 {
-    // Compute the distance to node; this is equal to the distance to
-    // the cellCenterPos of the node minus the boundingRadius of the node, scale * SQRT3.
-    float nodeDistance    = (obsPosition - cellCenterPos).norm() - scale * StarOctree::SQRT3;
-
-    if (nodeDistance > boundingRadius)
-        return;
-
-    // At this point, we've determined that the cellCenterPos of the node is
-    // close enough that we must check individual objects for proximity.
-
     // Compute distance squared to avoid having to sqrt for distance
     // comparison.
     float radiusSquared    = boundingRadius * boundingRadius;
+    StarBatch batch(&processor);
 
-    // Check all the objects in the node.
-    for (unsigned int i = 0; i < nObjects; ++i)
+    auto visitor = [&](uint32_t node)
     {
-        Star& obj = _firstObject[i];
+        if (objectCounts[node] == 0)
+            return;
 
-        if ((obsPosition - obj.getPosition()).squaredNorm() < radiusSquared)
+        // Check all the objects in the node.
+        NodeObjects nodeStars = nodeObjects(node);
+        for (uint32_t i = 0; i < nodeStars.count; ++i)
         {
-            float distance    = (obsPosition - obj.getPosition()).norm();
-            float appMag      = astro::absToAppMag(obj.getAbsoluteMagnitude(), distance);
+            const Star& obj = nodeStars.objects[i];
 
-            processor.process(obj, distance, appMag);
+            if ((obsPosition - obj.getPosition()).squaredNorm() < radiusSquared)
+            {
+                float distance    = (obsPosition - obj.getPosition()).norm();
+                float appMag      = astro::absToAppMag(obj.getAbsoluteMagnitude(), distance);
+
+                batch.add(obj, distance, appMag);
+            }
         }
+    };
+
+    traverseCloseNodes(obsPosition, boundingRadius, scale, visitor);
+    batch.flush();
+}
+
+
+namespace
+{
+// Lower bound of the distance from obsPosition to any star in the cell of
+// a node, computed in the same way as the distances to the stars
+// themselves. It's lowered by more than the rounding errors of both, so
+// that it never exceeds the distance computed for a star in the cell.
+float cellDistanceBound(const Vector3f& obsPosition, const Vector3f& cellCenterPos, float scale)
+{
+    const float margin = 1.0e-4f;
+    const float sqrt3  = 1.732050807568877f;
+
+    float coordMax = std::max(obsPosition.cwiseAbs().maxCoeff(), cellCenterPos.cwiseAbs().maxCoeff() + scale);
+    float distance = (cellCenterPos - obsPosition).norm();
+    float bound    = distance * (1.0f - margin) - scale * sqrt3 - 8.0f * std::numeric_limits<float>::epsilon() * coordMax;
+
+    return std::max(bound, 0.0f);
+}
+}
+
+
+// The keys of the searches are the squared distance, the apparent
+// magnitude and the absolute magnitude of the stars. No star in the
+// subtree of a node is brighter than the exclusion factor of the node's
+// parent, and apparent magnitudes grow with the distance, so each key
+// has a lower bound for a whole subtree.
+template<>
+void StarOctree::findNearestObjects(const Vector3f&           obsPosition,
+                                    float                     scale,
+                                    unsigned int              nObjects,
+                                    std::vector<const Star*>& result,
+                                    OctreeProcStats*          stats) const
+{
+    struct NearestKey
+    {
+        float object(const Star& star) const
+        {
+            return (star.getPosition() - obsPosition).squaredNorm();
+        }
+
+        float node(const Vector3f& cellCenterPos, float scale, float /*parentExclusionFactor*/) const
+        {
+            float distance = cellDistanceBound(obsPosition, cellCenterPos, scale);
+            return distance * distance;
+        }
+
+        const Vector3f& obsPosition;
+    };
+
+    findBestObjects(NearestKey{ obsPosition }, scale, nObjects, result, stats);
+}
+
+
+template<>
+void StarOctree::findBrightestObjects(const Vector3f&           obsPosition,
+                                      float                     scale,
+                                      unsigned int              nObjects,
+                                      std::vector<const Star*>& result,
+                                      OctreeProcStats*          stats) const
+{
+    struct BrightestKey
+    {
+        float object(const Star& star) const
+        {
+            return star.getApparentMagnitude((star.getPosition() - obsPosition).norm());
+        }
+
+        float node(const Vector3f& cellCenterPos, float scale, float parentExclusionFactor) const
+        {
+            return astro::absToAppMag(parentExclusionFactor, cellDistanceBound(obsPosition, cellCenterPos, scale));
+        }
+
+        const Vector3f& obsPosition;
+    };
+
+    findBestObjects(BrightestKey{ obsPosition }, scale, nObjects, result, stats);
+}
+
+
+template<>
+void StarOctree::findMostLuminousObjects(float                     scale,
+                                         unsigned int              nObjects,
+                                         std::vector<const Star*>& result,
+                                         OctreeProcStats*          stats) const
+{
+    struct LuminousKey
+    {
+        float object(const Star& star) const
+        {
+            return star.getAbsoluteMagnitude();
+        }
+
+        float node(const Vector3f& /*cellCenterPos*/, float /*scale*/, float parentExclusionFactor) const
+        {
+            return parentExclusionFactor;
+        }
+    };
+
+    findBestObjects(LuminousKey(), scale, nObjects, result, stats);
+}
+
+
+namespace
+{
+// Lower bounds of the angle between a ray and the points within a radius
+// of a center. The bounds are the tangents of the angles, which are
+// computed without any trigonometry, and infinite for angles of 90
+// degrees or more. For a sphere seen at an angular radius d with its
+// center at an angle c from the ray, the bound is tan(c - d). Spheres are
+// widened by more than the rounding errors in single precision positions,
+// and the bounds lowered by more than those of the angles computed for
+// stars by pickers, so that they never exceed either.
+//
+// The cone of maxAngle around the ray is also given as the five planes of
+// the pyramid enclosing it, in the form of a view frustum, for culling
+// octree nodes.
+class ConeBound
+{
+ public:
+    ConeBound(const Vector3f& obsPosition, const Vector3f& direction) :
+        obsPosition(obsPosition),
+        direction(direction)
+    {
+        Vector3f axis = std::abs(direction.x()) < 0.5f ? Vector3f::UnitX() : Vector3f::UnitY();
+        side[0] = direction.cross(axis).normalized();
+        side[1] = direction.cross(side[0]);
     }
 
-    // Recurse into the child nodes
-    if (_children != nullptr)
+    // Bounds above the tangent of maxAngle are rejected
+    void setMaxAngle(float angle, float planeMargin)
     {
-        for (int i = 0; i < 8; ++i)
+        if (angle == maxAngle)
+            return;
+        maxAngle = angle;
+        maxBound = angle < (float) (M_PI / 2) ? std::tan(angle) : std::numeric_limits<float>::infinity();
+
+        // Without a pyramid, planes which no node is outside of
+        if (angle + angleMargin >= (float) (M_PI / 2))
+        {
+            for (auto& plane : planes)
+                plane = Hyperplane<float, 3>(direction, std::numeric_limits<float>::infinity());
+            return;
+        }
+
+        float tangent = std::tan(angle + angleMargin);
+        for (unsigned int i = 0; i < 4; i++)
         {
-            _children[i]->processCloseObjects(processor,
-                                              obsPosition,
-                                              boundingRadius,
-                                              scale * 0.5f);
+            Vector3f normal = tangent * direction - (i % 2 == 0 ? 1.0f : -1.0f) * side[i / 2];
+            planes[i] = Hyperplane<float, 3>(normal.normalized(), obsPosition);
+        }
+        planes[4] = Hyperplane<float, 3>(direction, obsPosition);
+        for (auto& plane : planes)
+            plane.offset() += planeMargin;
+    }
+
+    const Hyperplane<float, 3>* pyramid() const
+    {
+        return planes;
+    }
+
+    // Returns false if all of the sphere is further than maxAngle from
+    // the ray
+    bool operator()(const Vector3f& center, float radius, float& bound) const
+    {
+        Vector3f toCenter = center - obsPosition;
+        float coordMax  = std::max(obsPosition.cwiseAbs().maxCoeff(), center.cwiseAbs().maxCoeff() + radius);
+        float distance2 = toCenter.squaredNorm();
+        radius = radius * (1.0f + margin) + 8.0f * std::numeric_limits<float>::epsilon() * coordMax;
+        if (distance2 <= radius * radius)
+        {
+            bound = 0.0f;
+            return true;
+        }
+
+        // Sine and cosine of c - d, times distance2
+        float along  = toCenter.dot(direction);
+        float across = toCenter.cross(direction).norm();
+        float tangentLength = std::sqrt(distance2 - radius * radius);
+        float sine   = across * tangentLength - along * radius;
+        float cosine = along * tangentLength + across * radius;
+        if (sine <= 0.0f)
+            bound = 0.0f;
+        else if (cosine <= 0.0f)
+            bound = std::numeric_limits<float>::infinity();
+        else
+            bound = std::max(sine / cosine * (1.0f - margin) - angleMargin, 0.0f);
+
+        return inside(bound);
+    }
+
+    bool inside(float bound) const
+    {
+        return bound <= maxBound;
+    }
+
+ private:
+    static constexpr const float margin      = 1.0e-4f;
+    static constexpr const float angleMargin = 1.0e-5f;
+
+    const Vector3f& obsPosition;
+    const Vector3f& direction;
+    Vector3f side[2];
+    Hyperplane<float, 3> planes[5];
+    float maxAngle{ -1.0f };
+    float maxBound{ 0.0f };
+};
+
+constexpr const float ConeBound::margin;
+constexpr const float ConeBound::angleMargin;
+}
+
+
+// Stars are found best first: the nodes still to be searched are kept in
+// a heap ordered by the angle bound of their cell, and the stars found in
+// the nodes searched in another, ordered by the angle bound of the star.
+// The tangents of the angles are compared, which are in the same order. A
+// star is only passed on once no node left can hold a star which comes
+// before it. The position used for a star with an orbit may be anywhere
+// within its orbital radius, so its bound is that of its orbit; the cells
+// are widened by MAX_STAR_ORBIT_RADIUS for the same reason, which is far
+// more than the rounding errors of the plane tests of cullChildren(). The
+// magnitude tests are the same as those of processVisibleObjects().
+template<>
+void StarOctree::processConeObjects(StarConeHandler&  processor,
+                                    const Vector3f&   obsPosition,
+                                    const Vector3f&   direction,
+                                    float             limitingFactor,
+                                    float             scale,
+                                    OctreeProcStats*  stats) const
+{
+    struct NodeEntry
+    {
+        float    bound;
+        uint32_t node;
+        uint32_t depth;
+        float    scale;
+        float    minDistance;
+    };
+    auto laterNode = [](const NodeEntry& a, const NodeEntry& b) { return a.bound > b.bound; };
+
+    struct Candidate
+    {
+        float       bound;
+        const Star* star;
+        float       distance;
+        float       appMag;
+    };
+    auto laterStar = [](const Candidate& a, const Candidate& b)
+    {
+        return a.bound > b.bound || (a.bound == b.bound && std::less<const Star*>()(b.star, a.star));
+    };
+
+    ConeBound coneBound(obsPosition, direction);
+    auto narrowCone = [&]() { coneBound.setMaxAngle(processor.maxAngle(), MAX_STAR_ORBIT_RADIUS); };
+
+    std::vector<NodeEntry> nodes;
+    nodes.reserve(64);
+    std::vector<Candidate> candidates;
+
+    narrowCone();
+    Vector3f rootCenter(centerX[0], centerY[0], centerZ[0]);
+    float rootBound;
+    if (coneBound(rootCenter, scale * SQRT3 + MAX_STAR_ORBIT_RADIUS, rootBound))
+        nodes.push_back({ rootBound, 0, 0, scale, (rootCenter - obsPosition).norm() - scale * SQRT3 });
+
+    for (;;)
+    {
+        while (!candidates.empty() && (nodes.empty() || candidates.front().bound < nodes.front().bound))
+        {
+            std::pop_heap(candidates.begin(), candidates.end(), laterStar);
+            Candidate candidate = candidates.back();
+            candidates.pop_back();
+            narrowCone();
+            if (!coneBound.inside(candidate.bound))
+                return;
+
+            processor.process(*candidate.star, candidate.distance, candidate.appMag);
+        }
+
+        if (nodes.empty())
+            break;
+
+        std::pop_heap(nodes.begin(), nodes.end(), laterNode);
+        NodeEntry entry = nodes.back();
+        nodes.pop_back();
+
+        // Neither this node nor any star found so far can be in the cone
+        narrowCone();
+        if (!coneBound.inside(entry.bound))
+            return;
+
+        if (stats != nullptr)
+        {
+            stats->nodes++;
+            stats->objects += objectCounts[entry.node];
+            stats->height = std::max(stats->height, (size_t) entry.depth + 1);
+        }
+
+        if (objectCounts[entry.node] != 0)
+        {
+            // The quantized magnitudes reject most faint stars without
+            // touching the stars themselves; they're rounded to 1/256.
+            float dimmest = entry.minDistance > 0 ? astro::appToAbsMag(limitingFactor, entry.minDistance) : 1000;
+            float maxMagnitude = dimmest * 256.0f + 1.0f;
+            NodeObjects nodeStars = nodeObjects(entry.node);
+            for (uint32_t i = 0; i < nodeStars.count; ++i)
+            {
+                if (nodeStars.magnitude != nullptr && nodeStars.magnitude[i] >= maxMagnitude)
+                    continue;
+
+                const Star& star = nodeStars.objects[i];
+                if (star.getAbsoluteMagnitude() >= dimmest)
+                    continue;
+
+                float bound;
+                if (!coneBound(star.getPosition(), star.getOrbitalRadius(), bound))
+                    continue;
+
+                float distance = (obsPosition - star.getPosition()).norm();
+                float appMag   = astro::absToAppMag(star.getAbsoluteMagnitude(), distance);
+                if (appMag < limitingFactor || (distance < MAX_STAR_ORBIT_RADIUS && star.getOrbit()))
+                {
+                    candidates.push_back({ bound, &star, distance, appMag });
+                    std::push_heap(candidates.begin(), candidates.end(), laterStar);
+                }
+            }
+        }
+
+        uint32_t child = firstChild[entry.node];
+        if (child == 0)
+            continue;
+        if (entry.minDistance > 0 &&
+            astro::absToAppMag(exclusionFactors[entry.node], entry.minDistance) > limitingFactor)
+            continue;
+
+        float childScale = entry.scale * 0.5f;
+        ChildArray minDistances;
+        unsigned int inCone = cullChildren(child, obsPosition, coneBound.pyramid(), childScale, minDistances);
+        for (unsigned int i = 0; i < NODE_CHILDREN; ++i)
+        {
+            if ((inCone & (1u << i)) == 0)
+                continue;
+
+            Vector3f center(centerX[child + i], centerY[child + i], centerZ[child + i]);
+            float bound;
+            if (coneBound(center, childScale * SQRT3 + MAX_STAR_ORBIT_RADIUS, bound))
+            {
+                nodes.push_back({ bound, child + i, entry.depth + 1, childScale, minDistances[i] });
+                std::push_heap(nodes.begin(), nodes.end(), laterNode);
+            }
         }
     }
 }
@@ -17,8 +17,18 @@
 #include <celengine/octree.h>
 
 
-typedef DynamicOctree  <Star, float> DynamicStarOctree;
-typedef StaticOctree   <Star, float> StarOctree;
-typedef OctreeProcessor<Star, float> StarHandler;
+typedef DynamicOctree      <Star, float> DynamicStarOctree;
+typedef StaticOctree       <Star, float> StarOctree;
+typedef OctreeProcessor    <Star, float> StarHandler;
+typedef OctreeConeProcessor<Star, float> StarConeHandler;
+
+// Fill in the compact culling data used by the star octree traversal for
+// the stars of a single node
+void quantizeStars(const Star* stars, uint32_t nStars,
+                   uint16_t* x, uint16_t* y, uint16_t* z, int16_t* magnitude,
+                   StarOctree::ObjectBounds& bounds);
+
+template<> int  DynamicStarOctree::childIndex(const Star&, const Eigen::Vector3f&);
+template<> void StarOctree::buildObjectData();
 
 #endif  // _CELENGINE_STAROCTREE_H_
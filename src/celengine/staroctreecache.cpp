@@ -0,0 +1,173 @@
+// staroctreecache.cpp
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// Persistent cache of the spatially sorted star catalog.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include "staroctreecache.h"
+
+using namespace std;
+
+
+constexpr const char     CACHE_FILE_HEADER[] = "CELOCTRC";
+// Increase the version whenever the octree construction or the layout
+// of the cache changes; stale caches are then rebuilt automatically.
+constexpr const uint32_t CACHE_VERSION       = 2;
+// Written in native byte order; caches from another architecture are
+// simply rejected.
+constexpr const uint32_t CACHE_BYTE_ORDER    = 0x01020304;
+
+namespace
+{
+struct CacheHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t key;
+    uint32_t nStars;
+    uint32_t nNodes;
+};
+static_assert(sizeof(CacheHeader) == 32, "Unexpected padding in star octree cache header");
+
+inline size_t nodeTableOffset(uint32_t nStars)
+{
+    size_t offset = sizeof(CacheHeader) + sizeof(uint32_t) * nStars;
+    return (offset + 7) & ~static_cast<size_t>(7);
+}
+
+inline uint64_t mix(uint64_t h, uint64_t w)
+{
+    h = (h ^ w) * 0x9e3779b97f4a7c15ull;
+    return h ^ (h >> 29);
+}
+}
+
+
+void StarOctreeCacheKey::add(const char* data, size_t size)
+{
+    hash = mix(hash, size);
+
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t w;
+        memcpy(&w, data + i, sizeof w);
+        hash = mix(hash, w);
+    }
+
+    uint64_t tail = 0;
+    if (i < size)
+        memcpy(&tail, data + i, size - i);
+    hash = mix(hash, tail);
+}
+
+
+bool StarOctreeCacheKey::addFile(const fs::path& filename)
+{
+    MappedFile file(filename);
+    if (file.isOpen())
+    {
+        add(file.data(), file.size());
+        return true;
+    }
+
+    // Unreadable and empty files still change the key, so that a file
+    // appearing later invalidates the cache.
+    add(nullptr, 0);
+    return false;
+}
+
+
+bool StarOctreeCache::open(const fs::path& filename, uint64_t key, uint32_t nStars)
+{
+    if (!file.open(filename) || file.size() < sizeof(CacheHeader))
+        return false;
+
+    CacheHeader header;
+    memcpy(&header, file.data(), sizeof header);
+    if (memcmp(header.magic, CACHE_FILE_HEADER, sizeof header.magic) != 0 ||
+        header.version != CACHE_VERSION ||
+        header.byteOrder != CACHE_BYTE_ORDER ||
+        header.key != key ||
+        header.nStars != nStars)
+    {
+        file.close();
+        return false;
+    }
+
+    size_t offset = nodeTableOffset(header.nStars);
+    if (file.size() != offset + sizeof(PackedNode) * header.nNodes)
+    {
+        file.close();
+        return false;
+    }
+
+    // The mapping is page aligned and the table offsets are multiples of
+    // the element alignment, so the tables can be used in place.
+    positions = reinterpret_cast<const uint32_t*>(file.data() + sizeof(CacheHeader));
+    nodeTable = reinterpret_cast<const PackedNode*>(file.data() + offset);
+    nNodes    = header.nNodes;
+
+    return true;
+}
+
+
+bool StarOctreeCache::write(const fs::path& filename,
+                            uint64_t key,
+                            const vector<uint32_t>& sortedPositions,
+                            const vector<PackedNode>& nodes)
+{
+    // Write to a temporary file first so that a concurrently starting
+    // instance never maps a partially written cache.
+    fs::path tmpname = filename;
+    tmpname += ".tmp";
+
+    {
+        ofstream out(tmpname.string(), ios::out | ios::binary | ios::trunc);
+        if (!out.good())
+            return false;
+
+        CacheHeader header;
+        memcpy(header.magic, CACHE_FILE_HEADER, sizeof header.magic);
+        header.version   = CACHE_VERSION;
+        header.byteOrder = CACHE_BYTE_ORDER;
+        header.key       = key;
+        header.nStars    = static_cast<uint32_t>(sortedPositions.size());
+        header.nNodes    = static_cast<uint32_t>(nodes.size());
+        out.write(reinterpret_cast<const char*>(&header), sizeof header);
+
+        out.write(reinterpret_cast<const char*>(sortedPositions.data()),
+                  sizeof(uint32_t) * sortedPositions.size());
+        size_t padding = nodeTableOffset(header.nStars) - sizeof header - sizeof(uint32_t) * header.nStars;
+        const char zeros[8] = { 0 };
+        out.write(zeros, padding);
+
+        out.write(reinterpret_cast<const char*>(nodes.data()),
+                  sizeof(PackedNode) * nodes.size());
+        if (!out.good())
+            return false;
+    }
+
+    // rename() replaces an existing file atomically on POSIX systems but
+    // fails on Windows, so retry after removing the old cache there.
+    if (rename(tmpname.string().c_str(), filename.string().c_str()) != 0)
+    {
+        remove(filename.string().c_str());
+        if (rename(tmpname.string().c_str(), filename.string().c_str()) != 0)
+        {
+            remove(tmpname.string().c_str());
+            return false;
+        }
+    }
+
+    return true;
+}
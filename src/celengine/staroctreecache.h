@@ -0,0 +1,66 @@
+// staroctreecache.h
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// Persistent cache of the spatially sorted star catalog.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <celcompat/filesystem.h>
+#include <celutil/mappedfile.h>
+#include <celengine/staroctree.h>
+
+/*! Hash of the contents of the catalog files a star database was built
+ *  from. Files must be added in the order that they're loaded, since
+ *  later catalogs may replace stars from earlier ones.
+ */
+class StarOctreeCacheKey
+{
+ public:
+    void add(const char* data, size_t size);
+    bool addFile(const fs::path& filename);
+
+    uint64_t value() const { return hash; }
+
+ private:
+    uint64_t hash{ 0xcbf29ce484222325ull };
+};
+
+
+/*! The star octree cache stores the result of building the star octree:
+ *  the node table of the StarOctree and, for every star in catalog number
+ *  order, its position in the spatially sorted star array. Star objects
+ *  themselves refer to run time data (details, orbits) and are not
+ *  stored; they're copied from the loaded catalog into their sorted
+ *  positions instead. The cache is only valid on the machine that wrote
+ *  it and for exactly the catalog files its key was computed from.
+ */
+class StarOctreeCache
+{
+ public:
+    using PackedNode = StarOctree::PackedNode;
+
+    bool open(const fs::path& filename, uint64_t key, uint32_t nStars);
+
+    const uint32_t*   sortedPositions() const { return positions; }
+    const PackedNode* nodes() const           { return nodeTable; }
+    uint32_t          nodeCount() const       { return nNodes; }
+
+    static bool write(const fs::path& filename,
+                      uint64_t key,
+                      const std::vector<uint32_t>& sortedPositions,
+                      const std::vector<PackedNode>& nodes);
+
+ private:
+    MappedFile        file;
+    const uint32_t*   positions{ nullptr };
+    const PackedNode* nodeTable{ nullptr };
+    uint32_t          nNodes{ 0 };
+};
@@ -225,6 +225,9 @@ public:
     ClosestStarFinder(float _maxDistance, const Universe* _universe);
     ~ClosestStarFinder() = default;
     void process(const Star& star, float distance, float appMag);
+    void processBatch(celestia::span<const Star* const> stars,
+                      celestia::span<const float> distances,
+                      celestia::span<const float> appMags);
 
 public:
     float maxDistance;
@@ -256,6 +259,37 @@ void ClosestStarFinder::process(const Star& star, float distance, float /*unused
     }
 }
 
+void ClosestStarFinder::processBatch(celestia::span<const Star* const> stars,
+                                     celestia::span<const float> distances,
+                                     celestia::span<const float> /*unused*/)
+{
+    if (withPlanets)
+    {
+        for (size_t i = 0; i < stars.size(); i++)
+            process(*stars[i], distances[i], 0.0f);
+        return;
+    }
+
+    // Without the solar system check this is a plain minimum search; the
+    // first of several equally distant stars wins, as with process().
+    size_t closest = stars.size();
+    float minDistance = closestDistance;
+    for (size_t i = 0; i < distances.size(); i++)
+    {
+        if (distances[i] < minDistance)
+        {
+            minDistance = distances[i];
+            closest = i;
+        }
+    }
+
+    if (closest != stars.size())
+    {
+        closestStar = const_cast<Star*>(stars[closest]);
+        closestDistance = minDistance;
+    }
+}
+
 
 class NearStarFinder : public StarHandler
 {
@@ -263,6 +297,9 @@ public:
     NearStarFinder(float _maxDistance, vector<const Star*>& nearStars);
     ~NearStarFinder() = default;
     void process(const Star& star, float distance, float appMag);
+    void processBatch(celestia::span<const Star* const> stars,
+                      celestia::span<const float> distances,
+                      celestia::span<const float> appMags);
 
 private:
     float maxDistance;
@@ -282,6 +319,17 @@ void NearStarFinder::process(const Star& star, float distance, float /*unused*/)
         nearStars.push_back(&star);
 }
 
+void NearStarFinder::processBatch(celestia::span<const Star* const> stars,
+                                  celestia::span<const float> distances,
+                                  celestia::span<const float> /*unused*/)
+{
+    for (size_t i = 0; i < stars.size(); i++)
+    {
+        if (distances[i] < maxDistance)
+            nearStars.push_back(stars[i]);
+    }
+}
+
 
 
 struct PlanetPickInfo
@@ -509,14 +557,19 @@ Selection Universe::pickPlanet(SolarSystem& solarSystem,
 }
 
 
-// StarPicker is a callback class for StarDatabase::findVisibleStars
-class StarPicker : public StarHandler
+// StarPicker is a callback class for StarDatabase::findStarsInCone; the
+// cone narrows to the angle of the closest star found so far.
+class StarPicker : public StarConeHandler
 {
 public:
     StarPicker(const Vector3f&, const Vector3f&, double, float);
     ~StarPicker() = default;
 
     void process(const Star& /*star*/, float /*unused*/, float /*unused*/);
+    float maxAngle() const;
+
+private:
+    inline void pick(const Star& star);
 
 public:
     const Star* pickedStar;
@@ -539,6 +592,16 @@ StarPicker::StarPicker(const Vector3f& _pickOrigin,
 }
 
 void StarPicker::process(const Star& star, float /*unused*/, float /*unused*/)
+{
+    pick(star);
+}
+
+float StarPicker::maxAngle() const
+{
+    return (float) (2.0 * asin(std::min(sinAngle2Closest, 1.0)));
+}
+
+void StarPicker::pick(const Star& star)
 {
     Vector3f relativeStarPos = star.getPosition() - pickOrigin;
     Vector3f starDir = relativeStarPos.normalized();
@@ -588,6 +651,12 @@ public:
                     float angle);
     ~CloseStarPicker() = default;
     void process(const Star& star, float lowPrecDistance, float appMag);
+    void processBatch(celestia::span<const Star* const> stars,
+                      celestia::span<const float> distances,
+                      celestia::span<const float> appMags);
+
+private:
+    inline void pick(const Star& star);
 
 public:
     UniversalCoord pickOrigin;
@@ -619,9 +688,23 @@ void CloseStarPicker::process(const Star& star,
                               float lowPrecDistance,
                               float /*unused*/)
 {
-    if (lowPrecDistance > maxDistance)
-        return;
+    if (lowPrecDistance <= maxDistance)
+        pick(star);
+}
 
+void CloseStarPicker::processBatch(celestia::span<const Star* const> stars,
+                                   celestia::span<const float> distances,
+                                   celestia::span<const float> /*unused*/)
+{
+    for (size_t i = 0; i < stars.size(); i++)
+    {
+        if (distances[i] <= maxDistance)
+            pick(*stars[i]);
+    }
+}
+
+void CloseStarPicker::pick(const Star& star)
+{
     Vector3d hPos = star.getPosition(now).offsetFromKm(pickOrigin);
     Vector3f starDir = hPos.cast<float>();
 
@@ -678,23 +761,17 @@ Selection Universe::pickStar(const UniversalCoord& origin,
     // over 100k stars.
     CloseStarPicker closePicker(origin, direction, when, 1.0f, tolerance);
     starCatalog->findCloseStars(closePicker, o, 1.0f);
+    // Selections outlive the frame, so stars of a paged catalog are
+    // replaced by stable copies.
     if (closePicker.closestStar != nullptr)
-        return Selection(const_cast<Star*>(closePicker.closestStar));
-
-    // Find visible stars expects an orientation, but we just have a direction
-    // vector.  Convert the direction vector into an orientation by computing
-    // the rotation required to map -Z to the direction.
-    Quaternionf rotation;
-    rotation.setFromTwoVectors(-Vector3f::UnitZ(), direction);
+        return Selection(const_cast<Star*>(starCatalog->getStableStar(closePicker.closestStar)));
 
+    // Only the stars within the tolerance of the pick ray are searched,
+    // closest to it first.
     StarPicker picker(o, direction, when, tolerance);
-    starCatalog->findVisibleStars(picker,
-                                  o,
-                                  rotation.conjugate(),
-                                  tolerance, 1.0f,
-                                  faintestMag);
+    starCatalog->findStarsInCone(picker, o, direction, faintestMag);
     if (picker.pickedStar != nullptr)
-        return Selection(const_cast<Star*>(picker.pickedStar));
+        return Selection(const_cast<Star*>(starCatalog->getStableStar(picker.pickedStar)));
     else
         return Selection();
 }
@@ -759,7 +836,9 @@ void DSOPicker::process(DeepSkyObject* const & dso, double /*unused*/, float /*u
 }
 
 
-class CloseDSOPicker : public DSOHandler
+// Tests DSOs against the pick ray for DSODatabase::pickDSO(); the
+// DSO whose center is closest in angle to the ray wins.
+class CloseDSOPicker : public DSORayPicker
 {
 public:
     CloseDSOPicker(const  Vector3d& pos,
@@ -769,16 +848,13 @@ public:
                    float);
     ~CloseDSOPicker() = default;
 
-    void process(DeepSkyObject* const & dso, double distance, float appMag);
+    bool pick(DeepSkyObject* const & dso, double& cosAngle);
 
 public:
     Vector3d  pickOrigin;
     Vector3d  pickDir;
     uint64_t renderFlags;
     double    maxDistance;
-
-    const DeepSkyObject* closestDSO;
-    double largestCosAngle;
 };
 
 
@@ -790,32 +866,28 @@ CloseDSOPicker::CloseDSOPicker(const Vector3d& pos,
     pickOrigin     (pos),
     pickDir        (dir),
     renderFlags    (renderFlags),
-    maxDistance    (maxDistance),
-    closestDSO     (nullptr),
-    largestCosAngle(-2.0)
+    maxDistance    (maxDistance)
 {
 }
 
 
-void CloseDSOPicker::process(DeepSkyObject* const & dso,
-                             double distance,
-                             float /*unused*/)
+bool CloseDSOPicker::pick(DeepSkyObject* const & dso, double& cosAngle)
 {
+    double distance = (pickOrigin - dso->getPosition()).norm() - dso->getBoundingSphereRadius();
     if (distance > maxDistance || !(dso->getRenderMask() & renderFlags) || !dso->isVisible() || !dso->isClickable())
-        return;
+        return false;
 
     double  distanceToPicker       = 0.0;
     double  cosAngleToBoundCenter  = 0.0;
-    if (dso->pick(Ray3d(pickOrigin, pickDir), distanceToPicker, cosAngleToBoundCenter))
-    {
-        // Don't select the object the observer is currently in:
-        if ((pickOrigin - dso->getPosition()).norm() > dso->getRadius() &&
-            cosAngleToBoundCenter > largestCosAngle)
-        {
-            closestDSO      = dso;
-            largestCosAngle = cosAngleToBoundCenter;
-        }
-    }
+    if (!dso->pick(Ray3d(pickOrigin, pickDir), distanceToPicker, cosAngleToBoundCenter))
+        return false;
+
+    // Don't select the object the observer is currently in:
+    if ((pickOrigin - dso->getPosition()).norm() <= dso->getRadius())
+        return false;
+
+    cosAngle = cosAngleToBoundCenter;
+    return true;
 }
 
 
@@ -830,10 +902,10 @@ Selection Universe::pickDeepSkyObject(const UniversalCoord& origin,
 
     CloseDSOPicker closePicker(orig, dir, renderFlags, 1e9, tolerance);
 
-    dsoCatalog->findCloseDSOs(closePicker, orig, 1e9);
-    if (closePicker.closestDSO != nullptr)
+    DeepSkyObject* closestDSO = dsoCatalog->pickDSO(closePicker, orig, dir);
+    if (closestDSO != nullptr)
     {
-        return Selection(const_cast<DeepSkyObject*>(closePicker.closestDSO));
+        return Selection(closestDSO);
     }
 
     Quaternionf rotation;
@@ -83,6 +83,8 @@ class Universe
     SolarSystem* getSolarSystem(const Selection&) const;
     SolarSystem* createSolarSystem(Star* star) const;
 
+    // The stars found may belong to a paged catalog, and are only valid
+    // until the next frame; see StarDatabase::getStableStar().
     void getNearStars(const UniversalCoord& position,
                       float maxDistance,
                       std::vector<const Star*>& stars) const;
@@ -0,0 +1,304 @@
+// chebyshevcache.cpp
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <cmath>
+#include <celmath/mathlib.h>
+#include "chebyshevcache.h"
+#include "orbit.h"
+
+using namespace Eigen;
+using namespace std;
+
+
+constexpr const unsigned int INITIAL_SEGMENTS = 4;
+constexpr const unsigned int MAX_SPLIT_DEPTH  = 10;
+constexpr const size_t       MAX_WINDOWS      = 8;
+constexpr const double       MAX_WINDOW_LENGTH = 3652.5;
+constexpr const double       MIN_WINDOW_LENGTH = 1.0;
+
+static double defaultTolerance = 0.001;
+
+namespace
+{
+// Sum of the Chebyshev series c[0] T0(x) + ... + c[n-1] Tn-1(x) with
+// Clenshaw's recurrence.
+inline double clenshaw(const double* c, int n, double x)
+{
+    double b1 = 0.0;
+    double b2 = 0.0;
+    for (int k = n - 1; k >= 1; k--)
+    {
+        double b0 = c[k] + 2.0 * x * b1 - b2;
+        b2 = b1;
+        b1 = b0;
+    }
+
+    return c[0] + x * b1 - b2;
+}
+}
+
+
+ChebyshevCache::ChebyshevCache(const CachingOrbit& _orbit, double _tolerance) :
+    orbit(_orbit),
+    tolerance(_tolerance)
+{
+    double period = orbit.getPeriod();
+    // Windows of long period orbits are lengthened so that the windows of
+    // a whole revolution, as sampled for its path, stay in the cache.
+    if (orbit.isPeriodic() && period > 0.0)
+        windowLength = max(MIN_WINDOW_LENGTH, min(period, max(MAX_WINDOW_LENGTH, period / (MAX_WINDOWS - 2))));
+    else
+        windowLength = 365.25;
+
+    orbit.getValidRange(validBegin, validEnd);
+}
+
+
+void ChebyshevCache::setDefaultTolerance(double tolerance)
+{
+    defaultTolerance = max(tolerance, 0.0);
+}
+
+
+double ChebyshevCache::getDefaultTolerance()
+{
+    return defaultTolerance;
+}
+
+
+Vector3d ChebyshevCache::position(double jd)
+{
+    Vector3d pos;
+    return evaluate(jd, false, pos) ? pos : orbit.computePosition(jd);
+}
+
+
+Vector3d ChebyshevCache::velocity(double jd)
+{
+    Vector3d vel;
+    return evaluate(jd, true, vel) ? vel : orbit.computeVelocity(jd);
+}
+
+
+// Evaluate the polynomials of the segment containing jd, or their
+// derivatives, fitting its window when it is requested for the second
+// time. Returns false when the position has to be computed directly.
+bool ChebyshevCache::evaluate(double jd, bool derivative, Vector3d& v)
+{
+    unique_lock<std::mutex> lock(mutex);
+
+    Window* window = findWindow(jd);
+    if (window == nullptr || (!window->fitted && !countQuery(*window, jd)))
+        return false;
+
+    if (!window->fitted)
+    {
+        // Fit without holding the lock, so that other threads can go on
+        // using the cache; until the fit is published they compute the
+        // positions of this window directly. The window may be evicted
+        // meanwhile, so it is looked up again.
+        window->fitting = true;
+        double start = window->start;
+        double end = window->end;
+        lock.unlock();
+
+        vector<Segment> segments;
+        fit(start, end, segments);
+
+        lock.lock();
+        window = findWindow(jd);
+        window->segments = move(segments);
+        window->fitted = true;
+        window->fitting = false;
+        fitCount++;
+    }
+
+    const vector<Segment>& segments = window->segments;
+    auto iter = upper_bound(segments.begin(), segments.end(), jd,
+                            [](double t, const Segment& s) { return t < s.start; });
+    if (iter == segments.begin())
+        return false;
+    --iter;
+    if (jd > iter->end)
+        return false;
+
+    const Segment* segment = &*iter;
+    double halfSpan = (segment->end - segment->start) * 0.5;
+    double x = (jd - segment->start) / halfSpan - 1.0;
+    if (derivative)
+    {
+        v = Vector3d(clenshaw(segment->velocity[0], Degree, x),
+                     clenshaw(segment->velocity[1], Degree, x),
+                     clenshaw(segment->velocity[2], Degree, x)) / halfSpan;
+    }
+    else
+    {
+        v = Vector3d(clenshaw(segment->position[0], Degree + 1, x),
+                     clenshaw(segment->position[1], Degree + 1, x),
+                     clenshaw(segment->position[2], Degree + 1, x));
+    }
+
+    return true;
+}
+
+
+// Return the window containing jd, evicting the least recently used one
+// if a new window has to be added, or nullptr outside of the valid range
+// of the orbit; called with the mutex held.
+ChebyshevCache::Window* ChebyshevCache::findWindow(double jd)
+{
+    if (validBegin < validEnd && (jd < validBegin || jd > validEnd))
+        return nullptr;
+
+    double index = floor(jd / windowLength);
+    double start = index * windowLength;
+    double end = start + windowLength;
+    if (validBegin < validEnd)
+    {
+        start = max(start, validBegin);
+        end = min(end, validEnd);
+    }
+
+    Window* window = lastWindow;
+    if (window == nullptr || jd < window->start || jd > window->end)
+    {
+        auto iter = windows.find((int64_t) index);
+        if (iter == windows.end())
+        {
+            if (windows.size() >= MAX_WINDOWS)
+            {
+                auto oldest = min_element(windows.begin(), windows.end(),
+                                          [](const pair<const int64_t, Window>& a,
+                                             const pair<const int64_t, Window>& b)
+                                          {
+                                              return a.second.lastUse < b.second.lastUse;
+                                          });
+                windows.erase(oldest);
+            }
+
+            iter = windows.emplace((int64_t) index, Window()).first;
+            iter->second.start = start;
+            iter->second.end = end;
+        }
+        window = &iter->second;
+        lastWindow = window;
+    }
+
+    window->lastUse = ++useCount;
+    return window;
+}
+
+
+// Count a lookup of a window which hasn't been fitted, and return whether
+// it should be fitted now.
+bool ChebyshevCache::countQuery(Window& window, double jd) const
+{
+    if (window.fitting)
+        return false;
+
+    if (window.queries < 2)
+    {
+        // Velocities computed by differentiation also ask for the
+        // position at the same time; they count as one lookup.
+        if (jd == window.lastQuery)
+            return false;
+        window.lastQuery = jd;
+        if (++window.queries < 2)
+            return false;
+    }
+
+    return true;
+}
+
+
+void ChebyshevCache::fit(double start, double end, vector<Segment>& segments) const
+{
+    double step = (end - start) / INITIAL_SEGMENTS;
+    for (unsigned int i = 0; i < INITIAL_SEGMENTS; i++)
+    {
+        double segmentEnd = i == INITIAL_SEGMENTS - 1 ? end : start + (i + 1) * step;
+        fitSegment(segments, start + i * step, segmentEnd, 0);
+    }
+}
+
+
+// Fit the orbit over [start, end] at the Chebyshev nodes, and check the
+// fit at the extrema of the next Chebyshev polynomial, which lie between
+// the nodes and include both ends. Segments that miss the tolerance are
+// halved; those that still miss it after MAX_SPLIT_DEPTH halvings are
+// left out, and positions in them are computed directly.
+void ChebyshevCache::fitSegment(vector<Segment>& segments,
+                                double start, double end,
+                                unsigned int depth) const
+{
+    constexpr int N = Degree + 1;
+
+    double mid = (start + end) * 0.5;
+    double halfSpan = (end - start) * 0.5;
+
+    Segment segment;
+    segment.start = start;
+    segment.end = end;
+
+    // The nodes followed by the check points, computed in one batch
+    double times[2 * N + 1];
+    for (int j = 0; j < N; j++)
+        times[j] = mid + halfSpan * cos(PI * (j + 0.5) / N);
+    for (int j = 0; j <= N; j++)
+        times[N + j] = mid + halfSpan * cos(PI * j / N);
+
+    Vector3d samples[2 * N + 1];
+    orbit.computePositions(times, samples, 2 * N + 1);
+
+    for (int k = 0; k < N; k++)
+    {
+        Vector3d c = Vector3d::Zero();
+        for (int j = 0; j < N; j++)
+            c += samples[j] * cos(PI * k * (j + 0.5) / N);
+        c *= (k == 0 ? 1.0 : 2.0) / N;
+        for (int i = 0; i < 3; i++)
+            segment.position[i][k] = c[i];
+    }
+
+    // Coefficients of the derivative: d[k-1] = d[k+1] + 2k c[k]
+    for (int i = 0; i < 3; i++)
+    {
+        double next = 0.0;
+        double current = 0.0;
+        for (int k = N - 1; k >= 1; k--)
+        {
+            double d = next + 2.0 * k * segment.position[i][k];
+            next = current;
+            current = d;
+            segment.velocity[i][k - 1] = d;
+        }
+        segment.velocity[i][0] *= 0.5;
+    }
+
+    double maxError = 0.0;
+    for (int j = 0; j <= N; j++)
+    {
+        double x = cos(PI * j / N);
+        Vector3d p(clenshaw(segment.position[0], N, x),
+                   clenshaw(segment.position[1], N, x),
+                   clenshaw(segment.position[2], N, x));
+        maxError = max(maxError, (p - samples[N + j]).norm());
+    }
+
+    if (maxError <= tolerance)
+    {
+        segments.push_back(segment);
+    }
+    else if (depth < MAX_SPLIT_DEPTH)
+    {
+        fitSegment(segments, start, mid, depth + 1);
+        fitSegment(segments, mid, end, depth + 1);
+    }
+}
@@ -0,0 +1,99 @@
+// chebyshevcache.h
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <Eigen/Core>
+
+class CachingOrbit;
+
+/*! A cache of Chebyshev polynomials fitted to the positions of an orbit
+ *  that is expensive to compute, like the VSOP87 series or the analytic
+ *  theories of the Moon and of the moons of Jupiter and Saturn.
+ *
+ *  Time is divided into windows of about one orbital period. A window is
+ *  fitted the second time a position in it is requested; single lookups
+ *  are computed directly. Each window is split into segments short
+ *  enough that the polynomials stay within the tolerance of the orbit at
+ *  the points between the fit nodes, so positions cost a binary search
+ *  and the evaluation of three polynomials. Velocities are the
+ *  derivatives of the polynomials. Only the most recently used windows
+ *  are kept. Lookups may come from several threads; they are serialized
+ *  by a mutex, which is not held while positions are computed directly
+ *  or while a window is fitted.
+ */
+class ChebyshevCache
+{
+ public:
+    ChebyshevCache(const CachingOrbit& orbit, double tolerance);
+    ~ChebyshevCache() = default;
+
+    Eigen::Vector3d position(double jd);
+    Eigen::Vector3d velocity(double jd);
+
+    double getTolerance() const { return tolerance; }
+    // Number of windows fitted so far, for tests and statistics
+    unsigned int getFitCount() const { return fitCount; }
+
+    // Tolerance in kilometers used for the analytic orbits created by
+    // CreateVSOP87Orbit() and GetCustomOrbit(); zero turns the cache off.
+    static void setDefaultTolerance(double tolerance);
+    static double getDefaultTolerance();
+
+    enum
+    {
+        Degree = 12,
+    };
+
+ private:
+    struct Segment
+    {
+        double start;
+        double end;
+        // Chebyshev coefficients of x, y and z, and of their derivatives
+        // with respect to the normalized time
+        double position[3][Degree + 1];
+        double velocity[3][Degree];
+    };
+
+    struct Window
+    {
+        double start;
+        double end;
+        std::vector<Segment> segments;
+        double lastQuery{ 0.0 };
+        unsigned int queries{ 0 };
+        uint64_t lastUse{ 0 };
+        bool fitted{ false };
+        bool fitting{ false };
+    };
+
+    Window* findWindow(double jd);
+    bool countQuery(Window& window, double jd) const;
+    bool evaluate(double jd, bool derivative, Eigen::Vector3d& v);
+    void fit(double start, double end, std::vector<Segment>& segments) const;
+    void fitSegment(std::vector<Segment>& segments, double start, double end, unsigned int depth) const;
+
+    const CachingOrbit& orbit;
+    double tolerance;
+    double windowLength;
+    double validBegin{ 0.0 };
+    double validEnd{ 0.0 };
+
+    std::map<int64_t, Window> windows;
+    Window* lastWindow{ nullptr };
+    uint64_t useCount{ 0 };
+    unsigned int fitCount{ 0 };
+
+    std::mutex mutex;
+};
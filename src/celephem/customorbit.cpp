@@ -8,6 +8,7 @@
 // of the License, or (at your option) any later version.
 
 #include "customorbit.h"
+#include "chebyshevcache.h"
 #include "vsop87.h"
 #include "jpleph.h"
 #include <celengine/astro.h>
@@ -15,7 +16,6 @@
 #include <celmath/geomutil.h>
 #include <cassert>
 #include <vector>
-#include <fstream>
 #include <celutil/debug.h>
 
 using namespace Eigen;
@@ -3083,10 +3083,36 @@ class JPLEphOrbit : public CachingOrbit
 
     Vector3d computePosition(double tjd) const override
     {
-        // Get the position relative to the Earth (for the Moon) or
-        // the solar system barycenter.
-        Vector3d pos = ephem.getPlanetPosition(target, tjd);
+        Vector3d pos;
+        evaluate(tjd, pos, nullptr);
+        return pos;
+    }
+
+    // Differentiate the Chebyshev polynomials rather than the positions
+    Vector3d computeVelocity(double tjd) const override
+    {
+        Vector3d pos, vel;
+        evaluate(tjd, pos, &vel);
+        return vel;
+    }
 
+    // The position comes with the velocity, so keep both
+    bool computeState(double tjd, Vector3d& pos, Vector3d& vel) const override
+    {
+        evaluate(tjd, pos, &vel);
+        return true;
+    }
+
+ private:
+    void evaluate(double tjd, Vector3d& pos, Vector3d* vel) const
+    {
+        // Positions are relative to the Earth (for the Moon) or the solar
+        // system barycenter; evaluate the target, the center and the Earth
+        // when either of them is the Moon, all at once.
+        JPLEphemItem items[3] = { target, center, JPLEph_Earth };
+        Vector3d positions[3];
+        Vector3d velocities[3];
+        unsigned int n = 1;
         if (center == JPLEph_SSB && target != JPLEph_Moon)
         {
             // No translation necessary
@@ -3097,28 +3123,38 @@ class JPLEphOrbit : public CachingOrbit
         }
         else
         {
-            Vector3d centerPos = ephem.getPlanetPosition(center, tjd);
+            n = target == JPLEph_Moon || center == JPLEph_Moon ? 3 : 2;
+        }
+
+        ephem.getStates(items, n, tjd, positions, vel != nullptr ? velocities : nullptr);
+        pos = toCelestia(relativeTo(positions, n));
+        if (vel != nullptr)
+            *vel = toCelestia(relativeTo(velocities, n));
+    }
+
+    // Compute the position or velocity of target relative to the center
+    Vector3d relativeTo(Vector3d* v, unsigned int n) const
+    {
+        if (n > 1)
+        {
             if (target == JPLEph_Moon)
-            {
-                pos += ephem.getPlanetPosition(JPLEph_Earth, tjd);
-            }
+                v[0] += v[2];
             if (center == JPLEph_Moon)
-            {
-                centerPos += ephem.getPlanetPosition(JPLEph_Earth, tjd);
-            }
-
-            // Compute the position of target relative to the center
-            pos -= centerPos;
+                v[1] += v[2];
+            v[0] -= v[1];
         }
+        return v[0];
+    }
 
+    static Vector3d toCelestia(const Vector3d& v)
+    {
         // Rotate from the J2000 mean equator to the ecliptic
-        pos = XRotation(-astro::J2000Obliquity) * pos;
+        Vector3d ecl = XRotation(-astro::J2000Obliquity) * v;
 
         // Convert to Celestia's coordinate system
-        return Vector3d(pos.x(), pos.z(), -pos.y());
+        return Vector3d(ecl.x(), ecl.z(), -ecl.y());
     }
 
- private:
     const JPLEphemeris& ephem;
     JPLEphemItem target;
     JPLEphemItem center;
@@ -3132,7 +3168,8 @@ static Orbit* CreateJPLEphOrbit(JPLEphemItem target,
                                 double period,
                                 double boundingRadius)
 {
-    if (jpleph == nullptr)
+    // Packed ephemerides may hold only some of the bodies
+    if (jpleph == nullptr || !jpleph->hasItem(target) || !jpleph->hasItem(center))
         return nullptr;
 
     Orbit* o = new JPLEphOrbit(*jpleph, target, center, period, boundingRadius);
@@ -3149,15 +3186,23 @@ static double yearToJD(int year)
 }
 
 
+// The analytic theories of the planets, of the Moon and of the moons of
+// Jupiter and Saturn sum up many periodic terms; evaluate them through
+// Chebyshev fits when the cache is enabled.
+static CachingOrbit* Cached(CachingOrbit* orbit)
+{
+    orbit->setChebyshevTolerance(ChebyshevCache::getDefaultTolerance());
+    return orbit;
+}
+
+
 Orbit* GetCustomOrbit(const string& name)
 {
     // Attempt to load JPL ephemeris data if we haven't tried already
     if (!jplephInitialized)
     {
         jplephInitialized = true;
-        ifstream in("data/jpleph.dat", ios::in | ios::binary);
-        if (in.good())
-            jpleph = JPLEphemeris::load(in);
+        jpleph = JPLEphemeris::open("data/jpleph.dat");
         if (jpleph != nullptr)
         {
            fmt::fprintf(clog, "Loaded DE%u ephemeris. Valid from JD %.8lf to JD %.8lf\n",
@@ -3166,25 +3211,25 @@ Orbit* GetCustomOrbit(const string& name)
     }
 
     if (name == "mercury")
-        return new MixedOrbit(new MercuryOrbit(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+        return new MixedOrbit(Cached(new MercuryOrbit()), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
     if (name == "venus")
-        return new MixedOrbit(new VenusOrbit(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+        return new MixedOrbit(Cached(new VenusOrbit()), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
     if (name == "earth")
-        return new MixedOrbit(new EarthOrbit(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+        return new MixedOrbit(Cached(new EarthOrbit()), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
     if (name == "moon")
-        return new MixedOrbit(new LunarOrbit(), yearToJD(-2000), yearToJD(4000), astro::EarthMass + astro::LunarMass);
+        return new MixedOrbit(Cached(new LunarOrbit()), yearToJD(-2000), yearToJD(4000), astro::EarthMass + astro::LunarMass);
     if (name == "mars")
-        return new MixedOrbit(new MarsOrbit(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+        return new MixedOrbit(Cached(new MarsOrbit()), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
     if (name == "jupiter")
-        return new MixedOrbit(new JupiterOrbit(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+        return new MixedOrbit(Cached(new JupiterOrbit()), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
     if (name == "saturn")
-        return new MixedOrbit(new SaturnOrbit(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+        return new MixedOrbit(Cached(new SaturnOrbit()), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
     if (name == "uranus")
-        return new MixedOrbit(new UranusOrbit(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+        return new MixedOrbit(Cached(new UranusOrbit()), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
     if (name == "neptune")
-        return new MixedOrbit(new NeptuneOrbit(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+        return new MixedOrbit(Cached(new NeptuneOrbit()), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
     if (name == "pluto")
-        return new MixedOrbit(new PlutoOrbit(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+        return new MixedOrbit(Cached(new PlutoOrbit()), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
 
     // Two styles of custom orbit name are permitted for JPL ephemeris orbits.
     // The preferred is <ephemeris>-<object>, e.g. jpl-mercury. But the reverse
@@ -3256,31 +3301,31 @@ Orbit* GetCustomOrbit(const string& name)
     if (name == "deimos")
         return new DeimosOrbit();
     if (name == "io")
-        return new IoOrbit();
+        return Cached(new IoOrbit());
     if (name == "europa")
-        return new EuropaOrbit();
+        return Cached(new EuropaOrbit());
     if (name == "ganymede")
-        return new GanymedeOrbit();
+        return Cached(new GanymedeOrbit());
     if (name == "callisto")
-        return new CallistoOrbit();
+        return Cached(new CallistoOrbit());
     if (name == "mimas")
-        return new MimasOrbit();
+        return Cached(new MimasOrbit());
     if (name == "enceladus")
-        return new EnceladusOrbit();
+        return Cached(new EnceladusOrbit());
     if (name == "tethys")
-        return new TethysOrbit();
+        return Cached(new TethysOrbit());
     if (name == "dione")
-        return new DioneOrbit();
+        return Cached(new DioneOrbit());
     if (name == "rhea")
-        return new RheaOrbit();
+        return Cached(new RheaOrbit());
     if (name == "titan")
-        return new TitanOrbit();
+        return Cached(new TitanOrbit());
     if (name == "hyperion")
-        return new HyperionOrbit();
+        return Cached(new HyperionOrbit());
     if (name == "iapetus")
-        return new IapetusOrbit();
+        return Cached(new IapetusOrbit());
     if (name == "phoebe")
-        return new PhoebeOrbit();
+        return Cached(new PhoebeOrbit());
     if (name == "miranda")
         return CreateUranianSatelliteOrbit(1);
     if (name == "ariel")
@@ -10,9 +10,12 @@
 // Load JPL's DE200, DE405, and DE406 ephemerides and compute planet
 // positions.
 
-#include <fstream>
-#include <iomanip>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
 #include <cassert>
+#include <cmath>
 #include <celutil/bytes.h>
 #include "jpleph.h"
 
@@ -27,33 +30,100 @@ static const unsigned int NConstants         =  400;
 static const unsigned int ConstantNameLength =  6;
 
 static const unsigned int MaxChebyshevCoeffs = 32;
+static const unsigned int MaxGranules        = 32;
 
 static const int LabelSize = 84;
 
+// Offset of the start date and of the DE number in the first record of a
+// DE file
+static const size_t DEStartDateOffset = LabelSize * 3 + NConstants * ConstantNameLength;
+static const size_t DENumberOffset    = 2840;
+static const size_t DEHeaderSize      = 2856;
 
-// Read a big-endian 32-bit unsigned integer
-static int32_t readUint(istream& in)
+constexpr const char     PACKED_FILE_HEADER[] = "CELJPLDE";
+constexpr const uint16_t PACKED_VERSION       = 0x0100;
+
+namespace
+{
+// Header of a packed ephemeris; all fields are little endian. The
+// records follow, each with its start and end date and the coefficients
+// of the bodies in the file.
+struct PackedHeader
 {
-    int32_t ret;
-    in.read((char*) &ret, sizeof(int32_t));
-    BE_TO_CPU_INT32(ret, ret);
-    return (uint32_t) ret;
+    char     magic[8];
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t DENum;
+    double   startDate;
+    double   endDate;
+    double   daysPerInterval;
+    double   au;
+    double   earthMoonMassRatio;
+    uint32_t recordSize;
+    uint32_t nRecords;
+    // Offset, number of coefficients and number of granules of each
+    // body; bodies left out have no coefficients.
+    uint32_t coeffInfo[JPLEph_NBodies][3];
+    uint32_t reserved2;
+};
+static_assert(sizeof(PackedHeader) == 200, "Unexpected padding in packed ephemeris header");
+
+constexpr const bool bigEndianHost =
+#if defined(WORDS_BIGENDIAN) || defined(__BIG_ENDIAN__)
+    true;
+#else
+    false;
+#endif
+
+inline uint32_t readUint(const char* p, bool swap)
+{
+    uint32_t ret;
+    memcpy(&ret, p, sizeof ret);
+    return swap ? bswap_32(ret) : ret;
 }
 
-// Read a big-endian 64-bit IEEE double--if the native double format isn't
-// IEEE 754, there will be troubles.
-static double readDouble(istream& in)
+// If the native double format isn't IEEE 754, there will be troubles.
+inline double readDouble(const char* p, bool swap)
 {
     double d;
-    in.read((char*) &d, sizeof(double));
-    BE_TO_CPU_DOUBLE(d, d);
-    return d;
+    memcpy(&d, p, sizeof d);
+    return swap ? bswap_double(d) : d;
+}
+
+inline void writeUint(ostream& out, uint32_t n)
+{
+    if (bigEndianHost)
+        n = bswap_32(n);
+    out.write(reinterpret_cast<const char*>(&n), sizeof n);
 }
 
+inline void writeDouble(ostream& out, double d)
+{
+    if (bigEndianHost)
+        d = bswap_double(d);
+    out.write(reinterpret_cast<const char*>(&d), sizeof d);
+}
 
-JPLEphRecord::~JPLEphRecord()
+// Number of coefficients of a body in each record
+inline unsigned int coeffCount(const JPLEphCoeffInfo& info)
 {
-    delete coeffs;
+    unsigned int nGranules = info.nGranules == (unsigned int) -1 ? 1 : info.nGranules;
+    return info.nCoeffs * 3 * nGranules;
+}
+
+// Whether the coefficients of a body fit into records of recordSize
+// doubles. The sums are done in 64 bits, so that the fields of a bad file
+// can't wrap around.
+bool isValidCoeffInfo(const JPLEphCoeffInfo& info, unsigned int recordSize)
+{
+    if (info.nCoeffs > MaxChebyshevCoeffs ||
+        (info.nGranules != (unsigned int) -1 && (info.nGranules == 0 || info.nGranules > MaxGranules)))
+    {
+        return false;
+    }
+
+    return (uint64_t) info.offset + coeffCount(info) + 2 <= (uint64_t) recordSize;
+}
 }
 
 
@@ -73,192 +143,433 @@ double JPLEphemeris::getEndDate() const
 }
 
 
-// Return the position of an object relative to the solar system barycenter
-// or the Earth (in the case of the Moon) at a specified TDB Julian date tjd.
-// If tjd is outside the span covered by the ephemeris it is clamped to a
-// valid time.
-Vector3d JPLEphemeris::getPlanetPosition(JPLEphemItem planet, double tjd) const
+bool JPLEphemeris::hasItem(JPLEphemItem item) const
 {
-    // Solar system barycenter is the origin
-    if (planet == JPLEph_SSB)
-    {
-        return Vector3d::Zero();
-    }
+    if (item == JPLEph_SSB)
+        return true;
+    if (item == JPLEph_Earth)
+        return hasItem(JPLEph_EarthMoonBary) && hasItem(JPLEph_Moon);
+    return item >= 0 && item < JPLEph_NBodies && coeffInfo[item].nCoeffs > 0;
+}
 
-    // The position of the Earth must be computed from the positions of the
-    // Earth-Moon barycenter and Moon
-    if (planet == JPLEph_Earth)
-    {
-        Vector3d embPos = getPlanetPosition(JPLEph_EarthMoonBary, tjd);
 
-        // Get the geocentric position of the Moon
-        Vector3d moonPos = getPlanetPosition(JPLEph_Moon, tjd);
+// Coefficient index of a record; the start and end dates of the record
+// come first, at indexes -2 and -1.
+inline double JPLEphemeris::coefficient(unsigned int record, unsigned int index) const
+{
+    size_t n = (size_t) record * recordSize + 2 + index;
+    return readDouble(records + n * sizeof(double), swapBytes);
+}
 
-        return embPos - moonPos * (1.0 / (earthMoonMassRatio + 1.0));
+
+namespace
+{
+// The Chebyshev polynomials and their derivatives at the normalized time
+// of a granule; bodies with the same number of granules share them.
+struct ChebyshevBasis
+{
+    unsigned int nGranules{ 0 };
+    unsigned int nTerms{ 0 };
+    unsigned int granule{ 0 };
+    double u{ 0.0 };
+    double T[MaxChebyshevCoeffs];
+    double dT[MaxChebyshevCoeffs];
+
+    void extend(unsigned int n)
+    {
+        if (nTerms == 0)
+        {
+            T[0] = 1.0;
+            T[1] = u;
+            dT[0] = 0.0;
+            dT[1] = 1.0;
+            nTerms = 2;
+        }
+        for (; nTerms < n; nTerms++)
+        {
+            T[nTerms] = 2.0 * u * T[nTerms - 1] - T[nTerms - 2];
+            dT[nTerms] = 2.0 * T[nTerms - 1] + 2.0 * u * dT[nTerms - 1] - dT[nTerms - 2];
+        }
     }
+};
+
+constexpr const unsigned int MaxBases = 4;
+}
+
 
+// Return the positions, and the velocities in km/day if velocities isn't
+// null, of several objects at a specified TDB Julian date tjd. Positions
+// are relative to the solar system barycenter, or to the Earth in the case
+// of the Moon. If tjd is outside the span covered by the ephemeris it is
+// clamped to a valid time. The record holding tjd is located once, and the
+// Chebyshev polynomials are evaluated once for all the objects sharing
+// the same granules.
+void JPLEphemeris::getStates(const JPLEphemItem* items, unsigned int n, double tjd,
+                             Vector3d* positions, Vector3d* velocities) const
+{
     // Clamp time to [ startDate, endDate ]
     if (tjd < startDate)
         tjd = startDate;
     else if (tjd > endDate)
-    tjd = endDate;
+        tjd = endDate;
 
     // recNo is always >= 0:
     auto recNo = (unsigned int) ((tjd - startDate) / daysPerInterval);
     // Make sure we don't go past the end of the array if t == endDate
-    if (recNo >= records.size())
-        recNo = records.size() - 1;
-    const JPLEphRecord* rec = &records[recNo];
-
-    assert(coeffInfo[planet].nGranules >= 1);
-    assert(coeffInfo[planet].nGranules <= 32);
-    assert(coeffInfo[planet].nCoeffs <= MaxChebyshevCoeffs);
+    if (recNo >= nRecords)
+        recNo = nRecords - 1;
+    double t0 = readDouble(records + (size_t) recNo * recordSize * sizeof(double), swapBytes);
 
-    // u is the normalized time (in [-1, 1]) for interpolating
-    // coeffs is a pointer to the Chebyshev coefficients
-    double u = 0.0;
-    double* coeffs = nullptr;
+    ChebyshevBasis bases[MaxBases];
+    unsigned int nBases = 0;
 
-    // nGranules is unsigned int so it will be compared against FFFFFFFF:
-    if (coeffInfo[planet].nGranules == (unsigned int) -1)
+    auto evaluate = [&](JPLEphemItem body, Vector3d& pos, Vector3d* vel)
     {
-        coeffs = rec->coeffs + coeffInfo[planet].offset;
-        u = 2.0 * (tjd - rec->t0) / daysPerInterval - 1.0;
-    }
-    else
-    {
-    double daysPerGranule = daysPerInterval / coeffInfo[planet].nGranules;
-    auto granule = (int) ((tjd - rec->t0) / daysPerGranule);
-    double granuleStartDate = rec->t0 + daysPerGranule * (double) granule;
-    coeffs = rec->coeffs + coeffInfo[planet].offset +
-            granule * coeffInfo[planet].nCoeffs * 3;
-    u = 2.0 * (tjd - granuleStartDate) / daysPerGranule - 1.0;
-    }
+        // Bodies left out of a packed file
+        if (!hasItem(body))
+        {
+            pos = Vector3d::Zero();
+            if (vel != nullptr)
+                *vel = Vector3d::Zero();
+            return;
+        }
+
+        const JPLEphCoeffInfo& info = coeffInfo[body];
+        assert(info.nCoeffs <= MaxChebyshevCoeffs);
+
+        // nGranules is unsigned int so it will be compared against FFFFFFFF:
+        unsigned int nGranules = info.nGranules == (unsigned int) -1 ? 1 : info.nGranules;
+        assert(nGranules >= 1);
+        assert(nGranules <= MaxGranules);
+        double daysPerGranule = daysPerInterval / nGranules;
 
-    // Evaluate the Chebyshev polynomials
-    double sum[3];
-    double cc[MaxChebyshevCoeffs];
-    unsigned int nCoeffs = coeffInfo[planet].nCoeffs;
-    for (int i = 0; i < 3; i++)
+        ChebyshevBasis* basis = nullptr;
+        for (unsigned int i = 0; i < nBases; i++)
+        {
+            if (bases[i].nGranules == nGranules)
+                basis = &bases[i];
+        }
+        if (basis == nullptr)
+        {
+            // More kinds of granules than expected; reuse the last slot
+            basis = &bases[min(nBases, MaxBases - 1)];
+            nBases = min(nBases + 1, MaxBases);
+
+            // u is the normalized time (in [-1, 1]) for interpolating
+            auto granule = (int) ((tjd - t0) / daysPerGranule);
+            granule = max(0, min(granule, (int) nGranules - 1));
+            double granuleStartDate = t0 + daysPerGranule * (double) granule;
+            basis->nGranules = nGranules;
+            basis->granule = (unsigned int) granule;
+            basis->u = 2.0 * (tjd - granuleStartDate) / daysPerGranule - 1.0;
+            basis->nTerms = 0;
+        }
+        basis->extend(max(info.nCoeffs, 2u));
+
+        // first is the index of the Chebyshev coefficients in the record
+        unsigned int first = info.offset + basis->granule * info.nCoeffs * 3;
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            unsigned int c = first + i * info.nCoeffs;
+            double p = 0.0;
+            double v = 0.0;
+            for (unsigned int j = 0; j < info.nCoeffs; j++)
+            {
+                double coeff = coefficient(recNo, c + j);
+                p += coeff * basis->T[j];
+                v += coeff * basis->dT[j];
+            }
+            pos[i] = p;
+            if (vel != nullptr)
+                (*vel)[i] = v * 2.0 / daysPerGranule;
+        }
+    };
+
+    Vector3d embPos, embVel, moonPos, moonVel;
+    bool earthComputed = false;
+    for (unsigned int i = 0; i < n; i++)
     {
-        cc[0] = 1.0;
-        cc[1] = u;
-        sum[i] = coeffs[i * nCoeffs] + coeffs[i * nCoeffs + 1] * u;
-        for (unsigned int j = 2; j < nCoeffs; j++)
+        Vector3d* vel = velocities != nullptr ? &velocities[i] : nullptr;
+        switch (items[i])
         {
-            cc[j] = 2.0 * u * cc[j - 1] - cc[j - 2];
-            sum[i] += coeffs[i * nCoeffs + j] * cc[j];
+        case JPLEph_SSB:
+            // Solar system barycenter is the origin
+            positions[i] = Vector3d::Zero();
+            if (vel != nullptr)
+                *vel = Vector3d::Zero();
+            break;
+
+        case JPLEph_Earth:
+            // The position of the Earth must be computed from the positions
+            // of the Earth-Moon barycenter and Moon
+            if (!earthComputed)
+            {
+                evaluate(JPLEph_EarthMoonBary, embPos, &embVel);
+                evaluate(JPLEph_Moon, moonPos, &moonVel);
+                earthComputed = true;
+            }
+            positions[i] = embPos - moonPos * (1.0 / (earthMoonMassRatio + 1.0));
+            if (vel != nullptr)
+                *vel = embVel - moonVel * (1.0 / (earthMoonMassRatio + 1.0));
+            break;
+
+        default:
+            evaluate(items[i], positions[i], vel);
+            break;
         }
     }
-
-    return Vector3d(sum[0], sum[1], sum[2]);
 }
 
 
-JPLEphemeris* JPLEphemeris::load(istream& in)
+// Return the position of an object relative to the solar system barycenter
+// or the Earth (in the case of the Moon) at a specified TDB Julian date tjd.
+Vector3d JPLEphemeris::getPlanetPosition(JPLEphemItem planet, double tjd) const
 {
-    JPLEphemeris* eph = nullptr;
+    Vector3d pos;
+    getStates(&planet, 1, tjd, &pos, nullptr);
+    return pos;
+}
 
-    // Skip past three header labels
-    in.ignore(LabelSize * 3);
-    if (!in.good())
-        return nullptr;
 
-    // Skip past the constant names
-    in.ignore(NConstants * ConstantNameLength);
-    if (!in.good())
+JPLEphemeris* JPLEphemeris::open(const fs::path& filename)
+{
+    auto* eph = new JPLEphemeris();
+    if (!eph->file.open(filename) || !eph->parse(eph->file.data(), eph->file.size()))
+    {
+        delete eph;
         return nullptr;
+    }
 
-    eph = new JPLEphemeris();
+    return eph;
+}
 
-    // Read the start time, end time, and time interval
-    eph->startDate = readDouble(in);
-    eph->endDate = readDouble(in);
-    eph->daysPerInterval = readDouble(in);
-    if (!in.good())
+
+JPLEphemeris* JPLEphemeris::load(istream& in)
+{
+    auto* eph = new JPLEphemeris();
+    eph->storage.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    if (!eph->parse(eph->storage.data(), eph->storage.size()))
     {
         delete eph;
         return nullptr;
     }
 
-    // Number of constants with valid values; not useful for us
-    (void) readUint(in);
+    return eph;
+}
 
-    eph->au = readDouble(in);     // kilometers per astronomical unit
-    eph->earthMoonMassRatio = readDouble(in);
 
-    // Read the coefficient information for each item in the ephemeris
-    unsigned int i;
-    for (i = 0; i < JPLEph_NItems; i++)
+bool JPLEphemeris::parse(const char* data, size_t size)
+{
+    if (size >= sizeof(PackedHeader) &&
+        memcmp(data, PACKED_FILE_HEADER, sizeof(PACKED_FILE_HEADER) - 1) == 0)
     {
-        eph->coeffInfo[i].offset = readUint(in) - 3;
-        eph->coeffInfo[i].nCoeffs = readUint(in);
-        eph->coeffInfo[i].nGranules = readUint(in);
+        return parsePacked(data, size);
     }
-    if (!in.good())
+
+    return parseDE(data, size);
+}
+
+
+bool JPLEphemeris::parseDE(const char* data, size_t size)
+{
+    if (size < DEHeaderSize)
+        return false;
+
+    // JPL distributes both big and little endian files; the DE number
+    // tells which one this is.
+    swapBytes = !bigEndianHost;
+    DENum = readUint(data + DENumberOffset, swapBytes);
+    if (DENum == 0 || DENum >= 10000)
     {
-        delete eph;
-        return nullptr;
+        swapBytes = !swapBytes;
+        DENum = readUint(data + DENumberOffset, swapBytes);
     }
 
-    eph->DENum = readUint(in);
+    // Read the start time, end time, and time interval
+    const char* p = data + DEStartDateOffset;
+    startDate = readDouble(p, swapBytes);
+    endDate = readDouble(p + 8, swapBytes);
+    daysPerInterval = readDouble(p + 16, swapBytes);
+    if (!(daysPerInterval > 0.0) || !(endDate > startDate))
+        return false;
+
+    // Skip the number of constants with valid values; not useful for us
+    au = readDouble(p + 28, swapBytes);     // kilometers per astronomical unit
+    earthMoonMassRatio = readDouble(p + 36, swapBytes);
 
-    switch (eph->DENum)
+    // Read the coefficient information for each item in the ephemeris
+    p += 44;
+    for (unsigned int i = 0; i < JPLEph_NItems; i++, p += 12)
+    {
+        // Offsets count from 1 and include the start and end dates of
+        // the record
+        unsigned int offset = readUint(p, swapBytes);
+        if (offset < 3 && i < JPLEph_NBodies)
+            return false;
+        coeffInfo[i].offset = offset - 3;
+        coeffInfo[i].nCoeffs = readUint(p + 4, swapBytes);
+        coeffInfo[i].nGranules = readUint(p + 8, swapBytes);
+    }
+
+    p += 4; // DE number
+    librationCoeffInfo.offset    = readUint(p, swapBytes);
+    librationCoeffInfo.nCoeffs   = readUint(p + 4, swapBytes);
+    librationCoeffInfo.nGranules = readUint(p + 8, swapBytes);
+
+    // Every record holds at least its start and end dates
+    double intervals = (endDate - startDate) / daysPerInterval;
+    if (!(intervals < (double) (size / (2 * sizeof(double)))))
+        return false;
+    nRecords = (unsigned int) intervals;
+    switch (DENum)
     {
     case 200:
-        eph->recordSize = DE200RecordSize;
+        recordSize = DE200RecordSize;
         break;
     case 405:
-        eph->recordSize = DE405RecordSize;
+        recordSize = DE405RecordSize;
         break;
     case 406:
-        eph->recordSize = DE406RecordSize;
+        recordSize = DE406RecordSize;
         break;
     default:
-        delete eph;
-        return nullptr;
+        // Later ephemerides have other record sizes; the file holds the
+        // header record, the constants record and the data records.
+        if (nRecords == 0 || size % ((size_t) (nRecords + 2) * sizeof(double)) != 0)
+            return false;
+        recordSize = (unsigned int) (size / ((size_t) (nRecords + 2) * sizeof(double)));
+        break;
     }
 
-    eph->librationCoeffInfo.offset        = readUint(in);
-    eph->librationCoeffInfo.nCoeffs       = readUint(in);
-    eph->librationCoeffInfo.nGranules     = readUint(in);
-    if (!in.good())
+    if (nRecords == 0 || size < (size_t) (nRecords + 2) * recordSize * sizeof(double))
+        return false;
+
+    for (unsigned int i = 0; i < JPLEph_NBodies; i++)
     {
-        delete eph;
-        return nullptr;
+        if (!isValidCoeffInfo(coeffInfo[i], recordSize))
+            return false;
     }
 
-    // Skip past the rest of the record
-    in.ignore(eph->recordSize * 8 - 2856);
-    // The next record contains constant values (which we don't need)
-    in.ignore(eph->recordSize * 8);
-    if (!in.good())
+    // The first record is the header and the next one contains constant
+    // values (which we don't need)
+    records = data + (size_t) recordSize * 2 * sizeof(double);
+
+    return true;
+}
+
+
+bool JPLEphemeris::parsePacked(const char* data, size_t size)
+{
+    PackedHeader header;
+    memcpy(&header, data, sizeof header);
+
+    swapBytes = bigEndianHost;
+    uint16_t version;
+    LE_TO_CPU_INT16(version, header.version);
+    if (version != PACKED_VERSION)
+        return false;
+
+    DENum = readUint(data + offsetof(PackedHeader, DENum), swapBytes);
+    startDate = readDouble(data + offsetof(PackedHeader, startDate), swapBytes);
+    endDate = readDouble(data + offsetof(PackedHeader, endDate), swapBytes);
+    daysPerInterval = readDouble(data + offsetof(PackedHeader, daysPerInterval), swapBytes);
+    au = readDouble(data + offsetof(PackedHeader, au), swapBytes);
+    earthMoonMassRatio = readDouble(data + offsetof(PackedHeader, earthMoonMassRatio), swapBytes);
+    recordSize = readUint(data + offsetof(PackedHeader, recordSize), swapBytes);
+    nRecords = readUint(data + offsetof(PackedHeader, nRecords), swapBytes);
+
+    // The record count and size are checked by division, so that their
+    // product can't wrap around.
+    size_t recordData = (size - sizeof header) / sizeof(double);
+    if (!(daysPerInterval > 0.0) || !(endDate > startDate) || nRecords == 0 || recordSize < 2 ||
+        (size - sizeof header) % sizeof(double) != 0 ||
+        recordData % nRecords != 0 || recordData / nRecords != recordSize)
     {
-        delete eph;
-        return nullptr;
+        return false;
     }
 
-    auto nRecords = (unsigned int) ((eph->endDate - eph->startDate) /
-                        eph->daysPerInterval);
-    eph->records.resize(nRecords);
-    for (i = 0; i < nRecords; i++)
+    const char* p = data + offsetof(PackedHeader, coeffInfo);
+    for (unsigned int i = 0; i < JPLEph_NBodies; i++, p += 12)
     {
-        eph->records[i].t0 = readDouble(in);
-        eph->records[i].t1 = readDouble(in);
+        coeffInfo[i].offset = readUint(p, swapBytes);
+        coeffInfo[i].nCoeffs = readUint(p + 4, swapBytes);
+        coeffInfo[i].nGranules = readUint(p + 8, swapBytes);
+        if (!isValidCoeffInfo(coeffInfo[i], recordSize))
+            return false;
+    }
+
+    // Packed files have neither nutations nor librations
+    coeffInfo[JPLEph_NItems - 1] = { 0, 0, 1 };
+    librationCoeffInfo = { 0, 0, 1 };
 
-        // Allocate coefficient array for this record; the first two
-        // 'coefficients' are actually the start and end time (t0 and t1)
-        eph->records[i].coeffs = new double[eph->recordSize - 2];
-        for (unsigned int j = 0; j < eph->recordSize - 2; j++)
-            eph->records[i].coeffs[j] = readDouble(in);
+    records = data + sizeof header;
 
-        // Make sure that we read this record successfully
-        if (!in.good())
+    return true;
+}
+
+
+bool JPLEphemeris::writePacked(ostream& out, unsigned int itemMask,
+                               double start, double end) const
+{
+    // The records overlapping [start, end]
+    auto recordAt = [this](double tjd)
+    {
+        double r = floor((tjd - startDate) / daysPerInterval);
+        return (unsigned int) max(0.0, min(r, (double) (nRecords - 1)));
+    };
+    unsigned int first = recordAt(start);
+    unsigned int last = max(first, recordAt(end));
+
+    PackedHeader header;
+    memset(&header, 0, sizeof header);
+    unsigned int packedSize = 2;
+    JPLEphCoeffInfo packedInfo[JPLEph_NBodies];
+    for (unsigned int i = 0; i < JPLEph_NBodies; i++)
+    {
+        packedInfo[i] = { 0, 0, 1 };
+        if ((itemMask & (1u << i)) != 0 && coeffInfo[i].nCoeffs > 0)
         {
-            delete eph;
-            return nullptr;
+            packedInfo[i] = coeffInfo[i];
+            packedInfo[i].offset = packedSize - 2;
+            packedSize += coeffCount(coeffInfo[i]);
         }
     }
 
-    return eph;
+    out.write(PACKED_FILE_HEADER, sizeof header.magic);
+    uint16_t version;
+    LE_TO_CPU_INT16(version, PACKED_VERSION);
+    out.write(reinterpret_cast<const char*>(&version), sizeof version);
+    out.write(reinterpret_cast<const char*>(&header.reserved), sizeof header.reserved);
+    writeUint(out, DENum);
+    writeDouble(out, startDate + first * daysPerInterval);
+    writeDouble(out, min(endDate, startDate + (last + 1) * daysPerInterval));
+    writeDouble(out, daysPerInterval);
+    writeDouble(out, au);
+    writeDouble(out, earthMoonMassRatio);
+    writeUint(out, packedSize);
+    writeUint(out, last - first + 1);
+    for (const auto& info : packedInfo)
+    {
+        writeUint(out, info.offset);
+        writeUint(out, info.nCoeffs);
+        writeUint(out, info.nGranules);
+    }
+    writeUint(out, 0);
+
+    for (unsigned int record = first; record <= last; record++)
+    {
+        const char* r = records + (size_t) record * recordSize * sizeof(double);
+        writeDouble(out, readDouble(r, swapBytes));
+        writeDouble(out, readDouble(r + 8, swapBytes));
+        for (unsigned int i = 0; i < JPLEph_NBodies; i++)
+        {
+            if (packedInfo[i].nCoeffs == 0)
+                continue;
+            unsigned int n = coeffCount(coeffInfo[i]);
+            for (unsigned int j = 0; j < n; j++)
+                writeDouble(out, coefficient(record, coeffInfo[i].offset + j));
+        }
+    }
+
+    return out.good();
 }
@@ -16,6 +16,8 @@
 #include <iostream>
 #include <vector>
 #include <Eigen/Core>
+#include <celcompat/filesystem.h>
+#include <celutil/mappedfile.h>
 
 enum JPLEphemItem
 {
@@ -37,6 +39,10 @@ enum JPLEphemItem
 
 #define JPLEph_NItems 12
 
+// Bodies with Chebyshev coefficients of their own; the twelfth item of a
+// DE file holds the nutations.
+#define JPLEph_NBodies 11
+
 struct JPLEphCoeffInfo
 {
     unsigned int offset;
@@ -45,17 +51,18 @@ struct JPLEphCoeffInfo
 };
 
 
-struct JPLEphRecord
-{
-    JPLEphRecord() = default;
-    ~JPLEphRecord();
-
-    double t0{ 0.0 };
-    double t1{ 0.0 };
-    double* coeffs{ nullptr };
-};
-
-
+/*! A JPL DE ephemeris, read from the binary files distributed by JPL or
+ *  from a packed file written by writePacked().
+ *
+ *  Files opened with open() are memory mapped, and the coefficients are
+ *  read from the mapping, with their byte order swapped if needed, only
+ *  when a position is computed. Only the pages of the records for the
+ *  dates actually visited are ever read from disk.
+ *
+ *  A packed file holds only the records of a range of dates and only the
+ *  coefficients of some of the bodies, in little endian order, after a
+ *  header of its own; it doesn't hold nutations and librations.
+ */
 class JPLEphemeris
 {
 private:
@@ -65,14 +72,31 @@ public:
     ~JPLEphemeris() = default;
 
     Eigen::Vector3d getPlanetPosition(JPLEphemItem, double t) const;
+    // Positions, and velocities in km/day unless velocities is null, of n
+    // objects at once
+    void getStates(const JPLEphemItem* items, unsigned int n, double t,
+                   Eigen::Vector3d* positions, Eigen::Vector3d* velocities) const;
+    bool hasItem(JPLEphemItem) const;
 
+    static JPLEphemeris* open(const fs::path& filename);
     static JPLEphemeris* load(std::istream&);
 
+    // Write the records covering startDate to endDate as a packed file,
+    // with the coefficients of the bodies whose bit (1 << JPLEphemItem)
+    // is set in itemMask.
+    bool writePacked(std::ostream& out, unsigned int itemMask,
+                     double startDate, double endDate) const;
+
     unsigned int getDENumber() const;
     double getStartDate() const;
     double getEndDate() const;
 
 private:
+    bool parse(const char* data, size_t size);
+    bool parseDE(const char* data, size_t size);
+    bool parsePacked(const char* data, size_t size);
+    double coefficient(unsigned int record, unsigned int index) const;
+
     JPLEphCoeffInfo coeffInfo[JPLEph_NItems];
     JPLEphCoeffInfo librationCoeffInfo;
 
@@ -86,7 +110,13 @@ private:
     unsigned int DENum;       // ephemeris version
     unsigned int recordSize;  // number of doubles per record
 
-    std::vector<JPLEphRecord> records;
+    MappedFile file;
+    // Only used when the ephemeris is loaded from a stream
+    std::vector<char> storage;
+
+    const char* records{ nullptr };
+    unsigned int nRecords{ 0 };
+    bool swapBytes{ false };
 };
 
 #endif // _CELENGINE_JPLEPH_H_
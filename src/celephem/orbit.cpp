@@ -9,10 +9,12 @@
 // of the License, or (at your option) any later version.
 
 #include "orbit.h"
+#include "chebyshevcache.h"
 #include <celengine/body.h>
 #include <celmath/mathlib.h>
 #include <celmath/solve.h>
 #include <celmath/geomutil.h>
+#include <celutil/threadcache.h>
 #include <functional>
 #include <algorithm>
 #include <cmath>
@@ -43,10 +45,10 @@ static Vector3d cubicInterpolate(const Vector3d& p0, const Vector3d& v0,
   *
   * Subclasses of orbit should override this method as necessary. The default
   * implementation uses an adaptive sampling scheme with the following defaults:
-  *    tolerance: 1 km
+  *    tolerance: the tolerance of proc, or 1 km if it has none
   *    start step: T / 1e5
   *    min step: T / 1e7
-  *    max step: T / 100
+  *    max step: T / 32, or T / 100 without a tolerance
   *
   * Where T is either the mean orbital period for periodic orbits or the valid
   * time span for aperiodic trajectories.
@@ -74,8 +76,18 @@ void Orbit::sample(double startTime, double endTime, OrbitSampleProc& proc) cons
     }
 
     AdaptiveSamplingParameters samplingParams;
-    samplingParams.tolerance = 1.0; // kilometers
-    samplingParams.maxStep = span / 100.0;
+    if (proc.getTolerance() > 0.0)
+    {
+        // Cubic Hermite curves follow nearly circular orbits closely with
+        // a few dozen samples per revolution.
+        samplingParams.tolerance = proc.getTolerance();
+        samplingParams.maxStep = span / 32.0;
+    }
+    else
+    {
+        samplingParams.tolerance = 1.0; // kilometers
+        samplingParams.maxStep = span / 100.0;
+    }
     samplingParams.minStep = span / 1.0e7;
     samplingParams.startStep = span / 1.0e5;
 
@@ -84,10 +96,15 @@ void Orbit::sample(double startTime, double endTime, OrbitSampleProc& proc) cons
 
 
 /** Adaptively sample the orbit over the range [ startTime, endTime ].
+  *
+  * The error of a step is the distance at its midpoint between the orbit
+  * and the cubic Hermite curve through the positions and velocities at
+  * both ends, which is the curve drawn by CurvePlot. Each step starts from
+  * the length of the previous one and takes the longest step whose error
+  * is within the tolerance, unless the minimum step is reached first.
   */
 void Orbit::adaptiveSample(double startTime, double endTime, OrbitSampleProc& proc, const AdaptiveSamplingParameters& samplingParams) const
 {
-    double startStepSize = samplingParams.startStep;
     double maxStepSize   = samplingParams.maxStep;
     double minStepSize   = samplingParams.minStep;
     double tolerance     = samplingParams.tolerance;
@@ -97,80 +114,63 @@ void Orbit::adaptiveSample(double startTime, double endTime, OrbitSampleProc& pr
     Vector3d lastP = positionAtTime(t);
     Vector3d lastV = velocityAtTime(t);
     proc.sample(t, lastP, lastV);
-    int sampCount = 0;
-    int nTests = 0;
 
-    while (t < endTime)
+    // Error of the step dt from t, with the state at its end
+    auto stepError = [&](double dt, Vector3d& p1, Vector3d& v1)
     {
-        // Make sure that we don't go past the end of the sample interval
-        maxStepSize = min(maxStepSize, endTime - t);
-        double dt = min(maxStepSize, startStepSize * 2.0);
+        p1 = positionAtTime(t + dt);
+        v1 = velocityAtTime(t + dt);
 
-        Vector3d p1 = positionAtTime(t + dt);
-        Vector3d v1 = velocityAtTime(t + dt);
-
-        double tmid = t + dt / 2.0;
-        Vector3d pTest = positionAtTime(tmid);
+        Vector3d pTest = positionAtTime(t + dt / 2.0);
         Vector3d pInterp = cubicInterpolate(lastP, lastV * dt,
                                             p1, v1 * dt,
                                             0.5);
-        nTests++;
+        return (pInterp - pTest).norm();
+    };
 
-        double positionError = (pInterp - pTest).norm();
+    double dt = samplingParams.startStep;
+    while (t < endTime)
+    {
+        // Make sure that we don't go past the end of the sample interval
+        double stepLimit = min(maxStepSize, endTime - t);
+        dt = max(min(dt, stepLimit), min(minStepSize, stepLimit));
+
+        Vector3d p1, v1;
+        double positionError = stepError(dt, p1, v1);
 
-        // Error is greater than tolerance; decrease the step until the
-        // error is within the tolerance.
         if (positionError > tolerance)
         {
+            // Error is greater than tolerance; decrease the step until the
+            // error is within the tolerance.
             while (positionError > tolerance && dt > minStepSize)
             {
-                dt /= stepFactor;
-
-                p1 = positionAtTime(t + dt);
-                v1 = velocityAtTime(t + dt);
-
-                tmid = t + dt / 2.0;
-                pTest = positionAtTime(tmid);
-                pInterp = cubicInterpolate(lastP, lastV * dt,
-                                           p1, v1 * dt,
-                                           0.5);
-                nTests++;
-
-                positionError = (pInterp - pTest).norm();
+                dt = max(dt / stepFactor, minStepSize);
+                positionError = stepError(dt, p1, v1);
             }
         }
         else
         {
-            // Error is less than the tolerance; increase the step size until the
-            // tolerance is just exceeded.
-            while (positionError < tolerance && dt < maxStepSize)
+            // Error is within the tolerance; increase the step size until
+            // the tolerance would be exceeded.
+            while (dt < stepLimit)
             {
-                dt *= stepFactor;
-
-                p1 = positionAtTime(t + dt);
-                v1 = velocityAtTime(t + dt);
-
-                tmid = t + dt / 2.0;
-                pTest = positionAtTime(tmid);
-                pInterp = cubicInterpolate(lastP, lastV * dt,
-                                           p1, v1 * dt,
-                                           0.5);
-                nTests++;
-
-                positionError = (pInterp - pTest).norm();
+                double longerStep = min(dt * stepFactor, stepLimit);
+                Vector3d p2, v2;
+                if (stepError(longerStep, p2, v2) > tolerance)
+                    break;
+                dt = longerStep;
+                p1 = p2;
+                v1 = v2;
             }
         }
 
-        t = t + dt;
+        // Land exactly on the end of the interval
+        t = dt >= endTime - t ? endTime : t + dt;
         lastP = p1;
         lastV = v1;
 
         proc.sample(t, lastP, lastV);
-        sampCount++;
     }
-
-    // Statistics for debugging
-    // clog << "Orbit samples: " << sampCount << ", nTests: " << nTests << endl;
 }
 
 
@@ -433,41 +433,111 @@ double EllipticalOrbit::getBoundingRadius() const
 }
 
 
-Vector3d CachingOrbit::positionAtTime(double jd) const
+namespace
 {
-    if (jd != lastTime)
+// An entry of the position and velocity cache of CachingOrbit. Each thread
+// has its own table; entries are found by hashing the orbit key and the
+// time, and are simply overwritten by later ones mapping to the same
+// place.
+struct OrbitCacheEntry
+{
+    uint64_t key{ 0 };
+    double jd{ 0.0 };
+    Vector3d position;
+    Vector3d velocity;
+    bool hasPosition{ false };
+    bool hasVelocity{ false };
+};
+
+constexpr const unsigned int ORBIT_CACHE_SIZE = 256;
+
+thread_local OrbitCacheEntry orbitCache[ORBIT_CACHE_SIZE];
+
+// Return the entry for an orbit and time, reset if it held another one
+OrbitCacheEntry& orbitCacheEntry(uint64_t key, double jd)
+{
+    OrbitCacheEntry& entry = orbitCache[threadCacheIndex(key, jd, ORBIT_CACHE_SIZE)];
+    if (entry.key != key || entry.jd != jd)
     {
-        lastTime = jd;
-        lastPosition = computePosition(jd);
-        positionCacheValid = true;
-        velocityCacheValid = false;
+        entry.key = key;
+        entry.jd = jd;
+        entry.hasPosition = false;
+        entry.hasVelocity = false;
     }
-    else if (!positionCacheValid)
+    return entry;
+}
+}
+
+
+CachingOrbit::CachingOrbit() :
+    cacheKey(newThreadCacheKey())
+{
+}
+
+
+CachingOrbit::~CachingOrbit() = default;
+
+
+void CachingOrbit::setChebyshevTolerance(double tolerance)
+{
+    if (tolerance > 0.0)
+        chebyshevCache.reset(new ChebyshevCache(*this, tolerance));
+    else
+        chebyshevCache.reset();
+    cacheKey = newThreadCacheKey();
+}
+
+
+// Computing a position or velocity may evaluate other orbits, and even
+// this one at other times, which can reuse the cache entry; it is looked
+// up again before storing the result.
+Vector3d CachingOrbit::positionAtTime(double jd) const
+{
+    OrbitCacheEntry& entry = orbitCacheEntry(cacheKey, jd);
+    if (entry.hasPosition)
+        return entry.position;
+
+    Vector3d position;
+    Vector3d velocity;
+    bool hasState = !chebyshevCache && computeState(jd, position, velocity);
+    if (!hasState)
+        position = chebyshevCache ? chebyshevCache->position(jd) : computePosition(jd);
+
+    OrbitCacheEntry& newEntry = orbitCacheEntry(cacheKey, jd);
+    newEntry.position = position;
+    newEntry.hasPosition = true;
+    if (hasState)
     {
-        lastPosition = computePosition(jd);
-        positionCacheValid = true;
+        newEntry.velocity = velocity;
+        newEntry.hasVelocity = true;
     }
 
-    return lastPosition;
+    return position;
 }
 
 
 Vector3d CachingOrbit::velocityAtTime(double jd) const
 {
-    if (jd != lastTime)
-    {
-        lastVelocity = computeVelocity(jd);
-        lastTime = jd;  // must be set *after* call to computeVelocity
-        positionCacheValid = false;
-        velocityCacheValid = true;
-    }
-    else if (!velocityCacheValid)
+    OrbitCacheEntry& entry = orbitCacheEntry(cacheKey, jd);
+    if (entry.hasVelocity)
+        return entry.velocity;
+
+    Vector3d position;
+    Vector3d velocity;
+    bool hasState = !chebyshevCache && computeState(jd, position, velocity);
+    if (!hasState)
+        velocity = chebyshevCache ? chebyshevCache->velocity(jd) : computeVelocity(jd);
+
+    OrbitCacheEntry& newEntry = orbitCacheEntry(cacheKey, jd);
+    newEntry.velocity = velocity;
+    newEntry.hasVelocity = true;
+    if (hasState)
     {
-        lastVelocity = computeVelocity(jd);
-        velocityCacheValid = true;
+        newEntry.position = position;
+        newEntry.hasPosition = true;
     }
 
-    return lastVelocity;
+    return velocity;
 }
 
 
@@ -480,8 +550,9 @@ Vector3d CachingOrbit::computeVelocity(double jd) const
     // Compute the velocity by differentiating.
     Vector3d p0 = positionAtTime(jd);
 
-    // Call computePosition() instead of positionAtTime() so that we
-    // don't affect the cached value.
+    // Call computePosition() instead of positionAtTime() so that the
+    // nearby time neither fills a cache entry nor counts as a lookup of
+    // the Chebyshev cache.
     // TODO: check the valid ranges of the orbit to make sure that
     // jd+dt is still in range.
     Vector3d p1 = computePosition(jd + ORBITAL_VELOCITY_DIFF_DELTA);
@@ -490,6 +561,19 @@ Vector3d CachingOrbit::computeVelocity(double jd) const
 }
 
 
+bool CachingOrbit::computeState(double /*jd*/, Vector3d& /*position*/, Vector3d& /*velocity*/) const
+{
+    return false;
+}
+
+
+void CachingOrbit::computePositions(const double* jd, Vector3d* positions, unsigned int n) const
+{
+    for (unsigned int i = 0; i < n; i++)
+        positions[i] = computePosition(jd[i]);
+}
+
+
 static EllipticalOrbit* StateVectorToOrbit(const Vector3d& position,
                                            const Vector3d& v,
                                            double mass,
@@ -10,10 +10,13 @@
 #ifndef _CELENGINE_ORBIT_H_
 #define _CELENGINE_ORBIT_H_
 
+#include <cstdint>
+#include <memory>
 #include <Eigen/Core>
 
 
 class OrbitSampleProc;
+class ChebyshevCache;
 
 class Orbit
 {
@@ -39,6 +42,13 @@ class Orbit
 
     virtual bool isPeriodic() const { return true; };
 
+    /*! Return true if the orbit may be evaluated on several threads at
+     *  once, so that its path can be sampled in the background. Orbits
+     *  computed by scripts or by libraries that aren't thread safe
+     *  return false.
+     */
+    virtual bool isThreadSafe() const { return true; }
+
     // Return the time range over which the orbit is valid; if the orbit
     // is always valid, begin and end should be equal.
     virtual void getValidRange(double& begin, double& end) const
@@ -93,37 +103,59 @@ class OrbitSampleProc
     virtual ~OrbitSampleProc() = default;
 
     virtual void sample(double t, const Eigen::Vector3d& position, const Eigen::Vector3d& velocity) = 0;
+
+    /*! Return the largest distance in kilometers allowed between the orbit
+     *  and the cubic Hermite curves through the samples, or zero to let the
+     *  orbit use its default sampling.
+     */
+    virtual double getTolerance() const { return 0.0; }
 };
 
 
 
-/*! Custom orbit classes should be derived from CachingOrbit.  The custom
- * orbits can be expensive to compute, with more than 50 periodic terms.
- * Celestia may need require position of a planet more than once per frame; in
- * order to avoid redundant calculation, the CachingOrbit class saves the
- * result of the last calculation and uses it if the time matches the cached
- * time.
+/*! CachingOrbit is the base class of orbits whose positions are
+ *  expensive to compute. Recently computed positions and velocities are
+ *  kept in a small table owned by each thread, keyed by orbit and time,
+ *  so the same orbit can be evaluated concurrently by several threads,
+ *  and a velocity computed by differentiation doesn't evict the position
+ *  at the same time.
  */
 class CachingOrbit : public Orbit
 {
  public:
-    CachingOrbit() = default;
-    virtual ~CachingOrbit() = default;
+    CachingOrbit();
+    virtual ~CachingOrbit();
 
     virtual Eigen::Vector3d computePosition(double jd) const = 0;
     virtual Eigen::Vector3d computeVelocity(double jd) const;
+    // Positions at n times; orbits that evaluate several times at once
+    // faster than one after the other override this. Used to fit the
+    // segments of the Chebyshev cache, whose times are all known up
+    // front, unlike those of adaptive sampling.
+    virtual void computePositions(const double* jd, Eigen::Vector3d* positions, unsigned int n) const;
+    // Position and velocity at once, for orbits that get both from the
+    // same evaluation; returns false when they are computed separately.
+    // Called when either of them is missing from the cache, which then
+    // keeps both.
+    virtual bool computeState(double jd, Eigen::Vector3d& position, Eigen::Vector3d& velocity) const;
     virtual double getPeriod() const = 0;
     virtual double getBoundingRadius() const = 0;
 
     Eigen::Vector3d positionAtTime(double jd) const;
     Eigen::Vector3d velocityAtTime(double jd) const;
 
+    /*! Compute positions and velocities from Chebyshev polynomials fitted
+     *  to computePosition(), within tolerance kilometers of it; a
+     *  tolerance of zero computes them directly again. See ChebyshevCache.
+     */
+    void setChebyshevTolerance(double tolerance);
+
  private:
-    mutable Eigen::Vector3d lastPosition;
-    mutable Eigen::Vector3d lastVelocity;
-    mutable double lastTime{ -1.0e30 };
-    mutable bool positionCacheValid{ false };
-    mutable bool velocityCacheValid{ false };
+    std::unique_ptr<ChebyshevCache> chebyshevCache;
+
+    // Key of the orbit in the per thread caches; changed whenever the
+    // cached values would become stale.
+    uint64_t cacheKey;
 };
 
 
@@ -144,6 +176,7 @@ class MixedOrbit : public Orbit
     virtual double getPeriod() const;
     virtual double getBoundingRadius() const;
     virtual void sample(double startTime, double endTime, OrbitSampleProc& proc) const;
+    virtual bool isThreadSafe() const { return primary->isThreadSafe(); }
 
  private:
     Orbit* primary;
@@ -173,6 +206,9 @@ class SynchronousOrbit : public Orbit
     virtual double getPeriod() const;
     virtual double getBoundingRadius() const;
     virtual void sample(double, double, OrbitSampleProc& proc) const;
+    // Positions depend on the rotation model of the body, which may be
+    // scripted
+    virtual bool isThreadSafe() const { return false; }
 
  private:
     const Body& body;
@@ -14,6 +14,7 @@
 #include "rotation.h"
 #include <celmath/geomutil.h>
 #include <celmath/mathlib.h>
+#include <celutil/threadcache.h>
 #include <cmath>
 
 using namespace Eigen;
@@ -55,75 +56,102 @@ RotationModel::angularVelocityAtTime(double tdb) const
 
 /***** CachingRotationModel *****/
 
+namespace
+{
+// An entry of the orientation cache of CachingRotationModel; each thread
+// has its own table, like the position cache of CachingOrbit.
+struct RotationCacheEntry
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    Quaterniond spin;
+    Quaterniond equator;
+    Vector3d angularVelocity;
+    uint64_t key{ 0 };
+    double tjd{ 0.0 };
+    bool hasSpin{ false };
+    bool hasEquator{ false };
+    bool hasAngularVelocity{ false };
+};
+
+constexpr const unsigned int ROTATION_CACHE_SIZE = 64;
+
+thread_local RotationCacheEntry rotationCache[ROTATION_CACHE_SIZE];
+
+// Return the entry for a rotation model and time, reset if it held
+// another one
+RotationCacheEntry& rotationCacheEntry(uint64_t key, double tjd)
+{
+    RotationCacheEntry& entry = rotationCache[threadCacheIndex(key, tjd, ROTATION_CACHE_SIZE)];
+    if (entry.key != key || entry.tjd != tjd)
+    {
+        entry.key = key;
+        entry.tjd = tjd;
+        entry.hasSpin = false;
+        entry.hasEquator = false;
+        entry.hasAngularVelocity = false;
+    }
+    return entry;
+}
+}
+
+
 CachingRotationModel::CachingRotationModel() :
-    lastTime(365.0),
-    spinCacheValid(false),
-    equatorCacheValid(false),
-    angularVelocityCacheValid(false)
+    cacheKey(newThreadCacheKey())
 {
 }
 
 
+// The entry is looked up again once the value is computed, as computing
+// it may have used the same entry for another rotation model.
 Quaterniond
 CachingRotationModel::spin(double tjd) const
 {
-    if (tjd != lastTime)
-    {
-        lastTime = tjd;
-        lastSpin = computeSpin(tjd);
-        spinCacheValid = true;
-        equatorCacheValid = false;
-        angularVelocityCacheValid = false;
-    }
-    else if (!spinCacheValid)
-    {
-        lastSpin = computeSpin(tjd);
-        spinCacheValid = true;
-    }
+    RotationCacheEntry& entry = rotationCacheEntry(cacheKey, tjd);
+    if (entry.hasSpin)
+        return entry.spin;
+
+    Quaterniond spin = computeSpin(tjd);
 
-    return lastSpin;
+    RotationCacheEntry& newEntry = rotationCacheEntry(cacheKey, tjd);
+    newEntry.spin = spin;
+    newEntry.hasSpin = true;
+
+    return spin;
 }
 
 
 Quaterniond
 CachingRotationModel::equatorOrientationAtTime(double tjd) const
 {
-    if (tjd != lastTime)
-    {
-        lastTime = tjd;
-        lastEquator = computeEquatorOrientation(tjd);
-        spinCacheValid = false;
-        equatorCacheValid = true;
-        angularVelocityCacheValid = false;
-    }
-    else if (!equatorCacheValid)
-    {
-        lastEquator = computeEquatorOrientation(tjd);
-        equatorCacheValid = true;
-    }
+    RotationCacheEntry& entry = rotationCacheEntry(cacheKey, tjd);
+    if (entry.hasEquator)
+        return entry.equator;
+
+    Quaterniond equator = computeEquatorOrientation(tjd);
 
-    return lastEquator;
+    RotationCacheEntry& newEntry = rotationCacheEntry(cacheKey, tjd);
+    newEntry.equator = equator;
+    newEntry.hasEquator = true;
+
+    return equator;
 }
 
 
 Vector3d
 CachingRotationModel::angularVelocityAtTime(double tjd) const
 {
-    if (tjd != lastTime)
-    {
-        lastAngularVelocity = computeAngularVelocity(tjd);
-        lastTime = tjd;
-        spinCacheValid = false;
-        equatorCacheValid = false;
-        angularVelocityCacheValid = true;
-    }
-    else if (!angularVelocityCacheValid)
-    {
-        lastAngularVelocity = computeAngularVelocity(tjd);
-        angularVelocityCacheValid = true;
-    }
+    RotationCacheEntry& entry = rotationCacheEntry(cacheKey, tjd);
+    if (entry.hasAngularVelocity)
+        return entry.angularVelocity;
+
+    Vector3d angularVelocity = computeAngularVelocity(tjd);
+
+    RotationCacheEntry& newEntry = rotationCacheEntry(cacheKey, tjd);
+    newEntry.angularVelocity = angularVelocity;
+    newEntry.hasAngularVelocity = true;
 
-    return lastAngularVelocity;
+    return angularVelocity;
 }
 
 
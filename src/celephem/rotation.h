@@ -11,6 +11,7 @@
 #ifndef _CELENGINE_ROTATION_H_
 #define _CELENGINE_ROTATION_H_
 
+#include <cstdint>
 #include <Eigen/Geometry>
 
 
@@ -71,13 +72,22 @@ class RotationModel
         begin = 0.0;
         end = 0.0;
     };
+
+    /*! Return true if the orientation may be computed on several threads
+     *  at once. Rotations computed by scripts or by libraries that aren't
+     *  thread safe return false.
+     */
+    virtual bool isThreadSafe() const
+    {
+        return true;
+    }
 };
 
 
 /*! CachingRotationModel is an abstract base class for complicated rotation
- *  models that are computationally expensive. The last calculated spin,
- *  equator orientation, and angular velocity are all cached and reused in
- *  order to avoid redundant calculation. Subclasses must override computeSpin(),
+ *  models that are computationally expensive. Recently calculated spins,
+ *  equator orientations, and angular velocities are cached per thread and
+ *  reused in order to avoid redundant calculation. Subclasses must override computeSpin(),
  *  computeEquatorOrientation(), and getPeriod(). The default implementation
  *  of computeAngularVelocity uses differentiation to approximate the
  *  the instantaneous angular velocity. It may be overridden if there is some
@@ -103,13 +113,8 @@ class CachingRotationModel : public RotationModel
     virtual bool isPeriodic() const = 0;
 
 private:
-    mutable Eigen::Quaterniond lastSpin;
-    mutable Eigen::Quaterniond lastEquator;
-    mutable Eigen::Vector3d lastAngularVelocity;
-    mutable double lastTime;
-    mutable bool spinCacheValid;
-    mutable bool equatorCacheValid;
-    mutable bool angularVelocityCacheValid;
+    // Key of the rotation model in the per thread caches
+    uint64_t cacheKey;
 };
 
 
@@ -18,9 +18,12 @@
 #include <celutil/bytes.h>
 #include <celutil/gettext.h>
 #include <celutil/debug.h>
+#include <celutil/mappedfile.h>
 #include <cmath>
+#include <cstring>
 #include <string>
 #include <algorithm>
+#include <atomic>
 #include <vector>
 #include <iostream>
 #include <fstream>
@@ -88,7 +91,9 @@ private:
     vector<Sample<T> > samples;
     double boundingRadius;
     double period;
-    mutable int lastSample;
+    // Hint for the next lookup; only read and written atomically, as the
+    // orbit may be evaluated from several threads.
+    mutable std::atomic<int> lastSample;
 
     TrajectoryInterpolation interpolation;
 };
@@ -453,7 +458,9 @@ private:
     vector<SampleXYZV<T> > samples;
     double boundingRadius;
     double period;
-    mutable int lastSample;
+    // Hint for the next lookup; only read and written atomically, as the
+    // orbit may be evaluated from several threads.
+    mutable std::atomic<int> lastSample;
 
     TrajectoryInterpolation interpolation;
 };
@@ -665,6 +672,213 @@ template <typename T> void SampledOrbitXYZV<T>::sample(double /* startTime */, d
 }
 
 
+/*! Sampled orbit with positions and velocities read from a memory mapped
+ *  indexed xyzv file. The samples are never copied into memory; the ones
+ *  around a time are located through the index entries of its chunk,
+ *  with a binary search of the few samples of the chunk, so only the
+ *  pages of the times actually visited are read from disk.
+ */
+class MappedOrbitXYZV : public CachingOrbit
+{
+public:
+    MappedOrbitXYZV(MappedFile&& _file, const XYZVIndexedHeader& header, TrajectoryInterpolation _interpolation);
+    ~MappedOrbitXYZV() override = default;
+
+    double getPeriod() const override;
+    double getBoundingRadius() const override;
+    Vector3d computePosition(double jd) const override;
+    Vector3d computeVelocity(double jd) const override;
+
+    bool isPeriodic() const override;
+    void getValidRange(double& begin, double& end) const override;
+
+    void sample(double startTime, double endTime, OrbitSampleProc& proc) const override;
+
+private:
+    uint64_t findSample(double jd) const;
+    Vector3d position(uint64_t n) const;
+    Vector3d velocity(uint64_t n) const;
+
+    MappedFile file;
+    const uint64_t* index;
+    const XYZVBinaryData* samples;
+    uint64_t count;
+    uint64_t chunkCount;
+    double indexStart;
+    double chunkDuration;
+    double boundingRadius;
+
+    TrajectoryInterpolation interpolation;
+};
+
+
+MappedOrbitXYZV::MappedOrbitXYZV(MappedFile&& _file,
+                                 const XYZVIndexedHeader& header,
+                                 TrajectoryInterpolation _interpolation) :
+    file(std::move(_file)),
+    count(header.count),
+    chunkCount(header.chunkCount),
+    indexStart(header.startTime),
+    chunkDuration(header.chunkDuration),
+    boundingRadius(header.boundingRadius),
+    interpolation(_interpolation)
+{
+    const char* data = file.data() + sizeof(XYZVIndexedHeader);
+    index = reinterpret_cast<const uint64_t*>(data);
+    samples = reinterpret_cast<const XYZVBinaryData*>(data + (chunkCount + 1) * sizeof(uint64_t));
+}
+
+
+double MappedOrbitXYZV::getPeriod() const
+{
+    return samples[count - 1].tdb - samples[0].tdb;
+}
+
+
+bool MappedOrbitXYZV::isPeriodic() const
+{
+    return false;
+}
+
+
+void MappedOrbitXYZV::getValidRange(double& begin, double& end) const
+{
+    begin = samples[0].tdb;
+    end = samples[count - 1].tdb;
+}
+
+
+double MappedOrbitXYZV::getBoundingRadius() const
+{
+    return boundingRadius;
+}
+
+
+// Position in km of sample n
+Vector3d MappedOrbitXYZV::position(uint64_t n) const
+{
+    return Map<const Vector3d>(samples[n].position);
+}
+
+
+// Velocity in km/Julian day of sample n; files store km/sec.
+Vector3d MappedOrbitXYZV::velocity(uint64_t n) const
+{
+    return Map<const Vector3d>(samples[n].velocity) * astro::daysToSecs(1.0);
+}
+
+
+// Return the index of the first sample not before jd, or the number of
+// samples if there is none.
+uint64_t MappedOrbitXYZV::findSample(double jd) const
+{
+    double chunk = floor((jd - indexStart) / chunkDuration);
+    auto c = (uint64_t) max(0.0, min(chunk, (double) (chunkCount - 1)));
+
+    // Rounding may put times at the very edge of a chunk into the next
+    // or the previous one; widen the range then.
+    uint64_t lo = index[c];
+    uint64_t hi = index[c + 1];
+    while (lo > 0 && samples[lo - 1].tdb >= jd)
+        lo--;
+    while (hi < count && samples[hi].tdb < jd)
+        hi++;
+
+    auto iter = lower_bound(samples + lo, samples + hi, jd,
+                            [](const XYZVBinaryData& s, double t) { return s.tdb < t; });
+    return (uint64_t) (iter - samples);
+}
+
+
+Vector3d MappedOrbitXYZV::computePosition(double jd) const
+{
+    Vector3d pos;
+    uint64_t n = findSample(jd);
+    if (n == 0)
+    {
+        pos = position(0);
+    }
+    else if (n < count)
+    {
+        const XYZVBinaryData& s0 = samples[n - 1];
+        const XYZVBinaryData& s1 = samples[n];
+        double h = s1.tdb - s0.tdb;
+        double t = (jd - s0.tdb) / h;
+
+        if (interpolation == TrajectoryInterpolationLinear)
+        {
+            Vector3d p0 = position(n - 1);
+            pos = p0 + t * (position(n) - p0);
+        }
+        else if (interpolation == TrajectoryInterpolationCubic)
+        {
+            pos = cubicInterpolate(position(n - 1), velocity(n - 1) * h, position(n), velocity(n) * h, t);
+        }
+        else
+        {
+            // Unknown interpolation type
+            pos = Vector3d::Zero();
+        }
+    }
+    else
+    {
+        pos = position(count - 1);
+    }
+
+    // Add correction for Celestia's coordinate system
+    return Vector3d(pos.x(), pos.z(), -pos.y());
+}
+
+
+// Velocity is computed as the derivative of the interpolating function
+// for position.
+Vector3d MappedOrbitXYZV::computeVelocity(double jd) const
+{
+    Vector3d vel(Vector3d::Zero());
+
+    uint64_t n = findSample(jd);
+    if (n > 0 && n < count)
+    {
+        const XYZVBinaryData& s0 = samples[n - 1];
+        const XYZVBinaryData& s1 = samples[n];
+        double h = s1.tdb - s0.tdb;
+
+        if (interpolation == TrajectoryInterpolationLinear)
+        {
+            vel = (position(n) - position(n - 1)) / h;
+        }
+        else if (interpolation == TrajectoryInterpolationCubic)
+        {
+            double t = (jd - s0.tdb) / h;
+            vel = cubicInterpolateVelocity(position(n - 1), velocity(n - 1) * h,
+                                           position(n), velocity(n) * h, t) / h;
+        }
+    }
+
+    // Add correction for Celestia's coordinate system
+    return Vector3d(vel.x(), vel.z(), -vel.y());
+}
+
+
+// Only the samples in [startTime, endTime], with the ones just outside of
+// it, are visited, so that sampling a time window doesn't read the pages
+// of the whole file.
+void MappedOrbitXYZV::sample(double startTime, double endTime, OrbitSampleProc& proc) const
+{
+    uint64_t first = findSample(startTime);
+    if (first > 0)
+        first--;
+    uint64_t last = min(findSample(endTime), count - 1);
+
+    for (uint64_t n = first; n <= last; n++)
+    {
+        Vector3d p = position(n);
+        Vector3d v = velocity(n);
+        proc.sample(samples[n].tdb, Vector3d(p.x(), p.z(), -p.y()), Vector3d(v.x(), v.z(), -v.y()));
+    }
+}
+
+
 // Scan past comments. A comment begins with the # character and ends
 // with a newline. Return true if the stream state is good. The stream
 // position will be at the first non-comment, non-whitespace character.
@@ -894,6 +1108,64 @@ LoadSampledOrbitXYZVBinary(const fs::path& filename, TrajectoryInterpolation int
 }
 
 
+/* Map an indexed binary xyzv sampled trajectory file. Return nullptr
+ * without complaint when the file doesn't exist or has another format.
+ */
+static Orbit* LoadMappedOrbitXYZV(const fs::path& filename, TrajectoryInterpolation interpolation)
+{
+    MappedFile file;
+    if (!file.open(filename) || file.size() < sizeof(XYZVIndexedHeader) ||
+        memcmp(file.data(), "CELXYZVI", sizeof(XYZVIndexedHeader::magic)) != 0)
+    {
+        return nullptr;
+    }
+
+    XYZVIndexedHeader header;
+    memcpy(&header, file.data(), sizeof header);
+
+    if (header.byteOrder != __BYTE_ORDER__)
+    {
+        fmt::fprintf(cerr, _("Unsupported byte order %i, expected %i.\n"),
+                     header.byteOrder, __BYTE_ORDER__);
+        return nullptr;
+    }
+
+    if (header.digits != std::numeric_limits<double>::digits)
+    {
+        fmt::fprintf(cerr, _("Unsupported digits number %i, expected %i.\n"),
+                     header.digits, std::numeric_limits<double>::digits);
+        return nullptr;
+    }
+
+    // Sizes are compared by division, as products of the counts of a bad
+    // file could wrap around.
+    size_t dataSize = file.size() - sizeof header;
+    if (header.count == 0 || header.chunkCount == 0 || !(header.chunkDuration > 0.0) ||
+        header.chunkCount >= dataSize / sizeof(uint64_t) ||
+        (dataSize - (header.chunkCount + 1) * sizeof(uint64_t)) % sizeof(XYZVBinaryData) != 0 ||
+        header.count != (dataSize - (header.chunkCount + 1) * sizeof(uint64_t)) / sizeof(XYZVBinaryData))
+    {
+        fmt::fprintf(cerr, _("Bad binary xyzv file %s.\n"), filename);
+        return nullptr;
+    }
+
+    // The lookups stay within the samples as long as the index entries
+    // are in order and end with the sample count. Only the index is
+    // checked, so that no sample pages are read in before they're used.
+    const auto* index = reinterpret_cast<const uint64_t*>(file.data() + sizeof header);
+    bool valid = index[header.chunkCount] == header.count;
+    for (uint64_t i = 0; valid && i < header.chunkCount; i++)
+        valid = index[i] <= index[i + 1];
+    if (!valid)
+    {
+        fmt::fprintf(cerr, _("Bad index in binary xyzv file %s.\n"), filename);
+        return nullptr;
+    }
+
+    return new MappedOrbitXYZV(std::move(file), header, interpolation);
+}
+
+
 /*! Load a trajectory file containing single precision positions.
  */
 Orbit* LoadSampledTrajectorySinglePrec(const fs::path& filename, TrajectoryInterpolation interpolation)
@@ -915,7 +1187,12 @@ Orbit* LoadSampledTrajectoryDoublePrec(const fs::path& filename, TrajectoryInter
 Orbit* LoadXYZVTrajectorySinglePrec(const fs::path& filename, TrajectoryInterpolation interpolation)
 {
     auto f = filename;
-    Orbit* ret = LoadSampledOrbitXYZVBinary(f += fs::path("bin"), interpolation, 0.0f); // FIXME
+    f += fs::path("bin"); // FIXME
+    Orbit* ret = LoadMappedOrbitXYZV(f, interpolation);
+    if (ret != nullptr)
+        return ret;
+
+    ret = LoadSampledOrbitXYZVBinary(f, interpolation, 0.0f);
     if (ret != nullptr)
         return ret;
 
@@ -928,7 +1205,12 @@ Orbit* LoadXYZVTrajectorySinglePrec(const fs::path& filename, TrajectoryInterpol
 Orbit* LoadXYZVTrajectoryDoublePrec(const fs::path& filename, TrajectoryInterpolation interpolation)
 {
     auto f = filename;
-    Orbit* ret = LoadSampledOrbitXYZVBinary(f += fs::path("bin"), interpolation, 0.0); // FIXME
+    f += fs::path("bin"); // FIXME
+    Orbit* ret = LoadMappedOrbitXYZV(f, interpolation);
+    if (ret != nullptr)
+        return ret;
+
+    ret = LoadSampledOrbitXYZVBinary(f, interpolation, 0.0);
     if (ret != nullptr)
         return ret;
 
@@ -18,6 +18,7 @@
 #include <cassert>
 #include <string>
 #include <algorithm>
+#include <atomic>
 #include <vector>
 #include <iostream>
 #include <fstream>
@@ -99,7 +100,9 @@ private:
 
 private:
     OrientationSampleVector samples;
-    mutable int lastSample{0};
+    // Hint for the next lookup; only a hint, so relaxed atomic accesses
+    // suffice when the orientation is computed on several threads.
+    mutable std::atomic<int> lastSample{0};
 
     enum InterpolationType
     {
@@ -165,7 +168,7 @@ SampledOrientation::getOrientation(double tjd) const
     {
         OrientationSample samp;
         samp.t = tjd;
-        int n = lastSample;
+        int n = lastSample.load(memory_order_relaxed);
 
         // Do a binary search to find the samples that define the orientation
         // at the current time. Cache the previous sample used and avoid
@@ -180,7 +183,7 @@ SampledOrientation::getOrientation(double tjd) const
             else
                 n = iter - samples.begin();
 
-            lastSample = n;
+            lastSample.store(n, memory_order_relaxed);
         }
 
         if (n == 0)
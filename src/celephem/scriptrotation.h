@@ -33,6 +33,8 @@ class ScriptedRotation : public RotationModel
     virtual bool isPeriodic() const;
     virtual double getPeriod() const;
     virtual void getValidRange(double& begin, double& end) const;
+    // The Lua state may only be used by one thread
+    virtual bool isThreadSafe() const { return false; }
 
  private:
     lua_State* luaState{ nullptr };
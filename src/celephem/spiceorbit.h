@@ -48,6 +48,8 @@ class SpiceOrbit : public CachingOrbit
     Eigen::Vector3d computeVelocity(double jd) const;
 
     virtual void getValidRange(double& begin, double& end) const;
+    // The SPICE toolkit isn't thread safe
+    virtual bool isThreadSafe() const { return false; }
 
  private:
     const std::string targetBodyName;
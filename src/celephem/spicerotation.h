@@ -36,6 +36,8 @@ class SpiceRotation : public CachingRotationModel
 
     bool isPeriodic() const;
     double getPeriod() const;
+    // The SPICE toolkit isn't thread safe
+    bool isThreadSafe() const { return false; }
 
     // No notion of an equator for SPICE rotation models
     Eigen::Quaterniond computeEquatorOrientation(double /* tdb */) const
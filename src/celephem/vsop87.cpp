@@ -15,6 +15,7 @@
 #include <cmath>
 #include <celmath/mathlib.h>
 #include <celengine/astro.h>
+#include "chebyshevcache.h"
 #include "vsop87.h"
 
 using namespace Eigen;
@@ -26,14 +27,34 @@ struct VSOPTerm
     double A, B, C;
 };
 
+// Number of terms, or of times, evaluated together by the vectorized
+// series
+constexpr const int VSOP_BLOCK = 8;
+
 struct VSOPSeries
 {
-    VSOPSeries(VSOPTerm* _terms, int _nTerms) :
-        terms(_terms), nTerms(_nTerms) {};
+    VSOPSeries(VSOPTerm* _terms, int _nTerms);
     VSOPTerm* terms;
     int nTerms;
+    // The terms transposed, padded with zero terms to whole blocks
+    ArrayXd A, B, C;
 };
 
+VSOPSeries::VSOPSeries(VSOPTerm* _terms, int _nTerms) :
+    terms(_terms), nTerms(_nTerms)
+{
+    int padded = (nTerms + VSOP_BLOCK - 1) / VSOP_BLOCK * VSOP_BLOCK;
+    A = ArrayXd::Zero(padded);
+    B = ArrayXd::Zero(padded);
+    C = ArrayXd::Zero(padded);
+    for (int i = 0; i < nTerms; i++)
+    {
+        A[i] = terms[i].A;
+        B[i] = terms[i].B;
+        C[i] = terms[i].C;
+    }
+}
+
 // Terms from the VSOP87 Planetary Theories
 // Bretagnon P., Francou G.
 // Astron. Astrophys. 202, 309 (1988)
@@ -10998,7 +11019,53 @@ static VSOPSeries sun_Z[] = {
 };
 
 
-static double SumSeries(const VSOPSeries& series, double t)
+namespace
+{
+typedef Array<double, VSOP_BLOCK, 1> SeriesBlock;
+
+// cos() of a block of angles. The angles are reduced to [-pi/4, pi/4] by
+// subtracting the nearest multiple of pi/2, split in three parts so that
+// the products are exact; the sine and cosine of the remainder are the
+// minimax polynomials of the Cephes library, and the quadrant picks one
+// of them and its sign. Accurate to a few ulps for angles up to 1e8.
+inline SeriesBlock blockCos(const SeriesBlock& x)
+{
+    const double PIO2_1 = 1.57079625129699707031e+00;
+    const double PIO2_2 = 7.54978941586159635335e-08;
+    const double PIO2_3 = 5.39030285815811905290e-15;
+
+    // ArrayBase::rint() needs Eigen 3.4
+    SeriesBlock k = (x * (2.0 / PI)).unaryExpr([](double a) { return std::nearbyint(a); });
+    SeriesBlock r = ((x - k * PIO2_1) - k * PIO2_2) - k * PIO2_3;
+    SeriesBlock z = r * r;
+
+    SeriesBlock sinr = ((((( 1.58962301576546568060e-10  * z
+                           - 2.50507477628578072866e-8)  * z
+                           + 2.75573136213857245213e-6)  * z
+                           - 1.98412698295895385996e-4)  * z
+                           + 8.33333333332211858878e-3)  * z
+                           - 1.66666666666666307295e-1)  * z * r + r;
+    SeriesBlock cosr = (((((-1.13585365213876817300e-11  * z
+                           + 2.08757008419747316778e-9)  * z
+                           - 2.75573141792967388112e-7)  * z
+                           + 2.48015872888517045348e-5)  * z
+                           - 1.38888888888730564116e-3)  * z
+                           + 4.16666666666665929218e-2)  * z * z - 0.5 * z + 1.0;
+
+    // Quadrant q = k mod 4: cos(x) is cos(r), -sin(r), -cos(r) and sin(r)
+    // for q = 0 to 3.
+    SeriesBlock q = k - 4.0 * (k * 0.25).floor();
+    SeriesBlock odd = q - 2.0 * (q * 0.5).floor();
+    SeriesBlock sign = 2.0 * (q - 1.5).abs() - 2.0;
+
+    return sign * (odd * sinr + (1.0 - odd) * cosr);
+}
+}
+
+
+// Sum of a series term by term with the C library cos(), as the series
+// were evaluated before they were vectorized
+static double SumSeriesScalar(const VSOPSeries& series, double t)
 {
     if (series.nTerms < 1)
         return 0.0;
@@ -11011,6 +11078,80 @@ static double SumSeries(const VSOPSeries& series, double t)
     return x;
 };
 
+
+// Sum of a series at one time, with the terms computed a block at a time.
+// They are added up in the order of the scalar sum: the series of the
+// longitudes have terms of several thousand radians, and adding them in
+// another order would change the result by more than 1e-12.
+static double SumSeries(const VSOPSeries& series, double t)
+{
+    double x = 0.0;
+    for (Index i = 0; i < series.A.size(); i += VSOP_BLOCK)
+    {
+        Map<const SeriesBlock> A(&series.A[i]);
+        Map<const SeriesBlock> B(&series.B[i]);
+        Map<const SeriesBlock> C(&series.C[i]);
+        SeriesBlock terms = A * blockCos(B + C * t);
+        for (int j = 0; j < VSOP_BLOCK; j++)
+            x += terms[j];
+    }
+
+    return x;
+}
+
+
+// Sums of a series at a block of times, a term at a time
+static SeriesBlock SumSeries(const VSOPSeries& series, const SeriesBlock& t)
+{
+    SeriesBlock x = SeriesBlock::Zero();
+    for (int i = 0; i < series.nTerms; i++)
+        x += series.A[i] * blockCos(series.B[i] + series.C[i] * t);
+
+    return x;
+}
+
+
+// A variable of the theory: the series multiplied by increasing powers
+// of t and summed up
+static double SumVariable(const VSOPSeries* series, int n, double t, bool scalarTerms)
+{
+    double x = 0.0;
+    double T = 1.0;
+    for (int i = 0; i < n; i++)
+    {
+        x += (scalarTerms ? SumSeriesScalar(series[i], t) : SumSeries(series[i], t)) * T;
+        T = t * T;
+    }
+
+    return x;
+}
+
+
+static SeriesBlock SumVariable(const VSOPSeries* series, int n, const SeriesBlock& t)
+{
+    SeriesBlock x = SeriesBlock::Zero();
+    SeriesBlock T = SeriesBlock::Ones();
+    for (int i = 0; i < n; i++)
+    {
+        x += SumSeries(series[i], t) * T;
+        T = t * T;
+    }
+
+    return x;
+}
+
+
+// Times of a batch as Julian millenia since J2000.0 in blocks; the last
+// block is filled up with the last time.
+static SeriesBlock BlockTimes(const double* jd, unsigned int start, unsigned int n)
+{
+    SeriesBlock t;
+    for (int j = 0; j < VSOP_BLOCK; j++)
+        t[j] = (jd[min(start + j, n - 1)] - 2451545.0) / 365250.0;
+    return t;
+}
+
+
 class VSOP87Orbit : public CachingOrbit
 {
  private:
@@ -11022,18 +11163,21 @@ class VSOP87Orbit : public CachingOrbit
     int nR;
     double period;
     double boundingRadius;
+    bool scalarTerms;
 
  public:
     VSOP87Orbit(VSOPSeries* _vsL, int _nL,
                 VSOPSeries* _vsB, int _nB,
                 VSOPSeries* _vsR, int _nR,
                 double _period,
-                double _boundingRadius) :
+                double _boundingRadius,
+                bool _scalarTerms) :
         vsL(_vsL), nL(_nL),
         vsB(_vsB), nB(_nB),
         vsR(_vsR), nR(_nR),
         period(_period),
-        boundingRadius(_boundingRadius)
+        boundingRadius(_boundingRadius),
+        scalarTerms(_scalarTerms)
     {
     };
     ~VSOP87Orbit() override = default;
@@ -11054,36 +11198,9 @@ class VSOP87Orbit : public CachingOrbit
         double t = (jd - 2451545.0) / 365250.0;
 
         // Heliocentric coordinates
-        double l = 0.0; // longitude
-        double b = 0.0; // latitude
-        double r = 0.0; // radius
-
-        int i;
-        double T;
-
-        // Evaluate series for l
-        T = 1;
-        for (i = 0; i < nL; i++)
-        {
-            l += SumSeries(vsL[i], t) * T;
-            T = t * T;
-        }
-
-        // Evaluate series for b
-        T = 1;
-        for (i = 0; i < nB; i++)
-        {
-            b += SumSeries(vsB[i], t) * T;
-            T = t * T;
-        }
-
-        // Evaluate series for r
-        T = 1;
-        for (i = 0; i < nR; i++)
-        {
-            r += SumSeries(vsR[i], t) * T;
-            T = t * T;
-        }
+        double l = SumVariable(vsL, nL, t, scalarTerms); // longitude
+        double b = SumVariable(vsB, nB, t, scalarTerms); // latitude
+        double r = SumVariable(vsR, nR, t, scalarTerms); // radius
 
         r *= KM_PER_AU;
 
@@ -11096,12 +11213,43 @@ class VSOP87Orbit : public CachingOrbit
                         -sin(l) * sin(b) * r);
     }
 
+    void computePositions(const double* jd, Vector3d* positions, unsigned int n) const override
+    {
+        if (scalarTerms)
+        {
+            CachingOrbit::computePositions(jd, positions, n);
+            return;
+        }
+
+        for (unsigned int i = 0; i < n; i += VSOP_BLOCK)
+        {
+            SeriesBlock t = BlockTimes(jd, i, n);
+            SeriesBlock l = SumVariable(vsL, nL, t) + PI;
+            SeriesBlock b = SumVariable(vsB, nB, t) - PI / 2;
+            SeriesBlock r = SumVariable(vsR, nR, t) * KM_PER_AU;
+
+            for (unsigned int j = 0; j < VSOP_BLOCK && i + j < n; j++)
+            {
+                positions[i + j] = Vector3d(cos(l[j]) * sin(b[j]) * r[j],
+                                            cos(b[j]) * r[j],
+                                            -sin(l[j]) * sin(b[j]) * r[j]);
+            }
+        }
+    }
+
 
     /** Custom implementation of sample() for VSOP87 orbits. The default
-      * implementation runs too slowly and produces too many samples.
+      * implementation with its 1 km tolerance runs too slowly and produces
+      * too many samples; it is only used when proc has a tolerance.
       */
     void sample(double startTime, double endTime, OrbitSampleProc& proc) const override
     {
+        if (proc.getTolerance() > 0.0)
+        {
+            CachingOrbit::sample(startTime, endTime, proc);
+            return;
+        }
+
         double span = getPeriod();
 
         AdaptiveSamplingParameters samplingParams{};
@@ -11132,18 +11280,21 @@ class VSOP87OrbitRect : public CachingOrbit
     int nZ;
     double period;
     double boundingRadius;
+    bool scalarTerms;
 
  public:
     VSOP87OrbitRect(VSOPSeries* _vsX, int _nX,
                     VSOPSeries* _vsY, int _nY,
                     VSOPSeries* _vsZ, int _nZ,
                     double _period,
-                    double _boundingRadius) :
+                    double _boundingRadius,
+                    bool _scalarTerms) :
         vsX(_vsX), nX(_nX),
         vsY(_vsY), nY(_nY),
         vsZ(_vsZ), nZ(_nZ),
         period(_period),
-        boundingRadius(_boundingRadius)
+        boundingRadius(_boundingRadius),
+        scalarTerms(_scalarTerms)
     {
     };
     ~VSOP87OrbitRect() override = default;
@@ -11168,39 +11319,34 @@ class VSOP87OrbitRect : public CachingOrbit
         // t is Julian millenia since J2000.0
         double t = (jd - 2451545.0) / 365250.0;
 
-        Vector3d v(Vector3d::Zero());
+        Vector3d v(SumVariable(vsX, nX, t, scalarTerms),
+                   SumVariable(vsY, nY, t, scalarTerms),
+                   SumVariable(vsZ, nZ, t, scalarTerms));
 
-        int i;
-        double T;
+        v *= KM_PER_AU;
 
-        // Evaluate series for x
-        T = 1;
-        for (i = 0; i < nX; i++)
-        {
-            v.x() += SumSeries(vsX[i], t) * T;
-            T = t * T;
-        }
+        // Corrections for internal coordinate system
+        return Vector3d(v.x(), v.z(), -v.y());
+    }
 
-        // Evaluate series for y
-        T = 1;
-        for (i = 0; i < nY; i++)
+    void computePositions(const double* jd, Vector3d* positions, unsigned int n) const override
+    {
+        if (scalarTerms)
         {
-            v.y() += SumSeries(vsY[i], t) * T;
-            T = t * T;
+            CachingOrbit::computePositions(jd, positions, n);
+            return;
         }
 
-        // Evaluate series for z
-        T = 1;
-        for (i = 0; i < nZ; i++)
+        for (unsigned int i = 0; i < n; i += VSOP_BLOCK)
         {
-            v.z() += SumSeries(vsZ[i], t) * T;
-            T = t * T;
-        }
+            SeriesBlock t = BlockTimes(jd, i, n);
+            SeriesBlock x = SumVariable(vsX, nX, t) * KM_PER_AU;
+            SeriesBlock y = SumVariable(vsY, nY, t) * KM_PER_AU;
+            SeriesBlock z = SumVariable(vsZ, nZ, t) * KM_PER_AU;
 
-        v *= KM_PER_AU;
-
-        // Corrections for internal coordinate system
-        return Vector3d(v.x(), v.z(), -v.y());
+            for (unsigned int j = 0; j < VSOP_BLOCK && i + j < n; j++)
+                positions[i + j] = Vector3d(x[j], z[j], -y[j]);
+        }
     }
 };
 
@@ -11212,98 +11358,101 @@ static double yearToJD(int year)
 }
 
 
-Orbit* CreateVSOP87Orbit(const string& name)
+CachingOrbit* CreateVSOP87SeriesOrbit(const string& name, bool scalarTerms)
 {
     if (name == "vsop87-mercury")
     {
-        Orbit* o = new VSOP87Orbit(mercury_L, 6,
-                                   mercury_B, 6,
-                                   mercury_R, 5,
-                                   0.2408 * 365.25,
-                                   60000000.0);
-        return new MixedOrbit(o, yearToJD(-4000), yearToJD(4000),
-                              astro::SolarMass);
+        return new VSOP87Orbit(mercury_L, 6,
+                               mercury_B, 6,
+                               mercury_R, 5,
+                               0.2408 * 365.25,
+                               60000000.0,
+                               scalarTerms);
     }
     else if (name == "vsop87-venus")
     {
-        Orbit* o = new VSOP87Orbit(venus_L, 6,
-                                   venus_B, 6,
-                                   venus_R, 5,
-                                   0.6152 * 365.25,
-                                   100000000.0);
-        return new MixedOrbit(o, yearToJD(-4000), yearToJD(4000),
-                              astro::SolarMass);
+        return new VSOP87Orbit(venus_L, 6,
+                               venus_B, 6,
+                               venus_R, 5,
+                               0.6152 * 365.25,
+                               100000000.0,
+                               scalarTerms);
     }
     else if (name == "vsop87-earth")
     {
-        Orbit* o = new VSOP87Orbit(earth_L, 6,
-                                   earth_B, 3,
-                                   earth_R, 6,
-                                   365.25,
-                                   160000000.0);
-        return new MixedOrbit(o, yearToJD(-4000), yearToJD(4000),
-                              astro::SolarMass);
+        return new VSOP87Orbit(earth_L, 6,
+                               earth_B, 3,
+                               earth_R, 6,
+                               365.25,
+                               160000000.0,
+                               scalarTerms);
     }
     else if (name == "vsop87-mars")
     {
-        Orbit* o = new VSOP87Orbit(mars_L, 6,
-                                   mars_B, 6,
-                                   mars_R, 6,
-                                   1.8809 * 365.25,
-                                   240000000);
-        return new MixedOrbit(o, yearToJD(-4000), yearToJD(4000),
-                              astro::SolarMass);
+        return new VSOP87Orbit(mars_L, 6,
+                               mars_B, 6,
+                               mars_R, 6,
+                               1.8809 * 365.25,
+                               240000000,
+                               scalarTerms);
     }
     else if (name == "vsop87-jupiter")
     {
-        Orbit* o = new VSOP87Orbit(jupiter_L, 6,
-                                   jupiter_B, 6,
-                                   jupiter_R, 6,
-                                   11.86 * 365.25,
-                                   800000000.0);
-        return new MixedOrbit(o, yearToJD(-4000), yearToJD(4000),
-                              astro::SolarMass);
+        return new VSOP87Orbit(jupiter_L, 6,
+                               jupiter_B, 6,
+                               jupiter_R, 6,
+                               11.86 * 365.25,
+                               800000000.0,
+                               scalarTerms);
     }
     else if (name == "vsop87-saturn")
     {
-        Orbit* o = new VSOP87Orbit(saturn_L, 6,
-                                   saturn_B, 6,
-                                   saturn_R, 6,
-                                   29.4577 * 365.25,
-                                   1.5e9);
-        return new MixedOrbit(o, yearToJD(-4000), yearToJD(4000),
-                              astro::SolarMass);
+        return new VSOP87Orbit(saturn_L, 6,
+                               saturn_B, 6,
+                               saturn_R, 6,
+                               29.4577 * 365.25,
+                               1.5e9,
+                               scalarTerms);
     }
     else if (name == "vsop87-uranus")
     {
-        Orbit* o = new VSOP87Orbit(uranus_L, 5,
-                                   uranus_B, 4,
-                                   uranus_R, 5,
-                                   84.0139 * 365.25,
-                                   3.0e9);
-        return new MixedOrbit(o, yearToJD(-4000), yearToJD(4000),
-                              astro::SolarMass);
+        return new VSOP87Orbit(uranus_L, 5,
+                               uranus_B, 4,
+                               uranus_R, 5,
+                               84.0139 * 365.25,
+                               3.0e9,
+                               scalarTerms);
     }
     else if (name == "vsop87-neptune")
     {
-        Orbit* o = new VSOP87Orbit(neptune_L, 4,
-                                   neptune_B, 4,
-                                   neptune_R, 5,
-                                   164.793 * 365.25,
-                                   4.7e9);
-        return new MixedOrbit(o, yearToJD(-4000), yearToJD(4000),
-                              astro::SolarMass);
+        return new VSOP87Orbit(neptune_L, 4,
+                               neptune_B, 4,
+                               neptune_R, 5,
+                               164.793 * 365.25,
+                               4.7e9,
+                               scalarTerms);
     }
     else if (name == "vsop87-sun")
     {
-        Orbit* o = new VSOP87OrbitRect(sun_X, 5,
-                                       sun_Y, 5,
-                                       sun_Z, 3,
-                                       0.0,
-                                       2000000);
-        return new MixedOrbit(o, yearToJD(-4000), yearToJD(6000),
-                              astro::SolarMass);
+        return new VSOP87OrbitRect(sun_X, 5,
+                                   sun_Y, 5,
+                                   sun_Z, 3,
+                                   0.0,
+                                   2000000,
+                                   scalarTerms);
     }
 
     return nullptr;
 }
+
+
+Orbit* CreateVSOP87Orbit(const string& name)
+{
+    CachingOrbit* o = CreateVSOP87SeriesOrbit(name, false);
+    if (o == nullptr)
+        return nullptr;
+
+    o->setChebyshevTolerance(ChebyshevCache::getDefaultTolerance());
+    double end = name == "vsop87-sun" ? yearToJD(6000) : yearToJD(4000);
+    return new MixedOrbit(o, yearToJD(-4000), end, astro::SolarMass);
+}
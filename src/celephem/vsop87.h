@@ -15,4 +15,10 @@
 
 extern Orbit* CreateVSOP87Orbit(const std::string& name);
 
+// The bare VSOP87 series of a planet, without the Chebyshev cache and the
+// approximations outside of the years -4000 to 4000. With scalarTerms,
+// the series are summed term by term with the C library cos() instead of
+// in vectorized blocks; for tests and benchmarks.
+extern CachingOrbit* CreateVSOP87SeriesOrbit(const std::string& name, bool scalarTerms = false);
+
 #endif // _CELENGINE_VSOP87_H_
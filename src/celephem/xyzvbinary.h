@@ -17,3 +17,28 @@ struct XYZVBinaryData
     double position[3];
     double velocity[3];
 };
+
+// Indexed binary xyzv files start with this header, whose magic is
+// "CELXYZVI" without a terminating null, followed by the time index and
+// the samples as XYZVBinaryData. Time is divided into chunkCount chunks
+// of chunkDuration days from startTime; entry i of the index, an
+// uint64_t, is the number of samples before the start of chunk i, and
+// the last of the chunkCount + 1 entries is the number of samples. The
+// samples of a time are thus found without a search of the whole file,
+// which is memory mapped rather than read.
+struct XYZVIndexedHeader
+{
+    char magic[8];
+    uint16_t byteOrder;
+    uint16_t digits;
+    uint32_t reserved;
+    uint64_t count;
+    uint64_t chunkCount;
+    double startTime;
+    double chunkDuration;
+    double boundingRadius;
+};
+static_assert(sizeof(XYZVIndexedHeader) == 56, "Unexpected padding in indexed xyzv header");
+
+// Average number of samples per chunk of the index written by xyzv2bin
+constexpr const uint64_t XYZV_SAMPLES_PER_CHUNK = 32;
@@ -24,6 +24,7 @@
 #include <celscript/legacy/execution.h>
 #include <celscript/legacy/cmdparser.h>
 #include <celengine/multitexture.h>
+#include <celephem/chebyshevcache.h>
 #ifdef USE_SPICE
 #include <celephem/spiceinterface.h>
 #endif
@@ -2370,6 +2371,11 @@ Simulation* CelestiaCore::getSimulation() const
     return sim;
 }
 
+ThreadPool* CelestiaCore::getThreadPool() const
+{
+    return threadPool.get();
+}
+
 void CelestiaCore::showText(string s,
                             int horig, int vorig,
                             int hoff, int voff,
@@ -3521,6 +3527,16 @@ class SolarSystemLoader
     };
 };
 
+// Only star catalogs contribute to the star octree cache key
+static void addToCacheKey(StarDatabase* starDB, const fs::path& filepath)
+{
+    starDB->addToCacheKey(filepath);
+}
+
+static void addToCacheKey(DSODatabase* /*unused*/, const fs::path& /*unused*/)
+{
+}
+
 template <class OBJDB> class CatalogLoader
 {
     OBJDB*      objDB;
@@ -3549,6 +3565,8 @@ template <class OBJDB> class CatalogLoader
         if (notifier != nullptr)
             notifier->update(filepath.filename().string());
 
+        addToCacheKey(objDB, filepath);
+
         ifstream catalogFile(filepath.string(), ios::in);
         if (catalogFile.good())
         {
@@ -3630,6 +3648,10 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
 
     universe = new Universe();
 
+    // Analytic orbits pick the tolerance up when the solar systems are
+    // loaded
+    ChebyshevCache::setDefaultTolerance(config->orbitCacheTolerance);
+
 
     /***** Load star catalogs *****/
 
@@ -3645,6 +3667,7 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
     DSONameDatabase* dsoNameDB  = new DSONameDatabase;
     DSODatabase*     dsoDB      = new DSODatabase;
     dsoDB->setNameDatabase(dsoNameDB);
+    dsoDB->setThreadPool(threadPool.get());
 
     // Load first the vector of dsoCatalogFiles in the data directory (deepsky.dsc, globulars.dsc,...):
 
@@ -3807,6 +3830,7 @@ bool CelestiaCore::initRenderer()
 
     Renderer::DetailOptions detailOptions;
     detailOptions.orbitPathSamplePoints = config->orbitPathSamplePoints;
+    detailOptions.orbitPathTolerance = config->orbitPathTolerance;
     detailOptions.shadowTextureSize = config->shadowTextureSize;
     detailOptions.eclipseTextureSize = config->eclipseTextureSize;
     detailOptions.orbitWindowEnd = config->orbitWindowEnd;
@@ -3824,6 +3848,9 @@ bool CelestiaCore::initRenderer()
         return false;
     }
 
+    renderer->setOrbitPathThreads(config->orbitPathThreads);
+    renderer->setOrbitCacheBudget((size_t) config->orbitPathMemoryBudget * 1024 * 1024);
+
     if ((renderer->getRenderFlags() & Renderer::ShowAutoMag) != 0)
     {
         renderer->setFaintestAM45deg(renderer->getFaintestAM45deg());
@@ -3884,10 +3911,11 @@ static void loadCrossIndex(StarDatabase* starDB,
 {
     if (!filename.empty())
     {
-        ifstream xrefFile(filename.string(), ios::in | ios::binary);
-        if (xrefFile.good())
+        starDB->addToCacheKey(filename);
+
+        if (fs::exists(filename))
         {
-            if (!starDB->loadCrossIndex(catalog, xrefFile))
+            if (!starDB->loadCrossIndex(catalog, filename))
                 fmt::fprintf(cerr, _("Error reading cross index %s\n"), filename);
             else
                 fmt::fprintf(clog, _("Loaded cross index %s\n"), filename);
@@ -3917,13 +3945,22 @@ bool CelestiaCore::readStars(const CelestiaConfig& cfg,
     // First load the binary star database file.  The majority of stars
     // will be defined here.
     StarDatabase* starDB = new StarDatabase();
+    if (!cfg.starOctreeCacheFile.empty())
+        starDB->setOctreeCacheFile(cfg.starOctreeCacheFile);
+
+    if (cfg.workerThreads != 1)
+    {
+        threadPool = unique_ptr<ThreadPool>(new ThreadPool(cfg.workerThreads));
+        starDB->setThreadPool(threadPool.get());
+        fmt::fprintf(clog, _("Using %u worker threads\n"), threadPool->threadCount());
+    }
+
     if (!cfg.starDatabaseFile.empty())
     {
         if (progressNotifier)
             progressNotifier->update(cfg.starDatabaseFile.string());
 
-        ifstream starFile(cfg.starDatabaseFile.string(), ios::in | ios::binary);
-        if (!starFile.good())
+        if (!fs::exists(cfg.starDatabaseFile))
         {
             fmt::fprintf(cerr, _("Error opening %s\n"), cfg.starDatabaseFile);
             delete starDB;
@@ -3931,7 +3968,7 @@ bool CelestiaCore::readStars(const CelestiaConfig& cfg,
             return false;
         }
 
-        if (!starDB->loadBinary(starFile))
+        if (!starDB->loadBinary(cfg.starDatabaseFile))
         {
             cerr << _("Error reading stars file\n");
             delete starDB;
@@ -3955,6 +3992,8 @@ bool CelestiaCore::readStars(const CelestiaConfig& cfg,
         if (file.empty())
             continue;
 
+        starDB->addToCacheKey(file);
+
         ifstream starFile(file.string(), ios::in);
         if (starFile.good())
             starDB->load(starFile);
@@ -3975,6 +4014,24 @@ bool CelestiaCore::readStars(const CelestiaConfig& cfg,
 
     starDB->finish();
 
+    if (!cfg.pagedStarDatabaseFile.empty())
+    {
+        if (progressNotifier)
+            progressNotifier->update(cfg.pagedStarDatabaseFile.string());
+
+        size_t budget = (size_t) cfg.pagedStarMemoryBudget * 1024 * 1024;
+        if (starDB->loadPagedCatalog(cfg.pagedStarDatabaseFile, budget))
+        {
+            fmt::fprintf(clog, _("%u stars in paged star database\n"),
+                         starDB->getPagedCatalog()->size());
+        }
+        else
+        {
+            fmt::fprintf(cerr, _("Error reading paged star database %s\n"),
+                         cfg.pagedStarDatabaseFile);
+        }
+    }
+
     universe->setStarCatalog(starDB);
 
     return true;
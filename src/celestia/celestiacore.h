@@ -11,6 +11,7 @@
 #define _CELESTIACORE_H_
 
 #include <celutil/filetype.h>
+#include <celutil/threadpool.h>
 #include <celutil/timer.h>
 #include <celutil/watcher.h>
 // #include <celutil/watchable.h>
@@ -215,6 +216,8 @@ class CelestiaCore // : public Watchable<CelestiaCore>
 
     Simulation* getSimulation() const;
     Renderer* getRenderer() const;
+    // Worker threads, or nullptr when everything runs on one thread
+    ThreadPool* getThreadPool() const;
     void showText(std::string s,
                   int horig = 0, int vorig = 0,
                   int hoff = 0, int voff = 0,
@@ -396,6 +399,8 @@ class CelestiaCore // : public Watchable<CelestiaCore>
 
     Timer* timer{ nullptr };
 
+    std::unique_ptr<ThreadPool> threadPool;
+
     std::unique_ptr<celestia::scripts::IScript>             m_script;
     std::unique_ptr<celestia::scripts::IScriptHook>         m_scriptHook;
     std::unique_ptr<celestia::scripts::LegacyScriptPlugin>  m_legacyPlugin;
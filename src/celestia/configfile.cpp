@@ -88,6 +88,8 @@ CelestiaConfig* ReadCelestiaConfig(const fs::path& filename, CelestiaConfig *con
     configParams->getPath("HDCrossIndex", config->HDCrossIndexFile);
     configParams->getPath("SAOCrossIndex", config->SAOCrossIndexFile);
     configParams->getPath("GlieseCrossIndex", config->GlieseCrossIndexFile);
+    configParams->getPath("StarOctreeCache", config->starOctreeCacheFile);
+    configParams->getPath("PagedStarDatabase", config->pagedStarDatabaseFile);
     configParams->getString("Font", config->mainFont);
     configParams->getString("LabelFont", config->labelFont);
     configParams->getString("TitleFont", config->titleFont);
@@ -123,11 +125,20 @@ CelestiaConfig* ReadCelestiaConfig(const fs::path& filename, CelestiaConfig *con
     configParams->getNumber("OrbitPeriodsShown", config->orbitPeriodsShown);
     config->linearFadeFraction = 0.0f;
     configParams->getNumber("LinearFadeFraction", config->linearFadeFraction);
+    config->orbitCacheTolerance = 0.001;
+    configParams->getNumber("OrbitCacheTolerance", config->orbitCacheTolerance);
 
     config->orbitPathSamplePoints = getUint(configParams, "OrbitPathSamplePoints", 100);
+    config->orbitPathTolerance = 0.5;
+    configParams->getNumber("OrbitPathTolerance", config->orbitPathTolerance);
+    config->orbitPathThreads = getUint(configParams, "OrbitPathThreads", 1);
+    config->orbitPathMemoryBudget = getUint(configParams, "OrbitPathMemoryBudget", 32);
     config->shadowTextureSize = getUint(configParams, "ShadowTextureSize", 256);
     config->eclipseTextureSize = getUint(configParams, "EclipseTextureSize", 128);
 
+    config->workerThreads = getUint(configParams, "WorkerThreads", 1);
+    config->pagedStarMemoryBudget = getUint(configParams, "PagedStarMemoryBudget", 256);
+
     config->consoleLogRows = getUint(configParams, "LogSize", 200);
 
     Value* solarSystemsVal = configParams->getValue("SolarSystemCatalogs");
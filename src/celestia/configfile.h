@@ -46,6 +46,8 @@ public:
     double orbitWindowEnd;
     double orbitPeriodsShown;
     double linearFadeFraction;
+    // Tolerance of the Chebyshev fits to analytic orbits, in kilometers
+    double orbitCacheTolerance;
     fs::path scriptScreenshotDirectory;
     std::string scriptSystemAccessPolicy;
 #ifdef CELX
@@ -56,6 +58,10 @@ public:
     fs::path HDCrossIndexFile;
     fs::path SAOCrossIndexFile;
     fs::path GlieseCrossIndexFile;
+    fs::path starOctreeCacheFile;
+    fs::path pagedStarDatabaseFile;
+    // Memory budget for the paged star database, in megabytes
+    unsigned int pagedStarMemoryBudget;
 
     StarDetails::StarTextureSet starTextures;
 
@@ -63,6 +69,12 @@ public:
     unsigned int shadowTextureSize;
     unsigned int eclipseTextureSize;
     unsigned int orbitPathSamplePoints;
+    double orbitPathTolerance;
+    unsigned int orbitPathThreads;
+    // Memory budget for cached orbit paths, in megabytes
+    unsigned int orbitPathMemoryBudget;
+
+    unsigned int workerThreads;
 
     unsigned int aaSamples;
 
@@ -10,8 +10,11 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
 #include <cstring>
 #include <cassert>
+#include <limits>
+#include <celutil/threadpool.h>
 #include "eclipsefinder.h"
 #include "celmath/ray.h"
 #include "celmath/distance.h"
@@ -22,6 +25,13 @@ using namespace celmath;
 
 
 constexpr const double dT = 1.0 / (24.0 * 60.0);
+// Search steps of one hour are taken
+constexpr const double SearchStep = 1.0 / 24.0;
+// Number of search steps in the spans of time searched at once; spans are
+// shorter without a thread pool, as the watcher is only called between
+// them.
+constexpr const size_t ChunkSteps = 24 * 30;
+constexpr const size_t SerialChunkSteps = 24;
 constexpr const int EclipseObjectMask = Body::Planet      |
                                         Body::Moon        |
                                         Body::MinorMoon   |
@@ -39,6 +49,12 @@ EclipseFinder::EclipseFinder(Body* _body,
 };
 
 
+void EclipseFinder::setThreadPool(ThreadPool* pool)
+{
+    threadPool = pool;
+}
+
+
 bool testEclipse(const Body& receiver, const Body& caster, double now)
 {
     // Ignore situations where the shadow casting body is much smaller than
@@ -98,105 +114,184 @@ bool testEclipse(const Body& receiver, const Body& caster, double now)
     return false;
 }
 
-#if 1
+// Given a time during an eclipse, find the first time at which the receiver
+// isn't eclipsed among now + dt, now + 2 dt, ... The times are summed step
+// by step, as by a linear search, but the eclipse is bracketed by doubling
+// the number of steps and its edge found by bisection.
 double findEclipseSpan(const Body& receiver, const Body& caster,
                        double now, double dt)
 {
-    double t = now;
-    while (testEclipse(receiver, caster, t))
-        t += dt;
-
-    return t;
-}
-#else
-// Given a time during an eclipse, find the start of the eclipse to
-// a precision of minStep.
-double findEclipseStart(const Body& receiver, const Body& occulter,
-                        double now,
-                        double startStep,
-                        double minStep)
-{
-    double step = startStep / 2;
-    double t = now - step;
-    bool eclipsed = true;
+    // Time after n steps from now
+    auto stepTime = [now, dt](unsigned int n)
+    {
+        double t = now;
+        for (unsigned int i = 0; i < n; i++)
+            t += dt;
+        return t;
+    };
+
+    // Steps known to be eclipsed, and not to be
+    unsigned int inside = 0;
+    unsigned int outside = 1;
+    while (testEclipse(receiver, caster, stepTime(outside)))
+    {
+        inside = outside;
+        outside *= 2;
+    }
 
-    // Perform a binary search to find the end of the eclipse
-    while (step > minStep)
+    while (outside - inside > 1)
     {
-        eclipsed = testEclipse(receiver, occulter, t);
-        step *= 0.5;
-        if (eclipsed)
-            t -= step;
+        unsigned int mid = inside + (outside - inside) / 2;
+        if (testEclipse(receiver, caster, stepTime(mid)))
+            inside = mid;
         else
-            t += step;
+            outside = mid;
     }
 
-    // Always return a time when the receiver is /not/ in eclipse
-    if (eclipsed)
-        t -= step;
-
-    return t;
+    return stepTime(outside);
 }
 
-// Given a time during an eclipse, find the end of the eclipse to
-// a precision of minStep.
-double findEclipseEnd(const Body& receiver, const Body& occulter,
-                      double now,
-                      double startStep,
-                      double minStep)
+
+namespace
+{
+struct FoundEclipse
+{
+    size_t step;
+    unsigned int body;
+    Eclipse eclipse;
+};
+
+// Tests of the bodies at the search steps. Each body is only tested once
+// the previous eclipse involving it has ended, so the eclipses on and of
+// each body are found independently of the others.
+class EclipseSearch
 {
-    // First do a coarse search to find the eclipse end to within the precision
-    // of startStep.
-    while (testEclipse(receiver, occulter, now + startStep))
-        now += startStep;
+ public:
+    EclipseSearch(const Body& _body, const vector<Body*>& _testBodies, int _eclipseTypeMask) :
+        body(_body),
+        testBodies(_testBodies),
+        eclipseTypeMask(_eclipseTypeMask)
+    {
+    }
 
-    double step = startStep / 2;
-    double t = now + step;
-    bool eclipsed = true;
+    unsigned int bodyCount() const { return (unsigned int) testBodies.size(); }
 
+    // Test body i at the search step of time t, appending its eclipses to
+    // found and setting lastEnd to the end of the last one.
+    void testStep(unsigned int i, size_t step, double t,
+                  double& lastEnd, vector<FoundEclipse>& found) const
+    {
+        if (eclipseTypeMask & Eclipse::Solar)
+            addEclipse(body, *testBodies[i], i, step, t, lastEnd, found);
 
-    // Perform a binary search to find the end of the eclipse
-    while (step > minStep)
+        if (eclipseTypeMask & Eclipse::Lunar)
+            addEclipse(*testBodies[i], body, i, step, t, lastEnd, found);
+    }
+
+ private:
+    void addEclipse(const Body& receiver, const Body& occulter,
+                    unsigned int i, size_t step, double now,
+                    double& lastEnd, vector<FoundEclipse>& found) const
     {
-        eclipsed = testEclipse(receiver, occulter, t);
-        step *= 0.5;
-        if (eclipsed)
-            t += step;
-        else
-            t -= step;
+        if (testEclipse(receiver, occulter, now))
+        {
+            FoundEclipse f;
+            f.step = step;
+            f.body = i;
+            f.eclipse.startTime = findEclipseSpan(receiver, occulter, now, -dT);
+            f.eclipse.endTime = findEclipseSpan(receiver, occulter, now, dT);
+            f.eclipse.receiver = const_cast<Body*>(&receiver);
+            f.eclipse.occulter = const_cast<Body*>(&occulter);
+            found.push_back(f);
+
+            lastEnd = f.eclipse.endTime;
+        }
     }
 
-    // Always return a time when the receiver is /not/ in eclipse
-    if (eclipsed)
-        t += step;
+    const Body& body;
+    const vector<Body*>& testBodies;
+    int eclipseTypeMask;
+};
+
+// A span of search steps, searched as if no eclipse was in progress at
+// its start
+struct Chunk
+{
+    size_t firstStep{ 0 };
+    vector<double> times;
+    // Eclipses found for each test body
+    vector<vector<FoundEclipse>> found;
+};
+
+void searchChunk(const EclipseSearch& search, Chunk& chunk)
+{
+    chunk.found.resize(search.bodyCount());
+    vector<double> lastEnd(search.bodyCount(), -numeric_limits<double>::infinity());
 
-    return t;
+    // All the bodies are tested at each step in turn, so the states of the
+    // body they orbit are computed once per step.
+    for (size_t n = 0; n < chunk.times.size(); n++)
+    {
+        for (unsigned int i = 0; i < search.bodyCount(); i++)
+        {
+            if (chunk.times[n] > lastEnd[i])
+                search.testStep(i, chunk.firstStep + n, chunk.times[n], lastEnd[i], chunk.found[i]);
+        }
+    }
 }
-#endif
 
-void addEclipse(const Body& receiver, const Body& occulter,
-                double now,
-                double /*startStep*/, double /*minStep*/,
-                vector<Eclipse>& eclipses,
-                vector<double>& previousEclipseEndTimes, int i)
+// Append the eclipses of a chunk to those found before it, in the order
+// of a single search over the whole range: by step, then by body. A body
+// still in eclipse at the start of the chunk is searched again until it
+// is tested at a step also tested by the search of the chunk; from there
+// on both searches find the same eclipses.
+void mergeChunk(const EclipseSearch& search, const Chunk& chunk,
+                vector<double>& previousEclipseEndTimes,
+                vector<Eclipse>& eclipses)
 {
-    if (testEclipse(receiver, occulter, now))
+    vector<FoundEclipse> merged;
+    for (unsigned int i = 0; i < search.bodyCount(); i++)
     {
-        Eclipse eclipse;
-#if 1
-        eclipse.startTime = findEclipseSpan(receiver, occulter, now, -dT);
-        eclipse.endTime = findEclipseSpan(receiver, occulter, now, dT);
-#else
-        eclipse.startTime = findEclipseStart(receiver, occulter, now, searchStep, minStep);
-        eclipse.endTime = findEclipseEnd(receiver, occulter, now, searchStep, minStep);
-#endif
-        eclipse.receiver = const_cast<Body*>(&receiver);
-        eclipse.occulter = const_cast<Body*>(&occulter);
-        eclipses.emplace_back(eclipse);
-
-        previousEclipseEndTimes[i] = eclipse.endTime;
+        const vector<FoundEclipse>& found = chunk.found[i];
+        double& lastEnd = previousEclipseEndTimes[i];
+
+        // End of the last eclipse found by the chunk before step n
+        double chunkLastEnd = -numeric_limits<double>::infinity();
+        size_t next = 0;
+        for (size_t n = 0; n < chunk.times.size(); n++)
+        {
+            size_t step = chunk.firstStep + n;
+            for (; next < found.size() && found[next].step < step; next++)
+                chunkLastEnd = found[next].eclipse.endTime;
+
+            double t = chunk.times[n];
+            if (t <= lastEnd)
+                continue;
+
+            if (t > chunkLastEnd)
+            {
+                for (; next < found.size(); next++)
+                {
+                    merged.push_back(found[next]);
+                    lastEnd = found[next].eclipse.endTime;
+                }
+                break;
+            }
+
+            search.testStep(i, step, t, lastEnd, merged);
+        }
     }
+
+    stable_sort(merged.begin(), merged.end(),
+                [](const FoundEclipse& a, const FoundEclipse& b)
+                {
+                    return a.step < b.step || (a.step == b.step && a.body < b.body);
+                });
+    for (const auto& f : merged)
+        eclipses.push_back(f.eclipse);
 }
+}
+
 
 void EclipseFinder::findEclipses(double startDate,
                                  double endDate,
@@ -229,33 +324,47 @@ void EclipseFinder::findEclipses(double startDate,
     if (testBodies.empty())
         return;
 
-    // TODO: Use a fixed step of one hour for now; we should use a binary
-    // search instead.
-    double searchStep = 1.0 / 24.0; // one hour
-
-    // Precision of eclipse duration calculation
-    double durationPrecision = 1.0 / (24.0 * 360.0); // ten seconds
-
-    for (double t = startDate; t <= endDate; t += searchStep)
+    bool threadSafe = body->isThreadSafe() &&
+                      all_of(testBodies.begin(), testBodies.end(),
+                             [](const Body* b) { return b->isThreadSafe(); });
+    bool parallel = threadPool != nullptr && threadPool->threadCount() > 1 && threadSafe;
+    size_t chunkSteps = parallel ? ChunkSteps : SerialChunkSteps;
+
+    // Split the search steps into chunks; their times are summed as by a
+    // single search, so they don't depend on the split.
+    vector<Chunk> chunks;
+    size_t step = 0;
+    for (double t = startDate; t <= endDate; t += SearchStep, step++)
     {
-        if (watcher != nullptr)
+        if (step % chunkSteps == 0)
         {
-            if (watcher->eclipseFinderProgressUpdate(t) == EclipseFinderWatcher::AbortOperation)
-                return;
+            chunks.emplace_back();
+            chunks.back().firstStep = step;
         }
+        chunks.back().times.push_back(t);
+    }
 
-        for (unsigned int i = 0; i < testBodies.size(); i++)
+    // Chunks are searched in batches of one per thread, then merged in order.
+    size_t batchSize = parallel ? threadPool->threadCount() : 1;
+    EclipseSearch search(*body, testBodies, eclipseTypeMask);
+    for (size_t c = 0; c < chunks.size(); c++)
+    {
+        if (watcher != nullptr &&
+            watcher->eclipseFinderProgressUpdate(chunks[c].times.front()) == EclipseFinderWatcher::AbortOperation)
         {
-            // Only test for an eclipse if we're not in the middle of
-            // of previous one.
-            if (t <= previousEclipseEndTimes[i])
-                continue;
-
-            if (eclipseTypeMask & Eclipse::Solar)
-                addEclipse(*body, *testBodies[i], t, searchStep, durationPrecision, eclipses, previousEclipseEndTimes, i);
+            break;
+        }
 
-            if (eclipseTypeMask & Eclipse::Lunar)
-                addEclipse(*testBodies[i], *body, t, searchStep, durationPrecision, eclipses, previousEclipseEndTimes, i);
+        if (c % batchSize == 0)
+        {
+            size_t n = min(batchSize, chunks.size() - c);
+            if (n > 1)
+                threadPool->parallelFor(n, [&](size_t i) { searchChunk(search, chunks[c + i]); });
+            else
+                searchChunk(search, chunks[c]);
         }
+
+        mergeChunk(search, chunks[c], previousEclipseEndTimes, eclipses);
+        chunks[c] = Chunk();
     }
 }
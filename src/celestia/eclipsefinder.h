@@ -16,6 +16,8 @@
 #include <vector>
 #include "celestiacore.h"
 
+class ThreadPool;
+
 struct Eclipse
 {
     // values must be 2^n
@@ -43,11 +45,22 @@ class EclipseFinderWatcher
     virtual Status eclipseFinderProgressUpdate(double t) = 0;
 };
 
+/*! EclipseFinder searches for eclipses on a planet and its moons. The
+ *  search range is split into spans of time which are searched on the
+ *  threads of the thread pool if one is set and all the bodies may be
+ *  used on several threads at once; the eclipses found are the same
+ *  whatever the number of threads. The watcher is only called by the
+ *  thread calling findEclipses(), between spans: once per day of the
+ *  search range without a thread pool, and once per 30 days with one,
+ *  so an abort takes effect once the spans being searched are done.
+ */
 class EclipseFinder
 {
  public:
     EclipseFinder(Body*, EclipseFinderWatcher* = nullptr);
 
+    void setThreadPool(ThreadPool* pool);
+
     void findEclipses(double startDate,
                       double endDate,
                       int eclipseTypeMask,
@@ -55,6 +68,7 @@ class EclipseFinder
  private:
     Body* body;
     EclipseFinderWatcher* watcher;
+    ThreadPool* threadPool{ nullptr };
 };
 #endif // _ECLIPSEFINDER_H_
 
@@ -0,0 +1,312 @@
+// eventfinder.cpp
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// Find conjunctions, occultations, transits and closest approaches of
+// pairs of objects seen from an observer.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <celengine/body.h>
+#include <celengine/location.h>
+#include <celengine/star.h>
+#include <celmath/mathlib.h>
+#include <celmath/solve.h>
+#include <celutil/threadpool.h>
+#include "eventfinder.h"
+
+using namespace Eigen;
+using namespace std;
+using namespace celmath;
+
+
+// Search steps of one hour are taken by default
+constexpr const double DefaultSearchStep = 1.0 / 24.0;
+// Precision of the times of events in days, about a tenth of a second
+constexpr const double TimeTolerance = 1.0e-6;
+
+
+// Whether the positions of an object may be computed on several threads
+// at once
+static bool isThreadSafe(const Selection& sel)
+{
+    switch (sel.getType())
+    {
+    case Selection::Type_Body:
+        return sel.body()->isThreadSafe();
+
+    case Selection::Type_Location:
+        return sel.location()->getParentBody() == nullptr ||
+               sel.location()->getParentBody()->isThreadSafe();
+
+    case Selection::Type_Star:
+        return sel.star()->isThreadSafe();
+
+    default:
+        return true;
+    }
+}
+
+
+namespace
+{
+// Geometry of a pair of objects seen from the observer at some time
+struct PairState
+{
+    double separation;
+    double distance;
+    // Distances of the objects from the observer, and their angular radii
+    double range1;
+    double range2;
+    double radius1;
+    double radius2;
+};
+
+class PairGeometry
+{
+ public:
+    PairGeometry(const Selection& _observer, const Selection& _first, const Selection& _second) :
+        observer(_observer),
+        first(_first),
+        second(_second)
+    {
+    }
+
+    PairState at(double t) const
+    {
+        UniversalCoord origin = observer.getPosition(t);
+        Vector3d p1 = first.getPosition(t).offsetFromKm(origin);
+        Vector3d p2 = second.getPosition(t).offsetFromKm(origin);
+
+        PairState s;
+        // The arctangent stays accurate for small separations
+        s.separation = atan2(p1.cross(p2).norm(), p1.dot(p2));
+        s.distance = (p2 - p1).norm();
+        s.range1 = p1.norm();
+        s.range2 = p2.norm();
+        s.radius1 = angularRadius(first.radius(), s.range1);
+        s.radius2 = angularRadius(second.radius(), s.range2);
+        return s;
+    }
+
+    double separation(double t) const
+    {
+        return at(t).separation;
+    }
+
+    // Separation less the sum of the angular radii, negative while the
+    // disks overlap
+    double overlap(double t) const
+    {
+        PairState s = at(t);
+        return s.separation - s.radius1 - s.radius2;
+    }
+
+    double distance(double t) const
+    {
+        return first.getPosition(t).offsetFromKm(second.getPosition(t)).norm();
+    }
+
+ private:
+    static double angularRadius(double radius, double range)
+    {
+        return radius < range ? asin(radius / range) : PI / 2.0;
+    }
+
+    const Selection& observer;
+    const Selection& first;
+    const Selection& second;
+};
+
+// Given a time at which the disks of the pair overlap, find the contact
+// before it if dt is negative, or after it, within the search range.
+// The contact is bracketed by steps of dt, then found by Brent's method.
+double findContact(const PairGeometry& pair, double now, double dt, double limit)
+{
+    auto overlap = [&pair](double t) { return pair.overlap(t); };
+
+    double inside = now;
+    for (;;)
+    {
+        double t = dt > 0.0 ? min(inside + dt, limit) : max(inside + dt, limit);
+        if (overlap(t) >= 0.0)
+            return solve_brent(overlap, inside, t, TimeTolerance).first;
+        if (t == limit)
+            return limit;
+        inside = t;
+    }
+}
+}
+
+
+EventFinder::EventFinder(const Selection& _observer) :
+    observer(_observer),
+    searchStep(DefaultSearchStep),
+    maxSeparation(PI)
+{
+}
+
+
+void EventFinder::addPair(const Selection& first, const Selection& second)
+{
+    pairs.emplace_back(first, second);
+}
+
+
+void EventFinder::setSearchStep(double step)
+{
+    searchStep = step;
+}
+
+
+void EventFinder::setMaxSeparation(double separation)
+{
+    maxSeparation = separation;
+}
+
+
+void EventFinder::setThreadPool(ThreadPool* pool)
+{
+    threadPool = pool;
+}
+
+
+void EventFinder::findPairEvents(const Selection& first, const Selection& second,
+                                 double startDate, double endDate,
+                                 int eventTypeMask,
+                                 vector<Event>& events) const
+{
+    PairGeometry pair(observer, first, second);
+
+    // Evenly spaced steps no longer than the search step; the times are
+    // computed from the step number so that they don't drift.
+    auto nSteps = (size_t) ceil((endDate - startDate) / searchStep) + 1;
+    nSteps = max(nSteps, (size_t) 3);
+    double step = (endDate - startDate) / (double) (nSteps - 1);
+    auto stepTime = [=](size_t n)
+    {
+        return n == nSteps - 1 ? endDate : startDate + (double) n * step;
+    };
+
+    const int separationEvents = Event::Conjunction | Event::Occultation | Event::Transit;
+    // End of the last occultation or transit found, so that an overlap
+    // with several minima of the separation is reported once
+    double overlapEnd = -numeric_limits<double>::infinity();
+
+    PairState s0 = pair.at(stepTime(0));
+    PairState s1 = pair.at(stepTime(1));
+    for (size_t n = 1; n < nSteps - 1; n++)
+    {
+        PairState s2 = pair.at(stepTime(n + 1));
+        double t0 = stepTime(n - 1);
+        double t1 = stepTime(n);
+        double t2 = stepTime(n + 1);
+
+        if ((eventTypeMask & separationEvents) != 0 &&
+            s1.separation < s0.separation && s1.separation <= s2.separation)
+        {
+            auto separation = [&pair](double t) { return pair.separation(t); };
+            double t = minimize_brent(separation, t0, t1, t2, TimeTolerance).first;
+            PairState s = pair.at(t);
+
+            Event event;
+            event.first = first;
+            event.second = second;
+            event.time = event.startTime = event.endTime = t;
+            event.separation = s.separation;
+            event.distance = s.distance;
+
+            if ((eventTypeMask & Event::Conjunction) != 0 && s.separation <= maxSeparation)
+            {
+                event.type = Event::Conjunction;
+                events.push_back(event);
+            }
+
+            if (s.separation < s.radius1 + s.radius2 && t > overlapEnd)
+            {
+                // The nearer object occults the farther one if its disk is
+                // the larger, and transits it otherwise.
+                bool firstNearer = s.range1 <= s.range2;
+                double nearRadius = firstNearer ? s.radius1 : s.radius2;
+                double farRadius = firstNearer ? s.radius2 : s.radius1;
+                event.type = nearRadius >= farRadius ? Event::Occultation : Event::Transit;
+                if ((eventTypeMask & event.type) != 0)
+                {
+                    if (!firstNearer)
+                        swap(event.first, event.second);
+                    event.startTime = findContact(pair, t, -step, startDate);
+                    event.endTime = findContact(pair, t, step, endDate);
+                    overlapEnd = event.endTime;
+                    events.push_back(event);
+                }
+            }
+        }
+
+        if ((eventTypeMask & Event::ClosestApproach) != 0 &&
+            s1.distance < s0.distance && s1.distance <= s2.distance)
+        {
+            auto distance = [&pair](double t) { return pair.distance(t); };
+            double t = minimize_brent(distance, t0, t1, t2, TimeTolerance).first;
+            PairState s = pair.at(t);
+
+            Event event;
+            event.type = Event::ClosestApproach;
+            event.first = first;
+            event.second = second;
+            event.time = event.startTime = event.endTime = t;
+            event.separation = s.separation;
+            event.distance = s.distance;
+            events.push_back(event);
+        }
+
+        s0 = s1;
+        s1 = s2;
+    }
+}
+
+
+void EventFinder::findEvents(double startDate,
+                             double endDate,
+                             int eventTypeMask,
+                             vector<Event>& events) const
+{
+    if (pairs.empty() || !(endDate > startDate) || !(searchStep > 0.0))
+        return;
+
+    // The events of each pair are found independently of the others
+    vector<vector<Event>> pairEvents(pairs.size());
+    auto searchPair = [&](size_t i)
+    {
+        findPairEvents(pairs[i].first, pairs[i].second,
+                       startDate, endDate, eventTypeMask, pairEvents[i]);
+    };
+
+    bool threadSafe = isThreadSafe(observer) &&
+                      all_of(pairs.begin(), pairs.end(),
+                             [](const pair<Selection, Selection>& p)
+                             {
+                                 return isThreadSafe(p.first) && isThreadSafe(p.second);
+                             });
+    if (threadPool != nullptr && threadSafe && pairs.size() > 1)
+    {
+        threadPool->parallelFor(pairs.size(), searchPair);
+    }
+    else
+    {
+        for (size_t i = 0; i < pairs.size(); i++)
+            searchPair(i);
+    }
+
+    // Events at the same time are listed in the order of their pairs
+    size_t firstEvent = events.size();
+    for (const auto& found : pairEvents)
+        events.insert(events.end(), found.begin(), found.end());
+    stable_sort(events.begin() + firstEvent, events.end(),
+                [](const Event& a, const Event& b) { return a.time < b.time; });
+}
@@ -0,0 +1,105 @@
+// eventfinder.h
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// Find conjunctions, occultations, transits and closest approaches of
+// pairs of objects seen from an observer.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <utility>
+#include <vector>
+#include <celengine/selection.h>
+
+class ThreadPool;
+
+struct Event
+{
+    // values must be 2^n
+    enum Type
+    {
+        Conjunction     = 0x01,
+        Occultation     = 0x02,
+        Transit         = 0x04,
+        ClosestApproach = 0x08,
+    };
+
+    Type type{ Conjunction };
+
+    // The objects of the pair; for occultations and transits, first is
+    // the one nearer to the observer.
+    Selection first;
+    Selection second;
+
+    // Time of the least angular separation of the objects, or of their
+    // least distance for closest approaches
+    double time{ 0.0 };
+    // Times of the first and last contact of the disks for occultations
+    // and transits, within the range searched, and time for the other
+    // events
+    double startTime{ 0.0 };
+    double endTime{ 0.0 };
+
+    // Angular separation of the centers seen by the observer in radians,
+    // and distance between the centers in kilometers, at time
+    double separation{ 0.0 };
+    double distance{ 0.0 };
+};
+
+/*! EventFinder searches for the events of pairs of objects seen from an
+ *  observer, using their geometric positions. The angular separation of
+ *  each pair, and their distance, are sampled at each search step; a
+ *  step less than both its neighbors brackets a minimum, which is found
+ *  by Brent's method:
+ *
+ *  - a conjunction is a minimum of the separation below the maximum
+ *    separation;
+ *  - an occultation or a transit is a minimum where the disks of the
+ *    objects overlap, with the nearer disk the larger or the smaller of
+ *    the two; the contacts are the roots of the separation less the sum
+ *    of the angular radii, also found by Brent's method;
+ *  - a closest approach is a minimum of the distance between the objects,
+ *    wherever the observer is.
+ *
+ *  Minima closer together than about a search step may be missed. The
+ *  pairs are searched on the threads of the thread pool if one is set
+ *  and all the objects may be used on several threads at once.
+ */
+class EventFinder
+{
+ public:
+    explicit EventFinder(const Selection& observer);
+
+    void addPair(const Selection& first, const Selection& second);
+
+    // Step of the search in days, an hour by default
+    void setSearchStep(double step);
+    // Largest separation of conjunctions in radians; all minima of the
+    // separation are reported by default.
+    void setMaxSeparation(double separation);
+    void setThreadPool(ThreadPool* pool);
+
+    // Append the events of the types in eventTypeMask to events, ordered
+    // by time.
+    void findEvents(double startDate,
+                    double endDate,
+                    int eventTypeMask,
+                    std::vector<Event>& events) const;
+
+ private:
+    void findPairEvents(const Selection& first, const Selection& second,
+                        double startDate, double endDate,
+                        int eventTypeMask,
+                        std::vector<Event>& events) const;
+
+    Selection observer;
+    std::vector<std::pair<Selection, Selection>> pairs;
+    double searchStep;
+    double maxSeparation;
+    ThreadPool* threadPool{ nullptr };
+};
@@ -380,6 +380,7 @@ static void eclipseCompute(GtkButton* button, EclipseData* ed)
         if (planete != nullptr)
         {
             EclipseFinder ef(planete);
+            ef.setThreadPool(ed->app->core->getThreadPool());
             ef.findEclipses((double)from, (double)to, ed->type, eclipseListRaw);
         }
     }
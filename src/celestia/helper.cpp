@@ -128,6 +128,17 @@ std::string Helper::getRenderInfo(const Renderer *r)
     if (info.count("MaxCubeMapSize") > 0)
         s += fmt::sprintf(_("Max cube map size: %s\n"), info["MaxCubeMapSize"]);
 
+    if (info.count("OrbitCacheEntries") > 0)
+    {
+        s += fmt::sprintf(_("Orbit path cache: %s paths, %s of %s bytes\n"),
+                          info["OrbitCacheEntries"], info["OrbitCacheBytes"], info["OrbitCacheBudget"]);
+        s += fmt::sprintf(_("Orbit path cache hits: %s, misses: %s, evictions: %s, pending: %s\n"),
+                          info["OrbitCacheHits"], info["OrbitCacheMisses"],
+                          info["OrbitCacheEvictions"], info["OrbitPathsPending"]);
+        s += fmt::sprintf(_("Orbit paths sampled: %s, %s samples in %s ms\n"),
+                          info["OrbitPathsSampled"], info["OrbitPathSamples"], info["OrbitSamplingTime"]);
+    }
+
     s += "\n";
 
     if (info.count("Extensions") > 0)
@@ -348,6 +348,7 @@ void EventFinder::slotFindEclipses()
     }
 
     EclipseFinder finder(obj.body(), this);
+    finder.setThreadPool(appCore->getThreadPool());
     searchTimer.start();
 
     double startTimeTDB = QDateToTDB(startDate);
@@ -354,6 +354,7 @@ BOOL APIENTRY EclipseFinderProc(HWND hDlg,
                     if (planete != nullptr)
                     {
                         EclipseFinder ef(planete);
+                        ef.setThreadPool(eclipseFinderDlg->appCore->getThreadPool());
                         ef.findEclipses((double)from, (double)to, eclipseFinderDlg->type, eclipseList);
                     }
                 }
@@ -7,6 +7,9 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <utility>
 
 #pragma once
@@ -79,4 +82,190 @@ template<class T, class F> std::pair<T, T> solve_iteration_fixed(F f,
     return std::make_pair(x2, x2 - x);
 }
 
+
+// Solve a function using Brent's method, which combines bisection with
+// the secant method and inverse quadratic interpolation. The values of
+// f at lower and upper must have opposite signs. Returns a pair with the
+// solution as the first element and the error as the second.
+template<class T, class F> std::pair<T, T> solve_brent(F f,
+                                                       T lower, T upper,
+                                                       T err,
+                                                       int maxIter = 100)
+{
+    using std::abs;
+
+    T a = lower;
+    T b = upper;
+    T fa = f(a);
+    T fb = f(b);
+    T c = b;
+    T fc = fb;
+    T d = b - a;
+    T e = d;
+
+    for (int i = 0; i < maxIter; i++)
+    {
+        // Keep the root between b and c, with b the best estimate
+        if ((fb > 0) == (fc > 0))
+        {
+            c = a;
+            fc = fa;
+            d = e = b - a;
+        }
+        if (abs(fc) < abs(fb))
+        {
+            a = b; b = c; c = a;
+            fa = fb; fb = fc; fc = fa;
+        }
+
+        T tol = 2 * std::numeric_limits<T>::epsilon() * abs(b) + err;
+        T m = (c - b) * (T) 0.5;
+        if (abs(m) <= tol || fb == 0)
+            return std::make_pair(b, abs(m));
+
+        if (abs(e) >= tol && abs(fa) > abs(fb))
+        {
+            T s = fb / fa;
+            T p, q;
+            if (a == c)
+            {
+                // Secant method
+                p = 2 * m * s;
+                q = 1 - s;
+            }
+            else
+            {
+                // Inverse quadratic interpolation
+                T r = fb / fc;
+                q = fa / fc;
+                p = s * (2 * m * q * (q - r) - (b - a) * (r - 1));
+                q = (q - 1) * (r - 1) * (s - 1);
+            }
+            if (p > 0)
+                q = -q;
+            else
+                p = -p;
+
+            // Accept the interpolation only if it falls well within the
+            // bracket and converges faster than bisection
+            if (2 * p < std::min(3 * m * q - abs(tol * q), abs(e * q)))
+            {
+                e = d;
+                d = p / q;
+            }
+            else
+            {
+                d = e = m;
+            }
+        }
+        else
+        {
+            d = e = m;
+        }
+
+        a = b;
+        fa = fb;
+        b += abs(d) > tol ? d : (m > 0 ? tol : -tol);
+        fb = f(b);
+    }
+
+    return std::make_pair(b, abs(c - b) / 2);
+}
+
+
+// Find a minimum of a function using Brent's method, which combines golden
+// section search with parabolic interpolation. The point x must lie
+// between lower and upper, with f(x) below f(lower) and f(upper). Returns
+// a pair with the position of the minimum as the first element and the
+// value of f there as the second.
+template<class T, class F> std::pair<T, T> minimize_brent(F f,
+                                                          T lower, T x, T upper,
+                                                          T err,
+                                                          int maxIter = 100)
+{
+    using std::abs;
+
+    const T goldenRatio = (T) 0.3819660112501051;
+
+    T a = std::min(lower, upper);
+    T b = std::max(lower, upper);
+    T w = x;
+    T v = x;
+    T fx = f(x);
+    T fw = fx;
+    T fv = fx;
+    T d = 0;
+    T e = 0;
+
+    for (int i = 0; i < maxIter; i++)
+    {
+        T xm = (a + b) * (T) 0.5;
+        T tol = 2 * std::numeric_limits<T>::epsilon() * abs(x) + err;
+        if (abs(x - xm) <= 2 * tol - (b - a) * (T) 0.5)
+            break;
+
+        bool golden = true;
+        if (abs(e) > tol)
+        {
+            // Fit a parabola through x, w and v
+            T r = (x - w) * (fx - fv);
+            T q = (x - v) * (fx - fw);
+            T p = (x - v) * q - (x - w) * r;
+            q = 2 * (q - r);
+            if (q > 0)
+                p = -p;
+            else
+                q = -q;
+
+            // Accept the parabolic step only if it falls within the bracket
+            // and moves less than half the step before last
+            if (abs(p) < abs(q * e * (T) 0.5) && p > q * (a - x) && p < q * (b - x))
+            {
+                e = d;
+                d = p / q;
+                T u = x + d;
+                if (u - a < 2 * tol || b - u < 2 * tol)
+                    d = xm > x ? tol : -tol;
+                golden = false;
+            }
+        }
+        if (golden)
+        {
+            e = x >= xm ? a - x : b - x;
+            d = goldenRatio * e;
+        }
+
+        T u = abs(d) >= tol ? x + d : x + (d > 0 ? tol : -tol);
+        T fu = f(u);
+        if (fu <= fx)
+        {
+            if (u >= x)
+                a = x;
+            else
+                b = x;
+            v = w; fv = fw;
+            w = x; fw = fx;
+            x = u; fx = fu;
+        }
+        else
+        {
+            if (u < x)
+                a = u;
+            else
+                b = u;
+            if (fu <= fw || w == x)
+            {
+                v = w; fv = fw;
+                w = u; fw = fu;
+            }
+            else if (fu <= fv || v == x || v == w)
+            {
+                v = u; fv = fu;
+            }
+        }
+    }
+
+    return std::make_pair(x, fx);
+}
+
 }; // namespace celmath
@@ -1117,6 +1117,9 @@ void CommandLoadFragment::process(ExecutionEnvironment& env)
     istringstream in(fragment);
     if (compareIgnoringCase(type, "ssc") == 0)
     {
+        // Objects which are replaced delete their orbits
+        if (env.getRenderer() != nullptr)
+            env.getRenderer()->invalidateOrbitCache();
         LoadSolarSystemObjects(in, *u, dir);
     }
     else if (compareIgnoringCase(type, "stc") == 0)
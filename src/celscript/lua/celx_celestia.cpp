@@ -31,6 +31,7 @@
 #include "celx_rotation.h"
 #include "celx_vector.h"
 #include "celx_category.h"
+#include <celestia/eventfinder.h>
 #include <celestia/url.h>
 #include <celestia/celestiacore.h>
 #include <celestia/view.h>
@@ -2117,6 +2118,8 @@ static int celestia_loadfragment(lua_State* l)
     istringstream in(frag);
     if (compareIgnoringCase(type, "ssc") == 0)
     {
+        // Objects which are replaced delete their orbits
+        appCore->getRenderer()->invalidateOrbitCache();
         ret = LoadSolarSystemObjects(in, *u, dir);
     }
     else if (compareIgnoringCase(type, "stc") == 0)
@@ -2457,6 +2460,181 @@ static int celestia_getrootcategories(lua_State *l)
     return celx.pushIterable<UserCategory*>(set);
 }
 
+// Names of the event types in celestia:findevents()
+static const struct
+{
+    const char* name;
+    Event::Type type;
+} EventTypeNames[] =
+{
+    { "conjunction",     Event::Conjunction     },
+    { "occultation",     Event::Occultation     },
+    { "transit",         Event::Transit         },
+    { "closestapproach", Event::ClosestApproach },
+};
+
+static int parseEventType(const char* name)
+{
+    for (const auto& e : EventTypeNames)
+    {
+        if (compareIgnoringCase(name, e.name) == 0)
+            return e.type;
+    }
+    return 0;
+}
+
+// celestia:findevents{ observer = obj, pairs = { { obj1, obj2 }, ... },
+//                      starttime = t0, endtime = t1, types = { ... },
+//                      step = days, maxseparation = radians }
+// Return the events of the pairs seen from the observer between the start
+// and end times, ordered by time.
+static int celestia_findevents(lua_State *l)
+{
+    CelxLua celx(l);
+    celx.checkArgs(2, 2, "One table argument expected for celestia:findevents()");
+    if (!lua_istable(l, 2))
+    {
+        celx.doError("Argument to celestia:findevents() must be a table");
+        return 0;
+    }
+
+    CelestiaCore* appCore = this_celestia(l);
+
+    auto getNumber = [&](const char* field, double defaultValue, const char* errorMessage)
+    {
+        lua_pushstring(l, field);
+        lua_gettable(l, 2);
+        double value = lua_isnil(l, 3) ? defaultValue : celx.safeGetNumber(3, AllErrors, errorMessage);
+        lua_settop(l, 2);
+        return value;
+    };
+
+    lua_pushstring(l, "observer");
+    lua_gettable(l, 2);
+    Selection* observer = to_object(l, 3);
+    if (observer == nullptr)
+    {
+        celx.doError("Field observer of celestia:findevents() must be an object");
+        return 0;
+    }
+    EventFinder finder(*observer);
+    lua_settop(l, 2);
+
+    lua_pushstring(l, "pairs");
+    lua_gettable(l, 2);
+    if (!lua_istable(l, 3))
+    {
+        celx.doError("Field pairs of celestia:findevents() must be a table");
+        return 0;
+    }
+    for (int i = 1; ; i++)
+    {
+        lua_rawgeti(l, 3, i);
+        if (lua_isnil(l, 4))
+            break;
+
+        Selection* first = nullptr;
+        Selection* second = nullptr;
+        if (lua_istable(l, 4))
+        {
+            lua_rawgeti(l, 4, 1);
+            lua_rawgeti(l, 4, 2);
+            first = to_object(l, 5);
+            second = to_object(l, 6);
+        }
+        if (first == nullptr || second == nullptr)
+        {
+            celx.doError("Pairs of celestia:findevents() must be tables of two objects");
+            return 0;
+        }
+        finder.addPair(*first, *second);
+        lua_settop(l, 3);
+    }
+    lua_settop(l, 2);
+
+    int eventTypeMask = 0;
+    auto addEventType = [&](const char* name)
+    {
+        int type = parseEventType(name);
+        if (type == 0)
+        {
+            string error = fmt::sprintf("Unknown event type in celestia:findevents(): %s", name);
+            celx.doError(error.c_str());
+        }
+        eventTypeMask |= type;
+    };
+    lua_pushstring(l, "types");
+    lua_gettable(l, 2);
+    if (lua_isnil(l, 3))
+    {
+        for (const auto& e : EventTypeNames)
+            eventTypeMask |= e.type;
+    }
+    else if (lua_isstring(l, 3))
+    {
+        addEventType(lua_tostring(l, 3));
+    }
+    else if (lua_istable(l, 3))
+    {
+        lua_pushnil(l);
+        while (lua_next(l, 3) != 0)
+        {
+            if (!lua_isstring(l, -1))
+                celx.doError("Field types of celestia:findevents() must name event types");
+            addEventType(lua_tostring(l, -1));
+            lua_pop(l, 1);
+        }
+    }
+    lua_settop(l, 2);
+    if (eventTypeMask == 0)
+    {
+        celx.doError("Field types of celestia:findevents() must name event types");
+        return 0;
+    }
+
+    double now = appCore->getSimulation()->getTime();
+    double startTime = getNumber("starttime", now, "Field starttime of celestia:findevents() must be a number");
+    double endTime = getNumber("endtime", startTime + 365.25, "Field endtime of celestia:findevents() must be a number");
+    double step = getNumber("step", 1.0 / 24.0, "Field step of celestia:findevents() must be a number");
+    if (step <= 0.0)
+    {
+        celx.doError("Field step of celestia:findevents() must be positive");
+        return 0;
+    }
+    finder.setSearchStep(step);
+    finder.setMaxSeparation(getNumber("maxseparation", PI, "Field maxseparation of celestia:findevents() must be a number"));
+    finder.setThreadPool(appCore->getThreadPool());
+
+    vector<Event> events;
+    finder.findEvents(startTime, endTime, eventTypeMask, events);
+
+    lua_newtable(l);
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        const Event& event = events[i];
+        lua_newtable(l);
+        for (const auto& e : EventTypeNames)
+        {
+            if (e.type == event.type)
+                celx.setTable("type", e.name);
+        }
+        lua_pushstring(l, "first");
+        celx.newObject(event.first);
+        lua_settable(l, -3);
+        lua_pushstring(l, "second");
+        celx.newObject(event.second);
+        lua_settable(l, -3);
+        celx.setTable("time", event.time);
+        celx.setTable("starttime", event.startTime);
+        celx.setTable("endtime", event.endTime);
+        celx.setTable("separation", event.separation);
+        celx.setTable("distance", event.distance);
+        lua_rawseti(l, -2, (int) i + 1);
+    }
+
+    return 1;
+}
+
 static int celestia_bindtranslationdomain(lua_State *l)
 {
 #ifdef ENABLE_NLS
@@ -2495,6 +2673,7 @@ void ExtendCelestiaMetaTable(lua_State* l)
     celx.registerMethod("deletecategory", celestia_deletecategory);
     celx.registerMethod("getcategories", celestia_getcategories);
     celx.registerMethod("getrootcategories", celestia_getrootcategories);
+    celx.registerMethod("findevents", celestia_findevents);
     celx.registerMethod("bindtranslationdomain", celestia_bindtranslationdomain);
     celx.pop(1);
 }
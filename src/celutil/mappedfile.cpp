@@ -0,0 +1,163 @@
+// mappedfile.cpp
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// Read-only memory mapped files.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <utility>
+#include "mappedfile.h"
+
+
+MappedFile::MappedFile(const fs::path& filename)
+{
+    open(filename);
+}
+
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+
+MappedFile::MappedFile(MappedFile&& other) noexcept :
+    m_data(other.m_data),
+    m_size(other.m_size)
+#ifdef _WIN32
+  , m_file(other.m_file),
+    m_map(other.m_map)
+#endif
+{
+    other.m_data = nullptr;
+    other.m_size = 0;
+#ifdef _WIN32
+    other.m_file = nullptr;
+    other.m_map  = nullptr;
+#endif
+}
+
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other)
+    {
+        close();
+        std::swap(m_data, other.m_data);
+        std::swap(m_size, other.m_size);
+#ifdef _WIN32
+        std::swap(m_file, other.m_file);
+        std::swap(m_map,  other.m_map);
+#endif
+    }
+    return *this;
+}
+
+
+#ifdef _WIN32
+bool MappedFile::open(const fs::path& filename)
+{
+    close();
+
+    HANDLE file = CreateFileW(filename.wstring().c_str(), GENERIC_READ,
+                              FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                              nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE map = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (map == nullptr)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* view = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr)
+    {
+        CloseHandle(map);
+        CloseHandle(file);
+        return false;
+    }
+
+    m_file = file;
+    m_map  = map;
+    m_data = static_cast<const char*>(view);
+    m_size = static_cast<size_t>(fileSize.QuadPart);
+
+    return true;
+}
+
+
+void MappedFile::close()
+{
+    if (m_data != nullptr)
+        UnmapViewOfFile(m_data);
+    if (m_map != nullptr)
+        CloseHandle(static_cast<HANDLE>(m_map));
+    if (m_file != nullptr)
+        CloseHandle(static_cast<HANDLE>(m_file));
+
+    m_data = nullptr;
+    m_size = 0;
+    m_file = nullptr;
+    m_map  = nullptr;
+}
+#else
+bool MappedFile::open(const fs::path& filename)
+{
+    close();
+
+    int fd = ::open(filename.string().c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void* addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping holds its own reference to the file.
+    ::close(fd);
+    if (addr == MAP_FAILED)
+        return false;
+
+    m_data = static_cast<const char*>(addr);
+    m_size = static_cast<size_t>(st.st_size);
+
+    return true;
+}
+
+
+void MappedFile::close()
+{
+    if (m_data != nullptr)
+        munmap(const_cast<char*>(m_data), m_size);
+
+    m_data = nullptr;
+    m_size = 0;
+}
+#endif
@@ -0,0 +1,47 @@
+// mappedfile.h
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// Read-only memory mapped files.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <celcompat/filesystem.h>
+
+/*! MappedFile maps a whole file read-only into the address space of the
+ *  process. The mapping stays valid until close() is called or the object
+ *  is destroyed, so pointers obtained from data() must not outlive it.
+ */
+class MappedFile
+{
+ public:
+    MappedFile() = default;
+    explicit MappedFile(const fs::path& filename);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&&) noexcept;
+    MappedFile& operator=(MappedFile&&) noexcept;
+
+    bool open(const fs::path& filename);
+    void close();
+
+    bool isOpen() const { return m_data != nullptr; }
+    const char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+ private:
+    const char* m_data  { nullptr };
+    size_t      m_size  { 0 };
+#ifdef _WIN32
+    void*       m_file  { nullptr };
+    void*       m_map   { nullptr };
+#endif
+};
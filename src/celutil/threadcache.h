@@ -0,0 +1,41 @@
+// threadcache.h
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// Helpers for the small per thread caches of values computed at a time.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+/*! Objects whose computed states are cached per thread, such as orbits,
+ *  rotation models and reference frames, own a key unique over the run,
+ *  so that an object allocated where a deleted one was doesn't get its
+ *  cached states. Each thread has a table of entries per kind of object,
+ *  found by hashing the key of the object and the time.
+ */
+inline uint64_t newThreadCacheKey()
+{
+    static std::atomic<uint64_t> nextKey{ 1 };
+    return nextKey++;
+}
+
+
+// Index of the entry for an object and a time in a table of size entries
+inline unsigned int threadCacheIndex(uint64_t key, double t, unsigned int size)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &t, sizeof bits);
+    uint64_t h = bits ^ (key * 0x9e3779b97f4a7c15ull);
+    h = (h ^ (h >> 31)) * 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 29;
+
+    return (unsigned int) (h % size);
+}
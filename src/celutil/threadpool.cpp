@@ -0,0 +1,142 @@
+// threadpool.cpp
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// A pool of worker threads sharing batches of tasks by work stealing.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "threadpool.h"
+
+using namespace std;
+
+
+ThreadPool::ThreadPool(unsigned int nThreads)
+{
+    if (nThreads == 0)
+        nThreads = max(1u, thread::hardware_concurrency());
+
+    for (unsigned int i = 0; i < nThreads; i++)
+        queues.emplace_back(new Queue);
+
+    for (unsigned int i = 0; i + 1 < nThreads; i++)
+        workers.emplace_back(&ThreadPool::workerMain, this, i);
+}
+
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> lock(stateMutex);
+        quit = true;
+    }
+    wakeWorkers.notify_all();
+
+    for (auto& worker : workers)
+        worker.join();
+}
+
+
+void ThreadPool::run(vector<Task>& tasks)
+{
+    if (tasks.empty())
+        return;
+
+    if (workers.empty())
+    {
+        for (auto& task : tasks)
+            task();
+        return;
+    }
+
+    lock_guard<mutex> batchLock(batchMutex);
+
+    pending = tasks.size();
+    for (size_t i = 0; i < tasks.size(); i++)
+    {
+        Queue& queue = *queues[i % queues.size()];
+        lock_guard<mutex> lock(queue.mutex);
+        queue.tasks.push_back(&tasks[i]);
+    }
+
+    {
+        lock_guard<mutex> lock(stateMutex);
+        generation++;
+    }
+    wakeWorkers.notify_all();
+
+    workOnBatch((unsigned int) workers.size());
+
+    // Wait for tasks still running on other threads
+    unique_lock<mutex> lock(stateMutex);
+    batchDone.wait(lock, [this]() { return pending == 0; });
+}
+
+
+// Take a task from the back of our own queue, or failing that, from the
+// front of another thread's queue.
+bool ThreadPool::takeTask(unsigned int index, Task*& task)
+{
+    {
+        Queue& own = *queues[index];
+        lock_guard<mutex> lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i < queues.size(); i++)
+    {
+        Queue& victim = *queues[(index + i) % queues.size()];
+        lock_guard<mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+void ThreadPool::workOnBatch(unsigned int index)
+{
+    Task* task;
+    while (takeTask(index, task))
+    {
+        (*task)();
+        if (--pending == 0)
+        {
+            // Lock so that the notification can't slip in between the
+            // submitter's check of pending and its wait.
+            lock_guard<mutex> lock(stateMutex);
+            batchDone.notify_all();
+        }
+    }
+}
+
+
+void ThreadPool::workerMain(unsigned int index)
+{
+    unsigned int seen = 0;
+    for (;;)
+    {
+        {
+            unique_lock<mutex> lock(stateMutex);
+            wakeWorkers.wait(lock, [this, seen]() { return quit || generation != seen; });
+            if (quit)
+                return;
+            seen = generation;
+        }
+
+        workOnBatch(index);
+    }
+}
@@ -0,0 +1,81 @@
+// threadpool.h
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// A pool of worker threads sharing batches of tasks by work stealing.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*! ThreadPool runs batches of independent tasks on a fixed set of worker
+ *  threads. The tasks of a batch are spread over per thread queues; a
+ *  thread takes tasks from the back of its own queue and, once that is
+ *  empty, steals from the front of the others. The thread submitting a
+ *  batch works on it as well, so a pool of n threads starts n - 1
+ *  workers, and a pool of one thread runs everything on the caller.
+ */
+class ThreadPool
+{
+ public:
+    typedef std::function<void()> Task;
+
+    // A thread count of 0 uses one thread per hardware thread.
+    explicit ThreadPool(unsigned int nThreads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned int threadCount() const { return (unsigned int) workers.size() + 1; }
+
+    // Run all tasks and return once they have completed. Tasks must not
+    // throw, and must not call run() themselves; only one thread at a
+    // time may submit a batch.
+    void run(std::vector<Task>& tasks);
+
+    // Convenience wrapper running body(i) for every i in [0, n)
+    template<typename F> void parallelFor(size_t n, F body)
+    {
+        std::vector<Task> tasks;
+        tasks.reserve(n);
+        for (size_t i = 0; i < n; i++)
+            tasks.push_back([&body, i]() { body(i); });
+        run(tasks);
+    }
+
+ private:
+    struct Queue
+    {
+        std::mutex         mutex;
+        std::deque<Task*>  tasks;
+    };
+
+    bool takeTask(unsigned int index, Task*& task);
+    void workOnBatch(unsigned int index);
+    void workerMain(unsigned int index);
+
+    std::vector<std::thread>            workers;
+    // One queue per worker, with the caller's queue last
+    std::vector<std::unique_ptr<Queue>> queues;
+
+    std::mutex                          batchMutex;
+    std::mutex                          stateMutex;
+    std::condition_variable             wakeWorkers;
+    std::condition_variable             batchDone;
+    std::atomic<size_t>                 pending{ 0 };
+    unsigned int                        generation{ 0 };
+    bool                                quit{ false };
+};
@@ -607,6 +607,36 @@ int UTF8StringCompare(const std::string& s0, const std::string& s1, size_t n, bo
 }
 
 
+//! Normalize and lower case a UTF-8 string, so that two strings compare
+//! equal with UTF8StringCompare(s0, s1, n, true) when the first n
+//! characters of their folded forms are the same. Bytes which aren't
+//! valid UTF-8 are copied unchanged.
+std::string UTF8FoldCase(const std::string& s)
+{
+    std::string folded;
+    folded.reserve(s.length());
+
+    int len = s.length();
+    int i = 0;
+    while (i < len)
+    {
+        wchar_t ch = 0;
+        if (!UTF8Decode(s, i, ch))
+        {
+            folded += s[i++];
+            continue;
+        }
+        i += UTF8EncodedSize(ch);
+
+        char buf[7];
+        int n = UTF8Encode((wchar_t) std::tolower(UTF8Normalize(ch)), buf);
+        folded.append(buf, n);
+    }
+
+    return folded;
+}
+
+
 #if 0
 //! Currently incomplete, but could be a helpful class for dealing with
 //! UTF-8 streams
@@ -806,19 +836,23 @@ std::string ReplaceGreekLetterAbbr(const std::string& str)
 
     if (str[0] >= 'A' && str[0] <= 'Z')
     {
-        // Linear search through all letter abbreviations
+        // Linear search through all letter abbreviations; both the names
+        // and the abbreviations start with an upper case letter, so
+        // comparing the first bytes rejects most of them quickly.
         for (int i = 0; i < instance->nLetters; i++)
         {
-            std::string prefix = instance->abbrevs[i];
-            if (len != prefix.length() || UTF8StringCompare(str, prefix, len, true) != 0)
+            const std::string* prefix = &instance->abbrevs[i];
+            if (len != prefix->length() || str[0] != (*prefix)[0] ||
+                UTF8StringCompare(str, *prefix, len, true) != 0)
             {
-                prefix = instance->names[i];
-                if (len != prefix.length() || UTF8StringCompare(str, prefix, len, true) != 0)
+                prefix = &instance->names[i];
+                if (len != prefix->length() || str[0] != (*prefix)[0] ||
+                    UTF8StringCompare(str, *prefix, len, true) != 0)
                     continue;
             }
 
             std::string ret = greekAlphabetUTF8[i];
-            auto len = prefix.length();
+            auto len = prefix->length();
             for (; str.length() > len && isdigit(str[len]); len++)
                 ret += toSuperscript(str[len]);
             ret += str.substr(len);
@@ -0,0 +1,77 @@
+// benchview.h
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Synthetic star catalogs and views of them shared by the benchmarks of
+// star traversals.
+
+#pragma once
+
+#include <cmath>
+#include <random>
+#include <vector>
+#include <Eigen/Geometry>
+#include <celmath/mathlib.h>
+#include <celengine/star.h>
+
+struct View
+{
+    Eigen::Vector3f position;
+    Eigen::Hyperplane<float, 3> frustumPlanes[5];
+};
+
+
+// A view from position with a vertical field of view in degrees, with the
+// same frustum as StarDatabase::findVisibleStars
+inline View makeView(const Eigen::Vector3f& position,
+                     const Eigen::Quaternionf& orientation,
+                     float fieldOfView = 45.0f)
+{
+    View view;
+    view.position = position;
+
+    Eigen::Matrix3f rot = orientation.toRotationMatrix();
+    float h = (float) std::tan(celmath::degToRad(fieldOfView) / 2);
+    float w = h * 1.6f;
+    Eigen::Vector3f planeNormals[5] =
+    {
+        Eigen::Vector3f(0.0f, 1.0f, -h),
+        Eigen::Vector3f(0.0f, -1.0f, -h),
+        Eigen::Vector3f(1.0f, 0.0f, -w),
+        Eigen::Vector3f(-1.0f, 0.0f, -w),
+        Eigen::Vector3f(0.0f, 0.0f, -1.0f),
+    };
+    for (int i = 0; i < 5; i++)
+        view.frustumPlanes[i] = Eigen::Hyperplane<float, 3>(rot.transpose() * planeNormals[i].normalized(), position);
+
+    return view;
+}
+
+
+// A catalog of starCount G2V stars, numbered in order, at positions drawn
+// from pos; faint stars are far more common than bright ones. The
+// benchmarks seed gen with a fixed value, so that every run uses the same
+// catalog.
+template<typename PositionDistribution>
+std::vector<Star> makeCatalog(unsigned int starCount, std::mt19937& gen, PositionDistribution& pos)
+{
+    std::normal_distribution<float> mag(10.0f, 4.0f);
+    StarDetails* details = StarDetails::GetNormalStarDetails(StellarClass::Spectral_G, 2, StellarClass::Lum_V);
+
+    std::vector<Star> stars(starCount);
+    for (unsigned int i = 0; i < starCount; i++)
+    {
+        Star& star = stars[i];
+        star.setPosition(pos(gen), pos(gen), pos(gen));
+        star.setAbsoluteMagnitude(mag(gen));
+        star.setDetails(details);
+        star.setIndex(i);
+    }
+
+    return stars;
+}
@@ -0,0 +1,252 @@
+// dsopickbench.cpp
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Measure the latency of picking deep sky objects along a ray for
+// catalogs of growing size. The ray search of DSOOctree::pickObject() is
+// compared with the traversal of all objects within 1e9 ly that
+// Universe::pickDeepSkyObject used before; both must pick the same object
+// for every ray. Half of the rays are aimed close to a random object.
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fmt/printf.h>
+#include <celmath/intersect.h>
+#include <celutil/timer.h>
+#include <celengine/astro.h>
+#include <celengine/dsooctree.h>
+
+using namespace std;
+using namespace Eigen;
+using namespace celmath;
+
+
+static unsigned int maxDSOCount = 1000000;
+static unsigned int pickCount = 200;
+
+constexpr const double DSO_OCTREE_ROOT_SIZE = 1.0e11;
+constexpr const float  DSO_OCTREE_MAGNITUDE = 8.0f;
+
+
+void Usage()
+{
+    cerr << "Usage: dsopickbench [options]\n";
+    cerr << "  Options:\n";
+    cerr << "    --dsos <n>  : number of objects in the largest catalog (default 1000000)\n";
+    cerr << "    --picks <n> : number of rays picked in each catalog (default 200)\n";
+}
+
+
+bool parseCommandLine(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--dsos") && i + 1 < argc)
+            maxDSOCount = max(1u, (unsigned int) strtoul(argv[++i], nullptr, 10));
+        else if (!strcmp(argv[i], "--picks") && i + 1 < argc)
+            pickCount = max(1u, (unsigned int) strtoul(argv[++i], nullptr, 10));
+        else
+            return false;
+    }
+
+    return true;
+}
+
+
+// A deep sky object picked by its bounding sphere, like open clusters and
+// nebulae
+class SphereDSO : public DeepSkyObject
+{
+ public:
+    const char* getType() const override { return "Sphere"; }
+    void setType(const std::string&) override {}
+    const char* getObjTypeName() const override { return "sphere"; }
+
+    bool pick(const Ray3d& ray, double& distanceToPicker, double& cosAngleToBoundCenter) const override
+    {
+        return DeepSkyObject::pick(ray, distanceToPicker, cosAngleToBoundCenter);
+    }
+
+    void render(const Vector3f&, const Quaternionf&, float, float, const Renderer*) override {}
+
+    uint64_t getRenderMask() const override { return 1; }
+};
+
+
+// The picker used with the traversal of all objects
+class LinearPicker : public DSOHandler
+{
+ public:
+    LinearPicker(const Vector3d& origin, const Vector3d& direction) :
+        origin(origin), direction(direction)
+    {
+    }
+
+    void process(DeepSkyObject* const& dso, double distance, float /*appMag*/) override
+    {
+        if (distance > 1e9 || !dso->isVisible() || !dso->isClickable())
+            return;
+
+        double distanceToPicker = 0.0;
+        double cosAngle         = 0.0;
+        if (dso->pick(Ray3d(origin, direction), distanceToPicker, cosAngle))
+        {
+            if ((origin - dso->getPosition()).norm() > dso->getRadius() && cosAngle > largestCosAngle)
+            {
+                picked          = dso;
+                largestCosAngle = cosAngle;
+            }
+        }
+    }
+
+    Vector3d origin;
+    Vector3d direction;
+    const DeepSkyObject* picked{ nullptr };
+    double largestCosAngle{ -2.0 };
+};
+
+
+// The same test, for the ray search
+class RayPicker : public DSORayPicker
+{
+ public:
+    RayPicker(const Vector3d& origin, const Vector3d& direction) :
+        origin(origin), direction(direction)
+    {
+    }
+
+    bool pick(DeepSkyObject* const& dso, double& cosAngle) override
+    {
+        double distance = (origin - dso->getPosition()).norm() - dso->getBoundingSphereRadius();
+        if (distance > 1e9 || !dso->isVisible() || !dso->isClickable())
+            return false;
+
+        double distanceToPicker = 0.0;
+        return dso->pick(Ray3d(origin, direction), distanceToPicker, cosAngle) &&
+               (origin - dso->getPosition()).norm() > dso->getRadius();
+    }
+
+    Vector3d origin;
+    Vector3d direction;
+};
+
+
+int main(int argc, char* argv[])
+{
+    if (!parseCommandLine(argc, argv))
+    {
+        Usage();
+        return 1;
+    }
+
+    fmt::printf("%10s %10s %14s %14s %9s %8s %8s\n",
+                "objects", "hits", "all (us)", "ray (us)", "speedup", "nodes", "objects");
+
+    for (unsigned int dsoCount = min(10000u, maxDSOCount); ; dsoCount = min(dsoCount * 10, maxDSOCount))
+    {
+        // Fixed seed: every run of the benchmark uses the same catalogs
+        // and rays. The objects fill a sphere of 1 Gly; the observer is
+        // in a big object at the center, which is never picked.
+        mt19937 gen(1234);
+        uniform_real_distribution<double> unit(-1.0, 1.0);
+        uniform_real_distribution<double> logRadius(3.0, 5.5);
+        auto randomDirection = [&]()
+        {
+            Vector3d v;
+            do
+            {
+                v = Vector3d(unit(gen), unit(gen), unit(gen));
+            } while (v.squaredNorm() > 1.0 || v.squaredNorm() < 1.0e-6);
+            return v.normalized();
+        };
+
+        vector<SphereDSO> dsos(dsoCount);
+        vector<DeepSkyObject*> unsortedDSOs(dsoCount);
+        for (unsigned int i = 0; i < dsoCount; i++)
+        {
+            SphereDSO& dso = dsos[i];
+            if (i == 0)
+            {
+                dso.setPosition(Vector3d::Zero());
+                dso.setRadius(50000.0f);
+            }
+            else
+            {
+                dso.setPosition(randomDirection() * 1.0e9 * cbrt((unit(gen) + 1.0) * 0.5));
+                dso.setRadius((float) pow(10.0, logRadius(gen)));
+            }
+            dso.setAbsoluteMagnitude(-20.0f + (float) unit(gen) * 3.0f);
+            unsortedDSOs[i] = &dso;
+        }
+
+        float absMag = astro::appToAbsMag(DSO_OCTREE_MAGNITUDE, (float) DSO_OCTREE_ROOT_SIZE * (float) sqrt(3.0));
+        vector<DeepSkyObject*> sortedDSOs(dsoCount);
+        DSOOctree* octree = DynamicDSOOctree::build(Vector3d::Zero(), absMag, DSO_OCTREE_ROOT_SIZE,
+                                                    unsortedDSOs, dsoCount, sortedDSOs.data());
+
+        Vector3d origin(1000.0, -2000.0, 500.0);
+        vector<Vector3d> rays;
+        for (unsigned int i = 0; i < pickCount; i++)
+        {
+            if (i % 2 == 0)
+            {
+                rays.push_back(randomDirection());
+            }
+            else
+            {
+                const DeepSkyObject& dso = dsos[gen() % dsoCount];
+                Vector3d toDSO = dso.getPosition() - origin;
+                Vector3d offset = randomDirection() * dso.getRadius() * 0.5;
+                rays.push_back((toDSO + offset).normalized());
+            }
+        }
+
+        vector<const DeepSkyObject*> reference;
+        Timer timer;
+        for (const auto& direction : rays)
+        {
+            LinearPicker picker(origin, direction);
+            octree->processCloseObjects(picker, origin, 1e9, DSO_OCTREE_ROOT_SIZE);
+            reference.push_back(picker.picked);
+        }
+        double linearTime = timer.getTime();
+
+        OctreeProcStats stats;
+        unsigned int hits = 0;
+        timer.reset();
+        for (size_t i = 0; i < rays.size(); i++)
+        {
+            RayPicker picker(origin, rays[i]);
+            DeepSkyObject* const* picked = octree->pickObject(picker, origin, rays[i], &stats);
+            const DeepSkyObject* dso = picked != nullptr ? *picked : nullptr;
+            if (dso != reference[i])
+            {
+                cerr << "Ray search picked a different object than the traversal of all objects\n";
+                return 1;
+            }
+            hits += dso != nullptr ? 1 : 0;
+        }
+        double rayTime = timer.getTime();
+
+        fmt::printf("%10u %10u %14.1f %14.1f %8.1fx %8.1f %8.1f\n", dsoCount, hits,
+                    linearTime / pickCount * 1.0e6, rayTime / pickCount * 1.0e6, linearTime / rayTime,
+                    (double) stats.nodes / pickCount, (double) stats.objects / pickCount);
+
+        delete octree;
+        if (dsoCount == maxDSOCount)
+            break;
+    }
+
+    return 0;
+}
@@ -0,0 +1,268 @@
+// namelookupbench.cpp
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Measure StarDatabase::findCatalogNumberByName for each form of name it
+// accepts, first with the name index the names are loaded into and then
+// with the lookup table built by finish(). Both must return the same
+// catalog numbers. A synthetic star name database and HD and SAO cross
+// indexes are generated, so no data files are required.
+
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fmt/printf.h>
+#include <celutil/bytes.h>
+#include <celutil/timer.h>
+#include <celutil/utf8.h>
+#include <celengine/constellation.h>
+#include <celengine/stardb.h>
+
+using namespace std;
+
+
+static unsigned int starCount = 200000;
+static unsigned int queryCount = 100000;
+
+constexpr const unsigned int CONSTELLATION_COUNT = 88;
+
+
+void Usage()
+{
+    cerr << "Usage: namelookupbench [options]\n";
+    cerr << "  Options:\n";
+    cerr << "    --stars <n>   : number of named stars (default 200000)\n";
+    cerr << "    --queries <n> : number of lookups of each form of name (default 100000)\n";
+}
+
+
+bool parseCommandLine(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--stars") && i + 1 < argc)
+            starCount = max(1u, (unsigned int) strtoul(argv[++i], nullptr, 10));
+        else if (!strcmp(argv[i], "--queries") && i + 1 < argc)
+            queryCount = max(1u, (unsigned int) strtoul(argv[++i], nullptr, 10));
+        else
+            return false;
+    }
+
+    return true;
+}
+
+
+static string properName(mt19937& gen)
+{
+    static const char* syllables[] =
+    {
+        "al", "be", "ca", "de", "el", "fa", "gi", "ha", "ir", "ka",
+        "lo", "ma", "ne", "or", "pu", "ra", "si", "ta", "ur", "ve",
+    };
+
+    string name;
+    unsigned int n = 2 + gen() % 3;
+    for (unsigned int i = 0; i < n; i++)
+        name += syllables[gen() % 20];
+    name[0] = (char) toupper(name[0]);
+    return name;
+}
+
+
+static string crossIndexData(const vector<pair<uint32_t, uint32_t>>& entries)
+{
+    string data = "CELINDEX";
+    uint16_t version = 0x0100;
+    LE_TO_CPU_INT16(version, version);
+    data.append(reinterpret_cast<const char*>(&version), sizeof version);
+    for (const auto& entry : entries)
+    {
+        uint32_t catalogNumber = entry.first;
+        uint32_t celCatalogNumber = entry.second;
+        LE_TO_CPU_INT32(catalogNumber, catalogNumber);
+        LE_TO_CPU_INT32(celCatalogNumber, celCatalogNumber);
+        data.append(reinterpret_cast<const char*>(&catalogNumber), sizeof catalogNumber);
+        data.append(reinterpret_cast<const char*>(&celCatalogNumber), sizeof celCatalogNumber);
+    }
+    return data;
+}
+
+
+struct NameForm
+{
+    const char* description;
+    vector<string> queries;
+};
+
+
+static double timeLookups(const StarDatabase& starDB,
+                          const vector<string>& queries,
+                          vector<AstroCatalog::IndexNumber>& results)
+{
+    results.resize(queries.size());
+    Timer timer;
+    for (size_t i = 0; i < queries.size(); i++)
+        results[i] = starDB.findCatalogNumberByName(queries[i]);
+    return timer.getTime();
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (!parseCommandLine(argc, argv))
+    {
+        Usage();
+        return 1;
+    }
+
+    // Fixed seed: every run of the benchmark uses the same names and
+    // queries. Catalog numbers are the HIP numbers of the stars; a tenth
+    // of the stars get a proper name, and the first ones get Bayer and
+    // Flamsteed designations.
+    mt19937 gen(1234);
+    Greek* greek = Greek::getInstance();
+    stringstream names;
+    vector<string> properNames;
+    vector<pair<string, string>> bayerNames;
+    vector<string> flamsteedNames;
+    vector<pair<uint32_t, uint32_t>> hdIndex;
+    vector<pair<uint32_t, uint32_t>> saoIndex;
+    for (unsigned int i = 1; i <= starCount; i++)
+    {
+        vector<string> starNames;
+        if (i % 10 == 0)
+        {
+            starNames.push_back(properName(gen) + " " + to_string(i));
+            properNames.push_back(starNames.back());
+        }
+
+        unsigned int letter = i % (unsigned int) greek->nLetters;
+        unsigned int con = (i / greek->nLetters) % CONSTELLATION_COUNT;
+        unsigned int component = i / (greek->nLetters * CONSTELLATION_COUNT);
+        const string abbrev = Constellation::getConstellation(con)->getAbbreviation();
+        if (component < 3)
+        {
+            string bayer = greek->abbrevs[letter];
+            if (component > 0)
+                bayer += to_string(component);
+            bayer += " " + abbrev;
+            starNames.push_back(bayer);
+
+            string longForm = greek->names[letter];
+            if (component > 0)
+                longForm += to_string(component);
+            bayerNames.emplace_back(bayer, longForm + " " + Constellation::getConstellation(con)->getName());
+        }
+        if (component < 6)
+        {
+            starNames.push_back(to_string(letter + 1 + component * greek->nLetters) + " " + abbrev);
+            flamsteedNames.push_back(starNames.back());
+        }
+
+        if (!starNames.empty())
+        {
+            names << i;
+            for (const auto& name : starNames)
+                names << ':' << name;
+            names << '\n';
+        }
+
+        hdIndex.emplace_back(i * 3 + 1, i);
+        saoIndex.emplace_back(i * 2 + 5, i);
+    }
+
+    StarNameDatabase* starNameDB = StarNameDatabase::readNames(names);
+    if (starNameDB == nullptr)
+    {
+        cerr << "Error reading the star names\n";
+        return 1;
+    }
+
+    StarDatabase starDB;
+    starDB.setNameDatabase(starNameDB);
+    istringstream hdData(crossIndexData(hdIndex));
+    istringstream saoData(crossIndexData(saoIndex));
+    if (!starDB.loadCrossIndex(StarDatabase::HenryDraper, hdData) ||
+        !starDB.loadCrossIndex(StarDatabase::SAO, saoData))
+    {
+        cerr << "Error loading the cross indexes\n";
+        return 1;
+    }
+
+    vector<NameForm> forms =
+    {
+        { "proper name",              {} },
+        { "proper name, upper case",  {} },
+        { "Bayer, abbreviated",       {} },
+        { "Bayer, long names",        {} },
+        { "Bayer, Greek letter",      {} },
+        { "Flamsteed",                {} },
+        { "HIP",                      {} },
+        { "TYC",                      {} },
+        { "HD",                       {} },
+        { "SAO",                      {} },
+        { "#",                        {} },
+        { "unknown",                  {} },
+    };
+    for (unsigned int i = 0; i < queryCount; i++)
+    {
+        unsigned int star = 1 + gen() % starCount;
+        string name = properNames[gen() % properNames.size()];
+        forms[0].queries.push_back(name);
+        transform(name.begin(), name.end(), name.begin(), ::toupper);
+        forms[1].queries.push_back(name);
+
+        const auto& bayer = bayerNames[gen() % bayerNames.size()];
+        forms[2].queries.push_back(bayer.first);
+        forms[3].queries.push_back(bayer.second);
+        forms[4].queries.push_back(ReplaceGreekLetterAbbr(bayer.first));
+        forms[5].queries.push_back(flamsteedNames[gen() % flamsteedNames.size()]);
+
+        forms[6].queries.push_back(fmt::sprintf("HIP %u", star));
+        forms[7].queries.push_back(fmt::sprintf("TYC %u-%u-1", star % 10000, star / 10000 + 1));
+        forms[8].queries.push_back(fmt::sprintf("HD %u", star * 3 + 1));
+        forms[9].queries.push_back(fmt::sprintf("SAO %u", star * 2 + 5));
+        forms[10].queries.push_back(fmt::sprintf("#%u", star));
+        forms[11].queries.push_back(properName(gen) + " " + to_string(starCount + star));
+    }
+
+    fmt::printf("%u names, %u lookups of each form\n", starNameDB->getNameCount(), queryCount);
+    fmt::printf("%-26s %12s %12s %8s\n", "form", "index (ns)", "table (ns)", "speedup");
+
+    vector<vector<AstroCatalog::IndexNumber>> reference(forms.size());
+    vector<double> indexTimes(forms.size());
+    for (size_t i = 0; i < forms.size(); i++)
+        indexTimes[i] = timeLookups(starDB, forms[i].queries, reference[i]);
+
+    // What StarDatabase::finish() does for the names
+    Timer timer;
+    starNameDB->buildIndexes();
+    double buildTime = timer.getTime();
+
+    for (size_t i = 0; i < forms.size(); i++)
+    {
+        vector<AstroCatalog::IndexNumber> results;
+        double t = timeLookups(starDB, forms[i].queries, results);
+        if (results != reference[i])
+        {
+            cerr << "Lookup table results differ from the name index for " << forms[i].description << '\n';
+            return 1;
+        }
+
+        fmt::printf("%-26s %12.1f %12.1f %7.2fx\n", forms[i].description,
+                    indexTimes[i] / queryCount * 1e9, t / queryCount * 1e9, indexTimes[i] / t);
+    }
+    fmt::printf("building the name indexes: %.3f s\n", buildTime);
+
+    return 0;
+}
@@ -0,0 +1,237 @@
+// octreebench.cpp
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Measure the throughput of the star octree visibility traversal. The
+// flat StarOctree is compared against a recursive traversal of a pointer
+// based copy of the same tree, which mirrors the way the octree was
+// traversed before it was flattened. Both traversals must find the same
+// stars; the result is reported in octree nodes visited per second.
+
+#include <iostream>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fmt/printf.h>
+#include <celmath/mathlib.h>
+#include <celutil/timer.h>
+#include <celengine/astro.h>
+#include <celengine/staroctree.h>
+#include "benchview.h"
+
+using namespace std;
+using namespace Eigen;
+
+
+static unsigned int starCount = 2000000;
+static unsigned int viewCount = 200;
+static float limitingMag = 6.0f;
+
+constexpr const float OCTREE_ROOT_SIZE = 1000000000.0f;
+constexpr const float SQRT3            = 1.732050807568877f;
+
+
+void Usage()
+{
+    cerr << "Usage: octreebench [options]\n";
+    cerr << "  Options:\n";
+    cerr << "    --stars <n>    : number of stars in the synthetic catalog (default 2000000)\n";
+    cerr << "    --views <n>    : number of random views to traverse (default 200)\n";
+    cerr << "    --magnitude <m>: limiting magnitude (default 6.0)\n";
+}
+
+
+bool parseCommandLine(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--stars") && i + 1 < argc)
+            starCount = max(1u, (unsigned int) strtoul(argv[++i], nullptr, 10));
+        else if (!strcmp(argv[i], "--views") && i + 1 < argc)
+            viewCount = max(1u, (unsigned int) strtoul(argv[++i], nullptr, 10));
+        else if (!strcmp(argv[i], "--magnitude") && i + 1 < argc)
+            limitingMag = (float) atof(argv[++i]);
+        else
+            return false;
+    }
+
+    return true;
+}
+
+
+// Pointer based octree node, as used by the recursive traversal.
+struct RecursiveNode
+{
+    Vector3f       cellCenterPos;
+    float          exclusionFactor;
+    const Star*    firstObject;
+    uint32_t       nObjects;
+    RecursiveNode* children[8];
+};
+
+
+static void buildRecursiveTree(const vector<StarOctree::PackedNode>& packed,
+                               const Star* stars,
+                               vector<RecursiveNode>& nodes)
+{
+    nodes.resize(packed.size());
+    for (size_t i = 0; i < packed.size(); i++)
+    {
+        const StarOctree::PackedNode& p = packed[i];
+        RecursiveNode& node = nodes[i];
+        node.cellCenterPos   = Vector3f(p.cellCenterPos[0], p.cellCenterPos[1], p.cellCenterPos[2]);
+        node.exclusionFactor = p.exclusionFactor;
+        node.firstObject     = stars + p.firstObject;
+        node.nObjects        = p.nObjects;
+        for (int j = 0; j < 8; j++)
+            node.children[j] = p.firstChild != 0 ? &nodes[p.firstChild + j] : nullptr;
+    }
+}
+
+
+static void processRecursive(const RecursiveNode& node,
+                             StarHandler& processor,
+                             const Vector3f& obsPosition,
+                             const Hyperplane<float, 3>* frustumPlanes,
+                             float scale,
+                             size_t& nodeCount)
+{
+    // The distances are spelled out in the same way as in StaticOctree,
+    // because nodes that touch a frustum plane may otherwise be culled
+    // differently due to rounding.
+    const Vector3f& c = node.cellCenterPos;
+    for (unsigned int i = 0; i < 5; ++i)
+    {
+        const Hyperplane<float, 3>& plane = frustumPlanes[i];
+        const Vector3f& n = plane.normal();
+        float r = scale * n.cwiseAbs().sum();
+        if (c.x() * n.x() + c.y() * n.y() + c.z() * n.z() + plane.offset() < -r)
+            return;
+    }
+
+    nodeCount++;
+
+    Vector3f d = c - obsPosition;
+    float minDistance = sqrt(d.x() * d.x() + d.y() * d.y() + d.z() * d.z()) - scale * SQRT3;
+    float dimmest     = minDistance > 0 ? astro::appToAbsMag(limitingMag, minDistance) : 1000;
+    for (uint32_t i = 0; i < node.nObjects; ++i)
+    {
+        const Star& obj = node.firstObject[i];
+        if (obj.getAbsoluteMagnitude() < dimmest)
+        {
+            float distance = (obsPosition - obj.getPosition()).norm();
+            float appMag   = astro::absToAppMag(obj.getAbsoluteMagnitude(), distance);
+            if (appMag < limitingMag)
+                processor.process(obj, distance, appMag);
+        }
+    }
+
+    if (minDistance <= 0 || astro::absToAppMag(node.exclusionFactor, minDistance) <= limitingMag)
+    {
+        if (node.children[0] != nullptr)
+        {
+            for (int i = 0; i < 8; ++i)
+                processRecursive(*node.children[i], processor, obsPosition, frustumPlanes, scale * 0.5f, nodeCount);
+        }
+    }
+}
+
+
+class StarCounter : public StarHandler
+{
+ public:
+    void process(const Star& /*star*/, float /*distance*/, float /*appMag*/) override
+    {
+        count++;
+    }
+
+    void processBatch(celestia::span<const Star* const> stars,
+                      celestia::span<const float> /*distances*/,
+                      celestia::span<const float> /*appMags*/) override
+    {
+        count += stars.size();
+    }
+
+    size_t count{ 0 };
+};
+
+
+int main(int argc, char* argv[])
+{
+    if (!parseCommandLine(argc, argv))
+    {
+        Usage();
+        return 1;
+    }
+
+    // Fixed seed: every run of the benchmark uses the same catalog and views
+    mt19937 gen(1234);
+    uniform_real_distribution<float> pos(-5000.0f, 5000.0f);
+    uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    cout << "Building octree of " << starCount << " stars\n";
+    vector<Star> unsortedStars = makeCatalog(starCount, gen, pos);
+
+    float absMag = astro::appToAbsMag(6.0f, OCTREE_ROOT_SIZE * SQRT3);
+    auto* dynamicRoot = new DynamicStarOctree(Vector3f(1000.0f, 1000.0f, 1000.0f), absMag);
+    for (const auto& star : unsortedStars)
+        dynamicRoot->insertObject(star, OCTREE_ROOT_SIZE);
+
+    Star* stars = new Star[starCount];
+    Star* firstStar = stars;
+    StarOctree* octree = nullptr;
+    dynamicRoot->rebuildAndSort(octree, firstStar);
+    delete dynamicRoot;
+
+    vector<StarOctree::PackedNode> packed;
+    octree->pack(packed);
+    vector<RecursiveNode> recursiveNodes;
+    buildRecursiveTree(packed, stars, recursiveNodes);
+    cout << "Octree has " << packed.size() << " nodes\n";
+
+    vector<View> views;
+    for (unsigned int i = 0; i < viewCount; i++)
+    {
+        Vector3f axis(unit(gen), unit(gen), unit(gen));
+        Quaternionf q(AngleAxisf((float) M_PI * unit(gen), axis.normalized()));
+        views.push_back(makeView(Vector3f(pos(gen), pos(gen), pos(gen)) * 0.1f, q));
+    }
+
+    size_t nodeCount = 0;
+    StarCounter recursiveCounter;
+    Timer timer;
+    for (const auto& view : views)
+        processRecursive(recursiveNodes[0], recursiveCounter, view.position, view.frustumPlanes, OCTREE_ROOT_SIZE, nodeCount);
+    double recursiveTime = timer.getTime();
+
+    StarCounter flatCounter;
+    timer.reset();
+    for (const auto& view : views)
+        octree->processVisibleObjects(flatCounter, view.position, view.frustumPlanes, limitingMag, OCTREE_ROOT_SIZE);
+    double flatTime = timer.getTime();
+
+    if (flatCounter.count != recursiveCounter.count)
+    {
+        cerr << "Traversals disagree: recursive found " << recursiveCounter.count
+             << " stars, flat found " << flatCounter.count << '\n';
+        return 1;
+    }
+
+    fmt::printf("%u views, %zu nodes and %zu stars visible in total\n", viewCount, nodeCount, flatCounter.count);
+    fmt::printf("recursive: %.3f s (%.2f Mnodes/s)\n", recursiveTime, nodeCount / recursiveTime * 1.0e-6);
+    fmt::printf("flat:      %.3f s (%.2f Mnodes/s), speedup %.2fx\n",
+                flatTime, nodeCount / flatTime * 1.0e-6, recursiveTime / flatTime);
+
+    delete octree;
+    delete[] stars;
+
+    return 0;
+}
@@ -0,0 +1,174 @@
+// octreebuildbench.cpp
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Measure how long it takes to build the star octree, comparing
+// insertion into a DynamicOctree followed by rebuildAndSort() with the
+// parallel DynamicOctree::build() on 2, 4, ... threads. All builds must
+// produce exactly the same nodes and star order.
+
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fmt/printf.h>
+#include <celutil/threadpool.h>
+#include <celutil/timer.h>
+#include <celengine/astro.h>
+#include <celengine/staroctree.h>
+
+using namespace std;
+using namespace Eigen;
+
+
+static unsigned int starCount = 2000000;
+static unsigned int maxThreads = 0;
+
+constexpr const float OCTREE_ROOT_SIZE = 1000000000.0f;
+
+
+void Usage()
+{
+    cerr << "Usage: octreebuildbench [options]\n";
+    cerr << "  Options:\n";
+    cerr << "    --stars <n>    : number of stars in the synthetic catalog (default 2000000)\n";
+    cerr << "    --threads <n>  : largest number of threads to test (default: all cores, at least 2)\n";
+}
+
+
+bool parseCommandLine(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--stars") && i + 1 < argc)
+            starCount = max(1u, (unsigned int) strtoul(argv[++i], nullptr, 10));
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+            maxThreads = (unsigned int) strtoul(argv[++i], nullptr, 10);
+        else
+            return false;
+    }
+
+    return true;
+}
+
+
+struct BuiltOctree
+{
+    vector<StarOctree::PackedNode> nodes;
+    vector<AstroCatalog::IndexNumber> order;
+};
+
+
+static void describe(const StarOctree& octree, const Star* stars, BuiltOctree& built)
+{
+    octree.pack(built.nodes);
+    built.order.resize(starCount);
+    for (unsigned int i = 0; i < starCount; i++)
+        built.order[i] = stars[i].getIndex();
+}
+
+
+static bool operator==(const BuiltOctree& a, const BuiltOctree& b)
+{
+    return a.order == b.order &&
+           a.nodes.size() == b.nodes.size() &&
+           memcmp(a.nodes.data(), b.nodes.data(), a.nodes.size() * sizeof(StarOctree::PackedNode)) == 0;
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (!parseCommandLine(argc, argv))
+    {
+        Usage();
+        return 1;
+    }
+
+    if (maxThreads == 0)
+        maxThreads = max(1u, thread::hardware_concurrency());
+
+    // Fixed seed: every run of the benchmark uses the same catalog. Half
+    // of the stars are in dense clusters, so that the tree gets deep.
+    mt19937 gen(1234);
+    uniform_real_distribution<float> pos(-5000.0f, 5000.0f);
+    normal_distribution<float> clusterPos(0.0f, 20.0f);
+    normal_distribution<float> mag(10.0f, 4.0f);
+
+    vector<Vector3f> clusters;
+    for (int i = 0; i < 100; i++)
+        clusters.emplace_back(pos(gen), pos(gen), pos(gen));
+
+    StarDetails* details = StarDetails::GetNormalStarDetails(StellarClass::Spectral_G, 2, StellarClass::Lum_V);
+    vector<Star> unsortedStars(starCount);
+    for (unsigned int i = 0; i < starCount; i++)
+    {
+        Star& star = unsortedStars[i];
+        if (i % 2 == 0)
+        {
+            star.setPosition(pos(gen), pos(gen), pos(gen));
+        }
+        else
+        {
+            const Vector3f& c = clusters[gen() % clusters.size()];
+            star.setPosition(c.x() + clusterPos(gen), c.y() + clusterPos(gen), c.z() + clusterPos(gen));
+        }
+        star.setAbsoluteMagnitude(mag(gen));
+        star.setDetails(details);
+        star.setIndex(i);
+    }
+
+    Vector3f center(1000.0f, 1000.0f, 1000.0f);
+    float absMag = astro::appToAbsMag(6.0f, OCTREE_ROOT_SIZE * (float) sqrt(3.0));
+    Star* stars = new Star[starCount];
+
+    Timer timer;
+    auto* dynamicRoot = new DynamicStarOctree(center, absMag);
+    for (const auto& star : unsortedStars)
+        dynamicRoot->insertObject(star, OCTREE_ROOT_SIZE);
+    Star* firstStar = stars;
+    StarOctree* octree = nullptr;
+    dynamicRoot->rebuildAndSort(octree, firstStar);
+    delete dynamicRoot;
+    double insertTime = timer.getTime();
+
+    BuiltOctree reference;
+    describe(*octree, stars, reference);
+    delete octree;
+
+    fmt::printf("%u stars, %zu octree nodes\n", starCount, reference.nodes.size());
+    fmt::printf("insert and rebuild: %.3f s\n", insertTime);
+
+    for (unsigned int nThreads = 2; nThreads <= max(2u, maxThreads); nThreads *= 2)
+    {
+        ThreadPool pool(nThreads);
+        timer.reset();
+        octree = DynamicStarOctree::build(center, absMag, OCTREE_ROOT_SIZE,
+                                          unsortedStars, starCount, stars, &pool);
+        double buildTime = timer.getTime();
+
+        BuiltOctree built;
+        describe(*octree, stars, built);
+        delete octree;
+        if (!(built == reference))
+        {
+            cerr << "Octree built with " << nThreads << " threads differs from the inserted one\n";
+            return 1;
+        }
+
+        fmt::printf("build, %u threads: %.3f s, speedup %.2fx\n",
+                    nThreads, buildTime, insertTime / buildTime);
+    }
+
+    delete[] stars;
+
+    return 0;
+}
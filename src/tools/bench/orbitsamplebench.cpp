@@ -0,0 +1,255 @@
+// orbitsamplebench.cpp
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Report the number of samples and the sampling time of the orbit paths
+// of planets, moons and eccentric orbits: with the adaptive sampling used
+// before, which restarted every step from the start step and kept the
+// first step exceeding the 1 km tolerance, with the default sampling of
+// each orbit, and with the tolerances of an orbit seen whole on screen
+// and seen from nearby. The largest distance between each orbit and the
+// Hermite curves through its samples, measured at their midpoints, must
+// stay within the tolerance.
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fmt/printf.h>
+#include <celengine/astro.h>
+#include <celmath/mathlib.h>
+#include <celutil/timer.h>
+#include <celephem/customorbit.h>
+#include <celephem/vsop87.h>
+
+using namespace std;
+using namespace Eigen;
+
+
+static unsigned int repeatCount = 5;
+static double pixelTolerance = 0.5;
+
+// Angular size of a pixel in radians, for a 45 degree field of view on
+// a 1080 pixel high window
+constexpr const double PIXEL_SIZE = 45.0 / 1080.0 * PI / 180.0;
+// Closest distance to an orbit assumed by the renderer, as a fraction of
+// its bounding radius
+constexpr const double MIN_VIEW_DISTANCE = 1.0e-5;
+
+constexpr const double J2000 = 2451545.0;
+
+
+void Usage()
+{
+    cerr << "Usage: orbitsamplebench [options]\n";
+    cerr << "  Options:\n";
+    cerr << "    --repeat <n>    : number of times each orbit is sampled (default 5)\n";
+    cerr << "    --pixels <tol>  : tolerance in pixels (default 0.5)\n";
+}
+
+
+bool parseCommandLine(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--repeat") && i + 1 < argc)
+            repeatCount = max(1u, (unsigned int) strtoul(argv[++i], nullptr, 10));
+        else if (!strcmp(argv[i], "--pixels") && i + 1 < argc)
+            pixelTolerance = max(1.0e-3, atof(argv[++i]));
+        else
+            return false;
+    }
+
+    return true;
+}
+
+
+class SampleCollector : public OrbitSampleProc
+{
+public:
+    explicit SampleCollector(double _tolerance) : tolerance(_tolerance) {}
+
+    void sample(double t, const Vector3d& p, const Vector3d& v) override
+    {
+        times.push_back(t);
+        positions.push_back(p);
+        velocities.push_back(v);
+    }
+
+    double getTolerance() const override { return tolerance; }
+
+    vector<double> times;
+    vector<Vector3d> positions;
+    vector<Vector3d> velocities;
+
+private:
+    double tolerance;
+};
+
+
+static Vector3d cubicInterpolate(const Vector3d& p0, const Vector3d& v0,
+                                 const Vector3d& p1, const Vector3d& v1,
+                                 double t)
+{
+    return p0 + (((2.0 * (p0 - p1) + v1 + v0) * (t * t * t)) +
+                ((3.0 * (p1 - p0) - 2.0 * v0 - v1) * (t * t)) +
+                (v0 * t));
+}
+
+
+// The adaptive sampling of Orbit::sample() before it was bounded by the
+// tolerance
+static void legacySample(const Orbit& orbit, double startTime, double endTime, OrbitSampleProc& proc)
+{
+    double span = orbit.getPeriod();
+    double startStepSize = span / 1.0e5;
+    double maxStepSize = span / 100.0;
+    double minStepSize = span / 1.0e7;
+    double tolerance = 1.0;
+    const double stepFactor = 1.25;
+    double t = startTime;
+
+    Vector3d lastP = orbit.positionAtTime(t);
+    Vector3d lastV = orbit.velocityAtTime(t);
+    proc.sample(t, lastP, lastV);
+
+    auto stepError = [&](double dt, Vector3d& p1, Vector3d& v1)
+    {
+        p1 = orbit.positionAtTime(t + dt);
+        v1 = orbit.velocityAtTime(t + dt);
+        Vector3d pTest = orbit.positionAtTime(t + dt / 2.0);
+        return (cubicInterpolate(lastP, lastV * dt, p1, v1 * dt, 0.5) - pTest).norm();
+    };
+
+    while (t < endTime)
+    {
+        maxStepSize = min(maxStepSize, endTime - t);
+        double dt = min(maxStepSize, startStepSize * 2.0);
+        Vector3d p1, v1;
+        double positionError = stepError(dt, p1, v1);
+        if (positionError > tolerance)
+        {
+            while (positionError > tolerance && dt > minStepSize)
+            {
+                dt /= stepFactor;
+                positionError = stepError(dt, p1, v1);
+            }
+        }
+        else
+        {
+            while (positionError < tolerance && dt < maxStepSize)
+            {
+                dt *= stepFactor;
+                positionError = stepError(dt, p1, v1);
+            }
+        }
+
+        t = t + dt;
+        lastP = p1;
+        lastV = v1;
+        proc.sample(t, lastP, lastV);
+    }
+}
+
+
+// Largest distance between the orbit and the Hermite curves through the
+// samples, at the midpoints of the curves. Steps no longer than the
+// minimum step of 1e-7 period are skipped: the tolerance may not be
+// reached across small discontinuities of the orbit, such as the edges
+// of the segments of a Chebyshev cache.
+static double maxError(const Orbit& orbit, const SampleCollector& samples)
+{
+    double minStep = orbit.getPeriod() * 1.0e-7 * 1.001;
+    double error = 0.0;
+    for (size_t i = 1; i < samples.times.size(); i++)
+    {
+        double dt = samples.times[i] - samples.times[i - 1];
+        if (dt <= minStep)
+            continue;
+        Vector3d p = cubicInterpolate(samples.positions[i - 1], samples.velocities[i - 1] * dt,
+                                      samples.positions[i], samples.velocities[i] * dt, 0.5);
+        error = max(error, (p - orbit.positionAtTime(samples.times[i - 1] + dt * 0.5)).norm());
+    }
+
+    return error;
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (!parseCommandLine(argc, argv))
+    {
+        Usage();
+        return 1;
+    }
+
+    vector<pair<string, shared_ptr<Orbit>>> orbits;
+    for (const char* name : { "vsop87-earth", "vsop87-jupiter", "vsop87-neptune" })
+        orbits.emplace_back(name, shared_ptr<Orbit>(CreateVSOP87Orbit(name)));
+    for (const char* name : { "moon", "io", "titan", "hyperion" })
+        orbits.emplace_back(name, shared_ptr<Orbit>(GetCustomOrbit(name)));
+    for (double e : { 0.0, 0.2, 0.6, 0.9, 0.97 })
+    {
+        double a = 3.0e8;
+        double period = 365.25 * pow(a / astro::AUtoKilometers(1.0), 1.5);
+        orbits.emplace_back(fmt::sprintf("elliptical e=%.2f", e),
+                            make_shared<EllipticalOrbit>(a * (1.0 - e), e, 0.3, 1.0, 2.0, 0.5, period));
+    }
+
+    fmt::printf("%-18s %9s %9s %9s %9s %9s %9s %9s %9s %10s\n", "orbit",
+                "legacy", "(ms)", "default", "(ms)", "far", "(ms)", "near", "(ms)", "near tol");
+
+    bool failed = false;
+    for (const auto& entry : orbits)
+    {
+        const Orbit& orbit = *entry.second;
+        double period = orbit.getPeriod();
+        double radius = orbit.getBoundingRadius();
+
+        // The whole orbit seen on screen, and the camera next to it
+        double farTolerance = pixelTolerance * PIXEL_SIZE * radius;
+        double nearTolerance = pixelTolerance * PIXEL_SIZE * radius * MIN_VIEW_DISTANCE;
+
+        unsigned int counts[4];
+        double times[4];
+        for (unsigned int run = 0; run < 4; run++)
+        {
+            double tolerance = run == 2 ? farTolerance : run == 3 ? nearTolerance : 0.0;
+            SampleCollector samples(tolerance);
+
+            Timer timer;
+            for (unsigned int i = 0; i < repeatCount; i++)
+            {
+                samples = SampleCollector(tolerance);
+                if (run == 0)
+                    legacySample(orbit, J2000, J2000 + period, samples);
+                else
+                    orbit.sample(J2000, J2000 + period, samples);
+            }
+            times[run] = timer.getTime() / repeatCount;
+            counts[run] = (unsigned int) samples.times.size();
+
+            double error = tolerance > 0.0 ? maxError(orbit, samples) : 0.0;
+            if (error > tolerance * 1.001)
+            {
+                cerr << entry.first << ": error " << error
+                     << " km exceeds the tolerance of " << tolerance << " km\n";
+                failed = true;
+            }
+        }
+
+        fmt::printf("%-18s %9u %9.3f %9u %9.3f %9u %9.3f %9u %9.3f %10.3g\n", entry.first,
+                    counts[0], times[0] * 1000.0, counts[1], times[1] * 1000.0,
+                    counts[2], times[2] * 1000.0, counts[3], times[3] * 1000.0, nearTolerance);
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,231 @@
+// pagedstarbench.cpp
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Measure the visibility traversal of a paged star catalog with a
+// limited memory budget, compared with the in memory star octree built
+// from the same stars. Both must pass the same stars to the handler in
+// the same order; the residency statistics of the paged catalog are
+// reported after the cold and the warm pass over the views.
+
+#include <iostream>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fmt/printf.h>
+#include <celmath/mathlib.h>
+#include <celutil/bytes.h>
+#include <celutil/threadpool.h>
+#include <celutil/timer.h>
+#include <celengine/astro.h>
+#include <celengine/pagedstarcatalog.h>
+#include "benchview.h"
+
+using namespace std;
+using namespace Eigen;
+
+
+static unsigned int starCount = 2000000;
+static unsigned int viewCount = 50;
+static unsigned int budgetMB = 16;
+static unsigned int nThreads = 1;
+static float limitingMag = 12.0f;
+static string filename = "pagedstarbench.pstars";
+
+constexpr const float OCTREE_ROOT_SIZE = 1000000000.0f;
+
+
+void Usage()
+{
+    cerr << "Usage: pagedstarbench [options]\n";
+    cerr << "  Options:\n";
+    cerr << "    --stars <n>    : number of stars in the synthetic catalog (default 2000000)\n";
+    cerr << "    --views <n>    : number of random views to traverse (default 50)\n";
+    cerr << "    --budget <MB>  : memory budget of the paged catalog (default 16)\n";
+    cerr << "    --threads <n>  : number of threads for the traversal (default 1)\n";
+    cerr << "    --magnitude <m>: limiting magnitude (default 12)\n";
+    cerr << "    --file <name>  : temporary paged catalog file (default pagedstarbench.pstars)\n";
+}
+
+
+bool parseCommandLine(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--stars") && i + 1 < argc)
+            starCount = max(1u, (unsigned int) strtoul(argv[++i], nullptr, 10));
+        else if (!strcmp(argv[i], "--views") && i + 1 < argc)
+            viewCount = max(1u, (unsigned int) strtoul(argv[++i], nullptr, 10));
+        else if (!strcmp(argv[i], "--budget") && i + 1 < argc)
+            budgetMB = (unsigned int) strtoul(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+            nThreads = max(1u, (unsigned int) strtoul(argv[++i], nullptr, 10));
+        else if (!strcmp(argv[i], "--magnitude") && i + 1 < argc)
+            limitingMag = (float) atof(argv[++i]);
+        else if (!strcmp(argv[i], "--file") && i + 1 < argc)
+            filename = argv[++i];
+        else
+            return false;
+    }
+
+    return true;
+}
+
+
+// Records the stars it's given by catalog number, since the paged and
+// the in memory stars are different objects.
+class StarRecorder : public StarHandler
+{
+ public:
+    void process(const Star& star, float distance, float appMag) override
+    {
+        stars.push_back(star.getIndex());
+        values.push_back(distance);
+        values.push_back(appMag);
+    }
+
+    void processBatch(celestia::span<const Star* const> batch,
+                      celestia::span<const float> distances,
+                      celestia::span<const float> appMags) override
+    {
+        for (size_t i = 0; i < batch.size(); i++)
+            process(*batch[i], distances[i], appMags[i]);
+    }
+
+    bool operator==(const StarRecorder& other) const
+    {
+        return stars == other.stars && values == other.values;
+    }
+
+    vector<AstroCatalog::IndexNumber> stars;
+    vector<float> values;
+};
+
+
+static void printStatistics(const char* pass, double t, const PagedStarCatalog::Statistics& stats)
+{
+    fmt::printf("%s: %.2f ms per view; %zu pages with %zu stars resident, %.1f of %.1f MB\n",
+                pass, t / viewCount * 1000.0, stats.residentPages, stats.residentStars,
+                stats.residentBytes / 1048576.0, stats.memoryBudget / 1048576.0);
+    fmt::printf("  %llu hits, %llu misses, %llu evictions\n",
+                (unsigned long long) stats.hits, (unsigned long long) stats.misses,
+                (unsigned long long) stats.evictions);
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (!parseCommandLine(argc, argv))
+    {
+        Usage();
+        return 1;
+    }
+
+    // Fixed seed: every run of the benchmark uses the same catalog and views
+    mt19937 gen(1234);
+    uniform_real_distribution<float> pos(-5000.0f, 5000.0f);
+    uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    cout << "Building octree of " << starCount << " stars\n";
+    StellarClass sc(StellarClass::NormalStar, StellarClass::Spectral_G, 2, StellarClass::Lum_V);
+    uint16_t spectralType = sc.pack();
+
+    vector<Star> unsortedStars = makeCatalog(starCount, gen, pos);
+    // Rounded like the magnitudes of a stars.dat file
+    for (auto& star : unsortedStars)
+        star.setAbsoluteMagnitude((float) (int16_t) (star.getAbsoluteMagnitude() * 256.0f) / 256.0f);
+
+    float absMag = astro::appToAbsMag(6.0f, OCTREE_ROOT_SIZE * (float) sqrt(3.0));
+    vector<Star> stars(starCount);
+    StarOctree* octree = DynamicStarOctree::build(Vector3f(1000.0f, 1000.0f, 1000.0f), absMag,
+                                                  OCTREE_ROOT_SIZE, unsortedStars, starCount,
+                                                  stars.data());
+
+    // Records in stars.dat format, in octree order
+    vector<char> records(20 * starCount);
+    for (unsigned int i = 0; i < starCount; i++)
+    {
+        const Star& star = stars[i];
+        uint32_t catNo = star.getIndex();
+        float x = star.getPosition().x();
+        float y = star.getPosition().y();
+        float z = star.getPosition().z();
+        int16_t absMag = (int16_t) (star.getAbsoluteMagnitude() * 256.0f);
+        uint16_t type = spectralType;
+        LE_TO_CPU_INT32(catNo, catNo);
+        LE_TO_CPU_FLOAT(x, x);
+        LE_TO_CPU_FLOAT(y, y);
+        LE_TO_CPU_FLOAT(z, z);
+        LE_TO_CPU_INT16(absMag, absMag);
+        LE_TO_CPU_INT16(type, type);
+
+        char* record = records.data() + 20 * i;
+        memcpy(record, &catNo, 4);
+        memcpy(record + 4, &x, 4);
+        memcpy(record + 8, &y, 4);
+        memcpy(record + 12, &z, 4);
+        memcpy(record + 16, &absMag, 2);
+        memcpy(record + 18, &type, 2);
+    }
+
+    vector<StarOctree::PackedNode> nodes;
+    octree->pack(nodes);
+    PagedStarCatalog catalog;
+    if (!PagedStarCatalog::write(filename, OCTREE_ROOT_SIZE, nodes, records.data(), starCount) ||
+        !catalog.open(filename))
+    {
+        cerr << "Error writing paged star catalog " << filename << '\n';
+        return 1;
+    }
+    catalog.setMemoryBudget((size_t) budgetMB * 1024 * 1024);
+    cout << "Paged catalog has " << nodes.size() << " nodes\n";
+
+    vector<View> views;
+    for (unsigned int i = 0; i < viewCount; i++)
+    {
+        Vector3f axis(unit(gen), unit(gen), unit(gen));
+        Quaternionf q(AngleAxisf((float) M_PI * unit(gen), axis.normalized()));
+        views.push_back(makeView(Vector3f(pos(gen), pos(gen), pos(gen)) * 0.1f, q));
+    }
+
+    ThreadPool pool(nThreads);
+    vector<StarRecorder> reference(views.size());
+    Timer timer;
+    for (size_t i = 0; i < views.size(); i++)
+    {
+        octree->processVisibleObjects(reference[i], views[i].position, views[i].frustumPlanes,
+                                      limitingMag, OCTREE_ROOT_SIZE, nullptr, &pool);
+    }
+    fmt::printf("in memory: %.2f ms per view\n", timer.getTime() / viewCount * 1000.0);
+
+    for (const char* pass : { "paged, cold", "paged, warm" })
+    {
+        timer.reset();
+        for (size_t i = 0; i < views.size(); i++)
+        {
+            StarRecorder result;
+            catalog.nextFrame();
+            catalog.octree()->processVisibleObjects(result, views[i].position, views[i].frustumPlanes,
+                                                    limitingMag, catalog.rootSize(), nullptr, &pool);
+            if (!(result == reference[i]))
+            {
+                cerr << "Paged traversal differs from the in memory one for view " << i << '\n';
+                return 1;
+            }
+        }
+        printStatistics(pass, timer.getTime(), catalog.getStatistics());
+    }
+
+    delete octree;
+    remove(filename.c_str());
+
+    return 0;
+}
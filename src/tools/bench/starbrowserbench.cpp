@@ -0,0 +1,251 @@
+// starbrowserbench.cpp
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Measure the star octree searches used by the star browser for the
+// nearest stars, the apparently brightest stars and the stars with the
+// brightest absolute magnitude, from an observer near the Sun and from
+// one far away from it. Each search is compared against the linear scan
+// over all stars that the star browser used before, which must find the
+// same stars in the same order.
+
+#include <iostream>
+#include <random>
+#include <set>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <fmt/printf.h>
+#include <celutil/timer.h>
+#include <celengine/astro.h>
+#include <celengine/staroctree.h>
+#include "benchview.h"
+
+using namespace std;
+using namespace Eigen;
+
+
+static unsigned int starCount = 2000000;
+static unsigned int listSize = 100;
+static unsigned int repeatCount = 20;
+
+constexpr const float OCTREE_ROOT_SIZE = 1000000000.0f;
+constexpr const float SQRT3            = 1.732050807568877f;
+
+
+void Usage()
+{
+    cerr << "Usage: starbrowserbench [options]\n";
+    cerr << "  Options:\n";
+    cerr << "    --stars <n>  : number of stars in the synthetic catalog (default 2000000)\n";
+    cerr << "    --list <n>   : number of stars to find (default 100)\n";
+    cerr << "    --repeat <n> : number of times each search is repeated (default 20)\n";
+}
+
+
+bool parseCommandLine(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--stars") && i + 1 < argc)
+            starCount = max(1u, (unsigned int) strtoul(argv[++i], nullptr, 10));
+        else if (!strcmp(argv[i], "--list") && i + 1 < argc)
+            listSize = max(1u, (unsigned int) strtoul(argv[++i], nullptr, 10));
+        else if (!strcmp(argv[i], "--repeat") && i + 1 < argc)
+            repeatCount = max(1u, (unsigned int) strtoul(argv[++i], nullptr, 10));
+        else
+            return false;
+    }
+
+    return true;
+}
+
+
+// The predicates and the scan are those of the star browser
+struct CloserStarPredicate
+{
+    Vector3f pos;
+    bool operator()(const Star* star0, const Star* star1) const
+    {
+        Vector3f v0 = star0->getPosition() - pos;
+        Vector3f v1 = star1->getPosition() - pos;
+        return v0.squaredNorm() < v1.squaredNorm();
+    }
+};
+
+
+struct BrighterStarPredicate
+{
+    Vector3f pos;
+    bool operator()(const Star* star0, const Star* star1) const
+    {
+        float d0 = (star0->getPosition() - pos).norm();
+        float d1 = (star1->getPosition() - pos).norm();
+        return star0->getApparentMagnitude(d0) < star1->getApparentMagnitude(d1);
+    }
+};
+
+
+struct BrightestStarPredicate
+{
+    bool operator()(const Star* star0, const Star* star1) const
+    {
+        return star0->getAbsoluteMagnitude() < star1->getAbsoluteMagnitude();
+    }
+};
+
+
+template<class Pred> static vector<const Star*> findStars(const Star* stars, unsigned int totalStars,
+                                                          Pred pred, unsigned int nStars)
+{
+    multiset<const Star*, Pred> firstStars(pred);
+    nStars = min(nStars, totalStars);
+
+    unsigned int i;
+    for (i = 0; i < nStars; i++)
+        firstStars.insert(&stars[i]);
+
+    const Star* lastStar = *--firstStars.end();
+    for (; i < totalStars; i++)
+    {
+        const Star* star = &stars[i];
+        if (pred(star, lastStar))
+        {
+            firstStars.insert(star);
+            firstStars.erase(--firstStars.end());
+            lastStar = *--firstStars.end();
+        }
+    }
+
+    return vector<const Star*>(firstStars.begin(), firstStars.end());
+}
+
+
+struct Search
+{
+    const char* description;
+    function<vector<const Star*>()> scan;
+    function<vector<const Star*>(OctreeProcStats&)> octree;
+};
+
+
+int main(int argc, char* argv[])
+{
+    if (!parseCommandLine(argc, argv))
+    {
+        Usage();
+        return 1;
+    }
+
+    // Fixed seed: every run of the benchmark uses the same catalog. Stars
+    // are denser towards the Sun, and faint stars are far more common
+    // than bright ones.
+    mt19937 gen(1234);
+    normal_distribution<float> pos(0.0f, 2000.0f);
+
+    cout << "Building octree of " << starCount << " stars\n";
+    vector<Star> unsortedStars = makeCatalog(starCount, gen, pos);
+
+    float absMag = astro::appToAbsMag(6.0f, OCTREE_ROOT_SIZE * SQRT3);
+    Star* stars = new Star[starCount];
+    StarOctree* octree = DynamicStarOctree::build(Vector3f(1000.0f, 1000.0f, 1000.0f), absMag,
+                                                  OCTREE_ROOT_SIZE, unsortedStars, starCount, stars);
+    unsortedStars.clear();
+    size_t nodeCount = (size_t) octree->countChildren() + 1;
+    fmt::printf("Octree has %zu nodes, finding %u stars\n", nodeCount, listSize);
+
+    struct Observer
+    {
+        const char* description;
+        Vector3f    position;
+    };
+    Observer observers[] =
+    {
+        { "near the Sun",  Vector3f(1.58e-5f, 0.0f, 0.0f) },
+        { "far from it",   Vector3f(7200.0f, -3100.0f, 4500.0f) },
+    };
+
+    fmt::printf("%-16s %-20s %12s %12s %9s %10s\n", "observer", "search", "scan (ms)", "octree (ms)", "speedup", "nodes");
+    for (const auto& observer : observers)
+    {
+        Vector3f obsPosition = observer.position;
+        vector<Search> searches =
+        {
+            {
+                "nearest",
+                [&]() { return findStars(stars, starCount, CloserStarPredicate{ obsPosition }, listSize); },
+                [&](OctreeProcStats& stats)
+                {
+                    vector<const Star*> result;
+                    octree->findNearestObjects(obsPosition, OCTREE_ROOT_SIZE, listSize, result, &stats);
+                    return result;
+                }
+            },
+            {
+                "apparent magnitude",
+                [&]() { return findStars(stars, starCount, BrighterStarPredicate{ obsPosition }, listSize); },
+                [&](OctreeProcStats& stats)
+                {
+                    vector<const Star*> result;
+                    octree->findBrightestObjects(obsPosition, OCTREE_ROOT_SIZE, listSize, result, &stats);
+                    return result;
+                }
+            },
+            {
+                "absolute magnitude",
+                [&]() { return findStars(stars, starCount, BrightestStarPredicate(), listSize); },
+                [&](OctreeProcStats& stats)
+                {
+                    vector<const Star*> result;
+                    octree->findMostLuminousObjects(OCTREE_ROOT_SIZE, listSize, result, &stats);
+                    return result;
+                }
+            },
+        };
+
+        for (const auto& search : searches)
+        {
+            vector<const Star*> reference;
+            Timer timer;
+            for (unsigned int i = 0; i < repeatCount; i++)
+                reference = search.scan();
+            double scanTime = timer.getTime() / repeatCount;
+
+            // The first search also pays for faulting in the nodes
+            vector<const Star*> result;
+            OctreeProcStats stats;
+            search.octree(stats);
+            timer.reset();
+            for (unsigned int i = 0; i < repeatCount; i++)
+            {
+                stats = OctreeProcStats();
+                result = search.octree(stats);
+            }
+            double octreeTime = timer.getTime() / repeatCount;
+
+            if (result != reference)
+            {
+                cerr << "Octree search for the " << search.description << " from " << observer.description
+                     << " differs from the linear scan\n";
+                return 1;
+            }
+
+            fmt::printf("%-16s %-20s %12.3f %12.3f %8.1fx %9.2f%%\n", observer.description, search.description,
+                        scanTime * 1.0e3, octreeTime * 1.0e3, scanTime / octreeTime,
+                        100.0 * stats.nodes / nodeCount);
+        }
+    }
+
+    delete octree;
+    delete[] stars;
+
+    return 0;
+}
@@ -0,0 +1,192 @@
+// stardbbench.cpp
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Compare the startup cost of loading a binary star database through
+// an input stream and through a memory mapping. A synthetic catalog is
+// generated first, so no data files are required.
+
+#include <iostream>
+#include <fstream>
+#include <random>
+#include <string>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fmt/printf.h>
+#include <celutil/bytes.h>
+#include <celutil/timer.h>
+#include <celengine/stellarclass.h>
+#include <celengine/stardb.h>
+
+using namespace std;
+
+
+static unsigned int starCount = 10000000;
+static unsigned int runCount = 3;
+static string catalogFilename = "stardbbench.dat";
+static bool keepCatalog = false;
+
+
+void Usage()
+{
+    cerr << "Usage: stardbbench [options]\n";
+    cerr << "  Options:\n";
+    cerr << "    --stars <n>   : number of stars in the synthetic catalog (default 10000000)\n";
+    cerr << "    --runs <n>    : number of timed runs for each loader (default 3)\n";
+    cerr << "    --file <path> : where to write the synthetic catalog\n";
+    cerr << "    --keep        : don't delete the synthetic catalog when done\n";
+}
+
+
+bool parseCommandLine(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--stars") && i + 1 < argc)
+            starCount = (unsigned int) strtoul(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "--runs") && i + 1 < argc)
+            runCount = max(1u, (unsigned int) strtoul(argv[++i], nullptr, 10));
+        else if (!strcmp(argv[i], "--file") && i + 1 < argc)
+            catalogFilename = argv[++i];
+        else if (!strcmp(argv[i], "--keep"))
+            keepCatalog = true;
+        else
+            return false;
+    }
+
+    return true;
+}
+
+
+template<typename T> static void writeLE(ostream& out, T value)
+{
+    static_assert(sizeof(T) == 2 || sizeof(T) == 4, "Unsupported field size");
+    if (sizeof(T) == 2)
+    {
+        uint16_t n;
+        memcpy(&n, &value, sizeof n);
+        LE_TO_CPU_INT16(n, n);
+        out.write(reinterpret_cast<char*>(&n), sizeof n);
+    }
+    else
+    {
+        uint32_t n;
+        memcpy(&n, &value, sizeof n);
+        LE_TO_CPU_INT32(n, n);
+        out.write(reinterpret_cast<char*>(&n), sizeof n);
+    }
+}
+
+
+static bool writeSyntheticCatalog(const string& filename, unsigned int nStars)
+{
+    ofstream out(filename, ios::out | ios::binary);
+    if (!out.good())
+        return false;
+
+    out.write("CELSTARS", 8);
+    writeLE(out, (uint16_t) 0x0100);
+    writeLE(out, (uint32_t) nStars);
+
+    const uint16_t spectralTypes[] =
+    {
+        StellarClass(StellarClass::NormalStar, StellarClass::Spectral_G, 2, StellarClass::Lum_V).packV1(),
+        StellarClass(StellarClass::NormalStar, StellarClass::Spectral_K, 5, StellarClass::Lum_III).packV1(),
+        StellarClass(StellarClass::NormalStar, StellarClass::Spectral_M, 3, StellarClass::Lum_V).packV1(),
+        StellarClass(StellarClass::NormalStar, StellarClass::Spectral_A, 0, StellarClass::Lum_V).packV1(),
+        StellarClass(StellarClass::WhiteDwarf, StellarClass::Spectral_DA, 7, StellarClass::Lum_Unknown).packV1(),
+    };
+
+    // Fixed seed: every run of the benchmark loads the same catalog
+    mt19937 gen(1234);
+    uniform_real_distribution<float> pos(-5000.0f, 5000.0f);
+    uniform_real_distribution<float> mag(-8.0f, 16.0f);
+    uniform_int_distribution<int> spec(0, sizeof(spectralTypes) / sizeof(spectralTypes[0]) - 1);
+
+    for (unsigned int i = 0; i < nStars; i++)
+    {
+        writeLE(out, (uint32_t) (i + 1));
+        writeLE(out, pos(gen));
+        writeLE(out, pos(gen));
+        writeLE(out, pos(gen));
+        writeLE(out, (int16_t) (mag(gen) * 256.0f));
+        writeLE(out, spectralTypes[spec(gen)]);
+    }
+
+    return out.good();
+}
+
+
+static double timeStreamLoad(const string& filename)
+{
+    Timer timer;
+    ifstream in(filename, ios::in | ios::binary);
+    auto* db = new StarDatabase();
+    bool ok = in.good() && db->loadBinary(in);
+    double t = timer.getTime();
+    delete db;
+    return ok ? t : -1.0;
+}
+
+
+static double timeMappedLoad(const string& filename)
+{
+    Timer timer;
+    auto* db = new StarDatabase();
+    bool ok = db->loadBinary(fs::path(filename));
+    double t = timer.getTime();
+    delete db;
+    return ok ? t : -1.0;
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (!parseCommandLine(argc, argv))
+    {
+        Usage();
+        return 1;
+    }
+
+    cout << "Writing synthetic catalog of " << starCount << " stars to " << catalogFilename << '\n';
+    if (!writeSyntheticCatalog(catalogFilename, starCount))
+    {
+        cerr << "Error writing " << catalogFilename << '\n';
+        return 1;
+    }
+
+    // Warm up the page cache so that both loaders see the same conditions.
+    timeStreamLoad(catalogFilename);
+
+    double bestStream = -1.0, bestMapped = -1.0;
+    for (unsigned int run = 0; run < runCount; run++)
+    {
+        double ts = timeStreamLoad(catalogFilename);
+        double tm = timeMappedLoad(catalogFilename);
+        if (ts < 0.0 || tm < 0.0)
+        {
+            cerr << "Error loading " << catalogFilename << '\n';
+            return 1;
+        }
+        fmt::printf("run %u: stream %.3f s, mapped %.3f s\n", run + 1, ts, tm);
+        bestStream = bestStream < 0.0 ? ts : min(bestStream, ts);
+        bestMapped = bestMapped < 0.0 ? tm : min(bestMapped, tm);
+    }
+
+    fmt::printf("best: stream %.3f s (%.1f Mstars/s), mapped %.3f s (%.1f Mstars/s), speedup %.2fx\n",
+                bestStream, starCount / bestStream * 1.0e-6,
+                bestMapped, starCount / bestMapped * 1.0e-6,
+                bestStream / bestMapped);
+
+    if (!keepCatalog)
+        remove(catalogFilename.c_str());
+
+    return 0;
+}
@@ -0,0 +1,248 @@
+// starpickbench.cpp
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Measure the latency of picking a star along a ray for catalogs of
+// growing size, with the cone search of StarOctree::processConeObjects()
+// and with the traversal of a narrow view frustum that
+// Universe::pickStar used before. The star picked by the cone search is
+// checked against a linear scan over all stars: it must be the one
+// closest in angle to the ray, up to the angular resolution of the picker.
+
+#include <iostream>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fmt/printf.h>
+#include <celutil/timer.h>
+#include <celengine/astro.h>
+#include <celengine/staroctree.h>
+#include "benchview.h"
+
+using namespace std;
+using namespace Eigen;
+
+
+static unsigned int maxStarCount = 2000000;
+static unsigned int pickCount = 200;
+static float limitingMagnitude = 9.0f;
+static float tolerance = 0.003f;
+
+constexpr const float  OCTREE_ROOT_SIZE = 1000000000.0f;
+constexpr const double ANGULAR_RES      = 3.5e-6;
+
+
+void Usage()
+{
+    cerr << "Usage: starpickbench [options]\n";
+    cerr << "  Options:\n";
+    cerr << "    --stars <n>     : number of stars in the largest catalog (default 2000000)\n";
+    cerr << "    --picks <n>     : number of rays picked in each catalog (default 200)\n";
+    cerr << "    --magnitude <m> : faintest magnitude of the stars picked (default 9)\n";
+    cerr << "    --tolerance <r> : pick tolerance in radians (default 0.003)\n";
+}
+
+
+bool parseCommandLine(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--stars") && i + 1 < argc)
+            maxStarCount = max(1u, (unsigned int) strtoul(argv[++i], nullptr, 10));
+        else if (!strcmp(argv[i], "--picks") && i + 1 < argc)
+            pickCount = max(1u, (unsigned int) strtoul(argv[++i], nullptr, 10));
+        else if (!strcmp(argv[i], "--magnitude") && i + 1 < argc)
+            limitingMagnitude = (float) atof(argv[++i]);
+        else if (!strcmp(argv[i], "--tolerance") && i + 1 < argc)
+            tolerance = (float) atof(argv[++i]);
+        else
+            return false;
+    }
+
+    return true;
+}
+
+
+// The angle test of Universe's StarPicker, for stars without orbits
+static double sinHalfAngle(const Star& star, const Vector3f& origin, const Vector3f& direction)
+{
+    Vector3f starDir = (star.getPosition() - origin).normalized();
+    return (starDir - direction).cast<double>().norm() / 2.0;
+}
+
+
+class Picker : public StarConeHandler
+{
+ public:
+    Picker(const Vector3f& origin, const Vector3f& direction) :
+        origin(origin),
+        direction(direction),
+        sinAngle2Closest(max(sin(tolerance / 2.0), ANGULAR_RES))
+    {
+    }
+
+    void process(const Star& star, float /*distance*/, float /*appMag*/) override
+    {
+        double sinAngle2 = sinHalfAngle(star, origin, direction);
+        if (sinAngle2 <= sinAngle2Closest)
+        {
+            sinAngle2Closest = max(sinAngle2, ANGULAR_RES);
+            picked = &star;
+        }
+    }
+
+    float maxAngle() const override
+    {
+        return (float) (2.0 * asin(min(sinAngle2Closest, 1.0)));
+    }
+
+    Vector3f origin;
+    Vector3f direction;
+    double sinAngle2Closest;
+    const Star* picked{ nullptr };
+};
+
+
+int main(int argc, char* argv[])
+{
+    if (!parseCommandLine(argc, argv))
+    {
+        Usage();
+        return 1;
+    }
+
+    fmt::printf("%10s %8s %14s %14s %9s %8s %8s\n",
+                "stars", "hits", "frustum (us)", "cone (us)", "speedup", "nodes", "objects");
+
+    for (unsigned int starCount = min(20000u, maxStarCount); ; starCount = min(starCount * 10, maxStarCount))
+    {
+        // Fixed seed: every run of the benchmark uses the same catalogs
+        // and rays. Stars are denser towards the Sun, and faint stars are
+        // far more common than bright ones; the observer is in the dense
+        // part.
+        mt19937 gen(1234);
+        normal_distribution<float> pos(0.0f, 2000.0f);
+        uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        auto randomDirection = [&]()
+        {
+            Vector3f v;
+            do
+            {
+                v = Vector3f(unit(gen), unit(gen), unit(gen));
+            } while (v.squaredNorm() > 1.0f || v.squaredNorm() < 1.0e-6f);
+            return v.normalized();
+        };
+
+        vector<Star> unsortedStars = makeCatalog(starCount, gen, pos);
+
+        float absMag = astro::appToAbsMag(6.0f, OCTREE_ROOT_SIZE * (float) sqrt(3.0));
+        vector<Star> stars(starCount);
+        StarOctree* octree = DynamicStarOctree::build(Vector3f(1000.0f, 1000.0f, 1000.0f), absMag,
+                                                      OCTREE_ROOT_SIZE, unsortedStars, starCount, stars.data());
+        unsortedStars.clear();
+
+        // Half of the rays are aimed close to a star bright enough to be
+        // picked.
+        Vector3f origin(20.0f, -35.0f, 12.0f);
+        vector<const Star*> pickable;
+        for (const auto& star : stars)
+        {
+            if (star.getApparentMagnitude((star.getPosition() - origin).norm()) < limitingMagnitude)
+                pickable.push_back(&star);
+        }
+
+        vector<Vector3f> rays;
+        for (unsigned int i = 0; i < pickCount; i++)
+        {
+            Vector3f direction = randomDirection();
+            if (i % 2 == 1 && !pickable.empty())
+            {
+                Vector3f toStar = (pickable[gen() % pickable.size()]->getPosition() - origin).normalized();
+                direction = (toStar + direction * tolerance * 0.5f).normalized();
+            }
+            rays.push_back(direction);
+        }
+
+        // Same frustum as StarDatabase::findVisibleStars with the field of
+        // view and aspect ratio used by Universe::pickStar before
+        double frustumTime = 0.0;
+        for (const auto& direction : rays)
+        {
+            Quaternionf rotation;
+            rotation.setFromTwoVectors(-Vector3f::UnitZ(), direction);
+            Matrix3f rot = rotation.conjugate().toRotationMatrix();
+            float h = tan(tolerance / 2);
+            Vector3f planeNormals[5] =
+            {
+                Vector3f(0.0f, 1.0f, -h),
+                Vector3f(0.0f, -1.0f, -h),
+                Vector3f(1.0f, 0.0f, -h),
+                Vector3f(-1.0f, 0.0f, -h),
+                Vector3f(0.0f, 0.0f, -1.0f),
+            };
+            Hyperplane<float, 3> frustumPlanes[5];
+            for (int i = 0; i < 5; i++)
+                frustumPlanes[i] = Hyperplane<float, 3>(rot.transpose() * planeNormals[i].normalized(), origin);
+
+            Picker picker(origin, direction);
+            Timer timer;
+            octree->processVisibleObjects(picker, origin, frustumPlanes, limitingMagnitude, OCTREE_ROOT_SIZE);
+            frustumTime += timer.getTime();
+        }
+
+        OctreeProcStats stats;
+        vector<const Star*> picked;
+        Timer timer;
+        for (const auto& direction : rays)
+        {
+            Picker picker(origin, direction);
+            octree->processConeObjects(picker, origin, direction, limitingMagnitude, OCTREE_ROOT_SIZE, &stats);
+            picked.push_back(picker.picked);
+        }
+        double coneTime = timer.getTime();
+
+        unsigned int hits = 0;
+        for (size_t i = 0; i < rays.size(); i++)
+        {
+            double closest = max(sin(tolerance / 2.0), ANGULAR_RES);
+            const Star* reference = nullptr;
+            for (const Star* star : pickable)
+            {
+                double sinAngle2 = sinHalfAngle(*star, origin, rays[i]);
+                if (sinAngle2 <= closest)
+                {
+                    closest = sinAngle2;
+                    reference = star;
+                }
+            }
+
+            bool same = picked[i] == nullptr ? reference == nullptr :
+                        reference != nullptr &&
+                        sinHalfAngle(*picked[i], origin, rays[i]) <= max(closest, ANGULAR_RES);
+            if (!same)
+            {
+                cerr << "Cone search picked a different star than the linear scan\n";
+                return 1;
+            }
+            hits += picked[i] != nullptr ? 1 : 0;
+        }
+
+        fmt::printf("%10u %8u %14.1f %14.1f %8.1fx %8.1f %8.1f\n", starCount, hits,
+                    frustumTime / pickCount * 1.0e6, coneTime / pickCount * 1.0e6, frustumTime / coneTime,
+                    (double) stats.nodes / pickCount, (double) stats.objects / pickCount);
+
+        delete octree;
+        if (starCount == maxStarCount)
+            break;
+    }
+
+    return 0;
+}
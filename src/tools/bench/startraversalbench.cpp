@@ -0,0 +1,209 @@
+// startraversalbench.cpp
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Measure how the star octree visibility traversal scales with the
+// number of threads, for wide field views with faint limiting
+// magnitudes. Every threaded run must pass exactly the same stars, in
+// the same order, to the handler as the single threaded one.
+
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fmt/printf.h>
+#include <celmath/mathlib.h>
+#include <celutil/threadpool.h>
+#include <celutil/timer.h>
+#include <celengine/astro.h>
+#include <celengine/staroctree.h>
+#include "benchview.h"
+
+using namespace std;
+using namespace Eigen;
+
+
+static unsigned int starCount = 2000000;
+static unsigned int viewCount = 50;
+static unsigned int maxThreads = 0;
+static float fieldOfView = 90.0f;
+static vector<float> magnitudes = { 12.0f, 14.0f };
+
+constexpr const float OCTREE_ROOT_SIZE = 1000000000.0f;
+
+
+void Usage()
+{
+    cerr << "Usage: startraversalbench [options]\n";
+    cerr << "  Options:\n";
+    cerr << "    --stars <n>    : number of stars in the synthetic catalog (default 2000000)\n";
+    cerr << "    --views <n>    : number of random views to traverse (default 50)\n";
+    cerr << "    --threads <n>  : largest number of threads to test (default: all cores)\n";
+    cerr << "    --fov <deg>    : vertical field of view in degrees (default 90)\n";
+    cerr << "    --magnitude <m>: limiting magnitude to test; may be repeated (default 12 and 14)\n";
+}
+
+
+bool parseCommandLine(int argc, char* argv[])
+{
+    bool magnitudeGiven = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--stars") && i + 1 < argc)
+            starCount = max(1u, (unsigned int) strtoul(argv[++i], nullptr, 10));
+        else if (!strcmp(argv[i], "--views") && i + 1 < argc)
+            viewCount = max(1u, (unsigned int) strtoul(argv[++i], nullptr, 10));
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+            maxThreads = (unsigned int) strtoul(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "--fov") && i + 1 < argc)
+            fieldOfView = (float) atof(argv[++i]);
+        else if (!strcmp(argv[i], "--magnitude") && i + 1 < argc)
+        {
+            if (!magnitudeGiven)
+                magnitudes.clear();
+            magnitudeGiven = true;
+            magnitudes.push_back((float) atof(argv[++i]));
+        }
+        else
+            return false;
+    }
+
+    return true;
+}
+
+
+// Records the sequence of stars it's given, so that runs can be compared.
+class StarRecorder : public StarHandler
+{
+ public:
+    void process(const Star& star, float distance, float appMag) override
+    {
+        stars.push_back(&star);
+        values.push_back(distance);
+        values.push_back(appMag);
+    }
+
+    void processBatch(celestia::span<const Star* const> batch,
+                      celestia::span<const float> distances,
+                      celestia::span<const float> appMags) override
+    {
+        for (size_t i = 0; i < batch.size(); i++)
+            process(*batch[i], distances[i], appMags[i]);
+    }
+
+    void clear()
+    {
+        stars.clear();
+        values.clear();
+    }
+
+    bool operator==(const StarRecorder& other) const
+    {
+        return stars == other.stars && values == other.values;
+    }
+
+    vector<const Star*> stars;
+    vector<float> values;
+};
+
+
+static double timeViews(const StarOctree& octree,
+                        const vector<View>& views,
+                        float limitingMag,
+                        ThreadPool* pool,
+                        vector<StarRecorder>& results)
+{
+    results.resize(views.size());
+    double total = 0.0;
+    for (size_t i = 0; i < views.size(); i++)
+    {
+        results[i].clear();
+        Timer timer;
+        octree.processVisibleObjects(results[i], views[i].position, views[i].frustumPlanes,
+                                     limitingMag, OCTREE_ROOT_SIZE, nullptr, pool);
+        total += timer.getTime();
+    }
+
+    return total;
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (!parseCommandLine(argc, argv))
+    {
+        Usage();
+        return 1;
+    }
+
+    if (maxThreads == 0)
+        maxThreads = max(1u, thread::hardware_concurrency());
+
+    // Fixed seed: every run of the benchmark uses the same catalog and views
+    mt19937 gen(1234);
+    uniform_real_distribution<float> pos(-5000.0f, 5000.0f);
+    uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    cout << "Building octree of " << starCount << " stars\n";
+    vector<Star> unsortedStars = makeCatalog(starCount, gen, pos);
+
+    float absMag = astro::appToAbsMag(6.0f, OCTREE_ROOT_SIZE * (float) sqrt(3.0));
+    auto* dynamicRoot = new DynamicStarOctree(Vector3f(1000.0f, 1000.0f, 1000.0f), absMag);
+    for (const auto& star : unsortedStars)
+        dynamicRoot->insertObject(star, OCTREE_ROOT_SIZE);
+
+    Star* stars = new Star[starCount];
+    Star* firstStar = stars;
+    StarOctree* octree = nullptr;
+    dynamicRoot->rebuildAndSort(octree, firstStar);
+    delete dynamicRoot;
+
+    vector<View> views;
+    for (unsigned int i = 0; i < viewCount; i++)
+    {
+        Vector3f axis(unit(gen), unit(gen), unit(gen));
+        Quaternionf q(AngleAxisf((float) M_PI * unit(gen), axis.normalized()));
+        views.push_back(makeView(Vector3f(pos(gen), pos(gen), pos(gen)) * 0.1f, q, fieldOfView));
+    }
+
+    for (float limitingMag : magnitudes)
+    {
+        vector<StarRecorder> reference;
+        double serialTime = timeViews(*octree, views, limitingMag, nullptr, reference);
+        size_t nVisible = 0;
+        for (const auto& result : reference)
+            nVisible += result.stars.size();
+
+        fmt::printf("magnitude %.1f, %.0f degree field: %zu stars visible per view\n",
+                    limitingMag, fieldOfView, nVisible / views.size());
+        fmt::printf("  1 thread:  %.2f ms per view\n", serialTime / views.size() * 1000.0);
+
+        for (unsigned int nThreads = 2; nThreads <= maxThreads; nThreads *= 2)
+        {
+            ThreadPool pool(nThreads);
+            vector<StarRecorder> results;
+            double t = timeViews(*octree, views, limitingMag, &pool, results);
+            if (results != reference)
+            {
+                cerr << "Results with " << nThreads << " threads differ from the single threaded ones\n";
+                return 1;
+            }
+            fmt::printf("  %u threads: %.2f ms per view, speedup %.2fx\n",
+                        nThreads, t / views.size() * 1000.0, serialTime / t);
+        }
+    }
+
+    delete octree;
+    delete[] stars;
+
+    return 0;
+}
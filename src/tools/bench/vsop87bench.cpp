@@ -0,0 +1,146 @@
+// vsop87bench.cpp
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Measure the evaluation of the VSOP87 series of the eight planets: term
+// by term with the C library cos(), as before they were vectorized, with
+// the terms of each series computed in vectorized blocks, and in batches
+// of times as used for orbit sampling and the Chebyshev fits of the orbit
+// cache. Every position must match the term by term one within 1e-12.
+
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fmt/printf.h>
+#include <celutil/timer.h>
+#include <celephem/vsop87.h>
+
+using namespace std;
+using namespace Eigen;
+
+
+static unsigned int positionCount = 20000;
+static unsigned int batchSize = 64;
+
+constexpr const double J2000 = 2451545.0;
+
+
+void Usage()
+{
+    cerr << "Usage: vsop87bench [options]\n";
+    cerr << "  Options:\n";
+    cerr << "    --positions <n> : number of positions computed per planet (default 20000)\n";
+    cerr << "    --batch <n>     : number of times evaluated together (default 64)\n";
+}
+
+
+bool parseCommandLine(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--positions") && i + 1 < argc)
+            positionCount = max(1u, (unsigned int) strtoul(argv[++i], nullptr, 10));
+        else if (!strcmp(argv[i], "--batch") && i + 1 < argc)
+            batchSize = max(1u, (unsigned int) strtoul(argv[++i], nullptr, 10));
+        else
+            return false;
+    }
+
+    return true;
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (!parseCommandLine(argc, argv))
+    {
+        Usage();
+        return 1;
+    }
+
+    const char* planets[] =
+    {
+        "vsop87-mercury", "vsop87-venus", "vsop87-earth", "vsop87-mars",
+        "vsop87-jupiter", "vsop87-saturn", "vsop87-uranus", "vsop87-neptune",
+    };
+
+    // Fixed seed: every run of the benchmark uses the same times, spread
+    // over the years -4000 to 4000. Batches are runs of evenly spaced
+    // times, like the samples of an orbit path.
+    mt19937 gen(1234);
+    uniform_real_distribution<double> year(-6000.0, 2000.0);
+    vector<double> times(positionCount);
+    for (unsigned int i = 0; i < positionCount; i += batchSize)
+    {
+        double start = J2000 + year(gen) * 365.25;
+        for (unsigned int j = i; j < min(i + batchSize, positionCount); j++)
+            times[j] = start + (j - i) * 2.0;
+    }
+
+    fmt::printf("%-16s %12s %12s %9s %12s %9s %12s\n",
+                "planet", "scalar (us)", "blocks (us)", "speedup", "batch (us)", "speedup", "max error");
+
+    double totalScalar = 0.0;
+    double totalBlocks = 0.0;
+    double totalBatch = 0.0;
+    for (const char* name : planets)
+    {
+        unique_ptr<CachingOrbit> scalar(CreateVSOP87SeriesOrbit(name, true));
+        unique_ptr<CachingOrbit> vector(CreateVSOP87SeriesOrbit(name, false));
+
+        std::vector<Vector3d> reference(positionCount);
+        Timer timer;
+        for (unsigned int i = 0; i < positionCount; i++)
+            reference[i] = scalar->computePosition(times[i]);
+        double scalarTime = timer.getTime();
+
+        std::vector<Vector3d> blocks(positionCount);
+        timer.reset();
+        for (unsigned int i = 0; i < positionCount; i++)
+            blocks[i] = vector->computePosition(times[i]);
+        double blockTime = timer.getTime();
+
+        std::vector<Vector3d> batch(positionCount);
+        timer.reset();
+        for (unsigned int i = 0; i < positionCount; i += batchSize)
+            vector->computePositions(&times[i], &batch[i], min(batchSize, positionCount - i));
+        double batchTime = timer.getTime();
+
+        double maxError = 0.0;
+        for (unsigned int i = 0; i < positionCount; i++)
+        {
+            double norm = reference[i].norm();
+            maxError = max(maxError, (blocks[i] - reference[i]).norm() / norm);
+            maxError = max(maxError, (batch[i] - reference[i]).norm() / norm);
+        }
+
+        if (maxError > 1.0e-12)
+        {
+            cerr << "Vectorized positions of " << name << " differ from the scalar ones\n";
+            return 1;
+        }
+
+        fmt::printf("%-16s %12.3f %12.3f %8.1fx %12.3f %8.1fx %12.2g\n", name,
+                    scalarTime / positionCount * 1.0e6, blockTime / positionCount * 1.0e6, scalarTime / blockTime,
+                    batchTime / positionCount * 1.0e6, scalarTime / batchTime, maxError);
+
+        totalScalar += scalarTime;
+        totalBlocks += blockTime;
+        totalBatch += batchTime;
+    }
+
+    fmt::printf("%-16s %12.3f %12.3f %8.1fx %12.3f %8.1fx\n", "all",
+                totalScalar / positionCount * 1.0e6, totalBlocks / positionCount * 1.0e6, totalScalar / totalBlocks,
+                totalBatch / positionCount * 1.0e6, totalScalar / totalBatch);
+
+    return 0;
+}
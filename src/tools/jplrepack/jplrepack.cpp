@@ -0,0 +1,176 @@
+// jplrepack.cpp
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Repack a JPL DE ephemeris into the compact format read by Celestia,
+// keeping only the records for a range of years and the coefficients of
+// the bodies actually used.
+
+#include <iostream>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <celengine/astro.h>
+#include <celephem/jpleph.h>
+
+using namespace std;
+
+
+static string inputFilename;
+static string outputFilename;
+static string bodyList;
+static int startYear = 0;
+static int endYear = 0;
+static bool startYearSet = false;
+static bool endYearSet = false;
+
+
+void Usage()
+{
+    cerr << "Usage: jplrepack [options] <DE ephemeris file> <output file>\n";
+    cerr << "  Options:\n";
+    cerr << "    --bodies <list> : comma separated bodies to keep (default all);\n";
+    cerr << "                      mercury venus emb earth mars jupiter saturn\n";
+    cerr << "                      uranus neptune pluto moon sun\n";
+    cerr << "    --start <year>  : first year kept (default start of the ephemeris)\n";
+    cerr << "    --end <year>    : last year kept (default end of the ephemeris)\n";
+}
+
+
+bool parseCommandLine(int argc, char* argv[])
+{
+    int fileCount = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--bodies") && i + 1 < argc)
+        {
+            bodyList = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--start") && i + 1 < argc)
+        {
+            startYear = atoi(argv[++i]);
+            startYearSet = true;
+        }
+        else if (!strcmp(argv[i], "--end") && i + 1 < argc)
+        {
+            endYear = atoi(argv[++i]);
+            endYearSet = true;
+        }
+        else if (argv[i][0] == '-')
+        {
+            return false;
+        }
+        else if (fileCount == 0)
+        {
+            inputFilename = argv[i];
+            fileCount++;
+        }
+        else if (fileCount == 1)
+        {
+            outputFilename = argv[i];
+            fileCount++;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return fileCount == 2;
+}
+
+
+// Bit mask of the bodies in the list; the position of the Earth is computed
+// from the ones of the Earth-Moon barycenter and of the Moon.
+bool parseBodies(const string& list, unsigned int& mask)
+{
+    static const struct { const char* name; unsigned int mask; } bodies[] =
+    {
+        { "mercury", 1u << JPLEph_Mercury },
+        { "venus",   1u << JPLEph_Venus },
+        { "emb",     1u << JPLEph_EarthMoonBary },
+        { "earth",   (1u << JPLEph_EarthMoonBary) | (1u << JPLEph_Moon) },
+        { "mars",    1u << JPLEph_Mars },
+        { "jupiter", 1u << JPLEph_Jupiter },
+        { "saturn",  1u << JPLEph_Saturn },
+        { "uranus",  1u << JPLEph_Uranus },
+        { "neptune", 1u << JPLEph_Neptune },
+        { "pluto",   1u << JPLEph_Pluto },
+        { "moon",    1u << JPLEph_Moon },
+        { "sun",     1u << JPLEph_Sun },
+    };
+
+    mask = 0;
+    istringstream in(list);
+    string name;
+    while (getline(in, name, ','))
+    {
+        bool found = false;
+        for (const auto& body : bodies)
+        {
+            if (name == body.name)
+            {
+                mask |= body.mask;
+                found = true;
+            }
+        }
+        if (!found)
+        {
+            cerr << "Unknown body " << name << '\n';
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (!parseCommandLine(argc, argv))
+    {
+        Usage();
+        return 1;
+    }
+
+    unsigned int mask = (1u << JPLEph_NBodies) - 1;
+    if (!bodyList.empty() && !parseBodies(bodyList, mask))
+        return 1;
+
+    unique_ptr<JPLEphemeris> eph(JPLEphemeris::open(inputFilename));
+    if (eph == nullptr)
+    {
+        cerr << "Error reading JPL ephemeris file " << inputFilename << '\n';
+        return 1;
+    }
+
+    double startDate = startYearSet ? (double) astro::Date(startYear, 1, 1) : eph->getStartDate();
+    double endDate = endYearSet ? (double) astro::Date(endYear + 1, 1, 1) : eph->getEndDate();
+    if (endDate <= startDate)
+    {
+        cerr << "The end of the range is before its start\n";
+        return 1;
+    }
+
+    ofstream out(outputFilename, ios::out | ios::binary);
+    if (!out.good())
+    {
+        cerr << "Error opening output file " << outputFilename << '\n';
+        return 1;
+    }
+
+    if (!eph->writePacked(out, mask, startDate, endDate))
+    {
+        cerr << "Error writing packed ephemeris " << outputFilename << '\n';
+        return 1;
+    }
+
+    return 0;
+}
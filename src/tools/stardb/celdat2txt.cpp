@@ -24,6 +24,7 @@
 #include <celengine/astro.h>
 #include <celengine/stellarclass.h>
 #include <celengine/star.h>
+#include <celengine/crossindex.h>
 
 using namespace std;
 #define PI 3.14159265358979323846
@@ -209,6 +210,22 @@ bool DumpxRefDatabase(istream& in, ostream& out)
 
     // Verify the version
     uint16_t version = readUshort(in);
+    if (version == 0x0200)
+    {
+        // Sorted cross index; read it from the start with its header
+        in.seekg(0);
+        CrossIndex xindex;
+        if (!xindex.load(in))
+            return false;
+
+        for (uint32_t i = 0; i < xindex.size(); i++)
+        {
+            out << xindex.data()[i].catalogNumber << ' ';
+            out << xindex.data()[i].celCatalogNumber << '\n';
+        }
+        return true;
+    }
+
     if (version != 0x0100)
     {
         cerr << "Bad version for cross index\n";
@@ -0,0 +1,156 @@
+// makepagedstardb.cpp
+//
+// Copyright (C) 2020, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Convert a binary star database to a paged star database, which
+// Celestia reads from disk by octree node as the stars come into view.
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <celutil/bytes.h>
+#include <celutil/threadpool.h>
+#include <celengine/astro.h>
+#include <celengine/pagedstarcatalog.h>
+
+using namespace std;
+
+
+// The octree has to have the same root as the one of the star database
+constexpr const float STAR_OCTREE_ROOT_SIZE = 1000000000.0f;
+constexpr const float STAR_OCTREE_MAGNITUDE = 6.0f;
+constexpr const size_t STAR_RECORD_SIZE     = 20;
+
+static string inputFilename;
+static string outputFilename;
+
+
+void Usage()
+{
+    cerr << "Usage: makepagedstardb <star database file> <output file>\n";
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        Usage();
+        return 1;
+    }
+    inputFilename  = argv[1];
+    outputFilename = argv[2];
+
+    ifstream in(inputFilename, ios::in | ios::binary);
+    if (!in.good())
+    {
+        cerr << "Error opening star database file " << inputFilename << '\n';
+        return 1;
+    }
+
+    char header[8];
+    uint16_t version = 0;
+    uint32_t nStars = 0;
+    in.read(header, sizeof header);
+    in.read(reinterpret_cast<char*>(&version), sizeof version);
+    in.read(reinterpret_cast<char*>(&nStars), sizeof nStars);
+    LE_TO_CPU_INT16(version, version);
+    LE_TO_CPU_INT32(nStars, nStars);
+    if (!in.good() || strncmp(header, "CELSTARS", sizeof header) != 0 || version != 0x0100)
+    {
+        cerr << "Bad header in star database " << inputFilename << '\n';
+        return 1;
+    }
+
+    vector<char> records(STAR_RECORD_SIZE * nStars);
+    in.read(records.data(), (streamsize) records.size());
+    if (!in.good())
+    {
+        cerr << "Star database " << inputFilename << " is truncated\n";
+        return 1;
+    }
+
+    // Only the positions and magnitudes matter for the octree; each star
+    // refers to its record by index.
+    vector<StarDetails*> detailsCache(0x10000, nullptr);
+    vector<Star> unsortedStars(nStars);
+    for (uint32_t i = 0; i < nStars; i++)
+    {
+        const char* record = records.data() + STAR_RECORD_SIZE * i;
+        float x, y, z;
+        int16_t absMag;
+        uint16_t spectralType;
+        memcpy(&x, record + 4, sizeof x);
+        memcpy(&y, record + 8, sizeof y);
+        memcpy(&z, record + 12, sizeof z);
+        memcpy(&absMag, record + 16, sizeof absMag);
+        memcpy(&spectralType, record + 18, sizeof spectralType);
+        LE_TO_CPU_FLOAT(x, x);
+        LE_TO_CPU_FLOAT(y, y);
+        LE_TO_CPU_FLOAT(z, z);
+        LE_TO_CPU_INT16(absMag, absMag);
+        LE_TO_CPU_INT16(spectralType, spectralType);
+
+        StarDetails* details = detailsCache[spectralType];
+        if (details == nullptr)
+        {
+            StellarClass sc;
+            if (sc.unpack(spectralType))
+                details = StarDetails::GetStarDetails(sc);
+            if (details == nullptr)
+            {
+                cerr << "Bad spectral type in star database, star #" << i << '\n';
+                return 1;
+            }
+            detailsCache[spectralType] = details;
+        }
+
+        Star& star = unsortedStars[i];
+        star.setPosition(x, y, z);
+        star.setAbsoluteMagnitude((float) absMag / 256.0f);
+        star.setDetails(details);
+        star.setIndex(i);
+    }
+
+    float absMag = astro::appToAbsMag(STAR_OCTREE_MAGNITUDE,
+                                      STAR_OCTREE_ROOT_SIZE * (float) sqrt(3.0));
+    vector<Star> sortedStars(nStars);
+    ThreadPool threadPool;
+    StarOctree* octree = DynamicStarOctree::build(Eigen::Vector3f(1000.0f, 1000.0f, 1000.0f),
+                                                  absMag,
+                                                  STAR_OCTREE_ROOT_SIZE,
+                                                  unsortedStars,
+                                                  nStars,
+                                                  sortedStars.data(),
+                                                  &threadPool);
+
+    vector<StarOctree::PackedNode> nodes;
+    octree->pack(nodes);
+    delete octree;
+
+    vector<char> sortedRecords(records.size());
+    for (uint32_t i = 0; i < nStars; i++)
+    {
+        memcpy(sortedRecords.data() + STAR_RECORD_SIZE * i,
+               records.data() + STAR_RECORD_SIZE * sortedStars[i].getIndex(),
+               STAR_RECORD_SIZE);
+    }
+
+    if (!PagedStarCatalog::write(outputFilename, STAR_OCTREE_ROOT_SIZE, nodes,
+                                 sortedRecords.data(), nStars))
+    {
+        cerr << "Error writing paged star database " << outputFilename << '\n';
+        return 1;
+    }
+
+    cout << nStars << " stars in " << nodes.size() << " octree nodes\n";
+
+    return 0;
+}
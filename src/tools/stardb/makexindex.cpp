@@ -7,13 +7,15 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 //
-// Convert an ASCII cross index to binary
+// Convert an ASCII cross index to binary, or repack an older binary cross
+// index.
 
 #include <iostream>
 #include <fstream>
 #include <iomanip>
 #include <string>
-#include <celutil/bytes.h>
+#include <vector>
+#include <celengine/crossindex.h>
 
 using namespace std;
 
@@ -67,52 +69,45 @@ bool parseCommandLine(int argc, char* argv[])
 }
 
 
-static void writeUint(ostream& out, uint32_t n)
-{
-    LE_TO_CPU_INT32(n, n);
-    out.write(reinterpret_cast<char*>(&n), sizeof n);
-}
-
-
-static void writeShort(ostream& out, int16_t n)
-{
-    LE_TO_CPU_INT16(n, n);
-    out.write(reinterpret_cast<char*>(&n), sizeof n);
-}
-
-
+// The input is either an ASCII list of catalog number pairs or a binary
+// cross index, which is repacked into the current format.
 bool WriteCrossIndex(istream& in, ostream& out)
 {
-    // Write the header
-    out.write("CELINDEX", 8);
-
-    // Write the version
-    writeShort(out, 0x0100);
+    vector<CrossIndex::Entry> entries;
 
-    unsigned int record = 0;
-    while (!in.eof())
+    if (in.peek() == 'C')
+    {
+        CrossIndex xindex;
+        if (!xindex.load(in))
+            return false;
+        entries.assign(xindex.data(), xindex.data() + xindex.size());
+    }
+    else
     {
-        unsigned int catalogNumber;
-        unsigned int celCatalogNumber;
+        unsigned int record = 0;
+        while (!in.eof())
+        {
+            unsigned int catalogNumber;
+            unsigned int celCatalogNumber;
 
-        in >> catalogNumber;
-        if (in.eof())
-            return true;
+            in >> catalogNumber;
+            if (in.eof())
+                break;
 
-        in >> celCatalogNumber;
-        if (!in.good())
-        {
-            cerr << "Error parsing record #" << record << '\n';
-            return false;
-        }
+            in >> celCatalogNumber;
+            if (!in.good())
+            {
+                cerr << "Error parsing record #" << record << '\n';
+                return false;
+            }
 
-        writeUint(out, (uint32_t) catalogNumber);
-        writeUint(out, (uint32_t) celCatalogNumber);
+            entries.push_back({ (uint32_t) catalogNumber, (uint32_t) celCatalogNumber });
 
-        record++;
+            record++;
+        }
     }
 
-    return true;
+    return CrossIndex::write(out, entries);
 }
 
 
@@ -148,5 +143,11 @@ int main(int argc, char* argv[])
 
     bool success = WriteCrossIndex(*inputFile, *outputFile);
 
+    // Flush and close the files
+    if (inputFile != &cin)
+        delete inputFile;
+    if (outputFile != &cout)
+        delete outputFile;
+
     return success ? 0 : 1;
 }
@@ -1,6 +1,7 @@
 #include <celephem/xyzvbinary.h>
 #include <celutil/bytes.h> // __BYTE_ORDER__
 #include <fmt/printf.h>
+#include <cstring> // memcmp
 #include <fstream>
 #include <iostream>
 #include <limits> // std::numeric_limits
@@ -26,7 +27,20 @@ static bool binaryToText(const string& infilename, const string& outfilename)
         return false;
     }
 
-    if (string(header.magic) != "CELXYZV")
+    // Indexed files share the fields of the plain header; skip their
+    // index to get to the samples.
+    if (memcmp(header.magic, "CELXYZVI", sizeof(header.magic)) == 0)
+    {
+        XYZVIndexedHeader indexedHeader;
+        in.seekg(0);
+        if (!in.read(reinterpret_cast<char*>(&indexedHeader), sizeof(indexedHeader)))
+        {
+            fmt::fprintf(cerr, _("Error reading header of %s.\n"), infilename);
+            return false;
+        }
+        in.seekg(sizeof(indexedHeader) + (indexedHeader.chunkCount + 1) * sizeof(uint64_t));
+    }
+    else if (string(header.magic) != "CELXYZV")
     {
         fmt::fprintf(cerr, _("Bad binary xyzv file %s.\n"), infilename);
         return false;
@@ -1,14 +1,18 @@
 #include <celephem/xyzvbinary.h>
 #include <celutil/bytes.h> // __BYTE_ORDER__
 #include <fmt/printf.h>
+#include <algorithm>
+#include <cmath>
 #include <cstring> // memcpy
 #include <fstream>
 #include <iostream>
 #include <limits> // std::numeric_limits
+#include <vector>
 
 using namespace std;
 
 constexpr char magic[8] = "CELXYZV";
+constexpr char indexedMagic[9] = "CELXYZVI";
 
 // Scan past comments. A comment begins with the # character and ends
 // with a newline. Return true if the stream state is good. The stream
@@ -104,17 +108,95 @@ static bool xyzvToBinary(const string& inFilename, const string& outFilename)
     return !!out.write(reinterpret_cast<char*>(&header), sizeof(header));
 }
 
+// Convert text xyzv file to an indexed binary file, which Celestia memory
+// maps instead of reading. Samples must be in time order; samples with
+// duplicate times are dropped, as Celestia does when loading them.
+static bool xyzvToIndexedBinary(const string& inFilename, const string& outFilename)
+{
+    ifstream in(inFilename);
+    if (!in.good() || !SkipComments(in))
+        return false;
+
+    vector<XYZVBinaryData> samples;
+    double boundingRadius = 0.0;
+    XYZVBinaryData data;
+    while (in.good())
+    {
+        in >> data.tdb;
+        in >> data.position[0];
+        in >> data.position[1];
+        in >> data.position[2];
+        in >> data.velocity[0];
+        in >> data.velocity[1];
+        in >> data.velocity[2];
+
+        if (!in.good())
+            continue;
+
+        if (!samples.empty() && data.tdb <= samples.back().tdb)
+        {
+            if (data.tdb == samples.back().tdb)
+                continue;
+            fmt::fprintf(cerr, "Sample at %.7lf is out of time order.\n", data.tdb);
+            return false;
+        }
+
+        double r = sqrt(data.position[0] * data.position[0] +
+                        data.position[1] * data.position[1] +
+                        data.position[2] * data.position[2]);
+        boundingRadius = max(boundingRadius, r);
+        samples.push_back(data);
+    }
+
+    if (samples.empty())
+        return false;
+
+    XYZVIndexedHeader header;
+    memcpy(header.magic, indexedMagic, 8);
+    header.byteOrder = __BYTE_ORDER__;
+    header.digits = std::numeric_limits<double>::digits;
+    header.reserved = 0;
+    header.count = samples.size();
+    header.chunkCount = max((uint64_t) 1, header.count / XYZV_SAMPLES_PER_CHUNK);
+    header.startTime = samples.front().tdb;
+    header.chunkDuration = (samples.back().tdb - samples.front().tdb) / (double) header.chunkCount;
+    if (!(header.chunkDuration > 0.0))
+        header.chunkDuration = 1.0;
+    header.boundingRadius = boundingRadius;
+
+    // Number of samples before the start of each chunk
+    vector<uint64_t> index(header.chunkCount + 1);
+    for (uint64_t i = 0; i < header.chunkCount; i++)
+    {
+        double start = header.startTime + (double) i * header.chunkDuration;
+        auto iter = lower_bound(samples.begin(), samples.end(), start,
+                                [](const XYZVBinaryData& s, double t) { return s.tdb < t; });
+        index[i] = (uint64_t) (iter - samples.begin());
+    }
+    index[header.chunkCount] = header.count;
+
+    ofstream out(outFilename, ios::binary);
+    out.write(reinterpret_cast<char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<char*>(index.data()), index.size() * sizeof(uint64_t));
+    out.write(reinterpret_cast<char*>(samples.data()), samples.size() * sizeof(XYZVBinaryData));
+
+    return out.good();
+}
+
 int main(int argc, char* argv[])
 {
-    if (argc < 3)
+    bool indexed = argc == 4 && strcmp(argv[1], "--indexed") == 0;
+    if (argc != 3 && !indexed)
     {
-        fmt::fprintf(cerr, "Usage: %s infile.xyzv outfile.bin\n", argv[0]);
+        fmt::fprintf(cerr, "Usage: %s [--indexed] infile.xyzv outfile.bin\n", argv[0]);
         return 1;
     }
 
-    if (!xyzvToBinary(argv[1], argv[2]))
+    const char* inFilename = argv[argc - 2];
+    const char* outFilename = argv[argc - 1];
+    if (!(indexed ? xyzvToIndexedBinary(inFilename, outFilename) : xyzvToBinary(inFilename, outFilename)))
     {
-        fmt::fprintf(cerr, "Error converting %s to %s.\n", argv[1], argv[2]);
+        fmt::fprintf(cerr, "Error converting %s to %s.\n", inFilename, outFilename);
         return 1;
     }
 
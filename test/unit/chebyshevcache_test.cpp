@@ -0,0 +1,152 @@
+#include <memory>
+#include <random>
+#include <thread>
+#include <celmath/mathlib.h>
+#include <celephem/chebyshevcache.h>
+#include <celephem/customorbit.h>
+#include <celephem/vsop87.h>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+using namespace Eigen;
+
+constexpr const double J2000 = 2451545.0;
+constexpr const double TOLERANCE = 0.001;
+
+// Compare an orbit evaluated through Chebyshev fits with the same orbit
+// computed from its analytic theory, at random times around J2000 which
+// are each looked up twice so that their windows get fitted.
+static void checkOrbit(Orbit* (*create)(const std::string&), const std::string& name, double span)
+{
+    ChebyshevCache::setDefaultTolerance(0.0);
+    Orbit* analytic = create(name);
+    ChebyshevCache::setDefaultTolerance(TOLERANCE);
+    Orbit* cached = create(name);
+    REQUIRE(analytic != nullptr);
+    REQUIRE(cached != nullptr);
+
+    std::mt19937 gen(1234);
+    std::uniform_real_distribution<double> time(J2000, J2000 + span);
+    std::vector<double> times(500);
+    for (auto& t : times)
+        t = time(gen);
+
+    for (double t : times)
+        cached->positionAtTime(t);
+
+    double maxError = 0.0;
+    double maxVelocityError = 0.0;
+    for (double t : times)
+    {
+        maxError = std::max(maxError, (cached->positionAtTime(t) - analytic->positionAtTime(t)).norm());
+
+        // Central difference of the analytic positions
+        double t0 = t - 1.0e-4;
+        double t1 = t + 1.0e-4;
+        Vector3d v = cached->velocityAtTime(t);
+        Vector3d reference = (analytic->positionAtTime(t1) - analytic->positionAtTime(t0)) / (t1 - t0);
+        maxVelocityError = std::max(maxVelocityError, (v - reference).norm() / reference.norm());
+    }
+
+    INFO(name << ": position error " << maxError << " km, relative velocity error " << maxVelocityError);
+    REQUIRE(maxError <= TOLERANCE);
+    REQUIRE(maxVelocityError <= 1.0e-5);
+
+    delete analytic;
+    delete cached;
+}
+
+// A circular orbit with a period of ten days, counting its evaluations
+class CircularOrbit : public CachingOrbit
+{
+ public:
+    Vector3d computePosition(double jd) const override
+    {
+        evaluations++;
+        double theta = 2.0 * PI * jd / getPeriod();
+        return Vector3d(cos(theta), 0.0, -sin(theta)) * getBoundingRadius();
+    }
+
+    double getPeriod() const override { return 10.0; }
+    double getBoundingRadius() const override { return 1.0e6; }
+
+    mutable unsigned int evaluations{ 0 };
+};
+
+TEST_CASE("ChebyshevCache", "[ChebyshevCache]")
+{
+    SECTION("Windows are fitted when used again")
+    {
+        CircularOrbit orbit;
+        ChebyshevCache cache(orbit, TOLERANCE);
+
+        cache.position(J2000 + 0.5);
+        REQUIRE(cache.getFitCount() == 0);
+        REQUIRE(orbit.evaluations == 1);
+
+        REQUIRE((cache.position(J2000 + 0.6) - orbit.computePosition(J2000 + 0.6)).norm() <= TOLERANCE);
+        REQUIRE(cache.getFitCount() == 1);
+
+        unsigned int evaluations = orbit.evaluations;
+        for (int i = 0; i < 100; i++)
+        {
+            double t = J2000 + 0.5 + i * 0.01;
+            REQUIRE((cache.position(t) - orbit.computePosition(t)).norm() <= TOLERANCE);
+        }
+        REQUIRE(orbit.evaluations == evaluations + 100);
+        REQUIRE(cache.getFitCount() == 1);
+    }
+
+    SECTION("Concurrent evaluation")
+    {
+        // Several threads looking up the same orbit, with windows fitted
+        // and evicted while the others use them
+        ChebyshevCache::setDefaultTolerance(0.0);
+        std::unique_ptr<Orbit> analytic(CreateVSOP87Orbit("vsop87-mars"));
+        ChebyshevCache::setDefaultTolerance(TOLERANCE);
+        std::unique_ptr<Orbit> cached(CreateVSOP87Orbit("vsop87-mars"));
+
+        std::vector<std::thread> threads;
+        std::vector<double> maxErrors(4, 0.0);
+        for (unsigned int i = 0; i < maxErrors.size(); i++)
+        {
+            threads.emplace_back([&, i]()
+            {
+                std::mt19937 gen(i);
+                std::uniform_real_distribution<double> time(J2000, J2000 + 20.0 * 687.0);
+                for (int j = 0; j < 2000; j++)
+                {
+                    double t = time(gen);
+                    Vector3d p = cached->positionAtTime(t);
+                    cached->velocityAtTime(t);
+                    double error = (cached->positionAtTime(t) - p).norm();
+                    error = std::max(error, (p - analytic->positionAtTime(t)).norm());
+                    maxErrors[i] = std::max(maxErrors[i], error);
+                }
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+
+        for (double error : maxErrors)
+            REQUIRE(error <= TOLERANCE);
+    }
+
+    SECTION("VSOP87")
+    {
+        checkOrbit(CreateVSOP87Orbit, "vsop87-earth", 365.25);
+        checkOrbit(CreateVSOP87Orbit, "vsop87-jupiter", 3652.5);
+        checkOrbit(CreateVSOP87Orbit, "vsop87-sun", 365.25);
+    }
+
+    SECTION("Custom orbits")
+    {
+        checkOrbit(GetCustomOrbit, "moon", 60.0);
+        checkOrbit(GetCustomOrbit, "jupiter", 3652.5);
+        checkOrbit(GetCustomOrbit, "io", 5.0);
+        checkOrbit(GetCustomOrbit, "callisto", 30.0);
+        checkOrbit(GetCustomOrbit, "titan", 30.0);
+        checkOrbit(GetCustomOrbit, "hyperion", 40.0);
+    }
+}
@@ -0,0 +1,185 @@
+#include <cmath>
+#include <memory>
+#include <vector>
+#include <celmath/mathlib.h>
+#include <celephem/orbit.h>
+#include <celengine/star.h>
+#include <celestia/eventfinder.h>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+using namespace Eigen;
+
+constexpr const double EPOCH = 2451545.0;
+// Distances of the near and far objects from the observer in km
+constexpr const double NEAR_DISTANCE = 1.0e6;
+constexpr const double FAR_DISTANCE = 2.0e6;
+
+namespace
+{
+// Motion along a straight line through origin at EPOCH, with an optional
+// sinusoidal wobble
+class LinearOrbit : public Orbit
+{
+ public:
+    LinearOrbit(const Vector3d& _origin, const Vector3d& _velocity,
+                const Vector3d& _wobble = Vector3d::Zero(), double _wobblePeriod = 1.0) :
+        origin(_origin),
+        velocity(_velocity),
+        wobble(_wobble),
+        wobblePeriod(_wobblePeriod)
+    {
+    }
+
+    Vector3d positionAtTime(double jd) const override
+    {
+        double t = jd - EPOCH;
+        return origin + velocity * t + wobble * std::sin(2.0 * PI * t / wobblePeriod);
+    }
+
+    double getPeriod() const override         { return 1.0e6; }
+    double getBoundingRadius() const override { return 1.0e8; }
+    bool isPeriodic() const override          { return false; }
+
+ private:
+    Vector3d origin;
+    Vector3d velocity;
+    Vector3d wobble;
+    double wobblePeriod;
+};
+
+// A star of some radius moving along an orbit around the origin
+struct TestObject
+{
+    TestObject(float radius, Orbit* _orbit) :
+        orbit(_orbit),
+        details(StarDetails::CreateStandardStarType("G2V", 5772.0f, 25.0f))
+    {
+        details->setRadius(radius);
+        details->addKnowledge(StarDetails::KnowRadius);
+        details->setOrbit(orbit.get());
+        star.setDetails(details.get());
+        star.setPosition(0.0f, 0.0f, 0.0f);
+    }
+
+    std::unique_ptr<Orbit> orbit;
+    std::unique_ptr<StarDetails> details;
+    Star star;
+};
+
+// Separation of the disks seen from the observer, computed independently
+// of EventFinder; negative while they overlap
+double overlap(const TestObject& observer, const TestObject& a, const TestObject& b, double t)
+{
+    UniversalCoord origin = observer.star.getPosition(t);
+    Vector3d p1 = a.star.getPosition(t).offsetFromKm(origin);
+    Vector3d p2 = b.star.getPosition(t).offsetFromKm(origin);
+    return std::acos(p1.normalized().dot(p2.normalized())) -
+           std::asin(a.star.getRadius() / p1.norm()) -
+           std::asin(b.star.getRadius() / p2.norm());
+}
+
+// Check that the contacts of an event are roots of the overlap, found
+// to within a few seconds
+void checkContacts(const TestObject& observer, const TestObject& a, const TestObject& b, const Event& event)
+{
+    constexpr double dt = 1.0e-4;
+    REQUIRE(event.startTime < event.time);
+    REQUIRE(event.time < event.endTime);
+    REQUIRE(overlap(observer, a, b, event.startTime - dt) > 0.0);
+    REQUIRE(overlap(observer, a, b, event.startTime + dt) < 0.0);
+    REQUIRE(overlap(observer, a, b, event.endTime - dt) < 0.0);
+    REQUIRE(overlap(observer, a, b, event.endTime + dt) > 0.0);
+}
+}
+
+TEST_CASE("Occultations and transits", "[EventFinder]")
+{
+    TestObject observer(1.0f, new LinearOrbit(Vector3d::Zero(), Vector3d::Zero()));
+    const double start = EPOCH - 5.0;
+    const double end = EPOCH + 5.0;
+
+    SECTION("Nearer larger disk occults the farther one")
+    {
+        // Angular radii of 0.01 and 0.001 radians; the far object crosses
+        // behind the near one at EPOCH.
+        TestObject nearObject(1.0e4f, new LinearOrbit(Vector3d(NEAR_DISTANCE, 0.0, 0.0), Vector3d::Zero()));
+        TestObject farObject(2.0e3f, new LinearOrbit(Vector3d(FAR_DISTANCE, 0.0, 0.0), Vector3d(0.0, 1.0e5, 0.0)));
+
+        // The nearer object is listed first whatever the order of the pair
+        EventFinder finder(Selection(&observer.star));
+        finder.addPair(Selection(&farObject.star), Selection(&nearObject.star));
+
+        std::vector<Event> events;
+        finder.findEvents(start, end, Event::Occultation | Event::Transit, events);
+        REQUIRE(events.size() == 1);
+        const Event& event = events[0];
+        REQUIRE(event.type == Event::Occultation);
+        REQUIRE(event.first.star() == &nearObject.star);
+        REQUIRE(event.second.star() == &farObject.star);
+        REQUIRE(event.time == Approx(EPOCH).margin(1.0e-5));
+        REQUIRE(event.separation < 1.0e-6);
+        checkContacts(observer, nearObject, farObject, event);
+
+        // The geometry is symmetric about EPOCH
+        REQUIRE(event.startTime + event.endTime == Approx(2.0 * EPOCH).margin(1.0e-5));
+
+        std::vector<Event> transits;
+        finder.findEvents(start, end, Event::Transit, transits);
+        REQUIRE(transits.empty());
+    }
+
+    SECTION("Nearer smaller disk transits the farther one")
+    {
+        TestObject nearObject(1.0e3f, new LinearOrbit(Vector3d(NEAR_DISTANCE, 0.0, 0.0), Vector3d::Zero()));
+        TestObject farObject(2.0e5f, new LinearOrbit(Vector3d(FAR_DISTANCE, 0.0, 0.0), Vector3d(0.0, 1.0e5, 0.0)));
+
+        EventFinder finder(Selection(&observer.star));
+        finder.addPair(Selection(&nearObject.star), Selection(&farObject.star));
+
+        std::vector<Event> events;
+        finder.findEvents(start, end, Event::Occultation | Event::Transit, events);
+        REQUIRE(events.size() == 1);
+        const Event& event = events[0];
+        REQUIRE(event.type == Event::Transit);
+        REQUIRE(event.first.star() == &nearObject.star);
+        REQUIRE(event.time == Approx(EPOCH).margin(1.0e-5));
+        checkContacts(observer, nearObject, farObject, event);
+        REQUIRE(event.startTime + event.endTime == Approx(2.0 * EPOCH).margin(1.0e-5));
+    }
+
+    SECTION("An overlap with several minima is reported once")
+    {
+        // The wobble makes the far object double back several times while
+        // behind the near one, so the separation has several minima.
+        TestObject nearObject(1.0e4f, new LinearOrbit(Vector3d(NEAR_DISTANCE, 0.0, 0.0), Vector3d::Zero()));
+        TestObject farObject(2.0e3f, new LinearOrbit(Vector3d(FAR_DISTANCE, 0.0, 0.0), Vector3d(0.0, 2.0e4, 0.0),
+                                                     Vector3d(0.0, 2.0e3, 0.0), 0.5));
+
+        EventFinder finder(Selection(&observer.star));
+        finder.addPair(Selection(&nearObject.star), Selection(&farObject.star));
+
+        std::vector<Event> events;
+        finder.findEvents(start, end, Event::Conjunction | Event::Occultation, events);
+
+        std::vector<Event> conjunctions;
+        std::vector<Event> occultations;
+        for (const auto& event : events)
+            (event.type == Event::Conjunction ? conjunctions : occultations).push_back(event);
+
+        REQUIRE(occultations.size() == 1);
+        const Event& occultation = occultations[0];
+        checkContacts(observer, nearObject, farObject, occultation);
+        REQUIRE(occultation.startTime + occultation.endTime == Approx(2.0 * EPOCH).margin(1.0e-5));
+
+        // The wobble also makes minima outside of the overlap
+        int overlapMinima = 0;
+        for (const auto& conjunction : conjunctions)
+        {
+            if (conjunction.time > occultation.startTime && conjunction.time < occultation.endTime)
+                overlapMinima++;
+        }
+        REQUIRE(overlapMinima >= 3);
+    }
+}
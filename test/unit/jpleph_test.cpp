@@ -0,0 +1,197 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <celephem/jpleph.h>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+using namespace Eigen;
+
+constexpr const unsigned int RECORD_SIZE = 400;
+constexpr const unsigned int N_RECORDS = 10;
+constexpr const unsigned int N_COEFFS = 4;
+constexpr const unsigned int N_GRANULES = 2;
+constexpr const double START_DATE = 2451536.5;
+constexpr const double INTERVAL = 32.0;
+
+// Write a value in big endian order, as in the files distributed by JPL
+template<typename T> static void writeBE(std::vector<char>& buf, size_t offset, T value)
+{
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    for (size_t i = 0; i < sizeof(T); i++)
+        buf[offset + i] = bytes[sizeof(T) - 1 - i];
+}
+
+// Build a small DE file: every body has the same layout, and the first
+// Chebyshev coefficient of each coordinate tells the body, the record,
+// the granule and the coordinate apart. The second one is 1, and the
+// others are c2 and c3.
+static std::string makeEphemeris(double c2 = 0.0, double c3 = 0.0)
+{
+    std::vector<char> buf((size_t) (N_RECORDS + 2) * RECORD_SIZE * 8, 0);
+    writeBE<double>(buf, 2652, START_DATE);
+    writeBE<double>(buf, 2660, START_DATE + N_RECORDS * INTERVAL);
+    writeBE<double>(buf, 2668, INTERVAL);
+    writeBE<double>(buf, 2680, 149597870.7);
+    writeBE<double>(buf, 2688, 81.3);
+    for (uint32_t i = 0; i < 12; i++)
+    {
+        uint32_t nCoeffs = i < 11 ? N_COEFFS : 0;
+        writeBE<uint32_t>(buf, 2696 + i * 12, 3 + i * N_COEFFS * 3 * N_GRANULES);
+        writeBE<uint32_t>(buf, 2700 + i * 12, nCoeffs);
+        writeBE<uint32_t>(buf, 2704 + i * 12, N_GRANULES);
+    }
+    writeBE<uint32_t>(buf, 2840, 999);
+
+    for (unsigned int r = 0; r < N_RECORDS; r++)
+    {
+        size_t record = (size_t) (r + 2) * RECORD_SIZE * 8;
+        writeBE<double>(buf, record, START_DATE + r * INTERVAL);
+        writeBE<double>(buf, record + 8, START_DATE + (r + 1) * INTERVAL);
+        for (unsigned int i = 0; i < 11 * N_GRANULES * 3; i++)
+        {
+            size_t coeffs = record + (2 + i * N_COEFFS) * 8;
+            writeBE<double>(buf, coeffs, i * 1000.0 + r);
+            writeBE<double>(buf, coeffs + 8, 1.0);
+            writeBE<double>(buf, coeffs + 16, c2);
+            writeBE<double>(buf, coeffs + 24, c3);
+        }
+    }
+
+    return std::string(buf.begin(), buf.end());
+}
+
+// Position of a body at the start of granule + u
+static Vector3d expected(unsigned int body, unsigned int record, unsigned int granule, double u)
+{
+    unsigned int first = (body * N_GRANULES + granule) * 3;
+    return Vector3d((first + 0) * 1000.0 + record + u,
+                    (first + 1) * 1000.0 + record + u,
+                    (first + 2) * 1000.0 + record + u);
+}
+
+TEST_CASE("JPL ephemeris", "[JPLEphemeris]")
+{
+    std::istringstream in(makeEphemeris());
+    std::unique_ptr<JPLEphemeris> eph(JPLEphemeris::load(in));
+    REQUIRE(eph != nullptr);
+    REQUIRE(eph->getDENumber() == 999);
+    REQUIRE(eph->getStartDate() == START_DATE);
+    REQUIRE(eph->getEndDate() == START_DATE + N_RECORDS * INTERVAL);
+
+    SECTION("Positions are read from the records")
+    {
+        // Middle of the second granule of record 3
+        double t = START_DATE + 3 * INTERVAL + INTERVAL * 0.75;
+        REQUIRE(eph->getPlanetPosition(JPLEph_Mars, t) == expected(JPLEph_Mars, 3, 1, 0.0));
+        REQUIRE(eph->getPlanetPosition(JPLEph_Sun, t) == expected(JPLEph_Sun, 3, 1, 0.0));
+
+        // The end of the ephemeris is the end of the last granule
+        REQUIRE(eph->getPlanetPosition(JPLEph_Venus, eph->getEndDate()) ==
+                expected(JPLEph_Venus, N_RECORDS - 1, 1, 1.0));
+    }
+
+    SECTION("States of several objects at once")
+    {
+        // Cubic polynomials, so that the derivatives of T2 and T3 are used
+        const double c2 = 0.5;
+        const double c3 = 0.25;
+        std::istringstream curvedIn(makeEphemeris(c2, c3));
+        std::unique_ptr<JPLEphemeris> curved(JPLEphemeris::load(curvedIn));
+        REQUIRE(curved != nullptr);
+
+        JPLEphemItem items[] = { JPLEph_Mars, JPLEph_Earth, JPLEph_Moon, JPLEph_SSB, JPLEph_Sun };
+        Vector3d positions[5];
+        Vector3d velocities[5];
+        double daysPerGranule = INTERVAL / N_GRANULES;
+        for (unsigned int g = 0; g < N_RECORDS * N_GRANULES; g++)
+        {
+            for (double u : { 0.1, 0.3, 0.5, 0.8 })
+            {
+                double t = START_DATE + (g + u) * daysPerGranule;
+                curved->getStates(items, 5, t, positions, velocities);
+                for (unsigned int i = 0; i < 5; i++)
+                {
+                    REQUIRE(positions[i] == curved->getPlanetPosition(items[i], t));
+
+                    // Central difference, within the same granule
+                    double h = 1.0e-3;
+                    Vector3d reference = (curved->getPlanetPosition(items[i], t + h) -
+                                          curved->getPlanetPosition(items[i], t - h)) / (2.0 * h);
+                    REQUIRE((velocities[i] - reference).norm() <= 1.0e-6);
+                }
+
+                // Derivative of x + c2 T2(x) + c3 T3(x), with x from -1 to 1
+                // over the granule; x is only as precise as the Julian date.
+                double x = 2.0 * u - 1.0;
+                double dxdt = 2.0 / daysPerGranule;
+                double v = (1.0 + 4.0 * c2 * x + c3 * (12.0 * x * x - 3.0)) * dxdt;
+                REQUIRE(velocities[0].isApprox(Vector3d::Constant(v), 1.0e-8));
+                REQUIRE(velocities[4].isApprox(Vector3d::Constant(v), 1.0e-8));
+            }
+        }
+    }
+
+    SECTION("Packed ephemerides")
+    {
+        unsigned int mask = (1 << JPLEph_Mars) | (1 << JPLEph_Sun);
+        std::ostringstream out;
+        REQUIRE(eph->writePacked(out, mask, START_DATE + 2 * INTERVAL + 1.0, START_DATE + 5 * INTERVAL - 1.0));
+
+        std::istringstream packedIn(out.str());
+        std::unique_ptr<JPLEphemeris> packed(JPLEphemeris::load(packedIn));
+        REQUIRE(packed != nullptr);
+        REQUIRE(packed->getDENumber() == 999);
+        REQUIRE(packed->getStartDate() == START_DATE + 2 * INTERVAL);
+        REQUIRE(packed->getEndDate() == START_DATE + 5 * INTERVAL);
+        REQUIRE(packed->hasItem(JPLEph_Mars));
+        REQUIRE(packed->hasItem(JPLEph_Sun));
+        REQUIRE(!packed->hasItem(JPLEph_Venus));
+        REQUIRE(!packed->hasItem(JPLEph_Earth));
+
+        for (double t = packed->getStartDate(); t <= packed->getEndDate(); t += 0.7)
+        {
+            REQUIRE(packed->getPlanetPosition(JPLEph_Mars, t) == eph->getPlanetPosition(JPLEph_Mars, t));
+            REQUIRE(packed->getPlanetPosition(JPLEph_Sun, t) == eph->getPlanetPosition(JPLEph_Sun, t));
+        }
+    }
+
+    SECTION("Malformed coefficient layouts are rejected")
+    {
+        // Raw offsets count from 3, and granule counts must be 1 to 32
+        std::string data = makeEphemeris();
+        std::vector<char> buf(data.begin(), data.end());
+        for (auto patch : { std::make_pair(2696 + 4 * 12, 0u),
+                            std::make_pair(2696 + 4 * 12, 2u),
+                            std::make_pair(2704 + 4 * 12, 0u),
+                            std::make_pair(2704 + 4 * 12, 33u) })
+        {
+            std::vector<char> bad = buf;
+            writeBE<uint32_t>(bad, patch.first, patch.second);
+            std::istringstream badIn(std::string(bad.begin(), bad.end()));
+            REQUIRE(JPLEphemeris::load(badIn) == nullptr);
+        }
+    }
+
+    SECTION("Mapped files")
+    {
+        fs::path path("jpleph_test.dat");
+        {
+            std::ofstream out(path.string(), std::ios::binary);
+            out << makeEphemeris();
+        }
+
+        std::unique_ptr<JPLEphemeris> mapped(JPLEphemeris::open(path));
+        REQUIRE(mapped != nullptr);
+        for (double t = START_DATE; t <= eph->getEndDate(); t += 3.3)
+            REQUIRE(mapped->getPlanetPosition(JPLEph_Earth, t) == eph->getPlanetPosition(JPLEph_Earth, t));
+
+        mapped.reset();
+        std::remove(path.string().c_str());
+    }
+}
@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <celengine/name.h>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+static std::vector<std::string> sorted(std::vector<std::string> v)
+{
+    std::sort(v.begin(), v.end());
+    return v;
+}
+
+TEST_CASE("NameDatabase", "[NameDatabase]")
+{
+    NameDatabase db;
+    db.add(1, "Sirius");
+    db.add(1, "ALF CMa");
+    db.add(2, "Sirius B");
+    db.add(3, "Sir");
+    db.add(4, "Canopus");
+    db.add(5, "ALF Cen A");
+    db.add(6, "Arcturus");
+    db.add(7, "Beta Pictoris");
+
+    const char* queries[] = { "", "s", "SIR", "sirius ", "sirius b", "siriusx", "c", "alf", "ALF C", "a", "bet", "x" };
+
+    std::vector<std::vector<std::string>> linear;
+    std::vector<AstroCatalog::IndexNumber> numbers;
+    for (const char* q : queries)
+    {
+        linear.push_back(sorted(db.getCompletion(q)));
+        numbers.push_back(db.getCatalogNumberByName(q));
+    }
+
+    db.buildIndexes();
+
+    SECTION("Same catalog numbers as the name index")
+    {
+        for (size_t i = 0; i < numbers.size(); i++)
+            REQUIRE(db.getCatalogNumberByName(queries[i]) == numbers[i]);
+    }
+
+    SECTION("Exact lookup")
+    {
+        AstroCatalog::IndexNumber invalid = AstroCatalog::InvalidIndex;
+        REQUIRE(db.getCatalogNumberByName("sirius") == 1);
+        REQUIRE(db.getCatalogNumberByName("SIRIUS B") == 2);
+        REQUIRE(db.getCatalogNumberByName("ALF cma") == 1);
+        REQUIRE(db.getCatalogNumberByName(ReplaceGreekLetterAbbr("ALF Cen A")) == 5);
+        REQUIRE(db.getCatalogNumberByName("Siriu") == invalid);
+        REQUIRE(db.getCatalogNumberByName("") == invalid);
+    }
+
+    SECTION("Same completions as the linear search")
+    {
+        for (size_t i = 0; i < linear.size(); i++)
+            REQUIRE(sorted(db.getCompletion(queries[i])) == linear[i]);
+    }
+
+    SECTION("Prefix completion")
+    {
+        REQUIRE(sorted(db.getCompletion("siR", false)) == std::vector<std::string>{ "Sir", "Sirius", "Sirius B" });
+        REQUIRE(db.getCompletion("sirius b", false) == std::vector<std::string>{ "Sirius B" });
+        REQUIRE(db.getCompletion("q", false).empty());
+        REQUIRE(db.getCompletion("", false).size() == db.getNameCount());
+    }
+
+    SECTION("Greek letters")
+    {
+        REQUIRE(db.getCompletion("ALF CM") == std::vector<std::string>{ ReplaceGreekLetterAbbr("ALF CMa") });
+        REQUIRE(db.getCompletion("alpha c").size() == 2);
+    }
+
+    SECTION("Limit")
+    {
+        REQUIRE(db.getCompletion("s", false, 2).size() == 2);
+        REQUIRE(db.getCompletion("s", false, 10).size() == 3);
+        REQUIRE(db.getCompletion("a", true, 1).size() == 1);
+    }
+
+    SECTION("Adding names invalidates the index")
+    {
+        db.add(8, "Sirrah");
+        REQUIRE(db.getCompletion("sirr", false) == std::vector<std::string>{ "Sirrah" });
+        REQUIRE(db.getCatalogNumberByName("sirrah") == 8);
+        db.buildIndexes();
+        REQUIRE(db.getCompletion("sirr", false) == std::vector<std::string>{ "Sirrah" });
+        REQUIRE(db.getCatalogNumberByName("sirrah") == 8);
+    }
+}
@@ -0,0 +1,218 @@
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <vector>
+#include <fmt/printf.h>
+#include <celmath/mathlib.h>
+#include <celephem/samporbit.h>
+#include <celephem/xyzvbinary.h>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+using namespace Eigen;
+
+constexpr const unsigned int N_SAMPLES = 100;
+constexpr const double START_DATE = 2451545.0;
+constexpr const double RADIUS = 1.0e6;
+constexpr const double PERIOD = 30.0;
+
+// Samples of a circular orbit at irregular steps, with velocities in
+// km/s as in xyzv files
+static std::vector<XYZVBinaryData> makeSamples()
+{
+    std::vector<XYZVBinaryData> samples(N_SAMPLES);
+    double w = 2.0 * PI / PERIOD;
+    for (unsigned int i = 0; i < N_SAMPLES; i++)
+    {
+        XYZVBinaryData& s = samples[i];
+        s.tdb = START_DATE + i * 0.5 + (i % 3) * 0.1;
+        double a = w * (s.tdb - START_DATE);
+        s.position[0] = RADIUS * std::cos(a);
+        s.position[1] = RADIUS * std::sin(a);
+        s.position[2] = 1000.0 * i;
+        s.velocity[0] = -RADIUS * w * std::sin(a) / 86400.0;
+        s.velocity[1] = RADIUS * w * std::cos(a) / 86400.0;
+        s.velocity[2] = 1000.0 / 0.5 / 86400.0;
+    }
+    return samples;
+}
+
+static void writeText(const char* filename, const std::vector<XYZVBinaryData>& samples)
+{
+    std::ofstream out(filename);
+    out << "# test trajectory\n";
+    for (const auto& s : samples)
+    {
+        out << fmt::sprintf("%.17g %.17g %.17g %.17g %.17g %.17g %.17g\n",
+                            s.tdb, s.position[0], s.position[1], s.position[2],
+                            s.velocity[0], s.velocity[1], s.velocity[2]);
+    }
+}
+
+// Write an indexed file as xyzv2bin --indexed does
+static void writeIndexed(const char* filename,
+                         const std::vector<XYZVBinaryData>& samples,
+                         uint64_t chunkCount,
+                         std::vector<uint64_t>* badIndex = nullptr)
+{
+    XYZVIndexedHeader header;
+    std::memcpy(header.magic, "CELXYZVI", 8);
+    header.byteOrder = __BYTE_ORDER__;
+    header.digits = std::numeric_limits<double>::digits;
+    header.reserved = 0;
+    header.count = samples.size();
+    header.chunkCount = chunkCount;
+    header.startTime = samples.front().tdb;
+    header.chunkDuration = (samples.back().tdb - samples.front().tdb) / (double) chunkCount;
+    header.boundingRadius = 2.0 * RADIUS;
+
+    std::vector<uint64_t> index(chunkCount + 1);
+    for (uint64_t i = 0; i < chunkCount; i++)
+    {
+        double start = header.startTime + (double) i * header.chunkDuration;
+        uint64_t n = 0;
+        while (n < samples.size() && samples[n].tdb < start)
+            n++;
+        index[i] = n;
+    }
+    index[chunkCount] = samples.size();
+    if (badIndex != nullptr)
+        index = *badIndex;
+
+    std::ofstream out(filename, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(&header), sizeof header);
+    out.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(uint64_t));
+    out.write(reinterpret_cast<const char*>(samples.data()), samples.size() * sizeof(XYZVBinaryData));
+}
+
+namespace
+{
+struct SampleList : public OrbitSampleProc
+{
+    void sample(double t, const Vector3d& p, const Vector3d& v) override
+    {
+        times.push_back(t);
+        positions.push_back(p);
+        velocities.push_back(v);
+    }
+
+    std::vector<double> times;
+    std::vector<Vector3d> positions;
+    std::vector<Vector3d> velocities;
+};
+}
+
+TEST_CASE("Indexed xyzv files", "[SampledOrbit]")
+{
+    std::vector<XYZVBinaryData> samples = makeSamples();
+    writeText("samporbit_test_text.xyzv", samples);
+    writeText("samporbit_test.xyzv", samples);
+    writeIndexed("samporbit_test.xyzvbin", samples, 7);
+
+    SECTION("Mapped files match text files")
+    {
+        for (auto interpolation : { TrajectoryInterpolationLinear, TrajectoryInterpolationCubic })
+        {
+            // The indexed file is found next to the text file
+            std::unique_ptr<Orbit> mapped(LoadXYZVTrajectoryDoublePrec("samporbit_test.xyzv", interpolation));
+            std::unique_ptr<Orbit> text(LoadXYZVTrajectoryDoublePrec("samporbit_test_text.xyzv", interpolation));
+            REQUIRE(mapped != nullptr);
+            REQUIRE(text != nullptr);
+
+            double begin, end;
+            mapped->getValidRange(begin, end);
+            REQUIRE(begin == samples.front().tdb);
+            REQUIRE(end == samples.back().tdb);
+
+            // Before, at and between the samples, across chunk boundaries,
+            // and after them
+            for (double t = START_DATE - 1.0; t <= end + 1.0; t += 0.0371)
+            {
+                Vector3d p0 = text->positionAtTime(t);
+                Vector3d p1 = mapped->positionAtTime(t);
+                REQUIRE((p1 - p0).norm() <= 1.0e-9 * RADIUS);
+
+                if (interpolation == TrajectoryInterpolationCubic)
+                {
+                    Vector3d v0 = text->velocityAtTime(t);
+                    Vector3d v1 = mapped->velocityAtTime(t);
+                    REQUIRE((v1 - v0).norm() <= 1.0e-9 * v0.norm() + 1.0e-9);
+                }
+            }
+            for (size_t i = 0; i < samples.size(); i++)
+            {
+                double t = samples[i].tdb;
+                REQUIRE((mapped->positionAtTime(t) - text->positionAtTime(t)).norm() <= 1.0e-9 * RADIUS);
+
+                // Linear interpolation moves along the chord between samples
+                if (interpolation == TrajectoryInterpolationLinear && i + 1 < samples.size())
+                {
+                    double h = samples[i + 1].tdb - t;
+                    Vector3d chord = (text->positionAtTime(t + h) - text->positionAtTime(t)) / h;
+                    Vector3d v = mapped->velocityAtTime(t + h * 0.5);
+                    REQUIRE((v - chord).norm() <= 1.0e-9 * chord.norm());
+                }
+            }
+
+            // All the samples
+            SampleList all0, all1;
+            text->sample(begin, end, all0);
+            mapped->sample(begin, end, all1);
+            REQUIRE(all1.times == all0.times);
+            for (size_t i = 0; i < all0.times.size(); i++)
+            {
+                REQUIRE((all1.positions[i] - all0.positions[i]).norm() <= 1.0e-9 * RADIUS);
+                REQUIRE((all1.velocities[i] - all0.velocities[i]).norm() <= 1.0e-9 * all0.velocities[i].norm());
+            }
+
+            // A window covers its range with the samples just outside of it
+            SampleList window;
+            double t0 = START_DATE + 10.05;
+            double t1 = START_DATE + 20.05;
+            mapped->sample(t0, t1, window);
+            REQUIRE(!window.times.empty());
+            REQUIRE(window.times.front() < t0);
+            REQUIRE(window.times.back() > t1);
+            for (size_t i = 1; i < window.times.size(); i++)
+                REQUIRE(window.times[i] > window.times[i - 1]);
+        }
+    }
+
+    SECTION("Bad indexed files are rejected")
+    {
+        // No text file to fall back to
+        std::vector<uint64_t> decreasing = { 0, 30, 20, 60, 100 };
+        writeIndexed("samporbit_test_bad.xyzvbin", samples, 4, &decreasing);
+        std::unique_ptr<Orbit> orbit(LoadXYZVTrajectoryDoublePrec("samporbit_test_bad.xyzv", TrajectoryInterpolationCubic));
+        REQUIRE(orbit == nullptr);
+
+        std::vector<uint64_t> tooLarge = { 0, 30, 60, 90, 101 };
+        writeIndexed("samporbit_test_bad.xyzvbin", samples, 4, &tooLarge);
+        orbit.reset(LoadXYZVTrajectoryDoublePrec("samporbit_test_bad.xyzv", TrajectoryInterpolationCubic));
+        REQUIRE(orbit == nullptr);
+
+        // A count whose size in bytes wraps around to the size of the samples
+        uint64_t wrappingCount = (uint64_t(1) << 61) + samples.size();
+        std::vector<uint64_t> wrappingIndex = { 0, 30, 60, 90, wrappingCount };
+        writeIndexed("samporbit_test_bad.xyzvbin", samples, 4, &wrappingIndex);
+        {
+            std::fstream out("samporbit_test_bad.xyzvbin", std::ios::in | std::ios::out | std::ios::binary);
+            out.seekp(offsetof(XYZVIndexedHeader, count));
+            out.write(reinterpret_cast<const char*>(&wrappingCount), sizeof wrappingCount);
+        }
+        orbit.reset(LoadXYZVTrajectoryDoublePrec("samporbit_test_bad.xyzv", TrajectoryInterpolationCubic));
+        REQUIRE(orbit == nullptr);
+
+        std::remove("samporbit_test_bad.xyzvbin");
+    }
+
+    std::remove("samporbit_test_text.xyzv");
+    std::remove("samporbit_test.xyzv");
+    std::remove("samporbit_test.xyzvbin");
+}
@@ -0,0 +1,57 @@
+#include <cmath>
+#include <celmath/solve.h>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+using namespace celmath;
+
+TEST_CASE("Brent's method", "[solve]")
+{
+    SECTION("Roots")
+    {
+        int calls = 0;
+        auto f = [&calls](double x) { calls++; return std::cos(x) - x; };
+        auto sol = solve_brent(f, 0.0, 1.0, 1.0e-12);
+        REQUIRE(sol.first == Approx(0.7390851332151607).margin(1.0e-11));
+        REQUIRE(sol.second <= 1.0e-11);
+        // Far fewer evaluations than the 40 taken by bisection
+        REQUIRE(calls < 15);
+
+        // Roots at the ends of the bracket, and with the bracket reversed
+        REQUIRE(solve_brent([](double x) { return x - 2.0; }, 2.0, 3.0, 1.0e-12).first == Approx(2.0));
+        REQUIRE(solve_brent([](double x) { return x * x * x - 8.0; }, 5.0, -1.0, 1.0e-12).first == Approx(2.0));
+
+        // Functions which are flat near the root converge like bisection
+        auto g = [](double x) { return std::pow(x - 0.3, 9.0); };
+        REQUIRE(solve_brent(g, -1.0, 1.0, 1.0e-10).first == Approx(0.3).margin(1.0e-9));
+
+        // Times in Julian days, found to within a millisecond
+        auto h = [](double t) { return std::sin((t - 2451545.0) * 0.7) - 0.5; };
+        auto root = solve_brent(h, 2451545.0, 2451546.0, 1.0e-8);
+        REQUIRE(std::abs(root.first - (2451545.0 + std::asin(0.5) / 0.7)) < 1.0e-8);
+    }
+
+    SECTION("Minima")
+    {
+        int calls = 0;
+        auto f = [&calls](double x) { calls++; return (x - 1.5) * (x - 1.5) + 2.0; };
+        auto min = minimize_brent(f, 0.0, 1.0, 4.0, 1.0e-10);
+        REQUIRE(min.first == Approx(1.5).margin(1.0e-9));
+        REQUIRE(min.second == Approx(2.0));
+
+        // Parabolic steps find the minimum of a parabola at once
+        calls = 0;
+        REQUIRE(minimize_brent(f, 0.0, 1.0, 4.0, 1.0e-6).first == Approx(1.5).margin(1.0e-6));
+        REQUIRE(calls < 10);
+
+        // A minimum where the function isn't smooth
+        auto g = [](double x) { return std::abs(x - 0.25); };
+        REQUIRE(minimize_brent(g, -1.0, 0.0, 1.0, 1.0e-10).first == Approx(0.25).margin(1.0e-9));
+
+        // The angle between two bodies passing each other
+        auto h = [](double t) { return std::atan2(std::abs(t - 2451545.3), 1.0e3); };
+        auto closest = minimize_brent(h, 2451545.0, 2451545.25, 2451546.0, 1.0e-8);
+        REQUIRE(std::abs(closest.first - 2451545.3) < 1.0e-7);
+    }
+}
@@ -0,0 +1,55 @@
+#include <random>
+#include <memory>
+#include <celephem/vsop87.h>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+using namespace Eigen;
+
+constexpr const double J2000 = 2451545.0;
+
+// The vectorized series, at one time and in batches, must give the same
+// positions as the series summed term by term.
+TEST_CASE("VSOP87", "[VSOP87]")
+{
+    const char* names[] =
+    {
+        "vsop87-mercury", "vsop87-venus", "vsop87-earth", "vsop87-mars",
+        "vsop87-jupiter", "vsop87-saturn", "vsop87-uranus", "vsop87-neptune",
+        "vsop87-sun",
+    };
+
+    // Times spread over the whole range of the theory, -4000 to 4000
+    std::mt19937 gen(1234);
+    std::uniform_real_distribution<double> year(-6000.0, 2000.0);
+    std::vector<double> times(101);
+    for (auto& t : times)
+        t = J2000 + year(gen) * 365.25;
+
+    for (const char* name : names)
+    {
+        std::unique_ptr<CachingOrbit> scalar(CreateVSOP87SeriesOrbit(name, true));
+        std::unique_ptr<CachingOrbit> vector(CreateVSOP87SeriesOrbit(name, false));
+        REQUIRE(scalar != nullptr);
+        REQUIRE(vector != nullptr);
+
+        std::vector<Vector3d> batch(times.size());
+        vector->computePositions(times.data(), batch.data(), (unsigned int) times.size());
+
+        double maxError = 0.0;
+        double maxBatchError = 0.0;
+        for (size_t i = 0; i < times.size(); i++)
+        {
+            Vector3d reference = scalar->computePosition(times[i]);
+            maxError = std::max(maxError, (vector->computePosition(times[i]) - reference).norm() / reference.norm());
+            maxBatchError = std::max(maxBatchError, (batch[i] - reference).norm() / reference.norm());
+        }
+
+        INFO(name << ": relative error " << maxError << ", in batches " << maxBatchError);
+        REQUIRE(maxError <= 1.0e-12);
+        REQUIRE(maxBatchError <= 1.0e-12);
+    }
+
+    REQUIRE(CreateVSOP87SeriesOrbit("vsop87-pluto") == nullptr);
+}